@@ -414,6 +414,9 @@ struct efcp_config {
 
 	ssize_t *pci_offset_table;
 
+	/* Fixed PCI layout for dt_cons, if any; kernel only */
+	const struct pci_layout * pci_layout;
+
         /* FIXME: Left here for phase 2 */
         struct policy * unknown_flow;
 
@@ -817,9 +820,32 @@ struct irati_ctrldev_ctldata {
 	irati_msg_port_t port_id;
 };
 
+/* Data structure passed along with ioctl */
+struct irati_mgmtdev_ctldata {
+	ipc_process_id_t ipcp_id;
+};
+
+/*
+ * A management SDU channel (an I/O device bound with IRATI_MGMT_BIND)
+ * carries batches of management SDUs: every read() or write() transfers
+ * one or more records back to back, each one made of this header followed
+ * by the SDU and padded to IRATI_MGMT_SDU_ALIGN bytes. The padding of the
+ * last record of a write() may be omitted.
+ */
+struct irati_mgmt_sdu_hdr {
+	uint32_t port_id;
+	uint32_t size;
+};
+
+#define IRATI_MGMT_SDU_ALIGN 8
+#define IRATI_MGMT_SDU_LEN(size)					\
+	((sizeof(struct irati_mgmt_sdu_hdr) + (size) +			\
+	  IRATI_MGMT_SDU_ALIGN - 1) & ~(IRATI_MGMT_SDU_ALIGN - 1))
+
 #define IRATI_FLOW_BIND _IOW(0xAF, 0x00, struct irati_iodev_ctldata)
 #define IRATI_CTRL_FLOW_BIND _IOW(0xAF, 0x01, struct irati_ctrldev_ctldata)
 #define IRATI_IOCTL_MSS_GET _IOR(0xAF, 0x02, struct irati_iodev_ctldata)
+#define IRATI_MGMT_BIND _IOW(0xAF, 0x03, struct irati_mgmtdev_ctldata)
 
 #ifdef __cplusplus
 }
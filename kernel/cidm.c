@@ -19,7 +19,15 @@
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <linux/spinlock.h>
 #include <linux/bitmap.h>
+#include <linux/list.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/timekeeping.h>
+#include <linux/math64.h>
 
 #define RINA_PREFIX "cidm"
 
@@ -28,19 +36,25 @@
 #include "utils.h"
 #include "cidm.h"
 #include "common.h"
+#include "rds/rbmp.h"
 
-#define MAX_CEP_ID (((2 << BITS_PER_BYTE) * sizeof(cep_id_t)) - 1)
+/* Until the DIF is configured, use the default 2 bytes cep-id PCI field */
+#define DEFAULT_CEP_ID_LENGTH 2
 
 struct cidm {
-	struct list_head allocated_cep_ids;
-	cep_id_t last_allocated;
-    	spinlock_t lock;
+	struct rbmp * ids;
+	size_t        max_cep_id;
+    	spinlock_t    lock;
 };
 
-struct alloc_cepid {
-        struct list_head       list;
-        cep_id_t cep_id;
-};
+/* Largest cep-id that fits in a cep-id PCI field of the given length */
+static size_t max_cep_id(size_t cep_id_length)
+{
+	if (cep_id_length >= sizeof(cep_id_t))
+		return INT_MAX;
+
+	return (1UL << (cep_id_length * BITS_PER_BYTE)) - 1;
+}
 
 struct cidm * cidm_create(void)
 {
@@ -50,93 +64,94 @@ struct cidm * cidm_create(void)
 	if (!instance)
 		return NULL;
 
-    	spin_lock_init(&instance->lock);
+	instance->max_cep_id = max_cep_id(DEFAULT_CEP_ID_LENGTH);
+	instance->ids = rbmp_create(instance->max_cep_id, 1);
+	if (!instance->ids) {
+		rkfree(instance);
+		return NULL;
+	}
 
-    	spin_lock(&instance->lock);
-	INIT_LIST_HEAD(&(instance->allocated_cep_ids));
-	instance->last_allocated = 0;
-    	spin_unlock(&instance->lock);
+    	spin_lock_init(&instance->lock);
 
-	LOG_INFO("Instance initialized successfully (%zd cep-ids)",
-			MAX_CEP_ID);
+	LOG_INFO("Instance initialized successfully (%zu cep-ids)",
+			instance->max_cep_id);
 
 	return instance;
 }
 
-int cidm_destroy(struct cidm * instance)
+int cidm_config_set(struct cidm * instance,
+		    size_t        cep_id_length)
 {
-	struct alloc_cepid * pos, * next;
+	struct rbmp * ids, * old;
+	size_t        max;
 
-        if (!instance) {
-                LOG_ERR("Bogus instance passed, bailing out");
-                return -1;
-        }
+	if (!instance || !cep_id_length) {
+		LOG_ERR("Bogus input parameters, bailing out");
+		return -1;
+	}
 
-        spin_lock(&instance->lock);
-        list_for_each_entry_safe(pos, next, &instance->allocated_cep_ids, list) {
-                rkfree(pos);
-        }
-        spin_unlock(&instance->lock);
+	max = max_cep_id(cep_id_length);
+	if (max == instance->max_cep_id)
+		return 0;
 
-        rkfree(instance);
+	ids = rbmp_create(max, 1);
+	if (!ids)
+		return -1;
 
-        return 0;
+	/* The range can only change while no cep-id is in use */
+	spin_lock(&instance->lock);
+	old = instance->ids;
+	if (rbmp_is_id_ok(old, rbmp_next(old, 1))) {
+		spin_unlock(&instance->lock);
+		rbmp_destroy(ids);
+		LOG_ERR("Cannot resize the cep-id range, cep-ids in use");
+		return -1;
+	}
+	instance->ids        = ids;
+	instance->max_cep_id = max;
+	spin_unlock(&instance->lock);
+
+	rbmp_destroy(old);
+
+	LOG_DBG("Cep-id range set to 1-%zu (%zu bytes long cep-ids)",
+		max, cep_id_length);
+
+	return 0;
 }
 
-int cidm_allocated(struct cidm * instance, cep_id_t cep_id)
+int cidm_destroy(struct cidm * instance)
 {
-	struct alloc_cepid * pos, * next;
-
-        list_for_each_entry_safe(pos, next, &instance->allocated_cep_ids, list) {
-                if (pos->cep_id == cep_id) {
-                    spin_unlock(&instance->lock);
-                	return 1;
-                }
+        if (!instance) {
+                LOG_ERR("Bogus instance passed, bailing out");
+                return -1;
         }
 
+        rbmp_destroy(instance->ids);
+        rkfree(instance);
+
         return 0;
 }
 
 cep_id_t cidm_allocate(struct cidm * instance)
 {
-	struct alloc_cepid * new_cep_id;
-        cep_id_t cep_id;
+        ssize_t cep_id;
 
         if (!instance) {
                 LOG_ERR("Bogus instance passed, bailing out");
-                return port_id_bad();
+                return cep_id_bad();
         }
 
 	spin_lock(&instance->lock);
-        if (instance->last_allocated == MAX_CEP_ID) {
-        	cep_id = 1;
-        } else {
-        	cep_id = instance->last_allocated + 1;
-        }
-
-        while (cidm_allocated(instance, cep_id)) {
-        	if (cep_id == MAX_CEP_ID) {
-        		cep_id = 1;
-        	} else {
-        		cep_id ++;
-        	}
-        }
+        cep_id = rbmp_allocate(instance->ids);
+	spin_unlock(&instance->lock);
 
-        new_cep_id = rkmalloc(sizeof(*new_cep_id), GFP_ATOMIC);
-        if (!new_cep_id) {
-		spin_unlock(&instance->lock);
-		LOG_ERR("Not enough memory to allocate cep-id %d", cep_id);
+        if (!rbmp_is_id_ok(instance->ids, cep_id)) {
+		LOG_ERR("No cep-id available");
         	return cep_id_bad();
 	}
 
-        INIT_LIST_HEAD(&(new_cep_id->list));
-        new_cep_id->cep_id = cep_id;
-        list_add(&(new_cep_id->list), &(instance->allocated_cep_ids));
-
-        instance->last_allocated = cep_id;
-	spin_unlock(&instance->lock);
-
-        LOG_DBG("Cep-id allocation completed successfully (id = %d)", cep_id);
+        LOG_DBG("Cep-id allocation completed successfully (id = %zd)",
+                cep_id);
 
         return cep_id;
 }
@@ -144,9 +159,9 @@ cep_id_t cidm_allocate(struct cidm * instance)
 int cidm_release(struct cidm * instance,
                  cep_id_t      id)
 {
-	struct alloc_cepid * pos, * next;
+	int ret;
 
-	if (!is_port_id_ok(id)) {
+	if (!is_cep_id_ok(id)) {
                LOG_ERR("Bad cep-id passed, bailing out");
                return -1;
 	}
@@ -156,18 +171,271 @@ int cidm_release(struct cidm * instance,
 	}
 
        	spin_lock(&instance->lock);
-	list_for_each_entry_safe(pos, next, &instance->allocated_cep_ids, list) {
-               if (pos->cep_id == id) {
-		       list_del(&pos->list);
-		       spin_unlock(&instance->lock);
-		       rkfree(pos);
-		       LOG_DBG("Cep-id %d released successfully", id);
-		       return 0;
-               }
-	}
+	ret = rbmp_release(instance->ids, id);
 	spin_unlock(&instance->lock);
-	
-	LOG_ERR("Didn't find cep-id %d, returning error", id);
-	
-	return -1;
+
+	if (ret) {
+		LOG_ERR("Didn't find cep-id %d, returning error", id);
+		return -1;
+	}
+
+	LOG_DBG("Cep-id %d released successfully", id);
+
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Connection setup benchmark, run on each read of the rina-cidm-bench
+ * debugfs file. A CIDM is filled up to CIDM_BENCH_FLOWS live cep-ids, then
+ * random connections are torn down and set up again while the others stay
+ * allocated. The same is done with the list based allocator the CIDM used
+ * before the IDR, which walks the list of allocated ids for every candidate
+ * id. It is quadratic in the live flows, so it gets fewer churn rounds.
+ * pidm sits on the same allocator as the CIDM.
+ */
+#define CIDM_BENCH_FLOWS      64000
+#define CIDM_BENCH_CHURN      100000
+#define CIDM_BENCH_LIST_CHURN 1000
+
+struct cidm_bench_ops {
+	const char * name;
+	int          churn;
+	void *       (* create)(void);
+	void         (* destroy)(void * a);
+	ssize_t      (* allocate)(void * a);
+	void         (* release)(void * a, ssize_t id);
+};
+
+static void * bench_cidm_create(void)
+{ return cidm_create(); }
+
+static void bench_cidm_destroy(void * a)
+{ cidm_destroy(a); }
+
+static ssize_t bench_cidm_allocate(void * a)
+{
+	cep_id_t id = cidm_allocate(a);
+
+	return is_cep_id_ok(id) ? id : -1;
+}
+
+static void bench_cidm_release(void * a, ssize_t id)
+{ cidm_release(a, id); }
+
+/* The former CIDM: allocated ids on a list, next candidate after the last */
+struct bench_list {
+	struct list_head ids;
+	cep_id_t         last_allocated;
+	size_t           max_cep_id;
+};
+
+struct bench_list_id {
+	struct list_head list;
+	cep_id_t         cep_id;
+};
+
+static void * bench_list_create(void)
+{
+	struct bench_list * l;
+
+	l = rkzalloc(sizeof(*l), GFP_KERNEL);
+	if (!l)
+		return NULL;
+
+	INIT_LIST_HEAD(&l->ids);
+	l->max_cep_id = max_cep_id(DEFAULT_CEP_ID_LENGTH);
+
+	return l;
+}
+
+static void bench_list_destroy(void * a)
+{
+	struct bench_list *    l = a;
+	struct bench_list_id * pos, * next;
+
+	list_for_each_entry_safe(pos, next, &l->ids, list)
+		rkfree(pos);
+	rkfree(l);
+}
+
+static bool bench_list_allocated(struct bench_list * l, cep_id_t cep_id)
+{
+	struct bench_list_id * pos;
+
+	list_for_each_entry(pos, &l->ids, list) {
+		if (pos->cep_id == cep_id)
+			return true;
+	}
+
+	return false;
+}
+
+static ssize_t bench_list_allocate(void * a)
+{
+	struct bench_list *    l = a;
+	struct bench_list_id * new_id;
+	cep_id_t               cep_id;
+	size_t                 tries;
+
+	cep_id = l->last_allocated == l->max_cep_id ? 1 : l->last_allocated + 1;
+	for (tries = 0; bench_list_allocated(l, cep_id); tries++) {
+		if (tries == l->max_cep_id)
+			return -1;
+		cep_id = cep_id == l->max_cep_id ? 1 : cep_id + 1;
+	}
+
+	new_id = rkmalloc(sizeof(*new_id), GFP_KERNEL);
+	if (!new_id)
+		return -1;
+
+	new_id->cep_id = cep_id;
+	list_add(&new_id->list, &l->ids);
+	l->last_allocated = cep_id;
+
+	return cep_id;
+}
+
+static void bench_list_release(void * a, ssize_t id)
+{
+	struct bench_list *    l = a;
+	struct bench_list_id * pos;
+
+	list_for_each_entry(pos, &l->ids, list) {
+		if (pos->cep_id == id) {
+			list_del(&pos->list);
+			rkfree(pos);
+			return;
+		}
+	}
+}
+
+static const struct cidm_bench_ops cidm_bench_ops[] = {
+	{ "idr cyclic", CIDM_BENCH_CHURN, bench_cidm_create,
+	  bench_cidm_destroy, bench_cidm_allocate, bench_cidm_release },
+	{ "list walk", CIDM_BENCH_LIST_CHURN, bench_list_create,
+	  bench_list_destroy, bench_list_allocate, bench_list_release },
+};
+
+static void cidm_bench_run(struct seq_file * s,
+			   const struct cidm_bench_ops * ops,
+			   u16 * ids)
+{
+	void * a;
+	u64    t0, ns_fill, ns_churn;
+	u32    rnd = 2463534242U;
+	int    i, j;
+
+	a = ops->create();
+	if (!a) {
+		seq_printf(s, "%-11s cannot create the allocator\n", ops->name);
+		return;
+	}
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < CIDM_BENCH_FLOWS; i++) {
+		ssize_t id = ops->allocate(a);
+
+		if (id < 0)
+			break;
+		ids[i] = id;
+		cond_resched();
+	}
+	ns_fill = ktime_get_ns() - t0;
+
+	if (i < CIDM_BENCH_FLOWS) {
+		seq_printf(s, "%-11s ran out of ids after %d flows\n",
+			   ops->name, i);
+		goto out;
+	}
+
+	t0 = ktime_get_ns();
+	for (j = 0; j < ops->churn; j++) {
+		ssize_t id;
+
+		/* xorshift32, the same sequence for every allocator */
+		rnd ^= rnd << 13;
+		rnd ^= rnd >> 17;
+		rnd ^= rnd << 5;
+		i = rnd % CIDM_BENCH_FLOWS;
+
+		ops->release(a, ids[i]);
+		id = ops->allocate(a);
+		if (id < 0)
+			break;
+		ids[i] = id;
+		cond_resched();
+	}
+	ns_churn = ktime_get_ns() - t0;
+
+	if (j < ops->churn) {
+		seq_printf(s, "%-11s ran out of ids after %d reallocations\n",
+			   ops->name, j);
+		i = CIDM_BENCH_FLOWS;
+		goto out;
+	}
+
+	seq_printf(s, "%-11s fill %8llu ns/flow, churn %8llu ns/flow "
+		   "over %6d flows (%llu flows/s)\n", ops->name,
+		   div_u64(ns_fill, CIDM_BENCH_FLOWS),
+		   div_u64(ns_churn, ops->churn), ops->churn,
+		   ns_churn ? div64_u64((u64) ops->churn * NSEC_PER_SEC,
+					ns_churn) : 0);
+	i = CIDM_BENCH_FLOWS;
+
+ out:
+	while (i--) {
+		ops->release(a, ids[i]);
+		cond_resched();
+	}
+	ops->destroy(a);
+}
+
+static int cidm_bench_dbg_show(struct seq_file * s, void * v)
+{
+	u16 * ids;
+	int   i;
+
+	ids = vmalloc(CIDM_BENCH_FLOWS * sizeof(*ids));
+	if (!ids)
+		return -ENOMEM;
+
+	seq_printf(s, "%d live flows, then teardown and setup of random "
+		   "flows\n", CIDM_BENCH_FLOWS);
+
+	for (i = 0; i < ARRAY_SIZE(cidm_bench_ops); i++)
+		cidm_bench_run(s, &cidm_bench_ops[i], ids);
+
+	vfree(ids);
+
+	return 0;
+}
+
+static int cidm_bench_dbg_open(struct inode * inode, struct file * file)
+{ return single_open(file, cidm_bench_dbg_show, inode->i_private); }
+
+static const struct file_operations cidm_bench_dbg_fops = {
+	.open    = cidm_bench_dbg_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry * cidm_bench_dbg;
+#endif
+
+void cidm_bench_init(void)
+{
+#ifdef CONFIG_DEBUG_FS
+	cidm_bench_dbg = debugfs_create_file("rina-cidm-bench", S_IRUSR, NULL,
+					     NULL, &cidm_bench_dbg_fops);
+#endif
+}
+
+void cidm_bench_fini(void)
+{
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove(cidm_bench_dbg);
+	cidm_bench_dbg = NULL;
+#endif
 }
@@ -28,9 +28,15 @@ struct cidm;
 
 struct cidm * cidm_create(void);
 int           cidm_destroy(struct cidm * instance);
+/* Bounds the cep-ids to the DIF's cep-id length, none must be in use */
+int           cidm_config_set(struct cidm * instance,
+                              size_t        cep_id_length);
 
 cep_id_t      cidm_allocate(struct cidm * instance);
 int           cidm_release(struct cidm * instance,
                            cep_id_t      cep_id);
 
+void          cidm_bench_init(void);
+void          cidm_bench_fini(void);
+
 #endif
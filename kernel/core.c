@@ -21,6 +21,9 @@
 #include <linux/export.h>
 #include <linux/module.h>
 #include <linux/sysfs.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/version.h>
 
 #define RINA_PREFIX "core"
 
@@ -30,6 +33,16 @@
 #include "rds/robjects.h"
 #include "iodev.h"
 #include "ctrldev.h"
+#include "du.h"
+#include "dtp.h"
+#include "dtp-utils.h"
+#include "rds/rwq.h"
+#include "rds/rcache.h"
+#include "ps-factory.h"
+#include "cidm.h"
+
+#define CREATE_TRACE_POINTS
+#include "rina-trace.h"
 
 #define MK_RINA_VERSION(MAJOR, MINOR, MICRO)                            \
         (((MAJOR & 0xFF) << 24) | ((MINOR & 0xFF) << 16) | (MICRO & 0xFFFF))
@@ -59,10 +72,99 @@ RINA_KTYPE(core);
 
 int irati_verbosity = LOG_VERB_INFO;
 EXPORT_SYMBOL(irati_verbosity);
-module_param(irati_verbosity, int, 0644);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+struct static_key_false irati_log_keys[LOG_VERB_DBG + 1] = {
+        [0 ... LOG_VERB_DBG] = STATIC_KEY_FALSE_INIT
+};
+EXPORT_SYMBOL(irati_log_keys);
+
+/* Keys can only be flipped once the module jump labels are set up */
+static bool log_keys_ready;
+static DEFINE_MUTEX(log_keys_lock);
+
+void irati_log_keys_update(void)
+{
+        int i;
+
+        mutex_lock(&log_keys_lock);
+        log_keys_ready = true;
+        for (i = 0; i <= LOG_VERB_DBG; i++) {
+                if (i <= irati_verbosity)
+                        static_branch_enable(&irati_log_keys[i]);
+                else
+                        static_branch_disable(&irati_log_keys[i]);
+        }
+        mutex_unlock(&log_keys_lock);
+}
+#else
+void irati_log_keys_update(void)
+{ }
+#endif
+EXPORT_SYMBOL(irati_log_keys_update);
+
+static int verbosity_set(const char * val, const struct kernel_param * kp)
+{
+        int ret;
+
+        ret = param_set_int(val, kp);
+        if (ret)
+                return ret;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+        if (READ_ONCE(log_keys_ready))
+                irati_log_keys_update();
+#endif
+
+        return 0;
+}
+
+static const struct kernel_param_ops verbosity_ops = {
+        .set = verbosity_set,
+        .get = param_get_int,
+};
+module_param_cb(irati_verbosity, &verbosity_ops, &irati_verbosity, 0644);
+
+/* Slab caches of the objects allocated on the data path */
+static int caches_init(void)
+{
+        if (rcaches_init())
+                return -1;
+        if (rwq_init())
+                goto fail_rwq;
+        if (du_init())
+                goto fail_du;
+        if (dtp_init())
+                goto fail_dtp;
+        if (dtp_utils_init())
+                goto fail_dtp_utils;
+
+        return 0;
+
+ fail_dtp_utils:
+        dtp_fini();
+ fail_dtp:
+        du_fini();
+ fail_du:
+        rwq_fini();
+ fail_rwq:
+        rcaches_fini();
+        return -1;
+}
+
+static void caches_fini(void)
+{
+        dtp_utils_fini();
+        dtp_fini();
+        du_fini();
+        rwq_fini();
+        rcaches_fini();
+}
 
 static int __init mod_init(void)
 {
+        irati_log_keys_update();
+
         LOG_DBG("IRATI RINA implementation initializing");
 
         LOG_DBG("Creating root rset");
@@ -71,8 +173,16 @@ static int __init mod_init(void)
                 return -1;
 	}
 
+        LOG_DBG("Creating object caches");
+        if (caches_init()) {
+                LOG_ERR("Cannot create object caches, bailing out");
+                robject_del(&core_object);
+                return -1;
+        }
+
         LOG_DBG("Initializing IODEV");
         if (iodev_init()) {
+                caches_fini();
                 robject_del(&core_object);
                 return -1;
         }
@@ -80,6 +190,7 @@ static int __init mod_init(void)
         LOG_DBG("Initializing CTRLDEV");
         if (ctrldev_init()) {
                 iodev_fini();
+                caches_fini();
                 robject_del(&core_object);
                 return -1;
         }
@@ -88,10 +199,15 @@ static int __init mod_init(void)
         if (kipcm_init(&core_object)) {
         	ctrldev_fini();
                 iodev_fini();
+                caches_fini();
                 robject_del(&core_object);
                 return -1;
         }
 
+        ps_bench_init();
+        pci_bench_init();
+        cidm_bench_init();
+
         LOG_INFO("IRATI RINA implementation v%d.%d.%d initialized",
                  RINA_VERSION_MAJOR(version),
                  RINA_VERSION_MINOR(version),
@@ -104,6 +220,10 @@ static int __init mod_init(void)
 
 static void __exit mod_exit(void)
 {
+	cidm_bench_fini();
+	pci_bench_fini();
+	ps_bench_fini();
+
 	if (kipcm_fini(default_kipcm)) {
 		LOG_ERR("Problems finalizing KIPCM");
 	}
@@ -114,6 +234,8 @@ static void __exit mod_exit(void)
 	iodev_fini();
 	LOG_INFO("IODEV finalized successfully");
 
+	caches_fini();
+
 	robject_del(&core_object);
 	LOG_INFO("IRATI RINA implementation kernel modules removed");
 }
@@ -36,6 +36,7 @@ struct dtcp_flowctrl_window_params {
 struct dtcp_flowctrl_rate_params {
         unsigned int sending_rate;
         unsigned int time_period;
+        bool pacing; /* pace sending_rate per PDU instead of per period */
 };
 
 struct dtcp_flowctrl_params {
@@ -83,6 +84,9 @@ struct dtcp_ps {
         int (* no_override_default_peak)(struct dtcp_ps * instance);
         int (* rcvr_rendezvous)(struct dtcp_ps * instance,
         		        const struct pci * pci);
+        /* Optional, run at the sender when the peer updates the window or
+         * the rate; may call dtcp_pacing_rate_set() */
+        int (* sender_pacing)(struct dtcp_ps * instance);
 
         /* Parametric policies. */
         bool flow_ctrl;
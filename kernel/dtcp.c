@@ -45,13 +45,21 @@
 #include "rds/rmem.h"
 #include "debug.h"
 
+/* A paced PDU may leave this early, to avoid arming a timer per PDU */
+#define DTCP_PACING_SLACK_NS (20 * NSEC_PER_USEC)
+
 static struct policy_set_list policy_sets = {
         .head = LIST_HEAD_INIT(policy_sets.head)
 };
 
 int dtcp_pdu_send(struct dtcp * dtcp, struct du * du)
 {
-        return dtp_pdu_ctrl_send(dtcp->parent, du);
+        if (dtp_pdu_ctrl_send(dtcp->parent, du))
+                return -1;
+
+        rstats_inc(dtcp->stats, DTCP_CTRL_PDUS_SENT);
+
+        return 0;
 }
 EXPORT_SYMBOL(dtcp_pdu_send);
 
@@ -128,6 +136,9 @@ static ssize_t dtcp_attr_show(struct robject *		     robj,
 	if (strcmp(robject_attr_name(attr), "rcv_rt_win_edge") == 0) {
 		return sprintf(buf, "%u\n", instance->sv->rcvr_rt_wind_edge);
 	}
+	if (strcmp(robject_attr_name(attr), "pacing_rate") == 0) {
+		return sprintf(buf, "%llu\n", dtcp_pacing_rate(instance));
+	}
 	/* Rate based */
 	if (strcmp(robject_attr_name(attr), "pdus_per_time_unit") == 0) {
 		return sprintf(buf, "%u\n", instance->sv->pdus_per_time_unit);
@@ -178,10 +189,34 @@ static ssize_t dtcp_attr_show(struct robject *		     robj,
 	if (strcmp(robject_attr_name(attr), "ps_name") == 0) {
 		return sprintf(buf, "%s\n",instance->base.ps_factory->name);
 	}
+	/* Control overhead */
+	if (strcmp(robject_attr_name(attr), "ctrl_pdus_sent") == 0) {
+		return sprintf(buf, "%llu\n",
+			rstats_read(instance->stats, DTCP_CTRL_PDUS_SENT));
+	}
+	if (strcmp(robject_attr_name(attr), "ctrl_pdus_rcvd") == 0) {
+		return sprintf(buf, "%llu\n",
+			rstats_read(instance->stats, DTCP_CTRL_PDUS_RCVD));
+	}
+	if (strcmp(robject_attr_name(attr), "ctrl_per_data_pdu") == 0) {
+		u64 ctrl, data;
+
+		/* Control PDUs (both directions) per data PDU, x1000 */
+		ctrl = rstats_read(instance->stats, DTCP_CTRL_PDUS_SENT) +
+		       rstats_read(instance->stats, DTCP_CTRL_PDUS_RCVD);
+		data = rstats_read(instance->parent->stats, DTP_TX_PDUS) +
+		       rstats_read(instance->parent->stats, DTP_RX_PDUS);
+		if (!data)
+			return sprintf(buf, "0.000\n");
+		ctrl = div64_u64(ctrl * 1000, data);
+		return sprintf(buf, "%llu.%03llu\n",
+			div64_u64(ctrl, 1000), ctrl - div64_u64(ctrl, 1000) * 1000);
+	}
 	return 0;
 }
 RINA_SYSFS_OPS(dtcp);
-RINA_ATTRS(dtcp, rtt, srtt, rttvar, ps_name);
+RINA_ATTRS(dtcp, rtt, srtt, rttvar, ps_name, ctrl_pdus_sent, ctrl_pdus_rcvd,
+	   ctrl_per_data_pdu);
 RINA_KTYPE(dtcp);
 
 int ctrl_pdu_send(struct dtcp * dtcp, pdu_type_t type, bool direct)
@@ -207,6 +242,7 @@ int ctrl_pdu_send(struct dtcp * dtcp, pdu_type_t type, bool direct)
         		du_destroy(du);
         		return -1;
         	}
+        	rstats_inc(dtcp->stats, DTCP_CTRL_PDUS_SENT);
         } else {
                 if (dtcp_pdu_send(dtcp, du)){
                 	atomic_dec(&dtcp->cpdus_in_transit);
@@ -460,8 +496,8 @@ static int rcv_ack(struct dtcp * dtcp,
         ps = container_of(rcu_dereference(dtcp->base.ps),
                           struct dtcp_ps, base);
 	if (ps->rtx_ctrl && ps->rtt_estimator) {
-        	if (ps->rtt_estimator(ps,
-        			      pci_control_ack_seq_num(&du->pci)) == -1) {
+        	if (ps_call(ps, rtt_estimator, default_rtt_estimator, ps,
+        		    pci_control_ack_seq_num(&du->pci)) == -1) {
         		/* Don't process this PDU anymore, it is ACKing a
         		 * DT PDU that is not in the RTX queue (was already
         		 * discarded)
@@ -471,7 +507,7 @@ static int rcv_ack(struct dtcp * dtcp,
         	}
 	}
 
-	ret = ps->sender_ack(ps, seq);
+	ret = ps_call(ps, sender_ack, default_sender_ack, ps, seq);
         rcu_read_unlock();
 
         LOG_DBG("DTCP received ACK (CPU: %d)", smp_processor_id());
@@ -481,9 +517,25 @@ static int rcv_ack(struct dtcp * dtcp,
         return ret;
 }
 
+/* Must be called with sv lock taken */
+static void rate_pacing_update(struct dtcp * dtcp)
+{
+	u64 rate = 0;
+
+	/* sndr_rate is expressed in bytes per time_unit ms */
+	if (dtcp->sv->time_unit)
+		rate = div_u64((u64) dtcp->sv->sndr_rate * MSEC_PER_SEC,
+			       dtcp->sv->time_unit);
+
+	if (rate > dtcp->sv->pacing_rate)
+		dtcp->sv->pacing_next = ktime_get();
+	dtcp->sv->pacing_rate = rate;
+}
+
 static int update_window_and_rate(struct dtcp * dtcp,
                 		  struct du *   du)
 {
+        struct dtcp_ps * ps;
         uint_t 	     rt;
         uint_t       tf;
         bool         cancel_rv_timer;
@@ -500,6 +552,8 @@ static int update_window_and_rate(struct dtcp * dtcp,
 		if(tf && rt) {
 			dtcp->sv->sndr_rate = rt;
 			dtcp->sv->time_unit = tf;
+			if (dtcp->sv->rate_paced)
+				rate_pacing_update(dtcp);
 
 			LOG_DBG("rbfc Rate based fields sets on flow ctl, "
 				"rate: %u, time: %u",
@@ -522,6 +576,14 @@ static int update_window_and_rate(struct dtcp * dtcp,
         if (cancel_rv_timer)
         	rtimer_stop(&dtcp->parent->timers.rendezvous);
 
+        /* Let the policy set derive the pacing rate from the new window */
+        rcu_read_lock();
+        ps = container_of(rcu_dereference(dtcp->base.ps),
+                          struct dtcp_ps, base);
+        if (ps->sender_pacing && ps->sender_pacing(ps))
+        	LOG_ERR("Failed Sender Pacing policy");
+        rcu_read_unlock();
+
         push_pdus_rmt(dtcp);
 
         du_destroy(du);
@@ -547,7 +609,8 @@ static int rcv_flow_ctl(struct dtcp * dtcp,
 	LOG_DBG("DTCP received FC: New RWE: %u, Credit: %u, SN to drop: %u",
 		seq, credit, seq-credit);
 	if (!ps->rtx_ctrl && ps->rtt_estimator)
-		ps->rtt_estimator(ps, seq - credit);
+		ps_call(ps, rtt_estimator, default_rtt_estimator_nortx,
+			ps, seq - credit);
 
 	rcu_read_unlock();
 
@@ -571,7 +634,8 @@ static int rcv_ack_and_flow_ctl(struct dtcp * dtcp,
                           struct dtcp_ps, base);
 
         if (ps->rtx_ctrl && ps->rtt_estimator) {
-        	if (ps->rtt_estimator(ps, seq) == -1) {
+        	if (ps_call(ps, rtt_estimator, default_rtt_estimator,
+        		    ps, seq) == -1) {
         		/* Don't process this PDU anymore, it is ACKing a
         		 * DT PDU that is not in the RTX queue (was already
         		 * discarded)
@@ -582,7 +646,7 @@ static int rcv_ack_and_flow_ctl(struct dtcp * dtcp,
         }
 
         /* This updates sender LWE */
-        if (ps->sender_ack(ps, seq))
+        if (ps_call(ps, sender_ack, default_sender_ack, ps, seq))
                 LOG_ERR("Could not update RTXQ and LWE");
 
         rcu_read_unlock();
@@ -631,6 +695,7 @@ int dtcp_common_rcv_control(struct dtcp * dtcp, struct du * du)
                 du_destroy(du);
                 return -1;
         }
+        rstats_inc(dtcp->stats, DTCP_CTRL_PDUS_RCVD);
 
         /* In case EFCP address of peer has changed */
         dtcp->parent->efcp->connection->destination_address =
@@ -896,6 +961,10 @@ static int dtcp_sv_init(struct dtcp * instance, struct dtcp_sv sv)
                                 instance->sv->sndr_rate;
                         instance->sv->time_unit =
                                 ps->flowctrl.rate.time_period;
+                        instance->sv->rate_paced =
+                                ps->flowctrl.rate.pacing;
+                        if (instance->sv->rate_paced)
+                                rate_pacing_update(instance);
                 }
         }
         rcu_read_unlock();
@@ -917,6 +986,8 @@ static int dtcp_sv_init(struct dtcp * instance, struct dtcp_sv sv)
                 instance->sv->rcvr_rate);
         LOG_DBG("  time_unit:           %u",
                 instance->sv->time_unit);
+        LOG_DBG("  pacing_rate:         %llu",
+                instance->sv->pacing_rate);
 
         return 0;
 }
@@ -1118,6 +1189,21 @@ int dtcp_set_policy_set_param(struct dtcp * dtcp,
                 } else if (strcmp(name, "flowctrl.rate.time_period") == 0) {
                         ret = kstrtouint(value, 10,
                                          &ps->flowctrl.rate.time_period);
+                } else if (strcmp(name, "flowctrl.rate.pacing") == 0) {
+                        ret = kstrtoint(value, 10, &bool_value);
+                        if (ret == 0) {
+                                ps->flowctrl.rate.pacing = bool_value;
+                        }
+                        if (ret == 0 && dtcp->sv && ps->flowctrl.rate_based) {
+                                spin_lock_bh(&dtcp->parent->sv_lock);
+                                dtcp->sv->rate_paced = bool_value;
+                                if (bool_value)
+                                        rate_pacing_update(dtcp);
+                                spin_unlock_bh(&dtcp->parent->sv_lock);
+                                /* Releases what pacing was holding back */
+                                if (!bool_value)
+                                        dtcp_pacing_rate_set(dtcp, 0);
+                        }
                 } else {
                         LOG_ERR("Unknown DTP parameter policy '%s'", name);
                 }
@@ -1182,6 +1268,13 @@ struct dtcp * dtcp_create(struct dtp *         dtp,
         atomic_set(&tmp->cpdus_in_transit, 0);
         rtimer_init(tf_rendezvous_rcv, &tmp->rendezvous_rcv, tmp);
 
+        tmp->stats = rstats_create_ni(DTCP_COUNTERS);
+        if (!tmp->stats) {
+                LOG_ERR("Cannot create DTCP counters");
+                dtcp_destroy(tmp);
+                return NULL;
+        }
+
         rina_component_init(&tmp->base);
 
         ps_name = (string_t *) policy_name(dtcp_cfg->dtcp_ps);
@@ -1202,7 +1295,8 @@ struct dtcp * dtcp_create(struct dtp *         dtp,
         /* FIXME: fixups to the state-vector should be placed here */
 
         if (dtcp_flow_ctrl(dtcp_cfg)) {
-		RINA_DECLARE_AND_ADD_ATTRS(&tmp->robj, dtcp, closed_win_q_length, closed_win_q_size);
+		RINA_DECLARE_AND_ADD_ATTRS(&tmp->robj, dtcp, closed_win_q_length, closed_win_q_size,
+			pacing_rate);
                 if (dtcp_window_based_fctrl(dtcp_cfg)) {
 			RINA_DECLARE_AND_ADD_ATTRS(&tmp->robj, dtcp, sndr_credit, rcvr_credit,
 				snd_rt_win_edge, rcv_rt_win_edge);
@@ -1240,10 +1334,12 @@ int dtcp_destroy(struct dtcp * instance)
                 return -1;
         }
 
+        /* Policy sets may run deferred work on the SV, stop them first */
+        rina_component_fini(&instance->base);
         if (instance->sv)       rkfree(instance->sv);
         if (instance->cfg)      dtcp_config_destroy(instance->cfg);
+        rstats_destroy(instance->stats);
         rtimer_destroy(&instance->rendezvous_rcv);
-        rina_component_fini(&instance->base);
         robject_del(&instance->robj);
         rkfree(instance);
 
@@ -1283,7 +1379,8 @@ int dtcp_sv_update(struct dtcp * dtcp, struct pci * pci)
         if (flow_ctrl) {
                 if (win_based) {
                 	LOG_DBG("Window based fctrl invoked");
-                        if (ps->rcvr_flow_control(ps, pci)) {
+                        if (ps_call(ps, rcvr_flow_control,
+                                    default_rcvr_flow_control, ps, pci)) {
                                 LOG_ERR("Failed Rcvr Flow Control policy");
                                 retval = -1;
                         }
@@ -1291,7 +1388,8 @@ int dtcp_sv_update(struct dtcp * dtcp, struct pci * pci)
 
                 if (rate_based) {
                         LOG_DBG("Rate based fctrl invoked");
-                        if (ps->rate_reduction(ps, pci)) {
+                        if (ps_call(ps, rate_reduction,
+                                    default_rate_reduction, ps, pci)) {
                                 LOG_ERR("Failed Rate Reduction policy");
                                 retval = -1;
                         }
@@ -1299,7 +1397,9 @@ int dtcp_sv_update(struct dtcp * dtcp, struct pci * pci)
 
                 if (!rtx_ctrl) {
                         LOG_DBG("Receiving flow ctrl invoked");
-                        if (ps->receiving_flow_control(ps, pci)) {
+                        if (ps_call(ps, receiving_flow_control,
+                                    default_receiving_flow_control,
+                                    ps, pci)) {
                                 LOG_ERR("Failed Receiving Flow Control "
                                         "policy");
                                 retval = -1;
@@ -1356,9 +1456,9 @@ bool dtcp_rate_exceeded(struct dtcp * dtcp, int send) {
 	uint_t lim = 0;
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,5,0)
-	getnstimeofday(&now);
+	ktime_get_ts(&now);
 #else
-	ktime_get_real_ts64(&now);
+	ktime_get_ts64(&now);
 #endif
 
 	timedif_ms = (int)(now.tv_sec - dtcp->sv->last_time.tv_sec) * 1000 +
@@ -1390,3 +1490,61 @@ bool dtcp_rate_exceeded(struct dtcp * dtcp, int send) {
 	return false;
 }
 EXPORT_SYMBOL(dtcp_rate_exceeded);
+
+/* Is the PDU of len bytes allowed to leave now? If not, returns its departure
+ * time in next. Must be called with sv lock taken */
+bool dtcp_pacing_admit(struct dtcp * dtcp, size_t len, ktime_t * next)
+{
+	u64 rate = dtcp->sv->pacing_rate;
+	ktime_t now;
+
+	if (!rate)
+		return true;
+
+	now = ktime_get();
+	if (ktime_after(dtcp->sv->pacing_next,
+			ktime_add_ns(now, DTCP_PACING_SLACK_NS))) {
+		*next = dtcp->sv->pacing_next;
+		return false;
+	}
+
+	/* No credit is accumulated while idle, it would be sent as a burst */
+	if (ktime_before(dtcp->sv->pacing_next, now))
+		dtcp->sv->pacing_next = now;
+
+	dtcp->sv->pacing_next = ktime_add_ns(dtcp->sv->pacing_next,
+			div64_u64((u64) len * NSEC_PER_SEC, rate));
+
+	return true;
+}
+EXPORT_SYMBOL(dtcp_pacing_admit);
+
+/* Sets the pacing rate in bytes/s, 0 disables pacing. Takes the sv lock, so
+ * that congestion control policies can call it from their hooks */
+void dtcp_pacing_rate_set(struct dtcp * dtcp, u64 rate)
+{
+	struct dtp * dtp = dtcp->parent;
+	u64 old;
+
+	spin_lock_bh(&dtp->sv_lock);
+	old = dtcp->sv->pacing_rate;
+	dtcp->sv->pacing_rate = rate;
+	/* The departure time of the next PDU was computed at the old rate */
+	if (!rate || rate > old)
+		dtcp->sv->pacing_next = ktime_get();
+	spin_unlock_bh(&dtp->sv_lock);
+
+	/* cwq_size takes the cwq lock, which nests outside the sv lock */
+	if (rate != old && (!rate || rate > old) && cwq_size(dtp->cwq) > 0) {
+		spin_lock_bh(&dtp->sv_lock);
+		dtp_pacing_timer_start(dtp, ktime_get());
+		spin_unlock_bh(&dtp->sv_lock);
+	}
+}
+EXPORT_SYMBOL(dtcp_pacing_rate_set);
+
+u64 dtcp_pacing_rate(struct dtcp * dtcp)
+{
+	return READ_ONCE(dtcp->sv->pacing_rate);
+}
+EXPORT_SYMBOL(dtcp_pacing_rate);
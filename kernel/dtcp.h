@@ -84,6 +84,9 @@ int		dtcp_last_time_set(struct dtcp *dtcp,
 					   struct timespec64 *s);
 #endif
 bool		dtcp_rate_exceeded(struct dtcp *dtcp, int send);
+bool		dtcp_pacing_admit(struct dtcp *dtcp, size_t len, ktime_t *next);
+void		dtcp_pacing_rate_set(struct dtcp *dtcp, u64 rate);
+u64		dtcp_pacing_rate(struct dtcp *dtcp);
 
 /* end SDK */
 
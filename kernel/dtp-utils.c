@@ -36,6 +36,34 @@
 #include "dtp.h"
 #include "rmt.h"
 #include "dtp-ps.h"
+#include "rina-trace.h"
+#include "rds/rcache.h"
+
+static struct rcache * rtxq_entry_cache;
+static struct rcache * rtt_entry_cache;
+
+int dtp_utils_init(void)
+{
+        rtxq_entry_cache = rcache_create("rina_rtxq_entry",
+                                         sizeof(struct rtxq_entry));
+        if (!rtxq_entry_cache)
+                return -1;
+
+        rtt_entry_cache = rcache_create("rina_rtt_entry",
+                                        sizeof(struct rtt_entry));
+        if (!rtt_entry_cache) {
+                rcache_destroy(rtxq_entry_cache);
+                return -1;
+        }
+
+        return 0;
+}
+
+void dtp_utils_fini(void)
+{
+        rcache_destroy(rtt_entry_cache);
+        rcache_destroy(rtxq_entry_cache);
+}
 
 /* Maximum retransmission time is 60 seconds */
 #define MAX_RTX_WAIT_TIME msecs_to_jiffies(60000)
@@ -193,7 +221,11 @@ static bool can_deliver(struct dtp * dtp, struct dtcp * dtcp)
         struct dtp_ps * ps;
 
         is_wb = dtcp_window_based_fctrl(dtcp->cfg);
-        is_rb = dtcp_rate_based_fctrl(dtcp->cfg);
+        is_rb = dtcp_rate_based_fctrl(dtcp->cfg) && !dtcp->sv->rate_paced;
+
+        /* Only held back by pacing, checked per PDU by the caller */
+        if (!is_wb && !is_rb)
+                return true;
 
         if (is_wb)
                 w_ret = (dtp->sv->max_seq_nr_sent < dtcp->sv->snd_rt_wind_edge);
@@ -227,6 +259,7 @@ void cwq_deliver(struct cwq * queue,
         bool           flow_ctrl;
 
         bool	       rate_ctrl = false;
+        bool	       paced;
         int 	       sz = 0;
 	uint_t 	       sc = 0;
 	ssize_t	       cwq_length = 0;
@@ -239,27 +272,52 @@ void cwq_deliver(struct cwq * queue,
         rcu_read_unlock();
 
         if(flow_ctrl) {
-        	rate_ctrl = dtcp_rate_based_fctrl(dtcp->cfg);
+        	rate_ctrl = dtcp_rate_based_fctrl(dtcp->cfg) &&
+        		    !dtcp->sv->rate_paced;
         }
+        paced = dtcp_pacing_rate(dtcp) != 0;
 
-        spin_lock(&queue->lock);
+        spin_lock_bh(&queue->lock);
         while (!rqueue_is_empty(queue->q) && can_deliver(dtp, dtcp)) {
                 struct du *       du;
 
+                /* Arms the pacing timer if the head cannot leave yet */
+                if (paced && !dtp_pacing_admit(dtp,
+                		du_len(rqueue_head_peek(queue->q))))
+                        break;
+
                 du = (struct du *) rqueue_head_pop(queue->q);
                 if (!du) {
-                        spin_unlock(&queue->lock);
+                        spin_unlock_bh(&queue->lock);
                         return;
                 }
+                if(rate_ctrl) {
+                	sz = du_data_len(du);
+			sc = dtcp->sv->pdus_sent_in_time_unit;
+
+			if(sz >= 0) {
+				if (sz + sc >= dtcp->sv->sndr_rate) {
+					dtcp->sv->pdus_sent_in_time_unit =
+						dtcp->sv->sndr_rate;
+
+					/* Keep it for the next time unit */
+					if (rqueue_head_push_ni(queue->q, du))
+						du_destroy(du);
+					break;
+				} else {
+					dtcp->sv->pdus_sent_in_time_unit += sz;
+				}
+			}
+                }
                 if (rtx_ctrl) {
                         if (!dtp->rtxq) {
-                                spin_unlock(&queue->lock);
+                                spin_unlock_bh(&queue->lock);
                                 LOG_ERR("Couldn't find the RTX queue");
                                 return;
                         }
                         tmp = du_dup_ni(du);
                         if (!tmp) {
-                                spin_unlock(&queue->lock);
+                                spin_unlock_bh(&queue->lock);
                                 return;
                         }
                         rtxq_push_ni(dtp->rtxq, tmp);
@@ -269,27 +327,12 @@ void cwq_deliver(struct cwq * queue,
                 		LOG_ERR("Failed to push SN to RTT Queue");
                 	}
                 }
-                if(rate_ctrl) {
-                	sz = du_data_len(du);
-			sc = dtcp->sv->pdus_sent_in_time_unit;
-
-			if(sz >= 0) {
-				if (sz + sc >= dtcp->sv->sndr_rate) {
-					dtcp->sv->pdus_sent_in_time_unit =
-						dtcp->sv->sndr_rate;
-
-					break;
-				} else {
-					dtcp->sv->pdus_sent_in_time_unit += sz;
-				}
-			}
-                }
                 dtp->sv->max_seq_nr_sent = pci_sequence_number_get(&du->pci);
                 dtcp->sv->snd_lft_win = dtp->sv->max_seq_nr_sent;
 
-                spin_unlock(&queue->lock);
+                spin_unlock_bh(&queue->lock);
                 dtp_pdu_send(dtp, rmt, du);
-                spin_lock(&queue->lock);
+                spin_lock_bh(&queue->lock);
         }
 
         if (!rqueue_is_empty(queue->q)) {
@@ -297,13 +340,13 @@ void cwq_deliver(struct cwq * queue,
 			dtp->sv->window_closed = true;
         	}
 
-                if(dtcp_rate_based_fctrl(dtcp->cfg)) {
+                if(rate_ctrl) {
                 	LOG_DBG("rbfc Cannot deliver anymore, closing...");
                 	dtp->sv->rate_fulfiled = true;
                 	dtp_start_rate_timer(dtp, dtcp);
                 }
 
-                spin_unlock(&queue->lock);
+                spin_unlock_bh(&queue->lock);
                 return;
         }
 
@@ -317,9 +360,12 @@ void cwq_deliver(struct cwq * queue,
 
         cwq_length = rqueue_length(queue->q);
 
-        spin_unlock(&queue->lock);
+        spin_unlock_bh(&queue->lock);
 
-        if (cwq_length < dtcp_max_closed_winq_length(dtp->dtcp->cfg))
+        /* With no cwq limit configured overrun disabled the write on every
+         * held back PDU (e.g. by pacing), re-enable it once drained */
+        if (cwq_length == 0 ||
+            cwq_length < dtcp_max_closed_winq_length(dtp->dtcp->cfg))
                 efcp_enable_write(dtp->efcp);
 
         LOG_DBG("CWQ has delivered until %u", dtp->sv->max_seq_nr_sent);
@@ -331,7 +377,7 @@ static struct rtxq_entry * rtxq_entry_create_gfp(struct du * du, gfp_t flag)
 {
         struct rtxq_entry * tmp;
 
-        tmp = rkzalloc(sizeof(*tmp), flag);
+        tmp = rcache_zalloc(rtxq_entry_cache, flag);
         if (!tmp)
                 return NULL;
 
@@ -359,7 +405,7 @@ int rtxq_entry_destroy(struct rtxq_entry * entry)
 
         du_destroy(entry->du);
         list_del(&entry->next);
-        rkfree(entry);
+        rcache_free(rtxq_entry_cache, entry);
 
         return 0;
 }
@@ -463,7 +509,8 @@ static int rtxqueue_entries_nack(struct rtxqueue * q,
                         }
 			if(dtp &&
 				dtcp &&
-				dtcp_rate_based_fctrl(dtcp->cfg)) {
+				dtcp_rate_based_fctrl(dtcp->cfg) &&
+				!dtcp->sv->rate_paced) {
 
 				sz = du_data_len(cur->du);
 				sc = dtcp->sv->pdus_sent_in_time_unit;
@@ -484,6 +531,12 @@ static int rtxqueue_entries_nack(struct rtxqueue * q,
 				}
 			}
                         tmp = du_dup_ni(cur->du);
+                        if (!tmp)
+                                continue;
+                        trace_dtp_retransmit(pci_cep_source(&tmp->pci),
+                                             pci_type(&tmp->pci),
+                                             pci_sequence_number_get(&tmp->pci),
+                                             du_len(tmp));
                         if (dtp_pdu_send(dtp,
 					 rmt,
 					 tmp))
@@ -637,7 +690,8 @@ static int rtxqueue_rtx(struct rtxq * q,
                         }
 
                         if (dtp && dtcp &&
-                            dtcp_rate_based_fctrl(dtcp->cfg)) {
+                            dtcp_rate_based_fctrl(dtcp->cfg) &&
+                            !dtcp->sv->rate_paced) {
                         	sz = du_data_len(cur->du);
 				sc = dtcp->sv->pdus_sent_in_time_unit;
 
@@ -658,6 +712,11 @@ static int rtxqueue_rtx(struct rtxq * q,
                         }
 
                         tmp = du_dup_ni(cur->du);
+                        if (!tmp)
+                                continue;
+                        trace_dtp_retransmit(pci_cep_source(&tmp->pci),
+                                             pci_type(&tmp->pci), seq,
+                                             du_len(tmp));
 
                         spin_unlock(&q->lock);
                         res = dtp_pdu_send(dtp, q->rmt, tmp);
@@ -950,6 +1009,9 @@ int dtp_pdu_send(struct dtp *  dtp,
 	struct efcp_container * efcpc;
 	cep_id_t		dest_cep_id;
 
+	trace_dtp_send(pci_cep_source(&du->pci), pci_type(&du->pci),
+		       pci_sequence_number_get(&du->pci), du_len(du));
+
 	/* Remote flow case */
 	if (pci_source(&du->pci) != pci_destination(&du->pci)) {
 		if (dtp->dtcp->sv->rendezvous_rcvr) {
@@ -957,7 +1019,7 @@ int dtp_pdu_send(struct dtp *  dtp,
 		}
 
 		if (rmt_send(rmt, du)) {
-			LOG_ERR("Problems sending PDU to RMT");
+			LOG_ERR_RL("Problems sending PDU to RMT");
 			return -1;
 		}
 
@@ -987,7 +1049,7 @@ static struct rtt_entry * rtt_entry_create_gfp(seq_num_t sn, gfp_t flag)
 {
         struct rtt_entry * tmp;
 
-        tmp = rkzalloc(sizeof(*tmp), flag);
+        tmp = rcache_zalloc(rtt_entry_cache, flag);
         if (!tmp)
                 return NULL;
 
@@ -1008,7 +1070,7 @@ static int rtt_entry_destroy(struct rtt_entry * entry)
                 return -1;
 
         list_del(&entry->next);
-        rkfree(entry);
+        rcache_free(rtt_entry_cache, entry);
 
         return 0;
 }
@@ -1033,7 +1095,7 @@ EXPORT_SYMBOL(rttq_create);
 static int rttq_entry_destroy(struct rtt_entry * entry)
 {
 	list_del(&entry->next);
-	rkfree(entry);
+	rcache_free(rtt_entry_cache, entry);
 	return 0;
 }
 
@@ -28,6 +28,9 @@
 #include "du.h"
 #include "rmt.h"
 
+int                 dtp_utils_init(void);
+void                dtp_utils_fini(void);
+
 struct cwq *        cwq_create(void);
 struct cwq *        cwq_create_ni(void);
 int                 cwq_destroy(struct cwq * q);
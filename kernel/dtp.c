@@ -42,7 +42,9 @@
 #include "rds/ringq.h"
 #include "pci.h"
 #include "rds/robjects.h"
+#include "rds/rcache.h"
 #include "efcp-str.h"
+#include "rina-trace.h"
 
 #define TO_POST_LENGTH 1000
 #define TO_SEND_LENGTH 16
@@ -79,30 +81,21 @@ static struct dtp_sv default_sv = {
         .drf_flag             = true,
 };
 
-#define stats_get(name, sv, retval)				\
-        ASSERT(sv);						\
-        retval = sv->stats.name;				\
+/* Per-CPU counters, they do not need the sv_lock */
+#define stats_get(NAME, dtp)					\
+        rstats_read(dtp->stats, DTP_##NAME)
 
-#define stats_inc(name, sv)					\
-        ASSERT(sv);						\
-        sv->stats.name##_pdus++;				\
-        LOG_DBG("PDUs __STRINGIFY(name) %u",			\
-		sv->stats.name##_pdus);				\
+#define stats_inc(NAME, dtp)					\
+        rstats_inc(dtp->stats, DTP_##NAME##_PDUS)
 
-#define stats_inc_bytes(name, sv, bytes)			\
-        ASSERT(sv);						\
-        sv->stats.name##_pdus++;				\
-	sv->stats.name##_bytes += (unsigned long) bytes;	\
-        LOG_DBG("PDUs __STRINGIFY(name) %u (%u)",		\
-		sv->stats.name##_pdus,				\
-		sv->stats.name##_bytes);			\
+#define stats_inc_bytes(NAME, dtp, bytes)			\
+        rstats_add_pdu(dtp->stats, DTP_##NAME##_PDUS, bytes)
 
 static ssize_t dtp_attr_show(struct robject *		     robj,
                          	     struct robj_attribute * attr,
                                      char *		     buf)
 {
 	struct dtp * instance;
-	unsigned int stats_ret;
 
 	instance = container_of(robj, struct dtp, robj);
 	if (!instance || !instance->cfg || !instance->sv)
@@ -133,40 +126,22 @@ static ssize_t dtp_attr_show(struct robject *		     robj,
 			dtp_conf_seq_num_ro_th(instance->cfg));
 	}
 	if (strcmp(robject_attr_name(attr), "drop_pdus") == 0) {
-		spin_lock_bh(&instance->sv_lock);
-		stats_get(drop_pdus, instance->sv, stats_ret);
-		spin_unlock_bh(&instance->sv_lock);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_get(DROP_PDUS, instance));
 	}
 	if (strcmp(robject_attr_name(attr), "err_pdus") == 0) {
-		spin_lock_bh(&instance->sv_lock);
-		stats_get(err_pdus, instance->sv, stats_ret);
-		spin_unlock_bh(&instance->sv_lock);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_get(ERR_PDUS, instance));
 	}
 	if (strcmp(robject_attr_name(attr), "tx_pdus") == 0) {
-		spin_lock_bh(&instance->sv_lock);
-		stats_get(tx_pdus, instance->sv, stats_ret);
-		spin_unlock_bh(&instance->sv_lock);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_get(TX_PDUS, instance));
 	}
 	if (strcmp(robject_attr_name(attr), "tx_bytes") == 0) {
-		spin_lock_bh(&instance->sv_lock);
-		stats_get(tx_bytes, instance->sv, stats_ret);
-		spin_unlock_bh(&instance->sv_lock);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_get(TX_BYTES, instance));
 	}
 	if (strcmp(robject_attr_name(attr), "rx_pdus") == 0) {
-		spin_lock_bh(&instance->sv_lock);
-		stats_get(rx_pdus, instance->sv, stats_ret);
-		spin_unlock_bh(&instance->sv_lock);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_get(RX_PDUS, instance));
 	}
 	if (strcmp(robject_attr_name(attr), "rx_bytes") == 0) {
-		spin_lock_bh(&instance->sv_lock);
-		stats_get(rx_bytes, instance->sv, stats_ret);
-		spin_unlock_bh(&instance->sv_lock);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_get(RX_BYTES, instance));
 	}
 	if (strcmp(robject_attr_name(attr), "ps_name") == 0) {
 		return sprintf(buf, "%s\n", instance->base.ps_factory->name);
@@ -219,6 +194,18 @@ struct squeue {
         struct seq_queue * queue;
 };
 
+static struct rcache * seq_queue_entry_cache;
+
+int dtp_init(void)
+{
+        seq_queue_entry_cache = rcache_create("rina_seq_queue_entry",
+                                              sizeof(struct seq_queue_entry));
+        return seq_queue_entry_cache ? 0 : -1;
+}
+
+void dtp_fini(void)
+{ rcache_destroy(seq_queue_entry_cache); }
+
 static struct seq_queue * seq_queue_create(void)
 {
         struct seq_queue * tmp;
@@ -237,7 +224,7 @@ static struct seq_queue_entry * seq_queue_entry_create_gfp(struct du *  du,
 {
         struct seq_queue_entry * tmp;
 
-        tmp = rkzalloc(sizeof(*tmp), flags);
+        tmp = rcache_zalloc(seq_queue_entry_cache, flags);
         if (!tmp)
                 return NULL;
 
@@ -254,7 +241,7 @@ static void seq_queue_entry_destroy(struct seq_queue_entry * seq_entry)
         ASSERT(seq_entry);
 
         if (seq_entry->du) du_destroy(seq_entry->du);
-        rkfree(seq_entry);
+        rcache_free(seq_queue_entry_cache, seq_entry);
 
         return;
 }
@@ -746,9 +733,9 @@ static unsigned int msec_to_next_rate(uint time_frame, struct timespec64 * last)
 // ret = convert_to_ms_units(last - now) + timeframe
 // (Being sure to avoid overflow/underflow)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,5,0)
-	getnstimeofday(&now);
+	ktime_get_ts(&now);
 #else
-	ktime_get_real_ts64(&now);
+	ktime_get_ts64(&now);
 #endif
 	return ((int)last->tv_sec - (int)now.tv_sec) * 1000
 		+ ((int)last->tv_nsec - (int)now.tv_nsec) / 1000000
@@ -823,9 +810,9 @@ static void tf_rate_window(struct timer_list * tl)
         LOG_DBG("rbfc Re-opening the rate mechanism");
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,5,0)
-        getnstimeofday(&now);
+        ktime_get_ts(&now);
 #else
-	ktime_get_real_ts64(&now);
+	ktime_get_ts64(&now);
 #endif
 
         spin_lock_bh(&dtp->sv_lock);
@@ -842,6 +829,56 @@ static void tf_rate_window(struct timer_list * tl)
         return;
 }
 
+static enum hrtimer_restart tf_pacing(struct hrtimer * timer)
+{
+	struct dtp * dtp;
+
+	dtp = container_of(timer, struct dtp, timers.pacing);
+	tasklet_hi_schedule(&dtp->pacing_tasklet);
+
+	return HRTIMER_NORESTART;
+}
+
+static void pacing_worker(unsigned long o)
+{
+	struct dtp * dtp = (struct dtp *) o;
+	struct cwq * cwq = READ_ONCE(dtp->cwq);
+
+	if (READ_ONCE(dtp->dtcp) && cwq)
+		cwq_deliver(cwq, dtp, dtp->rmt);
+}
+
+/* Must be called with the sv lock taken */
+void dtp_pacing_timer_start(struct dtp * dtp, ktime_t at)
+{
+	/* dtp_destroy has cancelled the timer already */
+	if (dtp->pacing_stopped)
+		return;
+
+	/* An earlier expiration will deliver this PDU as well */
+	if (hrtimer_is_queued(&dtp->timers.pacing) &&
+	    !ktime_after(hrtimer_get_expires(&dtp->timers.pacing), at))
+		return;
+
+	hrtimer_start(&dtp->timers.pacing, at, HRTIMER_MODE_ABS);
+}
+
+bool dtp_pacing_admit(struct dtp * dtp, size_t len)
+{
+	ktime_t next;
+	bool    ret;
+
+	/* cwq_deliver calls this with the cwq lock held and BHs disabled, so
+	 * the unlock cannot run the pacing tasklet, which takes that lock */
+	spin_lock_bh(&dtp->sv_lock);
+	ret = dtcp_pacing_admit(dtp->dtcp, len, &next);
+	if (!ret)
+		dtp_pacing_timer_start(dtp, next);
+	spin_unlock_bh(&dtp->sv_lock);
+
+	return ret;
+}
+
 int dtp_sv_init(struct dtp * dtp,
                 bool         rexmsn_ctrl,
                 bool         window_based,
@@ -856,12 +893,6 @@ int dtp_sv_init(struct dtp * dtp,
         ASSERT(dtp);
         ASSERT(dtp->sv);
 
-	dtp->sv->stats.drop_pdus = 0;
-	dtp->sv->stats.err_pdus = 0;
-	dtp->sv->stats.tx_pdus = 0;
-	dtp->sv->stats.tx_bytes = 0;
-	dtp->sv->stats.rx_pdus = 0;
-	dtp->sv->stats.rx_bytes = 0;
         dtp->sv->rexmsn_ctrl  = rexmsn_ctrl;
         dtp->sv->window_based = window_based;
         dtp->sv->rate_based   = rate_based;
@@ -1050,6 +1081,19 @@ struct dtp * dtp_create(struct efcp *       efcp,
         }
 
         dtp->efcp = efcp;
+        spin_lock_init(&dtp->sv_lock);
+
+        /* Set up first, dtp_destroy() cancels them on any failure below */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,13,0)
+        hrtimer_init(&dtp->timers.pacing, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        dtp->timers.pacing.function = tf_pacing;
+#else
+        hrtimer_setup(&dtp->timers.pacing, tf_pacing, CLOCK_MONOTONIC,
+                      HRTIMER_MODE_ABS);
+#endif
+        tasklet_init(&dtp->pacing_tasklet,
+                     pacing_worker,
+                     (unsigned long) dtp);
 
 	if (robject_init_and_add(&dtp->robj,
 				 &dtp_rtype,
@@ -1069,7 +1113,12 @@ struct dtp * dtp_create(struct efcp *       efcp,
         *dtp->sv = default_sv;
         /* FIXME: fixups to the state-vector should be placed here */
 
-        spin_lock_init(&dtp->sv_lock);
+        dtp->stats = rstats_create(DTP_COUNTERS);
+        if (!dtp->stats) {
+                LOG_ERR("Cannot create DTP counters");
+                dtp_destroy(dtp);
+                return NULL;
+        }
 
         dtp->cfg   = dtp_cfg;
         dtp->rmt  = rmt;
@@ -1172,6 +1221,14 @@ int dtp_destroy(struct dtp * instance)
 
         spin_unlock_bh(&instance->lock);
 
+        /* Nobody arms the pacing timer after this, a running pacing worker
+         * or a rate update included */
+        spin_lock_bh(&instance->sv_lock);
+        instance->pacing_stopped = true;
+        spin_unlock_bh(&instance->sv_lock);
+        hrtimer_cancel(&instance->timers.pacing);
+        tasklet_kill(&instance->pacing_tasklet);
+
         if (dtcp) {
         	if (dtcp_destroy(dtcp)) {
         		LOG_WARN("Error destroying DTCP");
@@ -1217,6 +1274,7 @@ int dtp_destroy(struct dtp * instance)
 
         if (instance->seqq) squeue_destroy(instance->seqq);
         if (instance->sv)   rkfree(instance->sv);
+        rstats_destroy(instance->stats);
         if (instance->cfg) dtp_config_destroy(instance->cfg);
         rina_component_fini(&instance->base);
 
@@ -1244,7 +1302,7 @@ static bool window_is_closed(struct dtp *    dtp,
                 w_ret = true;
         }
 
-        if (dtp->sv->rate_based) {
+        if (dtp->sv->rate_based && !dtcp->sv->rate_paced) {
         	if(dtcp_rate_exceeded(dtcp, 1)) {
         		dtp->sv->rate_fulfiled = true;
         		r_ret = true;
@@ -1373,7 +1431,8 @@ int dtp_write(struct dtp * instance,
 						dtcp,
 						csn,
 						ps)) {
-				if (ps->closed_window(ps, du)) {
+				if (ps_call(ps, closed_window, default_closed_window,
+					    ps, du)) {
 					LOG_ERR("Problems with the closed window policy");
 					goto stats_err_exit;
 				}
@@ -1418,7 +1477,7 @@ int dtp_write(struct dtp * instance,
 
 				return 0;
 			}
-			if(instance->sv->rate_based) {
+			if(instance->sv->rate_based && !dtcp->sv->rate_paced) {
 				spin_lock_bh(&instance->sv_lock);
 				sc = dtcp->sv->pdus_sent_in_time_unit;
 				if(sbytes >= 0) {
@@ -1432,6 +1491,22 @@ int dtp_write(struct dtp * instance,
 				spin_unlock_bh(&instance->sv_lock);
 			}
                 }
+
+                /* Pacing: hold the PDU back until its departure time, also
+                 * when others are already waiting so order is preserved */
+                if (dtcp_pacing_rate(dtcp) &&
+                    (cwq_size(instance->cwq) > 0 ||
+                     !dtp_pacing_admit(instance, du_len(du)))) {
+                        if (ps_call(ps, closed_window,
+                                    default_closed_window, ps, du)) {
+                                LOG_ERR("Problems with the closed window policy");
+                                goto stats_err_exit;
+                        }
+                        rcu_read_unlock();
+
+                        return 0;
+                }
+
                 if (instance->sv->rexmsn_ctrl) {
                         cdu = du_dup_ni(du);
                         if (!cdu) {
@@ -1450,15 +1525,14 @@ int dtp_write(struct dtp * instance,
                 	}
                 }
 
-                if (ps->transmission_control(ps, du)) {
+                if (ps_call(ps, transmission_control,
+                            default_transmission_control, ps, du)) {
                         LOG_ERR("Problems with transmission control");
                         goto stats_err_exit;
                 }
 
                 rcu_read_unlock();
-                spin_lock_bh(&instance->sv_lock);
-                stats_inc_bytes(tx, instance->sv, sbytes);
-                spin_unlock_bh(&instance->sv_lock);
+                stats_inc_bytes(TX, instance, sbytes);
 
                 /* Start SenderInactivityTimer */
                 if (rtimer_restart(&instance->timers.sender_inactivity,
@@ -1475,9 +1549,7 @@ int dtp_write(struct dtp * instance,
                          instance->rmt,
                          du))
 		return -1;
-        spin_lock_bh(&instance->sv_lock);
-	stats_inc_bytes(tx, instance->sv, sbytes);
-	spin_unlock_bh(&instance->sv_lock);
+	stats_inc_bytes(TX, instance, sbytes);
 	return 0;
 
 pdu_err_exit:
@@ -1489,9 +1561,7 @@ pdu_stats_err_exit:
 stats_err_exit:
         rcu_read_unlock();
 stats_nounlock_err_exit:
-	spin_lock_bh(&instance->sv_lock);
-	stats_inc(err, instance->sv);
-	spin_unlock_bh(&instance->sv_lock);
+	stats_inc(ERR, instance);
 	return -1;
 }
 
@@ -1567,6 +1637,9 @@ int dtp_receive(struct dtp * instance,
 
         LOG_DBG("DTP receive started...");
 
+        trace_dtp_receive(pci_cep_destination(&du->pci), pci_type(&du->pci),
+                          pci_sequence_number_get(&du->pci), du_len(du));
+
         dtcp = instance->dtcp;
         efcp = instance->efcp;
 
@@ -1626,7 +1699,7 @@ int dtp_receive(struct dtp * instance,
 
                         dtp_send_pending_ctrl_pdus(instance);
                         pdu_post(instance, du);
-			stats_inc_bytes(rx, instance->sv, sbytes);
+			stats_inc_bytes(RX, instance, sbytes);
 
                         return 0;
                 }
@@ -1634,7 +1707,7 @@ int dtp_receive(struct dtp * instance,
                 LOG_ERR("Expecting DRF but not present, dropping PDU %d...",
                         seq_num);
 
-		stats_inc(drop, instance->sv);
+		stats_inc(DROP, instance);
 		spin_unlock_bh(&instance->sv_lock);
 
                 du_destroy(du);
@@ -1649,9 +1722,9 @@ int dtp_receive(struct dtp * instance,
         if ((seq_num <= LWE) ||
         		(is_fc_overrun(instance, dtcp, seq_num, sbytes))) {
         	/* Duplicate PDU or flow control overrun */
-        	LOG_ERR("Duplicate PDU or flow control overrun.SN: %u, LWE:%u",
+        	LOG_ERR_RL("Duplicate PDU or flow control overrun.SN: %u, LWE:%u",
         		 seq_num, LWE);
-                stats_inc(drop, instance->sv);
+                stats_inc(DROP, instance);
 
                 spin_unlock_bh(&instance->sv_lock);
 
@@ -1721,9 +1794,7 @@ int dtp_receive(struct dtp * instance,
                 if (pdu_post(instance, du))
                         return -1;
 
-                spin_lock_bh(&instance->sv_lock);
-		stats_inc_bytes(rx, instance->sv, sbytes);
-		spin_unlock_bh(&instance->sv_lock);
+		stats_inc_bytes(RX, instance, sbytes);
                 return 0;
 
         fail:
@@ -1771,9 +1842,7 @@ int dtp_receive(struct dtp * instance,
                 if (du) {
                 	sbytes = du_data_len(du);
                         pdu_post(instance, du);
-                        spin_lock_bh(&instance->sv_lock);
-			stats_inc_bytes(rx, instance->sv, sbytes);
-			spin_unlock_bh(&instance->sv_lock);
+			stats_inc_bytes(RX, instance, sbytes);
 		}
         }
 
@@ -28,6 +28,8 @@
 #include "ps-factory.h"
 #include "rds/robjects.h"
 
+int          dtp_init(void);
+void         dtp_fini(void);
 struct dtp * dtp_create(struct efcp *       efcp,
                         struct rmt *        rmt,
                         struct dtp_config * dtp_cfg,
@@ -66,6 +68,11 @@ void         dtp_squeue_flush(struct dtp * dtp);
 // be processed.
 void         dtp_start_rate_timer(struct dtp * dtp, struct dtcp * dtcp);
 
+/* Pacing: dtp_pacing_admit() arms the pacing timer for the departure time of
+ * a PDU that cannot leave yet. dtp_pacing_timer_start() needs the sv lock */
+bool         dtp_pacing_admit(struct dtp * dtp, size_t len);
+void         dtp_pacing_timer_start(struct dtp * dtp, ktime_t at);
+
 /* FIXME: temporal addition so that DTCP's sending ack can call this function
  * that was originally static */
 struct pci * process_A_expiration(struct dtp * dtp, struct dtcp * dtcp);
@@ -23,6 +23,8 @@
 #include <linux/export.h>
 #include <linux/types.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define RINA_PREFIX "du"
 
@@ -30,12 +32,91 @@
 #include "utils.h"
 #include "debug.h"
 #include "du.h"
+#include "rds/rcache.h"
+#include "rds/rstats.h"
 
 /* If this is defined PCI is considered when growing/shrinking PDUs in SDUP */
 #define PDU_HEAD_GROW_WITH_PCI
 #define MAX_PCIS_LEN (40 * 5)
 #define MAX_TAIL_LEN 20
 
+static struct rcache * du_cache;
+static struct rcache * du_list_item_cache;
+
+/*
+ * Reallocations of the skb data when a DU runs out of head or tail room.
+ * Writers size the DUs with the room advertised by the IPCPs below, so
+ * these should stay at zero on the write path.
+ */
+enum du_counter {
+	DU_HEAD_REALLOCS = 0,
+	DU_TAIL_REALLOCS,
+	DU_COUNTERS
+};
+
+static struct rstats * du_stats;
+static struct dentry * du_dbg;
+
+#ifdef CONFIG_DEBUG_FS
+static int du_dbg_show(struct seq_file * s, void * v)
+{
+	seq_printf(s, "head_reallocs %llu\n",
+		   rstats_read(du_stats, DU_HEAD_REALLOCS));
+	seq_printf(s, "tail_reallocs %llu\n",
+		   rstats_read(du_stats, DU_TAIL_REALLOCS));
+
+	return 0;
+}
+
+static int du_dbg_open(struct inode * inode, struct file * file)
+{ return single_open(file, du_dbg_show, inode->i_private); }
+
+static const struct file_operations du_dbg_fops = {
+	.open    = du_dbg_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+#endif
+
+int du_init(void)
+{
+	du_cache = rcache_create("rina_du", sizeof(struct du));
+	if (!du_cache)
+		return -1;
+
+	du_list_item_cache = rcache_create("rina_du_list_item",
+					   sizeof(struct du_list_item));
+	if (!du_list_item_cache)
+		goto fail_item;
+
+	du_stats = rstats_create(DU_COUNTERS);
+	if (!du_stats)
+		goto fail_stats;
+
+#ifdef CONFIG_DEBUG_FS
+	du_dbg = debugfs_create_file("rina-du", S_IRUSR, NULL, NULL,
+				     &du_dbg_fops);
+#endif
+
+	return 0;
+
+ fail_stats:
+	rcache_destroy(du_list_item_cache);
+ fail_item:
+	rcache_destroy(du_cache);
+	return -1;
+}
+
+void du_fini(void)
+{
+	debugfs_remove(du_dbg);
+	du_dbg = NULL;
+	rstats_destroy(du_stats);
+	rcache_destroy(du_list_item_cache);
+	rcache_destroy(du_cache);
+}
+
 int du_destroy(struct du * du)
 {
 	bool free_du = false;
@@ -49,11 +130,11 @@ int du_destroy(struct du * du)
 			free_du = true;
 		kfree_skb(du->skb); /* this destroys pci too */
 		if (likely(free_du))
-			rkfree(du);
+			rcache_free(du_cache, du);
 		return 0;
 	}
 
-	rkfree(du);
+	rcache_free(du_cache, du);
 	return 0;
 }
 EXPORT_SYMBOL(du_destroy);
@@ -75,17 +156,18 @@ struct sk_buff * du_detach_skb(struct du * du)
 }
 EXPORT_SYMBOL(du_detach_skb);
 
-struct du *du_create_gfp(size_t data_len, gfp_t flags)
+static struct du * du_create_gfp_room(size_t data_len, size_t headroom,
+				      size_t tailroom, gfp_t flags)
 {
 	struct du *tmp;
 
-	tmp = rkzalloc(sizeof(*tmp), flags);
+	tmp = rcache_zalloc(du_cache, flags);
 	if (unlikely(!tmp))
 		return NULL;
 
-	tmp->skb = alloc_skb(MAX_PCIS_LEN + data_len + MAX_TAIL_LEN, flags);
+	tmp->skb = alloc_skb(headroom + data_len + tailroom, flags);
 	if (unlikely(!tmp->skb)) {
-		rkfree(tmp);
+		rcache_free(du_cache, tmp);
 		LOG_ERR("Could not allocate DU...");
 		return NULL;
 	}
@@ -96,7 +178,7 @@ struct du *du_create_gfp(size_t data_len, gfp_t flags)
 	tmp->cfg = NULL;
 	tmp->sdup_head = NULL;
 	tmp->sdup_tail = NULL;
-	skb_reserve(tmp->skb, MAX_PCIS_LEN);
+	skb_reserve(tmp->skb, headroom);
 	skb_put(tmp->skb, data_len);
 	tmp->skb->ip_summed = CHECKSUM_UNNECESSARY;
 
@@ -105,6 +187,13 @@ struct du *du_create_gfp(size_t data_len, gfp_t flags)
 	return tmp;
 }
 
+struct du *du_create_gfp(size_t data_len, gfp_t flags)
+{ return du_create_gfp_room(data_len, MAX_PCIS_LEN, MAX_TAIL_LEN, flags); }
+
+struct du * du_create_room(size_t data_len, size_t headroom, size_t tailroom)
+{ return du_create_gfp_room(data_len, headroom, tailroom, GFP_KERNEL); }
+EXPORT_SYMBOL(du_create_room);
+
 struct du * du_create(size_t data_len)
 { return du_create_gfp(data_len, GFP_KERNEL); }
 EXPORT_SYMBOL(du_create);
@@ -190,19 +279,20 @@ static struct du *du_dup_gfp(gfp_t flags,
 {
 	struct du *tmp;
 
-	tmp = rkmalloc(sizeof(*tmp), flags);
+	tmp = rcache_alloc(du_cache, flags);
 	if (!tmp)
 		return NULL;
 
 	tmp->skb = skb_clone(du->skb, flags);
 	if (!tmp->skb) {
-		rkfree(tmp);
+		rcache_free(du_cache, tmp);
 		return NULL;
 	}
 
 	tmp->pci.h = du->pci.h;
 	tmp->pci.len = du->pci.len;
 	tmp->cfg = du->cfg;
+	tmp->hw_verified = du->hw_verified;
 
 	return tmp;
 }
@@ -232,7 +322,7 @@ struct du * du_create_from_skb(struct sk_buff* skb)
 		return NULL;
 	}
 
-	tmp = rkzalloc(sizeof(*tmp), GFP_ATOMIC);
+	tmp = rcache_zalloc(du_cache, GFP_ATOMIC);
 	if (unlikely(!tmp))
 		return NULL;
 
@@ -254,6 +344,7 @@ int du_tail_grow(struct du *du, size_t bytes)
 	if (unlikely(skb_tailroom(du->skb) < bytes)){
 		LOG_DBG("Could not grow DU tail, no mem... (%d < %zd)",
 			skb_tailroom(du->skb), bytes);
+		rstats_inc(du_stats, DU_TAIL_REALLOCS);
 		if (pskb_expand_head(du->skb, 0, bytes, GFP_ATOMIC)) {
 			LOG_ERR("Could not add tailroom to DU...");
 			return -1;
@@ -292,6 +383,7 @@ int du_head_grow(struct du * du, size_t bytes)
 	if (unlikely(skb_headroom(du->skb) < bytes)){
 		LOG_DBG("Can not grow DU head, no mem... (%d < %zd)",
 			 skb_headroom(du->skb), bytes);
+		rstats_inc(du_stats, DU_HEAD_REALLOCS);
 		if (pskb_expand_head(du->skb, bytes, 0, GFP_ATOMIC)) {
 			LOG_ERR("Could not add headroom to DU...");
 			return -1;
@@ -363,13 +455,13 @@ struct du * du_create_gfp_efcp(pdu_type_t type, struct efcp_config *cfg,
 	pci_len = pci_calculate_size(cfg, type);
 	ASSERT(pci_len > 0);
 
-	tmp = rkzalloc(sizeof(*tmp), flags);
+	tmp = rcache_zalloc(du_cache, flags);
 	if (unlikely(!tmp))
 		return NULL;
 
 	tmp->skb = alloc_skb(MAX_PCIS_LEN + MAX_TAIL_LEN, flags);
 	if (unlikely(!tmp->skb)) {
-		rkfree(tmp);
+		rcache_free(du_cache, tmp);
 		return NULL;
 	}
 	skb_reserve(tmp->skb, MAX_PCIS_LEN);
@@ -410,7 +502,7 @@ struct du_list_item * du_list_item_create_gfp(struct du * du, gfp_t flags)
 {
 	struct du_list_item * item;
 
-	item = rkzalloc(sizeof(*item), flags);
+	item = rcache_zalloc(du_list_item_cache, flags);
 	if (unlikely(!item))
 		return NULL;
 
@@ -465,7 +557,7 @@ int du_list_item_destroy(struct du_list_item * item, bool destroy_du)
 	if (destroy_du)
 		du_destroy(item->du);
 
-	rkfree(item);
+	rcache_free(du_list_item_cache, item);
 
 	return 0;
 }
@@ -32,6 +32,9 @@ struct du {
 	void *sdup_head; /* opaque used by SDU protection policy (TTL)*/
 	void *sdup_tail; /* opaque used by SDU protection policy (error check) */
 	struct sk_buff *skb;
+	/* The lower IPCP had the whole PDU checked by the hardware on the
+	 * hop it arrived from (e.g. the Ethernet FCS). Cleared by SDUP. */
+	bool hw_verified;
 };
 
 struct du_list {
@@ -44,8 +47,13 @@ struct du_list_item {
 };
 
 struct pci * du_pci(struct du * du);
+int du_init(void);
+void du_fini(void);
 struct du * du_create_ni(size_t data_len);
 struct du * du_create(size_t data_len);
+/* A DU with the given room before and after the data, for the headers and
+ * trailers the IPCPs below will add */
+struct du * du_create_room(size_t data_len, size_t headroom, size_t tailroom);
 struct du *du_create_efcp_ni(pdu_type_t type, struct efcp_config *cfg);
 struct du *du_create_efcp(pdu_type_t type, struct efcp_config *cfg);
 int du_destroy(struct du * du);
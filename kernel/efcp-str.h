@@ -21,6 +21,8 @@
 #ifndef RINA_EFCP_STR_H
 #define RINA_EFCP_STR_H
 
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include <linux/list.h>
 #include <linux/version.h>
 
@@ -30,6 +32,7 @@
 #include "rmt.h"
 #include "ps-factory.h"
 #include "rds/robjects.h"
+#include "rds/rstats.h"
 
 /*
  * IMAPs
@@ -137,15 +140,6 @@ struct dtp_sv {
         bool         drf_flag;
 
         uint_t     seq_number_rollover_threshold;
-	/* FIXME: we need to control rollovers...*/
-	struct {
-		unsigned int drop_pdus;
-		unsigned int err_pdus;
-		unsigned int tx_pdus;
-		unsigned int tx_bytes;
-		unsigned int rx_pdus;
-		unsigned int rx_bytes;
-	} stats;
         seq_num_t  max_seq_nr_rcv;
         seq_num_t  seq_nr_to_send;
         seq_num_t  max_seq_nr_sent;
@@ -157,6 +151,17 @@ struct dtp_sv {
         bool       rate_fulfiled;
 };
 
+/* Per-CPU DTP counters */
+enum dtp_counter {
+        DTP_DROP_PDUS = 0,
+        DTP_ERR_PDUS,
+        DTP_TX_PDUS,
+        DTP_TX_BYTES,
+        DTP_RX_PDUS,
+        DTP_RX_BYTES,
+        DTP_COUNTERS
+};
+
 struct dtp {
         struct dtcp *       dtcp;
         struct efcp *       efcp;
@@ -185,7 +190,15 @@ struct dtp {
                 struct timer_list rate_window;
                 struct timer_list rtx;
                 struct timer_list rendezvous;
+                /* Releases the PDUs held back in the cwq by pacing */
+                struct hrtimer    pacing;
         } timers;
+        /* Runs cwq_deliver out of the hardirq context of the pacing timer */
+        struct tasklet_struct pacing_tasklet;
+        /* Set under sv_lock by dtp_destroy, the pacing timer is not armed
+         * any more */
+        bool                pacing_stopped;
+        struct rstats *     stats; /* enum dtp_counter */
         struct robject	robj;
 
         spinlock_t		lock;
@@ -256,6 +269,17 @@ struct dtcp_sv {
         /* PDUs already sent in this time unit */
         uint_t       pdus_sent_in_time_unit;
 
+        /*
+         * Pacing: when pacing_rate (bytes/s) is not zero, PDUs are spaced
+         * individually instead of counted per time unit. pacing_next is the
+         * earliest departure time (CLOCK_MONOTONIC) of the next PDU.
+         * rate_paced is set when the advertised sndr_rate drives the
+         * pacing rate instead of the time unit window.
+         */
+        u64          pacing_rate;
+        ktime_t      pacing_next;
+        bool         rate_paced;
+
         /* Inbound */
 
         /*
@@ -315,6 +339,13 @@ struct dtcp_sv {
         bool         rendezvous_rcvr;
 };
 
+/* Per-CPU DTCP counters */
+enum dtcp_counter {
+        DTCP_CTRL_PDUS_SENT = 0,
+        DTCP_CTRL_PDUS_RCVD,
+        DTCP_COUNTERS
+};
+
 struct dtcp {
         struct dtp *            parent;
 
@@ -329,6 +360,8 @@ struct dtcp {
         struct timer_list 	   rendezvous_rcv;
 
         atomic_t               cpdus_in_transit;
+        /* Control PDU overhead, exported through sysfs */
+        struct rstats *        stats; /* enum dtcp_counter */
         struct robject         robj;
 };
 
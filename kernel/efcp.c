@@ -34,6 +34,7 @@
 #include "connection.h"
 #include "debug.h"
 #include "delim-ps.h"
+#include "delim-ps-default.h"
 #include "efcp-str.h"
 #include "efcp.h"
 #include "efcp-utils.h"
@@ -281,7 +282,14 @@ int efcp_container_config_set(struct efcp_container * container,
                 return -1;
         }
 
+        if (cidm_config_set(container->cidm,
+                            efcp_cfg->dt_cons->cep_id_length)) {
+                LOG_ERR("Could not set the cep-id range of the container");
+                return -1;
+        }
+
 	efcp_cfg->pci_offset_table = pci_offset_table_create(efcp_cfg->dt_cons);
+	efcp_cfg->pci_layout = pci_layout_select(efcp_cfg->dt_cons);
         container->config = efcp_cfg;
         if (container->config->dt_cons->max_sdu_size == 0) {
         	container->config->dt_cons->max_sdu_size =
@@ -307,8 +315,8 @@ static int efcp_write(struct efcp * efcp,
 						        struct delim_ps,
 						        base);
 
-		if (delim_ps->delim_fragment(delim_ps, du,
-					     efcp->delim->tx_dus)) {
+		if (ps_call(delim_ps, delim_fragment, default_delim_fragment,
+			    delim_ps, du, efcp->delim->tx_dus)) {
 			LOG_ERR("Error performing SDU fragmentation");
 			du_list_clear(efcp->delim->tx_dus, true);
 			return -1;
@@ -910,8 +918,9 @@ int efcp_enqueue(struct efcp * efcp,
 						        struct delim_ps,
 						        base);
 
-		if (delim_ps->delim_process_udf(delim_ps, du,
-						efcp->delim->rx_dus)) {
+		if (ps_call(delim_ps, delim_process_udf,
+			    default_delim_process_udf,
+			    delim_ps, du, efcp->delim->rx_dus)) {
 			LOG_ERR("Error processing EFCP UDF by delimiting");
 			du_list_clear(efcp->delim->rx_dus, true);
 			return -1;
@@ -31,6 +31,7 @@
 #include <linux/sched.h>
 #include <linux/spinlock.h>
 #include <linux/compat.h>
+#include <linux/kref.h>
 
 #define RINA_PREFIX "iodev"
 
@@ -42,18 +43,292 @@
 #include "kfa.h"
 #include "kfa-utils.h"
 #include "ctrldev.h"
+#include "iodev.h"
+#include "du.h"
 #include "irati/kernel-msg.h"
 
 extern struct kipcm *default_kipcm;
 
+/* Management SDUs waiting for the IPCP daemon, must be a power of 2 */
+#define MGMT_CHAN_QLEN 1024
+
+struct mgmt_chan_entry {
+	port_id_t   port_id;
+	struct du * du;
+};
+
+/* Referenced by the IPCP and by the I/O device bound to it */
+struct mgmt_chan {
+	struct kref            ref;
+	/* In mgmt_chans until the IPCP destroys the channel */
+	struct list_head       node;
+	ipc_process_id_t       ipcp_id;
+	spinlock_t             lock;
+	wait_queue_head_t      wq;
+	bool                   bound;
+	bool                   dead;
+	/* Free running indexes of the queue */
+	unsigned int           head;
+	unsigned int           tail;
+	unsigned long          drops;
+	struct mgmt_chan_entry q[MGMT_CHAN_QLEN];
+};
+
+/* The channels of all the IPCPs, looked up by IPCP id on bind */
+static LIST_HEAD(mgmt_chans);
+static DEFINE_SPINLOCK(mgmt_chans_lock);
+
 /* Private data to an iodev file instance. */
 struct iodev_priv {
         port_id_t       port_id;
         struct iowaitqs * wqs;
         spinlock_t 	flow_dealloc_lock;
         int		flow_dealloc;
+        /* Set if bound to the management SDU channel of an IPCP */
+        struct mgmt_chan * mgmt;
 };
 
+static bool mgmt_chan_empty(struct mgmt_chan * chan)
+{ return chan->head == chan->tail; }
+
+/* Called with the lock held */
+static void mgmt_chan_drain(struct mgmt_chan * chan)
+{
+	while (!mgmt_chan_empty(chan)) {
+		du_destroy(chan->q[chan->head & (MGMT_CHAN_QLEN - 1)].du);
+		chan->head++;
+	}
+}
+
+static void mgmt_chan_release(struct kref * ref)
+{
+	struct mgmt_chan * chan = container_of(ref, struct mgmt_chan, ref);
+
+	LOG_DBG("Management SDU channel of IPCP %u released (%lu drops)",
+		chan->ipcp_id, chan->drops);
+	rkfree(chan);
+}
+
+struct mgmt_chan * mgmt_chan_create(ipc_process_id_t ipcp_id)
+{
+	struct mgmt_chan * chan;
+
+	chan = rkzalloc(sizeof(*chan), GFP_KERNEL);
+	if (!chan)
+		return NULL;
+
+	kref_init(&chan->ref);
+	chan->ipcp_id = ipcp_id;
+	spin_lock_init(&chan->lock);
+	init_waitqueue_head(&chan->wq);
+
+	spin_lock_bh(&mgmt_chans_lock);
+	list_add(&chan->node, &mgmt_chans);
+	spin_unlock_bh(&mgmt_chans_lock);
+
+	return chan;
+}
+EXPORT_SYMBOL(mgmt_chan_create);
+
+void mgmt_chan_destroy(struct mgmt_chan * chan)
+{
+	if (!chan)
+		return;
+
+	/* Not found by mgmt_chan_bind any more */
+	spin_lock_bh(&mgmt_chans_lock);
+	list_del(&chan->node);
+	spin_unlock_bh(&mgmt_chans_lock);
+
+	spin_lock_bh(&chan->lock);
+	chan->dead = true;
+	mgmt_chan_drain(chan);
+	spin_unlock_bh(&chan->lock);
+
+	wake_up_interruptible_all(&chan->wq);
+	kref_put(&chan->ref, mgmt_chan_release);
+}
+EXPORT_SYMBOL(mgmt_chan_destroy);
+
+int mgmt_chan_post(struct mgmt_chan * chan,
+		   port_id_t          port_id,
+		   struct du *        du)
+{
+	struct mgmt_chan_entry * e;
+
+	if (!chan)
+		return 1;
+
+	spin_lock_bh(&chan->lock);
+	if (!chan->bound || chan->dead) {
+		spin_unlock_bh(&chan->lock);
+		return 1;
+	}
+
+	if (chan->tail - chan->head >= MGMT_CHAN_QLEN) {
+		chan->drops++;
+		spin_unlock_bh(&chan->lock);
+		LOG_WARN_RL("Management SDU queue of IPCP %u full, dropping",
+			    chan->ipcp_id);
+		du_destroy(du);
+		return -1;
+	}
+
+	e = &chan->q[chan->tail & (MGMT_CHAN_QLEN - 1)];
+	e->port_id = port_id;
+	e->du = du;
+	chan->tail++;
+	spin_unlock_bh(&chan->lock);
+
+	wake_up_interruptible_poll(&chan->wq, POLLIN | POLLRDNORM);
+
+	return 0;
+}
+EXPORT_SYMBOL(mgmt_chan_post);
+
+static int mgmt_chan_bind(struct iodev_priv * priv, ipc_process_id_t ipcp_id)
+{
+	struct mgmt_chan * pos, * chan = NULL;
+
+	/* The reference is taken under the lock mgmt_chan_destroy takes to
+	 * unlist the channel, so the IPCP cannot free it in between */
+	spin_lock_bh(&mgmt_chans_lock);
+	list_for_each_entry(pos, &mgmt_chans, node) {
+		if (pos->ipcp_id == ipcp_id) {
+			if (kref_get_unless_zero(&pos->ref))
+				chan = pos;
+			break;
+		}
+	}
+	spin_unlock_bh(&mgmt_chans_lock);
+
+	if (!chan)
+		return -ENXIO;
+
+	spin_lock_bh(&chan->lock);
+	if (chan->bound || chan->dead) {
+		spin_unlock_bh(&chan->lock);
+		kref_put(&chan->ref, mgmt_chan_release);
+		return -EBUSY;
+	}
+	chan->bound = true;
+	spin_unlock_bh(&chan->lock);
+
+	priv->mgmt = chan;
+
+	return 0;
+}
+
+static void mgmt_chan_unbind(struct mgmt_chan * chan)
+{
+	spin_lock_bh(&chan->lock);
+	chan->bound = false;
+	mgmt_chan_drain(chan);
+	spin_unlock_bh(&chan->lock);
+
+	kref_put(&chan->ref, mgmt_chan_release);
+}
+
+/* Hands as many queued SDUs as fit in the buffer, never splitting one */
+static ssize_t mgmt_chan_read(struct mgmt_chan * chan,
+			      char __user *      buffer,
+			      size_t             size,
+			      bool               blocking)
+{
+	struct irati_mgmt_sdu_hdr hdr;
+	struct mgmt_chan_entry e;
+	size_t off = 0, len;
+
+	spin_lock_bh(&chan->lock);
+	while (mgmt_chan_empty(chan) && !chan->dead) {
+		spin_unlock_bh(&chan->lock);
+		if (!blocking)
+			return -EAGAIN;
+		if (wait_event_interruptible(chan->wq,
+					     !mgmt_chan_empty(chan) ||
+					     chan->dead))
+			return -ERESTARTSYS;
+		spin_lock_bh(&chan->lock);
+	}
+
+	while (!mgmt_chan_empty(chan)) {
+		e = chan->q[chan->head & (MGMT_CHAN_QLEN - 1)];
+		len = IRATI_MGMT_SDU_LEN(du_len(e.du));
+		if (off + len > size)
+			break;
+		chan->head++;
+		spin_unlock_bh(&chan->lock);
+
+		hdr.port_id = e.port_id;
+		hdr.size = du_len(e.du);
+		if (copy_to_user(buffer + off, &hdr, sizeof(hdr)) ||
+		    copy_to_user(buffer + off + sizeof(hdr), du_buffer(e.du),
+				 hdr.size)) {
+			du_destroy(e.du);
+			return off ? off : -EFAULT;
+		}
+		du_destroy(e.du);
+		off += len;
+
+		spin_lock_bh(&chan->lock);
+	}
+
+	/* Not even the first SDU fits */
+	if (!off && !mgmt_chan_empty(chan)) {
+		spin_unlock_bh(&chan->lock);
+		return -EMSGSIZE;
+	}
+	spin_unlock_bh(&chan->lock);
+
+	/* 0 (EOF) if the IPCP is gone */
+	return off;
+}
+
+static ssize_t mgmt_chan_write(struct mgmt_chan *  chan,
+			       const char __user * buffer,
+			       size_t              size)
+{
+	struct irati_mgmt_sdu_hdr hdr;
+	struct du * du;
+	size_t off = 0;
+	ssize_t ret = -EINVAL;
+
+	while (off + sizeof(hdr) <= size) {
+		if (copy_from_user(&hdr, buffer + off, sizeof(hdr))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (!hdr.size || hdr.size > size - off - sizeof(hdr)) {
+			ret = -EINVAL;
+			break;
+		}
+
+		du = du_create(hdr.size);
+		if (!du) {
+			ret = -ENOMEM;
+			break;
+		}
+		if (copy_from_user(du_buffer(du), buffer + off + sizeof(hdr),
+				   hdr.size)) {
+			du_destroy(du);
+			ret = -EFAULT;
+			break;
+		}
+
+		if (kipcm_mgmt_du_write(default_kipcm, chan->ipcp_id,
+					hdr.port_id, du)) {
+			LOG_ERR_RL("Could not write management SDU to "
+				   "port-id %u", hdr.port_id);
+			ret = -EIO;
+			break;
+		}
+
+		off += min_t(size_t, IRATI_MGMT_SDU_LEN(hdr.size), size - off);
+	}
+
+	return off ? off : ret;
+}
+
 static ssize_t iodev_write(struct file *f, const char __user *buffer, 
 			   size_t size, loff_t *ppos)
 {
@@ -68,6 +343,9 @@ static ssize_t iodev_write(struct file *f, const char __user *buffer,
                 return -EINVAL;
         }
 
+        if (priv->mgmt)
+        	return mgmt_chan_write(priv->mgmt, buffer, size);
+
         ASSERT(default_kipcm);
         retval = kipcm_du_write(default_kipcm, priv->port_id, buffer,
         			NULL, size, blocking);
@@ -90,6 +368,10 @@ static ssize_t iodev_write_iter(struct kiocb * kcb, struct iov_iter * iov)
 		return -EINVAL;
 	}
 
+	/* Management SDU batches only go through plain write() */
+	if (priv->mgmt)
+		return -EOPNOTSUPP;
+
 	ASSERT(default_kipcm);
 	retval = kipcm_du_write(default_kipcm, priv->port_id, NULL,
 				iov, size, blocking);
@@ -167,6 +449,9 @@ static ssize_t iodev_read(struct file *f, char __user *buffer,
 
         LOG_DBG("Syscall read SDU (size = %zd, port-id = %d)",
                 size, priv->port_id);
+
+	if (priv->mgmt)
+		return mgmt_chan_read(priv->mgmt, buffer, size, blocking);
 	
 	return common_read(size, blocking, priv->port_id, buffer, NULL);
 }
@@ -180,6 +465,9 @@ static ssize_t iodev_read_iter(struct kiocb * kio, struct iov_iter * iov)
 
 	LOG_DBG("iov_read_iter called: %p, %p", kio, iov);
 
+	if (priv->mgmt)
+		return -EOPNOTSUPP;
+
 	return common_read(size, blocking, priv->port_id, NULL, iov);
 }	
 
@@ -193,6 +481,17 @@ static unsigned int iodev_poll(struct file *f, poll_table *wait)
         unsigned int mask = 0;
         int res;
 
+        if (priv->mgmt) {
+        	poll_wait(f, &priv->mgmt->wq, wait);
+        	spin_lock_bh(&priv->mgmt->lock);
+        	if (!mgmt_chan_empty(priv->mgmt) || priv->mgmt->dead)
+        		mask |= POLLIN | POLLRDNORM;
+        	if (!priv->mgmt->dead)
+        		mask |= POLLOUT | POLLWRNORM;
+        	spin_unlock_bh(&priv->mgmt->lock);
+        	return mask;
+        }
+
         if (!is_port_id_ok(priv->port_id)) {
                 return -ENXIO;
         }
@@ -266,7 +565,10 @@ static int iodev_release(struct inode *inode, struct file *f)
 
         LOG_DBG("I/O dev release called for port-id %d", priv->port_id);
 
-        deallocate_flow(priv);
+        if (priv->mgmt)
+        	mgmt_chan_unbind(priv->mgmt);
+        else
+        	deallocate_flow(priv);
 
         rkfree(priv->wqs);
         rkfree(priv);
@@ -290,7 +592,9 @@ static long iodev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
         struct iodev_priv *priv = f->private_data;
         void __user *p = (void __user *)arg;
         struct irati_iodev_ctldata data;
+        struct irati_mgmtdev_ctldata mdata;
         size_t max_sdu_size;
+        int ret;
 
         switch(cmd) {
 
@@ -304,7 +608,7 @@ static long iodev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
         		return -EINVAL;
         	}
 
-        	if (is_port_id_ok(priv->port_id)) {
+        	if (is_port_id_ok(priv->port_id) || priv->mgmt) {
         		LOG_ERR("Cannot bind to port %d, "
         				"already bound to port id %d",
 					data.port_id, priv->port_id);
@@ -339,6 +643,29 @@ static long iodev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
         	break;
         }
 
+        case IRATI_MGMT_BIND: {
+        	if (copy_from_user(&mdata, p, sizeof(mdata))) {
+        		return -EFAULT;
+        	}
+
+        	if (is_port_id_ok(priv->port_id) || priv->mgmt) {
+        		LOG_ERR("Cannot bind to the management SDU channel "
+        			"of IPCP %u, already bound", mdata.ipcp_id);
+        		return -EBUSY;
+        	}
+
+        	ret = mgmt_chan_bind(priv, mdata.ipcp_id);
+        	if (ret) {
+        		LOG_ERR("Error binding to the management SDU channel "
+        			"of IPCP %u (%d)", mdata.ipcp_id, ret);
+        		return ret;
+        	}
+
+        	LOG_DBG("Bound to the management SDU channel of IPCP %u",
+        		mdata.ipcp_id);
+        	break;
+        }
+
         default:
         	LOG_ERR("Invalid cmd %u", cmd);
         	return -EINVAL;
@@ -23,6 +23,8 @@
 
 #include <linux/wait.h>
 
+#include "common.h"
+
 int iodev_init(void);
 void iodev_fini(void);
 
@@ -31,4 +33,24 @@ struct iowaitqs {
 	wait_queue_head_t     write_wqueue;
 };
 
+/*
+ * Management SDU channel of an IPC Process: the IPCP daemon binds an I/O
+ * device to it (IRATI_MGMT_BIND) and reads/writes batches of management
+ * SDUs through it, instead of a control message per SDU.
+ */
+struct mgmt_chan;
+struct du;
+
+struct mgmt_chan * mgmt_chan_create(ipc_process_id_t ipcp_id);
+
+/* Called on IPCP destruction: drops the queued SDUs and wakes up the
+ * reader, which gets EOF */
+void               mgmt_chan_destroy(struct mgmt_chan * chan);
+
+/* Returns 1 without touching the DU if no daemon is bound to the channel,
+ * otherwise takes its ownership and returns 0 (queued) or -1 (dropped) */
+int                mgmt_chan_post(struct mgmt_chan * chan,
+				  port_id_t          port_id,
+				  struct du *        du);
+
 #endif
@@ -187,6 +187,14 @@ struct ipcp_instance_ops {
          * The maximum size of SDUs that this IPCP will accept
          */
         size_t (* max_sdu_size)(struct ipcp_instance_data * data);
+
+        /*
+         * Worst case bytes this IPCP and the ones below it add in front of
+         * (headroom) and after (tailroom) an SDU written to it, so that
+         * writers can allocate the DU once. Optional, NULL means none.
+         */
+        size_t (* du_headroom)(struct ipcp_instance_data * data);
+        size_t (* du_tailroom)(struct ipcp_instance_data * data);
 };
 
 /* FIXME: Should work on struct ipcp_instance, not on ipcp_instance_ops */
@@ -47,6 +47,7 @@
 #include "sdup.h"
 #include "efcp-utils.h"
 #include "rds/rtimer.h"
+#include "iodev.h"
 #include "irati/kernel-msg.h"
 
 /*  FIXME: To be removed ABSOLUTELY */
@@ -83,6 +84,8 @@ struct ipcp_instance_data {
         address_t		old_address;
         spinlock_t              lock;
         struct list_head        list;
+        /* Management SDUs to the IPCP daemon, if bound */
+        struct mgmt_chan *      mgmt;
         /* Timers required for the address change procedure */
         struct {
         	struct timer_list use_naddress;
@@ -856,7 +859,22 @@ static int normal_mgmt_du_post(struct ipcp_instance_data * data,
 		return -1;
 	}
 
+	/* Straight to the daemon if it reads the management SDU channel,
+	 * otherwise through a control message */
+	switch (mgmt_chan_post(data->mgmt, port_id, du)) {
+	case 0:
+		return 0;
+	case 1:
+		break;
+	default:
+		return -1;
+	}
+
         wdata = rkzalloc(sizeof(* wdata), GFP_ATOMIC);
+        if (!wdata) {
+        	du_destroy(du);
+        	return -1;
+        }
         wdata->du  = du;
         wdata->port_id = port_id;
         wdata->irati_port_id = data->irati_port;
@@ -935,6 +953,29 @@ static size_t normal_max_sdu_size(struct ipcp_instance_data * data)
         return data->efcpc->config->dt_cons->max_sdu_size;
 }
 
+static size_t normal_du_headroom(struct ipcp_instance_data * data)
+{
+        ssize_t pci_len;
+
+        ASSERT(data);
+        if (!data->efcpc || !data->efcpc->config)
+        	return 0;
+
+        pci_len = pci_calculate_size(data->efcpc->config, PDU_TYPE_DT);
+        if (pci_len < 0)
+                pci_len = 0;
+
+        /* DT PCI and SDU delimiter flags, then what the N-1 ports add */
+        return pci_len + 1 + rmt_du_headroom(data->rmt);
+}
+
+static size_t normal_du_tailroom(struct ipcp_instance_data * data)
+{
+        ASSERT(data);
+
+        return rmt_du_tailroom(data->rmt);
+}
+
 ipc_process_id_t normal_ipcp_id(struct ipcp_instance_data * data)
 {
 	ASSERT(data);
@@ -1266,7 +1307,9 @@ static struct ipcp_instance_ops normal_instance_ops = {
         .update_crypto_state       = normal_update_crypto_state,
 	.address_change            = normal_address_change,
         .dif_name		   = normal_dif_name,
-	.max_sdu_size		   = normal_max_sdu_size
+	.max_sdu_size		   = normal_max_sdu_size,
+	.du_headroom		   = normal_du_headroom,
+	.du_tailroom		   = normal_du_tailroom
 };
 
 static struct ipcp_instance * normal_create(struct ipcp_factory_data * data,
@@ -1358,6 +1401,17 @@ static struct ipcp_instance * normal_create(struct ipcp_factory_data * data,
 
         instance->data->efcpc->rmt = instance->data->rmt;
 
+        instance->data->mgmt = mgmt_chan_create(id);
+        if (!instance->data->mgmt) {
+                LOG_ERR("Failed creation of the management SDU channel");
+                rmt_destroy(instance->data->rmt);
+		sdup_destroy(instance->data->sdup);
+                efcp_container_destroy(instance->data->efcpc);
+                rkfree(instance->data);
+                rkfree(instance);
+                return NULL;
+        }
+
         rtimer_init(tf_use_naddress,
         	    &instance->data->timers.use_naddress,
 		    instance->data);
@@ -1417,6 +1471,8 @@ static int normal_destroy(struct ipcp_factory_data * data,
 
         efcp_container_destroy(tmp->efcpc);
         rmt_destroy(tmp->rmt);
+        /* After the RMT, which posts management PDUs to the channel */
+        mgmt_chan_destroy(tmp->mgmt);
         sdup_destroy(tmp->sdup);
         name_fini(&tmp->name);
         name_fini(&tmp->dif_name);
@@ -59,6 +59,7 @@
 #include "rinarp/rinarp.h"
 #include "rinarp/arp826-utils.h"
 #include "rds/robjects.h"
+#include "rds/rstats.h"
 
 /* FIXME: To be solved properly */
 static struct workqueue_struct * rcv_wq;
@@ -144,6 +145,16 @@ enum vlan_mode {
  * Contains all the information associated to an instance of a
  * shim Ethernet IPC Process
  */
+enum eth_ipcp_counter {
+        ETH_TX_PDUS = 0,
+        ETH_TX_BYTES,
+        ETH_RX_PDUS,
+        ETH_RX_BYTES,
+        ETH_TX_DROP_PDUS,
+        ETH_RX_DROP_PDUS,
+        ETH_COUNTERS
+};
+
 struct ipcp_instance_data {
         struct list_head       list;
         ipc_process_id_t       id;
@@ -181,6 +192,9 @@ struct ipcp_instance_data {
         /* Flow control between this IPCP and the associated netdev. */
         unsigned int tx_busy;
 
+        /* Per-CPU counters, enum eth_ipcp_counter */
+        struct rstats * stats;
+
 #ifdef CONFIG_DEBUG_FS
 #if 0
         // Base directory
@@ -366,11 +380,30 @@ static ssize_t eth_ipcp_attr_show(struct robject *        robj,
                         instance->data->info->interface_name);
         if (strcmp(robject_attr_name(attr), "tx_busy") == 0)
                 return sprintf(buf, "%u\n", instance->data->tx_busy);
+        if (strcmp(robject_attr_name(attr), "tx_pdus") == 0)
+                return sprintf(buf, "%llu\n",
+                        rstats_read(instance->data->stats, ETH_TX_PDUS));
+        if (strcmp(robject_attr_name(attr), "tx_bytes") == 0)
+                return sprintf(buf, "%llu\n",
+                        rstats_read(instance->data->stats, ETH_TX_BYTES));
+        if (strcmp(robject_attr_name(attr), "rx_pdus") == 0)
+                return sprintf(buf, "%llu\n",
+                        rstats_read(instance->data->stats, ETH_RX_PDUS));
+        if (strcmp(robject_attr_name(attr), "rx_bytes") == 0)
+                return sprintf(buf, "%llu\n",
+                        rstats_read(instance->data->stats, ETH_RX_BYTES));
+        if (strcmp(robject_attr_name(attr), "tx_drop_pdus") == 0)
+                return sprintf(buf, "%llu\n",
+                        rstats_read(instance->data->stats, ETH_TX_DROP_PDUS));
+        if (strcmp(robject_attr_name(attr), "rx_drop_pdus") == 0)
+                return sprintf(buf, "%llu\n",
+                        rstats_read(instance->data->stats, ETH_RX_DROP_PDUS));
 
         return 0;
 }
 RINA_SYSFS_OPS(eth_ipcp);
-RINA_ATTRS(eth_ipcp, name, type, dif, address, vlan_id, iface, tx_busy);
+RINA_ATTRS(eth_ipcp, name, type, dif, address, vlan_id, iface, tx_busy,
+           tx_pdus, tx_bytes, rx_pdus, rx_bytes, tx_drop_pdus, rx_drop_pdus);
 RINA_KTYPE(eth_ipcp);
 
 static DEFINE_SPINLOCK(data_instances_lock);
@@ -1172,7 +1205,8 @@ static int eth_du_write(struct ipcp_instance_data * data,
         length = du_len(du);
 
         if (unlikely(length > (data->dev->mtu - hlen))) {
-                LOG_ERR("SDU too large (%d), dropping", length);
+                LOG_ERR_RL("SDU too large (%d), dropping", length);
+                rstats_inc(data->stats, ETH_TX_DROP_PDUS);
                 du_destroy(du);
                 return -1;
         }
@@ -1186,7 +1220,7 @@ static int eth_du_write(struct ipcp_instance_data * data,
 
         spin_lock_bh(&data->lock);
         if (flow->port_id_state != PORT_STATE_ALLOCATED) {
-                LOG_ERR("Flow is not in the right state to call this");
+                LOG_ERR_RL("Flow is not in the right state to call this");
                 du_destroy(du);
                 spin_unlock_bh(&data->lock);
                 return -1;
@@ -1216,16 +1250,18 @@ static int eth_du_write(struct ipcp_instance_data * data,
         skb = du_detach_skb(du);
         bup_skb = skb_clone(skb, GFP_ATOMIC);
         if (!bup_skb) {
-                LOG_ERR("Error cloning SBK, bailing out");
+                LOG_ERR_RL("Error cloning SBK, bailing out");
                 kfree_skb(skb);
+                rstats_inc(data->stats, ETH_TX_DROP_PDUS);
                 du_destroy(du);
                 return -1;
         }
         du_attach_skb(du, skb);
 
         if (unlikely(skb_tailroom(bup_skb) < tlen)) {
-                LOG_ERR("Missing tail room in SKB, bailing out...");
+                LOG_ERR_RL("Missing tail room in SKB, bailing out...");
                 kfree_skb(bup_skb);
+                rstats_inc(data->stats, ETH_TX_DROP_PDUS);
                 du_destroy(du);
                 return -1;
         }
@@ -1236,8 +1272,9 @@ static int eth_du_write(struct ipcp_instance_data * data,
         retval = dev_hard_header(bup_skb, data->dev,
                                  ETH_P_RINA, dest_hw, src_hw, bup_skb->len);
         if (retval < 0) {
-                LOG_ERR("Problems in dev_hard_header (%d)", retval);
+                LOG_ERR_RL("Problems in dev_hard_header (%d)", retval);
                 kfree_skb(bup_skb);
+                rstats_inc(data->stats, ETH_TX_DROP_PDUS);
                 du_destroy(du);
                 return -1;
         }
@@ -1248,7 +1285,8 @@ static int eth_du_write(struct ipcp_instance_data * data,
         retval = dev_queue_xmit(bup_skb);
 
         if (retval == -ENETDOWN) {
-                LOG_ERR("dev_q_xmit returned device down");
+                LOG_ERR_RL("dev_q_xmit returned device down");
+                rstats_inc(data->stats, ETH_TX_DROP_PDUS);
                 du_destroy(du);
                 return -1;
         }
@@ -1260,6 +1298,7 @@ static int eth_du_write(struct ipcp_instance_data * data,
                 return -EAGAIN;
         }
 
+        rstats_add_pdu(data->stats, ETH_TX_PDUS, length);
         du_destroy(du);
         LOG_DBG("Packet sent");
         return 0;
@@ -1268,7 +1307,7 @@ static int eth_du_write(struct ipcp_instance_data * data,
 static int eth_rcv_worker(void * o)
 {
         struct ipcp_instance_data *     data;
-        const struct gpa *              gpaddr;
+        struct gpa *                    gpaddr;
         struct name *                   sname;
         struct ipcp_instance           *ipcp;
         struct ipcp_instance           *user_ipcp;
@@ -1336,14 +1375,13 @@ static int eth_rcv_worker(void * o)
 
         sname  = NULL;
         gpaddr = rinarp_find_gpa(data->app_handle, flow->dest_ha);
-        if (gpaddr && gpa_is_ok(gpaddr)) {
-                flow->dest_pa = gpa_dup_gfp(GFP_KERNEL, gpaddr);
-                if (!flow->dest_pa) {
-                        LOG_ERR("Failed to duplicate gpa");
-                        kfa_port_id_release(data->kfa, flow->port_id);
-                        unbind_and_destroy_flow(data, flow);
-                        return -1;
-                }
+        if (gpaddr && !gpa_is_ok(gpaddr)) {
+                gpa_destroy(gpaddr);
+                gpaddr = NULL;
+        }
+        if (gpaddr) {
+                /* The flow owns the copy from now on */
+                flow->dest_pa = gpaddr;
 
                 gpastr = gpa_address_to_string_gfp(GFP_KERNEL, gpaddr);
                 if (!gpastr) {
@@ -1443,8 +1481,11 @@ static int eth_recv_process_packet(struct sk_buff *    skb,
                 return -1;
         }
 
+        rstats_add_pdu(data->stats, ETH_RX_PDUS, skb->len);
+
         if (!data->app_name) {
-                LOG_ERR("No app registered yet! Someone is doing something bad on the network");
+                LOG_ERR_RL("No app registered yet! Someone is doing something bad on the network");
+                rstats_inc(data->stats, ETH_RX_DROP_PDUS);
                 kfree_skb(skb);
                 return -1;
         }
@@ -1487,11 +1528,15 @@ static int eth_recv_process_packet(struct sk_buff *    skb,
 
         du = du_create_from_skb(linear_skb);
         if (!du) {
-                LOG_ERR("Could not create SDU from buffer");
+                LOG_ERR_RL("Could not create SDU from buffer");
+                rstats_inc(data->stats, ETH_RX_DROP_PDUS);
                 kfree_skb(linear_skb);
                 return -1;
         }
 
+        /* The NIC drops frames with a bad FCS unless told to pass them all */
+        du->hw_verified = !(dev->features & NETIF_F_RXALL);
+
         spin_lock(&data->lock);
         flow = find_flow_by_gha(data, ghaddr);
         if (!flow) {
@@ -1549,7 +1594,8 @@ static int eth_recv_process_packet(struct sk_buff *    skb,
                 if (flow->port_id_state == PORT_STATE_ALLOCATED) {
                         if (!flow->user_ipcp) {
                                 spin_unlock(&data->lock);
-                                LOG_ERR("Flow is being deallocated, dropping PDU");
+                                LOG_ERR_RL("Flow is being deallocated, dropping PDU");
+                                rstats_inc(data->stats, ETH_RX_DROP_PDUS);
                                 du_destroy(du);
                                 return -1;
                         }
@@ -1562,7 +1608,8 @@ static int eth_recv_process_packet(struct sk_buff *    skb,
                             du_enqueue(flow->user_ipcp->data,
                                        flow->port_id,
                                        du)) {
-                                LOG_ERR("Couldn't enqueue SDU to user IPCP");
+                                LOG_ERR_RL("Couldn't enqueue SDU to user IPCP");
+                                rstats_inc(data->stats, ETH_RX_DROP_PDUS);
                                 return -1;
                         }
 
@@ -1570,9 +1617,10 @@ static int eth_recv_process_packet(struct sk_buff *    skb,
                         LOG_DBG("Queueing frame");
 
                         if (rfifo_push_ni(flow->sdu_queue, du)) {
-                                LOG_ERR("Failed to write %zd bytes"
+                                LOG_ERR_RL("Failed to write %zd bytes"
                                         "into the fifo",
                                         sizeof(struct sdu *));
+                                rstats_inc(data->stats, ETH_RX_DROP_PDUS);
                                 spin_unlock(&data->lock);
                                 du_destroy(du);
                                 return -1;
@@ -1967,6 +2015,22 @@ static size_t eth_max_sdu_size(struct ipcp_instance_data * data)
         return data->dev->mtu - sizeof(struct ethhdr);
 }
 
+static size_t eth_du_headroom(struct ipcp_instance_data * data)
+{
+        if (!data || !data->dev)
+                return 0;
+
+        return LL_RESERVED_SPACE(data->dev);
+}
+
+static size_t eth_du_tailroom(struct ipcp_instance_data * data)
+{
+        if (!data || !data->dev)
+                return 0;
+
+        return data->dev->needed_tailroom;
+}
+
 ipc_process_id_t eth_ipcp_id(struct ipcp_instance_data * data)
 {
         ASSERT(data);
@@ -2030,7 +2094,9 @@ static struct ipcp_instance_ops eth_instance_ops = {
         .update_crypto_state	   = NULL,
         .address_change            = NULL,
         .dif_name		   = eth_dif_name,
-        .max_sdu_size		   = eth_max_sdu_size
+        .max_sdu_size		   = eth_max_sdu_size,
+        .du_headroom		   = eth_du_headroom,
+        .du_tailroom		   = eth_du_tailroom
 };
 
 static int ntfy_user_ipcp_on_if_state_change(struct ipcp_instance_data * data,
@@ -2166,6 +2232,7 @@ static void inst_cleanup(struct ipcp_instance * inst)
                         name_destroy(inst->data->name);
                 if (inst->data->eth_packet_type)
                         rkfree(inst->data->eth_packet_type);
+                rstats_destroy(inst->data->stats);
 
                 rkfree(inst->data);
         }
@@ -2225,6 +2292,13 @@ static struct ipcp_instance* eth_create(struct ipcp_factory_data*  data,
                 return NULL;
         }
 
+        inst->data->stats = rstats_create(ETH_COUNTERS);
+        if (!inst->data->stats) {
+                LOG_ERR("Instance creation failed (#2)");
+                inst_cleanup(inst);
+                return NULL;
+        }
+
         inst->data->id = id;
         inst->data->vlan_mode = VLAN_MODE_AUTO;
 
@@ -2237,7 +2311,7 @@ static struct ipcp_instance* eth_create(struct ipcp_factory_data*  data,
 
         inst->data->info = rkzalloc(sizeof(*inst->data->info), GFP_KERNEL);
         if (!inst->data->info) {
-                LOG_ERR("Instance creation failed (#2)");
+                LOG_ERR("Instance creation failed (#3)");
                 inst_cleanup(inst);
                 return NULL;
         }
@@ -2246,7 +2320,7 @@ static struct ipcp_instance* eth_create(struct ipcp_factory_data*  data,
 
         inst->data->fspec = rkzalloc(sizeof(*inst->data->fspec), GFP_KERNEL);
         if (!inst->data->fspec) {
-                LOG_ERR("Instance creation failed (#3)");
+                LOG_ERR("Instance creation failed (#4)");
                 inst_cleanup(inst);
                 return NULL;
         }
@@ -2395,6 +2469,8 @@ static int eth_destroy(struct ipcp_factory_data * data,
                         if (pos->fspec)
                                 rkfree(pos->fspec);
 
+                        rstats_destroy(pos->stats);
+
                         if (pos->app_handle) {
                                 if (rinarp_remove(pos->app_handle)) {
                                         LOG_ERR("Failed to remove "
@@ -39,6 +39,8 @@
 #include "kfa-utils.h"
 #include "rina-device.h"
 #include "ipcp-utils.h"
+#include "rina-trace.h"
+#include "rds/rstats.h"
 
 #define RINA_IP_FLOW_ENT_NAME "RINA_IP"
 
@@ -74,6 +76,17 @@ struct ipcp_flow {
 	atomic_t	       posters;
 	bool		       msg_boundaries;
 	struct rina_device   * ip_dev;
+	struct rstats        * stats; /* enum kfa_flow_counter */
+};
+
+/* Per-CPU flow counters, dumped in debugfs */
+enum kfa_flow_counter {
+	KFA_FLOW_TX_SDUS = 0,
+	KFA_FLOW_TX_BYTES,
+	KFA_FLOW_RX_SDUS,
+	KFA_FLOW_RX_BYTES,
+	KFA_FLOW_DROP_SDUS,
+	KFA_FLOW_COUNTERS
 };
 
 struct flowdel_data {
@@ -86,6 +99,12 @@ struct ipcp_instance_data {
 	struct kfa *kfa;
 };
 
+static void kfa_flow_free(struct ipcp_flow *flow)
+{
+	rstats_destroy(flow->stats);
+	rkfree(flow);
+}
+
 #ifdef CONFIG_DEBUG_FS
 
 static void kfa_flows_dbg_flow_show(struct ipcp_flow *flow, struct seq_file *s) {
@@ -113,6 +132,15 @@ static void kfa_flows_dbg_flow_show(struct ipcp_flow *flow, struct seq_file *s)
 
     seq_printf(s, "State: %s\n", fs);
 
+    seq_printf(s, "TX SDUs: %llu (%llu bytes)\n",
+               rstats_read(flow->stats, KFA_FLOW_TX_SDUS),
+               rstats_read(flow->stats, KFA_FLOW_TX_BYTES));
+    seq_printf(s, "RX SDUs: %llu (%llu bytes)\n",
+               rstats_read(flow->stats, KFA_FLOW_RX_SDUS),
+               rstats_read(flow->stats, KFA_FLOW_RX_BYTES));
+    seq_printf(s, "Dropped SDUs: %llu\n",
+               rstats_read(flow->stats, KFA_FLOW_DROP_SDUS));
+
     if (flow->ipc_process->ops->ipcp_id) {
         pid = flow->ipc_process->ops->ipcp_id(flow->ipc_process->data);
         seq_printf(s, "IPCP process ID: %d\n", pid);
@@ -240,7 +268,7 @@ static int kfa_flow_destroy(struct kfa       *instance,
 
 	ip_dev = flow->ip_dev;
 	flow->ip_dev = NULL;
-	rkfree(flow); flow = NULL;
+	kfa_flow_free(flow); flow = NULL;
 
 	if(!ip_dev)
 		return retval;
@@ -611,9 +639,11 @@ int kfa_flow_du_write(struct kfa  *kfa,
 
 	spin_unlock_bh(&kfa->lock);
 	if (ipcp->ops->du_write(ipcp->data, id, du, false)) {
-		LOG_ERR("Couldn't write SDU on port-id %d", id);
+		LOG_ERR_RL("Couldn't write SDU on port-id %d", id);
+		rstats_inc(flow->stats, KFA_FLOW_DROP_SDUS);
 		retval = -EIO;
 	} else {
+		rstats_add_pdu(flow->stats, KFA_FLOW_TX_SDUS, length);
 		retval = length;
 	}
 	spin_lock_bh(&kfa->lock);
@@ -630,6 +660,8 @@ finish:
 
 	spin_unlock_bh(&kfa->lock);
 
+	trace_kfa_write(id, retval);
+
 	return retval;
 }
 EXPORT_SYMBOL(kfa_flow_du_write);
@@ -661,6 +693,9 @@ int kfa_flow_ub_write(struct kfa * instance,
 	size_t max_sdu_size = 0;
 	size_t copylen = 0;
 	size_t data_written = 0;
+	bool room_known = false;
+	size_t headroom = 0;
+	size_t tailroom = 0;
 
 	LOG_DBG("Trying to write SDU to port-id %d", id);
 
@@ -690,6 +725,14 @@ int kfa_flow_ub_write(struct kfa * instance,
 	        return -EMSGSIZE;
 	}
 
+	/* Allocate each DU once, with room for every header and trailer the
+	 * IPCPs below will add */
+	if (ipcp->ops->du_headroom && ipcp->ops->du_tailroom) {
+		room_known = true;
+		headroom = ipcp->ops->du_headroom(ipcp->data);
+		tailroom = ipcp->ops->du_tailroom(ipcp->data);
+	}
+
 	atomic_inc(&flow->writers);
 
 	while (left) {
@@ -707,7 +750,11 @@ int kfa_flow_ub_write(struct kfa * instance,
 			}
 		} else {
 			/* This SDU comes from the I/O device */
-			du = du_create(copylen);
+			if (room_known)
+				du = du_create_room(copylen, headroom,
+						    tailroom);
+			else
+				du = du_create(copylen);
 			if (!du) {
 				retval = -ENOMEM;
 				goto finish;
@@ -810,11 +857,13 @@ int kfa_flow_ub_write(struct kfa * instance,
 			spin_unlock_bh(&instance->lock);
 			if (ipcp->ops->du_write(ipcp->data, id, du, blocking)) {
 				spin_lock_bh(&instance->lock);
-				LOG_ERR("Couldn't write SDU on port-id %d", id);
+				LOG_ERR_RL("Couldn't write SDU on port-id %d", id);
+				rstats_inc(flow->stats, KFA_FLOW_DROP_SDUS);
 				retval = -EIO;
 				goto finish;
 			}
 			spin_lock_bh(&instance->lock);
+			rstats_add_pdu(flow->stats, KFA_FLOW_TX_SDUS, copylen);
 		} else { /* non-blocking I/O */
 			if (flow->state == PORT_STATE_PENDING
 					|| flow->state == PORT_STATE_DISABLED) {
@@ -839,11 +888,13 @@ int kfa_flow_ub_write(struct kfa * instance,
 			spin_unlock_bh(&instance->lock);
 			if (ipcp->ops->du_write(ipcp->data, id, du, blocking)) {
 				spin_lock_bh(&instance->lock);
-				LOG_ERR("Couldn't write SDU on port-id %d", id);
+				LOG_ERR_RL("Couldn't write SDU on port-id %d", id);
+				rstats_inc(flow->stats, KFA_FLOW_DROP_SDUS);
 				retval = -EIO;
 				goto finish;
 			}
 			spin_lock_bh(&instance->lock);
+			rstats_add_pdu(flow->stats, KFA_FLOW_TX_SDUS, copylen);
 		}
 
 		left -= copylen;
@@ -862,10 +913,13 @@ int kfa_flow_ub_write(struct kfa * instance,
 
 	spin_unlock_bh(&instance->lock);
 
-	if (data_written == 0)
+	if (data_written == 0) {
+		trace_kfa_write(id, retval);
 		return retval;
-	else
-		return data_written;
+	}
+
+	trace_kfa_write(id, data_written);
+	return data_written;
 }
 
 static bool queue_ready(struct ipcp_flow *flow)
@@ -1157,6 +1211,8 @@ finish:
 
 		spin_unlock_bh(&instance->lock);
 
+		trace_kfa_read(id, retval);
+
 		return retval;
 }
 EXPORT_SYMBOL(kfa_flow_du_read);
@@ -1209,10 +1265,15 @@ static int kfa_du_post(struct ipcp_instance_data *data,
 		retval = rina_dev_rcv(skb, flow->ip_dev);
 	} else {
 		/* SDU will be consumed through I/O dev */
+		size_t len = du_len(du);
+
 		if (rfifo_push_ni(flow->sdu_ready, du)) {
-			LOG_ERR("Could not write %zd bytes into port-id %d",
-				sizeof(struct du *), id);
+			LOG_ERR_RL("Could not write %zd bytes into port-id %d",
+				   sizeof(struct du *), id);
+			rstats_inc(flow->stats, KFA_FLOW_DROP_SDUS);
 			retval = -1;
+		} else {
+			rstats_add_pdu(flow->stats, KFA_FLOW_RX_SDUS, len);
 		}
 	}
 
@@ -1279,6 +1340,13 @@ int kfa_flow_create(struct kfa           *instance,
 	atomic_set(&flow->posters, 0);
 	flow->wqs = 0;
 
+	flow->stats = rstats_create(KFA_FLOW_COUNTERS);
+	if (!flow->stats) {
+		LOG_ERR("Failed to create flow counters, bailing out");
+		rkfree(flow);
+		return -1;
+	}
+
 	flow->ipc_process = ipcp;
 
 	flow->state	  = PORT_STATE_PENDING;
@@ -1293,7 +1361,7 @@ int kfa_flow_create(struct kfa           *instance,
 		flow->ip_dev = rina_dev_create(name, instance->ipcp, pid);
 		if (!flow->ip_dev) {
 			LOG_ERR("Could not allocate memory for RINA IP virtual device");
-			rkfree(flow);
+			kfa_flow_free(flow);
 			return -1;
 		}
 		flow->msg_boundaries = true;
@@ -1306,7 +1374,7 @@ int kfa_flow_create(struct kfa           *instance,
 
 	if (kfa_pmap_add_ni(instance->flows, pid, flow)) {
 		/*if (flow->ip_dev) rina_dev_destroy(flow->ip_dev);*/
-		rkfree(flow);
+		kfa_flow_free(flow);
 
 		spin_unlock_bh(&instance->lock);
 		LOG_ERR("Could not map flow and port-id %d", pid);
@@ -1363,7 +1431,7 @@ static int kfa_flow_ipcp_bind(struct ipcp_instance_data *data,
 	flow->sdu_ready	  = rfifo_create_ni();
 	if (!flow->sdu_ready) {
 		kfa_pmap_remove(instance->flows, pid);
-		rkfree(flow);
+		kfa_flow_free(flow);
 		spin_unlock_bh(&instance->lock);
 		return -1;
 	}
@@ -27,6 +27,8 @@
 
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/jump_label.h>
 
 #define LOG_VERB_EMERG   1
 #define LOG_VERB_ALERT   2
@@ -39,50 +41,82 @@
 
 extern int irati_verbosity;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
+/*
+ * One static key per verbosity level, enabled for all the levels up to
+ * irati_verbosity. A disabled LOG_* is a NOP in the instruction stream
+ * instead of a load and a compare on every call.
+ */
+extern struct static_key_false irati_log_keys[LOG_VERB_DBG + 1];
+#define LOG_ENABLED(LVL) static_branch_unlikely(&irati_log_keys[LVL])
+#else
+#define LOG_ENABLED(LVL) (irati_verbosity >= (LVL))
+#endif
+
+/* Applies irati_verbosity to the static keys */
+void irati_log_keys_update(void);
+
 /* The global logs prefix */
 #define __GPFX "rina-"
 
 #define __LOG(PFX, LVL, BAN, FMT, ARGS...)                                   \
         do { printk(LVL __GPFX PFX "(" BAN "): " FMT "\n", ##ARGS); } while (0)
 
+#define __LOG_RL(PFX, LVL, BAN, FMT, ARGS...)                                \
+        do {                                                                 \
+                printk_ratelimited(LVL __GPFX PFX "(" BAN "): " FMT "\n",    \
+                                   ##ARGS);                                  \
+        } while (0)
+
 /* Sorted by "urgency" (high to low) */
 #define LOG_EMERG(FMT, ARGS...) __LOG(RINA_PREFIX, KERN_EMERG,      \
                                       "EMER", FMT, ##ARGS)
 #define LOG_ALERT(FMT, ARGS...) \
-	if (irati_verbosity >= LOG_VERB_ALERT) \
+	if (LOG_ENABLED(LOG_VERB_ALERT)) \
 		 __LOG(RINA_PREFIX, KERN_ALERT,      \
                        "ALRT", FMT, ##ARGS)
 
 #define LOG_CRIT(FMT,  ARGS...) \
-	if (irati_verbosity >= LOG_VERB_CRIT) \
+	if (LOG_ENABLED(LOG_VERB_CRIT)) \
 		 __LOG(RINA_PREFIX, KERN_CRIT,       \
                        "CRIT", FMT, ##ARGS)
 
 #define LOG_ERR(FMT,   ARGS...) \
-	if (irati_verbosity >= LOG_VERB_ERR) \
+	if (LOG_ENABLED(LOG_VERB_ERR)) \
 		__LOG(RINA_PREFIX, KERN_ERR,        \
                       "ERR",  FMT, ##ARGS)
 
 #define LOG_WARN(FMT,  ARGS...) \
-	if (irati_verbosity >= LOG_VERB_WARN) \
+	if (LOG_ENABLED(LOG_VERB_WARN)) \
 		__LOG(RINA_PREFIX, KERN_WARNING,    \
                       "WARN", FMT, ##ARGS)
 
 #define LOG_NOTE(FMT,  ARGS...) \
-	if (irati_verbosity >= LOG_VERB_NOTE) \
+	if (LOG_ENABLED(LOG_VERB_NOTE)) \
 		 __LOG(RINA_PREFIX, KERN_NOTICE,     \
                        "NOTE", FMT, ##ARGS)
 
 #define LOG_INFO(FMT,  ARGS...) \
-	if (irati_verbosity >= LOG_VERB_INFO) \
+	if (LOG_ENABLED(LOG_VERB_INFO)) \
 		__LOG(RINA_PREFIX, KERN_INFO,       \
                       "INFO", FMT, ##ARGS)
 
 #define LOG_DBG(FMT,   ARGS...) \
-	if (irati_verbosity >= LOG_VERB_DBG) \
+	if (LOG_ENABLED(LOG_VERB_DBG)) \
 		__LOG(RINA_PREFIX, KERN_DEBUG,      \
                       "DBG", FMT, ##ARGS)
 
+/* Rate limited variants, for the per-PDU paths (drops, queue overruns) */
+#define LOG_ERR_RL(FMT,  ARGS...) \
+	if (LOG_ENABLED(LOG_VERB_ERR)) \
+		__LOG_RL(RINA_PREFIX, KERN_ERR,     \
+                         "ERR",  FMT, ##ARGS)
+
+#define LOG_WARN_RL(FMT, ARGS...) \
+	if (LOG_ENABLED(LOG_VERB_WARN)) \
+		__LOG_RL(RINA_PREFIX, KERN_WARNING, \
+                         "WARN", FMT, ##ARGS)
+
 /* Helpers */
 #define LOG_DBGF(FMT,  ARGS...) LOG_DBG("(%s: " FMT, __FUNCTION__, ##ARGS)
 #define LOG_ERRF(FMT,  ARGS...) LOG_ERR("(%s: " FMT, __FUNCTION__, ##ARGS)
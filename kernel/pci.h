@@ -99,7 +99,23 @@ struct pci {
 	size_t len;
 };
 
+/* The fields of the base PCI plus the sequence number, see pci_parse() */
+struct pci_fields {
+	address_t   destination;
+	address_t   source;
+	qos_id_t    qos_id;
+	cep_id_t    cep_dst;
+	cep_id_t    cep_src;
+	pdu_type_t  type;
+	pdu_flags_t flags;
+	ssize_t     length;
+	seq_num_t   sequence_number;
+};
+
+struct pci_layout;
+
 ssize_t	* pci_offset_table_create(struct dt_cons *dt_cons);
+const struct pci_layout * pci_layout_select(const struct dt_cons *dt_cons);
 bool pci_is_ok(const struct pci *pci);
 ssize_t	pci_calculate_size(struct efcp_config *cfg,pdu_type_t type);
 int pci_cep_source_set(struct pci *pci, cep_id_t src_cep_id);
@@ -116,6 +132,8 @@ int pci_format(struct pci *pci, cep_id_t src_cep_id, cep_id_t dst_cep_id,
 	       seq_num_t sequence_number, qos_id_t qos_id,
 	       pdu_flags_t flags,
 	       ssize_t length, pdu_type_t type);
+/* Reads all the fields of struct pci_fields at once */
+void pci_parse(const struct pci *pci, struct pci_fields *f);
 
 /* FIXME: remove _get from the API name */
 seq_num_t pci_sequence_number_get(const struct pci *pci);
@@ -158,6 +176,9 @@ int			pci_get(struct pci *pci);
 int			pci_release(struct pci *pci); /* This should be called only after process_A_expiration */
 
 
+void pci_bench_init(void);
+void pci_bench_fini(void);
+
 #if 0
 booli			pci_getset_test(void);
 #endif
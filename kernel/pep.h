@@ -60,6 +60,7 @@ struct ipcp_flow {
 	atomic_t	       posters;
 	bool		       msg_boundaries;
 	struct rina_device   * ip_dev;
+	struct rstats        * stats;
 };
 
 struct flowdel_data {
@@ -29,6 +29,7 @@
 #include "debug.h"
 #include "pff.h"
 #include "pff-ps.h"
+#include "pff-ps-default.h"
 
 static struct policy_set_list policy_sets = {
         .head = LIST_HEAD_INIT(policy_sets.head)
@@ -286,7 +287,7 @@ int pff_nhop(struct pff * instance,
                           struct pff_ps, base);
 
         ASSERT(ps->pff_nhop);
-        if (ps->pff_nhop(ps, pci, ports, count)) {
+        if (ps_call(ps, pff_nhop, default_nhop, ps, pci, ports, count)) {
                 rcu_read_unlock();
                 return -1;
         }
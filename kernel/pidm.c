@@ -17,7 +17,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
-#include <linux/list.h>
+#include <linux/spinlock.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 
@@ -28,11 +28,12 @@
 #include "utils.h"
 #include "pidm.h"
 #include "common.h"
+#include "rds/rbmp.h"
 
-#define MAX_PORT_ID (((2 << BITS_PER_BYTE) * sizeof(port_id_t)) - 1)
+#define MAX_PORT_ID 0xFFFF
 
 struct pidm {
-	struct list_head allocated_ports;
+	struct rbmp * ids;
 	port_id_t last_allocated;
         spinlock_t lock;
 
@@ -42,25 +43,22 @@ struct pidm {
 #endif
 };
 
-struct alloc_pid {
-        struct list_head       list;
-        port_id_t pid;
-};
-
 #ifdef CONFIG_DEBUG_FS
 static int pidm_dbg_show(struct seq_file *s, void *v) {
         struct pidm *instance;
-	struct alloc_pid * pos, * next;
+        ssize_t pid;
 
         instance = (struct pidm *)s->private;
         seq_printf(s, "Last allocated: %u\n", instance->last_allocated);
         seq_printf(s, "Allocated ports:\n");
 
-        spin_lock(&instance->lock);
-        list_for_each_entry_safe(pos, next, &instance->allocated_ports, list) {
-                seq_printf(s, "%d ", pos->pid);
+        spin_lock_bh(&instance->lock);
+        for (pid = rbmp_next(instance->ids, 0);
+             rbmp_is_id_ok(instance->ids, pid);
+             pid = rbmp_next(instance->ids, pid + 1)) {
+                seq_printf(s, "%zd ", pid);
         }
-        spin_unlock(&instance->lock);
+        spin_unlock_bh(&instance->lock);
 
         seq_printf(s, "\n");
 
@@ -84,11 +82,16 @@ struct pidm * pidm_create(struct dentry *dbg_dir)
 {
         struct pidm *instance;
 
-        instance = rkmalloc(sizeof(struct pidm), GFP_KERNEL);
+        instance = rkzalloc(sizeof(struct pidm), GFP_KERNEL);
         if (!instance) return NULL;
 
-        INIT_LIST_HEAD(&(instance->allocated_ports));
+        instance->ids = rbmp_create(MAX_PORT_ID, 1);
+        if (!instance->ids) {
+                rkfree(instance);
+                return NULL;
+        }
         instance->last_allocated = 0;
+        spin_lock_init(&instance->lock);
 
 #ifdef CONFIG_DEBUG_FS
         if (dbg_dir)
@@ -96,7 +99,7 @@ struct pidm * pidm_create(struct dentry *dbg_dir)
                                                          instance, &pidm_dbg_fops);
 #endif
 
-        LOG_INFO("Instance initialized successfully (%zd port-ids)",
+        LOG_INFO("Instance initialized successfully (%d port-ids)",
         	MAX_PORT_ID);
 
         return instance;
@@ -104,8 +107,6 @@ struct pidm * pidm_create(struct dentry *dbg_dir)
 
 int pidm_destroy(struct pidm * instance)
 {
-	struct alloc_pid * pos, * next;
-
         if (!instance) {
                 LOG_ERR("Bogus instance passed, bailing out");
                 return -1;
@@ -116,65 +117,33 @@ int pidm_destroy(struct pidm * instance)
                 debugfs_remove(instance->dbg_file);
 #endif
 
-        spin_lock(&instance->lock);
-
-        list_for_each_entry_safe(pos, next, &instance->allocated_ports, list) {
-                rkfree(pos);
-        }
-
+        rbmp_destroy(instance->ids);
         rkfree(instance);
 
         return 0;
 }
 
-int pidm_allocated(struct pidm * instance, port_id_t port_id)
-{
-	struct alloc_pid * pos, * next;
-
-        list_for_each_entry_safe(pos, next, &instance->allocated_ports, list) {
-                if (pos->pid == port_id) {
-                	return 1;
-                }
-        }
-
-        return 0;
-}
-
 port_id_t pidm_allocate(struct pidm * instance)
 {
-	struct alloc_pid * new_port_id;
-        port_id_t pid;
+        ssize_t pid;
 
         if (!instance) {
                 LOG_ERR("Bogus instance passed, bailing out");
                 return port_id_bad();
         }
 
-        if (instance->last_allocated == MAX_PORT_ID) {
-        	pid = 1;
-        } else {
-        	pid = instance->last_allocated + 1;
-        }
-
-        while (pidm_allocated(instance, pid)) {
-        	if (pid == MAX_PORT_ID) {
-        		pid = 1;
-        	} else {
-        		pid ++;
-        	}
-        }
+        spin_lock_bh(&instance->lock);
+        pid = rbmp_allocate(instance->ids);
+        if (rbmp_is_id_ok(instance->ids, pid))
+                instance->last_allocated = pid;
+        spin_unlock_bh(&instance->lock);
 
-        new_port_id = rkmalloc(sizeof(*new_port_id), GFP_ATOMIC);
-        if (!new_port_id)
+        if (!rbmp_is_id_ok(instance->ids, pid)) {
+                LOG_ERR("No port-id available");
         	return port_id_bad();
+        }
 
-        INIT_LIST_HEAD(&(new_port_id->list));
-        new_port_id->pid = pid;
-        list_add(&(new_port_id->list), &(instance->allocated_ports));
-
-        instance->last_allocated = pid;
-
-        LOG_DBG("Port-id allocation completed successfully (id = %d)", pid);
+        LOG_DBG("Port-id allocation completed successfully (id = %zd)", pid);
 
         return pid;
 }
@@ -182,8 +151,7 @@ port_id_t pidm_allocate(struct pidm * instance)
 int pidm_release(struct pidm * instance,
                  port_id_t     id)
 {
-	struct alloc_pid * pos, * next;
-        int found = 0;
+        int ret;
 
         if (!is_port_id_ok(id)) {
                 LOG_ERR("Bad flow-id passed, bailing out");
@@ -194,15 +162,11 @@ int pidm_release(struct pidm * instance,
                 return -1;
         }
 
-        list_for_each_entry_safe(pos, next, &instance->allocated_ports, list) {
-                if (pos->pid == id) {
-                	list_del(&pos->list);
-                	rkfree(pos);
-                        found = 1;
-                }
-        }
+        spin_lock_bh(&instance->lock);
+        ret = rbmp_release(instance->ids, id);
+        spin_unlock_bh(&instance->lock);
 
-        if (!found) {
+        if (ret) {
                 LOG_ERR("Didn't find port-id %d, returning error", id);
         } else {
                 LOG_DBG("Port-id release completed successfully (port_id: %d)", id);
@@ -210,4 +174,3 @@ int pidm_release(struct pidm * instance,
 
         return 0;
 }
-
@@ -22,6 +22,9 @@
 #include <linux/list.h>
 #include <linux/kernel.h>
 #include <linux/string.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/timekeeping.h>
 
 #define RINA_PREFIX "ps-factory"
 
@@ -312,3 +315,153 @@ ps_factory_nop_policy(void)
 }
 EXPORT_SYMBOL(ps_factory_nop_policy);
 
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Microbenchmark of the policy set hooks, run on each read of the
+ * rina-ps-bench debugfs file. A PDU goes through the hooks DTP, PFF, RMT
+ * and SDUP call on the transmit path; they are timed when called
+ * indirectly as before and through ps_call(), with the default policy
+ * set and with another one.
+ */
+#define PS_BENCH_PDUS 1000000
+
+struct ps_bench_ps {
+        int (* transmission_control)(struct ps_bench_ps * ps, u32 * pdu);
+        int (* nhop)(struct ps_bench_ps * ps, u32 * pdu);
+        int (* enqueue)(struct ps_bench_ps * ps, u32 * pdu);
+        int (* add_error_check)(struct ps_bench_ps * ps, u32 * pdu);
+};
+
+static noinline int bench_transmission_control(struct ps_bench_ps * ps,
+                                               u32 * pdu)
+{ *pdu += 1; return 0; }
+
+static noinline int bench_nhop(struct ps_bench_ps * ps, u32 * pdu)
+{ *pdu ^= 0x5a; return 0; }
+
+static noinline int bench_enqueue(struct ps_bench_ps * ps, u32 * pdu)
+{ *pdu += 3; return 0; }
+
+static noinline int bench_add_error_check(struct ps_bench_ps * ps,
+                                          u32 * pdu)
+{ *pdu = (*pdu << 1) | (*pdu >> 31); return 0; }
+
+static noinline int bench_other_hook(struct ps_bench_ps * ps, u32 * pdu)
+{ *pdu += 7; return 0; }
+
+static struct ps_bench_ps bench_default_ps = {
+        .transmission_control = bench_transmission_control,
+        .nhop                 = bench_nhop,
+        .enqueue              = bench_enqueue,
+        .add_error_check      = bench_add_error_check,
+};
+
+static struct ps_bench_ps bench_other_ps = {
+        .transmission_control = bench_other_hook,
+        .nhop                 = bench_other_hook,
+        .enqueue              = bench_other_hook,
+        .add_error_check      = bench_other_hook,
+};
+
+static struct ps_bench_ps * bench_ps;
+
+static u64 ps_bench_indirect(u32 * pdu)
+{
+        struct ps_bench_ps * ps;
+        u64                  t0 = ktime_get_ns();
+        int                  i;
+
+        for (i = 0; i < PS_BENCH_PDUS; i++) {
+                /* Reloaded, as the ps is under RCU on the data path */
+                ps = READ_ONCE(bench_ps);
+                ps->transmission_control(ps, pdu);
+                ps->nhop(ps, pdu);
+                ps->enqueue(ps, pdu);
+                ps->add_error_check(ps, pdu);
+        }
+
+        return ktime_get_ns() - t0;
+}
+
+static u64 ps_bench_ps_call(u32 * pdu)
+{
+        struct ps_bench_ps * ps;
+        u64                  t0 = ktime_get_ns();
+        int                  i;
+
+        for (i = 0; i < PS_BENCH_PDUS; i++) {
+                ps = READ_ONCE(bench_ps);
+                ps_call(ps, transmission_control,
+                        bench_transmission_control, ps, pdu);
+                ps_call(ps, nhop, bench_nhop, ps, pdu);
+                ps_call(ps, enqueue, bench_enqueue, ps, pdu);
+                ps_call(ps, add_error_check, bench_add_error_check, ps, pdu);
+        }
+
+        return ktime_get_ns() - t0;
+}
+
+static void ps_bench_run(struct seq_file * s, const char * name,
+                         struct ps_bench_ps * ps)
+{
+        u64 ns_ind, ns_call;
+        u32 pdu = 0;
+
+        WRITE_ONCE(bench_ps, ps);
+        ns_ind  = ps_bench_indirect(&pdu);
+        ns_call = ps_bench_ps_call(&pdu);
+
+        seq_printf(s, "%-8s indirect %4llu.%02llu ns/PDU, "
+                   "ps_call %4llu.%02llu ns/PDU (%u)\n", name,
+                   ns_ind / (PS_BENCH_PDUS / 1000) / 1000,
+                   ns_ind / (PS_BENCH_PDUS / 1000) % 1000 / 10,
+                   ns_call / (PS_BENCH_PDUS / 1000) / 1000,
+                   ns_call / (PS_BENCH_PDUS / 1000) % 1000 / 10, pdu);
+}
+
+static int ps_bench_dbg_show(struct seq_file * s, void * v)
+{
+        seq_printf(s, "%d PDUs, 4 hooks per PDU, direct calls %s\n",
+                   PS_BENCH_PDUS,
+#ifdef PS_DIRECT_CALLS
+                   "on"
+#else
+                   "off (no retpolines nor IBT)"
+#endif
+                   );
+
+        ps_bench_run(s, "default", &bench_default_ps);
+        ps_bench_run(s, "other", &bench_other_ps);
+
+        return 0;
+}
+
+static int ps_bench_dbg_open(struct inode * inode, struct file * file)
+{ return single_open(file, ps_bench_dbg_show, inode->i_private); }
+
+static const struct file_operations ps_bench_dbg_fops = {
+        .open    = ps_bench_dbg_open,
+        .read    = seq_read,
+        .llseek  = seq_lseek,
+        .release = single_release,
+};
+
+static struct dentry * ps_bench_dbg;
+#endif
+
+void ps_bench_init(void)
+{
+#ifdef CONFIG_DEBUG_FS
+        ps_bench_dbg = debugfs_create_file("rina-ps-bench", S_IRUSR, NULL,
+                                           NULL, &ps_bench_dbg_fops);
+#endif
+}
+
+void ps_bench_fini(void)
+{
+#ifdef CONFIG_DEBUG_FS
+        debugfs_remove(ps_bench_dbg);
+        ps_bench_dbg = NULL;
+#endif
+}
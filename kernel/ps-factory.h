@@ -107,4 +107,28 @@ void ps_factory_parse_component_id(const string_t *path, size_t *cmplen,
 
 void ps_factory_nop_policy(void);
 
+/*
+ * Calls the hook of a policy set. When the hook is dflt, the one of the
+ * default policy set, it is called directly: with retpolines or IBT an
+ * indirect call costs a lot more than a compare and a well predicted
+ * branch. Policy sets are selected per component, so the hook is always
+ * read from the ps the caller got under RCU and nothing needs to be
+ * rebound when base_select_policy_set_finish() swaps it.
+ */
+#if defined(CONFIG_RETPOLINE) || defined(CONFIG_MITIGATION_RETPOLINE) || \
+    defined(CONFIG_X86_KERNEL_IBT)
+#define PS_DIRECT_CALLS
+#endif
+
+#ifdef PS_DIRECT_CALLS
+#define ps_call(ps, hook, dflt, ...)                                    \
+        (likely((ps)->hook == (dflt)) ? (dflt)(__VA_ARGS__) :           \
+                                        (ps)->hook(__VA_ARGS__))
+#else
+#define ps_call(ps, hook, dflt, ...) ((ps)->hook(__VA_ARGS__))
+#endif
+
+void ps_bench_init(void);
+void ps_bench_fini(void);
+
 #endif
@@ -1,5 +1,5 @@
 /*
- * RINA Bitmaps
+ * RINA Bitmaps (id allocators)
  *
  *    Francesco Salvestrini <f.salvestrini@nextworks.it>
  *
@@ -20,7 +20,7 @@
 
 #include <linux/export.h>
 #include <linux/types.h>
-#include <linux/bitmap.h>
+#include <linux/idr.h>
 
 #define RINA_PREFIX "rbmp"
 
@@ -29,20 +29,25 @@
 #include "rmem.h"
 #include "rbmp.h"
 
-#define BITS_IN_BITMAP ((2 << BITS_PER_BYTE) * sizeof(size_t))
-
+/*
+ * The ids are kept in an IDR (a radix tree) rather than in a flat bitmap,
+ * so the map is not bounded by a compile time size and allocating does not
+ * scan from the first id. Allocation is cyclic: the search starts after
+ * the last id handed out, so a released id is not reused until the whole
+ * range has been walked, and late PDUs for a dead connection do not hit
+ * the new one. As before, the callers serialize the accesses.
+ */
 struct rbmp {
-        ssize_t offset;
-        size_t  size;
-
-        DECLARE_BITMAP(bitmap, BITS_IN_BITMAP);
+        ssize_t    offset;
+        size_t     size;
+        struct idr idr;
 };
 
 static struct rbmp * rbmp_create_gfp(gfp_t flags, size_t bits, ssize_t offset)
 {
         struct rbmp * tmp;
 
-        if (bits == 0)
+        if (bits == 0 || offset < 0 || offset + bits - 1 > INT_MAX)
                 return NULL;
 
         tmp = rkzalloc(sizeof(*tmp), flags);
@@ -51,7 +56,7 @@ static struct rbmp * rbmp_create_gfp(gfp_t flags, size_t bits, ssize_t offset)
 
         tmp->size   = bits;
         tmp->offset = offset;
-        bitmap_zero(tmp->bitmap, BITS_IN_BITMAP);
+        idr_init(&tmp->idr);
 
         return tmp;
 }
@@ -69,6 +74,7 @@ int rbmp_destroy(struct rbmp * b)
         if (!b)
                 return -1;
 
+        idr_destroy(&b->idr);
         rkfree(b);
 
         return 0;
@@ -84,20 +90,18 @@ static ssize_t bad_id(struct rbmp * b)
 
 ssize_t rbmp_allocate(struct rbmp * b)
 {
-        ssize_t id;
+        int id;
 
         if (!b)
-                return bad_id(b);
+                return -1;
 
-        id = (ssize_t) bitmap_find_next_zero_area(b->bitmap,
-                                                  BITS_IN_BITMAP,
-                                                  0, 1, 0);
+        /* Callers hold a spinlock, the IDR cannot sleep to get nodes */
+        id = idr_alloc_cyclic(&b->idr, b, b->offset, b->offset + b->size,
+                              GFP_ATOMIC);
         if (id < 0)
                 return bad_id(b);
 
-        bitmap_set(b->bitmap, id, 1);
-
-        return id + b->offset;
+        return id;
 }
 EXPORT_SYMBOL(rbmp_allocate);
 
@@ -105,7 +109,7 @@ static bool is_id_ok(struct rbmp * b, ssize_t id)
 {
         ASSERT(b);
 
-        if ((id < b->offset) || (id > (b->offset + b->size)))
+        if ((id < b->offset) || (id >= (b->offset + b->size)))
                 return false;
 
         return true;
@@ -120,20 +124,47 @@ bool rbmp_is_id_ok(struct rbmp * b, ssize_t id)
 }
 EXPORT_SYMBOL(rbmp_is_id_ok);
 
-int rbmp_release(struct rbmp * b,
-                 ssize_t       id)
+bool rbmp_is_allocated(struct rbmp * b, ssize_t id)
+{
+        if (!b || !is_id_ok(b, id))
+                return false;
+
+        return idr_find(&b->idr, id) != NULL;
+}
+EXPORT_SYMBOL(rbmp_is_allocated);
+
+ssize_t rbmp_next(struct rbmp * b, ssize_t id)
 {
-        ssize_t rid;
+        int next;
 
         if (!b)
                 return -1;
 
+        if (id < b->offset)
+                id = b->offset;
         if (!is_id_ok(b, id))
+                return bad_id(b);
+
+        next = id;
+        if (!idr_get_next(&b->idr, &next))
+                return bad_id(b);
+
+        return next;
+}
+EXPORT_SYMBOL(rbmp_next);
+
+int rbmp_release(struct rbmp * b,
+                 ssize_t       id)
+{
+        if (!b)
                 return -1;
 
-        rid = id - b->offset;
+        if (!is_id_ok(b, id))
+                return -1;
 
-        bitmap_clear(b->bitmap, id, 1);
+        if (!idr_find(&b->idr, id))
+                return -1;
+        idr_remove(&b->idr, id);
 
         return 0;
 }
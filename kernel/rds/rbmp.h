@@ -1,5 +1,5 @@
 /*
- * RINA Bitmaps
+ * RINA Bitmaps (id allocators)
  *
  *    Francesco Salvestrini <f.salvestrini@nextworks.it>
  *
@@ -31,5 +31,8 @@ ssize_t       rbmp_allocate(struct rbmp * instance);
 int           rbmp_release(struct rbmp * instance,
                            ssize_t       id);
 bool          rbmp_is_id_ok(struct rbmp * b, ssize_t id);
+bool          rbmp_is_allocated(struct rbmp * b, ssize_t id);
+/* First allocated id >= id, an invalid id if there is none */
+ssize_t       rbmp_next(struct rbmp * b, ssize_t id);
 
 #endif
@@ -0,0 +1,231 @@
+/*
+ * RINA object caches
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define RINA_PREFIX "rcache"
+
+#include "logs.h"
+#include "debug.h"
+#include "rmem.h"
+#include "rstats.h"
+#include "rcache.h"
+
+#if defined(CONFIG_RINA_MEMORY_TAMPERING) || \
+    defined(CONFIG_RINA_MEMORY_POISONING) || \
+    defined(CONFIG_RINA_MEMORY_STATS)
+#define RCACHE_USE_RMEM
+#endif
+
+enum rcache_counter {
+        RCACHE_ALLOCS = 0,
+        RCACHE_FREES,
+        RCACHE_FAILS,
+        RCACHE_COUNTERS
+};
+
+struct rcache {
+        char                name[32];
+        size_t              size;
+        struct kmem_cache * cache;
+        struct rstats *     stats;
+        struct list_head    next;
+};
+
+static LIST_HEAD(caches);
+static DEFINE_MUTEX(caches_lock);
+static struct dentry * caches_dbg;
+
+#ifdef CONFIG_DEBUG_FS
+static int rcaches_dbg_show(struct seq_file * s, void * v)
+{
+        struct rcache * c;
+        u64             allocs, frees;
+
+        seq_printf(s, "%-24s %8s %12s %12s %10s %8s\n",
+                   "name", "objsize", "allocs", "frees", "inuse", "fails");
+
+        mutex_lock(&caches_lock);
+        list_for_each_entry(c, &caches, next) {
+                allocs = rstats_read(c->stats, RCACHE_ALLOCS);
+                frees  = rstats_read(c->stats, RCACHE_FREES);
+                seq_printf(s, "%-24s %8zu %12llu %12llu %10lld %8llu\n",
+                           c->name, c->size, allocs, frees,
+                           (long long) (allocs - frees),
+                           rstats_read(c->stats, RCACHE_FAILS));
+        }
+        mutex_unlock(&caches_lock);
+
+#ifdef RCACHE_USE_RMEM
+        seq_printf(s, "(rmem debugging enabled, slab caches bypassed)\n");
+#endif
+
+        return 0;
+}
+
+static int rcaches_dbg_open(struct inode * inode, struct file * file)
+{ return single_open(file, rcaches_dbg_show, inode->i_private); }
+
+static const struct file_operations rcaches_dbg_fops = {
+        .open    = rcaches_dbg_open,
+        .read    = seq_read,
+        .llseek  = seq_lseek,
+        .release = single_release,
+};
+#endif
+
+int rcaches_init(void)
+{
+#ifdef CONFIG_DEBUG_FS
+        caches_dbg = debugfs_create_file("rina-caches", S_IRUSR, NULL, NULL,
+                                         &rcaches_dbg_fops);
+#endif
+        return 0;
+}
+
+void rcaches_fini(void)
+{
+        ASSERT(list_empty(&caches));
+
+        debugfs_remove(caches_dbg);
+        caches_dbg = NULL;
+}
+
+struct rcache * rcache_create(const char * name, size_t size)
+{
+        struct rcache * c;
+
+        if (!name || !size) {
+                LOG_ERR("Bogus input parameters, cannot create cache");
+                return NULL;
+        }
+
+        c = rkzalloc(sizeof(*c), GFP_KERNEL);
+        if (!c)
+                return NULL;
+
+        snprintf(c->name, sizeof(c->name), "%s", name);
+        c->size  = size;
+        c->stats = rstats_create(RCACHE_COUNTERS);
+        if (!c->stats) {
+                rkfree(c);
+                return NULL;
+        }
+
+#ifndef RCACHE_USE_RMEM
+        c->cache = kmem_cache_create(c->name, size, 0, SLAB_HWCACHE_ALIGN,
+                                     NULL);
+        if (!c->cache) {
+                LOG_ERR("Cannot create slab cache %s", c->name);
+                rstats_destroy(c->stats);
+                rkfree(c);
+                return NULL;
+        }
+#endif
+
+        mutex_lock(&caches_lock);
+        list_add_tail(&c->next, &caches);
+        mutex_unlock(&caches_lock);
+
+        LOG_DBG("Cache %s created, object size %zu", c->name, size);
+
+        return c;
+}
+EXPORT_SYMBOL(rcache_create);
+
+void rcache_destroy(struct rcache * c)
+{
+        u64 leaked;
+
+        if (!c)
+                return;
+
+        mutex_lock(&caches_lock);
+        list_del(&c->next);
+        mutex_unlock(&caches_lock);
+
+        leaked = rstats_read(c->stats, RCACHE_ALLOCS) -
+                 rstats_read(c->stats, RCACHE_FREES);
+        if (leaked)
+                LOG_WARN("Cache %s destroyed with %llu objects in use",
+                         c->name, leaked);
+
+        if (c->cache)
+                kmem_cache_destroy(c->cache);
+        rstats_destroy(c->stats);
+        rkfree(c);
+}
+EXPORT_SYMBOL(rcache_destroy);
+
+void * rcache_alloc(struct rcache * c, gfp_t flags)
+{
+        void * ptr;
+
+#ifdef RCACHE_USE_RMEM
+        ptr = rkmalloc(c->size, flags);
+#else
+        ptr = kmem_cache_alloc(c->cache, flags);
+#endif
+        if (unlikely(!ptr)) {
+                rstats_inc(c->stats, RCACHE_FAILS);
+                return NULL;
+        }
+        rstats_inc(c->stats, RCACHE_ALLOCS);
+
+        return ptr;
+}
+EXPORT_SYMBOL(rcache_alloc);
+
+void * rcache_zalloc(struct rcache * c, gfp_t flags)
+{
+        void * ptr;
+
+#ifdef RCACHE_USE_RMEM
+        ptr = rkzalloc(c->size, flags);
+#else
+        ptr = kmem_cache_zalloc(c->cache, flags);
+#endif
+        if (unlikely(!ptr)) {
+                rstats_inc(c->stats, RCACHE_FAILS);
+                return NULL;
+        }
+        rstats_inc(c->stats, RCACHE_ALLOCS);
+
+        return ptr;
+}
+EXPORT_SYMBOL(rcache_zalloc);
+
+void rcache_free(struct rcache * c, void * ptr)
+{
+        if (unlikely(!ptr))
+                return;
+
+        rstats_inc(c->stats, RCACHE_FREES);
+#ifdef RCACHE_USE_RMEM
+        rkfree(ptr);
+#else
+        kmem_cache_free(c->cache, ptr);
+#endif
+}
+EXPORT_SYMBOL(rcache_free);
@@ -0,0 +1,83 @@
+/*
+ * RINA per-CPU statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/types.h>
+#include <linux/percpu.h>
+
+#define RINA_PREFIX "rstats"
+
+#include "logs.h"
+#include "debug.h"
+#include "rmem.h"
+#include "rstats.h"
+
+static struct rstats * rstats_create_gfp(gfp_t flags, unsigned int n)
+{
+        struct rstats * tmp;
+
+        tmp = rkzalloc(sizeof(*tmp), flags);
+        if (!tmp)
+                return NULL;
+
+        /* Per-CPU memory comes zeroed */
+        tmp->n    = n;
+        tmp->pcpu = __alloc_percpu_gfp(n * sizeof(local64_t),
+                                       __alignof__(local64_t),
+                                       flags);
+        if (!tmp->pcpu) {
+                LOG_ERR("Cannot allocate %u per-CPU counters", n);
+                rkfree(tmp);
+                return NULL;
+        }
+
+        return tmp;
+}
+
+struct rstats * rstats_create(unsigned int n)
+{ return rstats_create_gfp(GFP_KERNEL, n); }
+EXPORT_SYMBOL(rstats_create);
+
+struct rstats * rstats_create_ni(unsigned int n)
+{ return rstats_create_gfp(GFP_ATOMIC, n); }
+EXPORT_SYMBOL(rstats_create_ni);
+
+void rstats_destroy(struct rstats * s)
+{
+        if (!s)
+                return;
+
+        free_percpu(s->pcpu);
+        rkfree(s);
+}
+EXPORT_SYMBOL(rstats_destroy);
+
+u64 rstats_read(struct rstats * s, unsigned int i)
+{
+        u64 sum = 0;
+        int cpu;
+
+        if (!s || i >= s->n)
+                return 0;
+
+        for_each_possible_cpu(cpu)
+                sum += local64_read(&per_cpu_ptr(s->pcpu, cpu)[i]);
+
+        return sum;
+}
+EXPORT_SYMBOL(rstats_read);
@@ -0,0 +1,76 @@
+/*
+ * RINA per-CPU statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef RINA_RSTATS_H
+#define RINA_RSTATS_H
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <asm/local64.h>
+
+/*
+ * A set of u64 counters, each CPU updating its own copy without locks or
+ * shared atomics. The copies are only summed up when the counters are read
+ * (sysfs, debugfs), so updating them on the data path does not bounce
+ * cache lines between CPUs. The same counters are updated from process
+ * context and from softirqs, local64_t keeps each update whole if one
+ * interrupts the other.
+ */
+struct rstats {
+        unsigned int          n;
+        local64_t __percpu *  pcpu;
+};
+
+struct rstats * rstats_create(unsigned int n);
+struct rstats * rstats_create_ni(unsigned int n);
+void            rstats_destroy(struct rstats * s);
+
+/* Sum of counter i over all the CPUs */
+u64             rstats_read(struct rstats * s, unsigned int i);
+
+static inline void rstats_add(struct rstats * s, unsigned int i, u64 v)
+{
+        local64_t * cnt;
+
+        if (unlikely(!s))
+                return;
+
+        cnt = get_cpu_ptr(s->pcpu);
+        local64_add(v, &cnt[i]);
+        put_cpu_ptr(s->pcpu);
+}
+
+static inline void rstats_inc(struct rstats * s, unsigned int i)
+{ rstats_add(s, i, 1); }
+
+/* Counts one PDU in counter i and its bytes in counter i + 1 */
+static inline void rstats_add_pdu(struct rstats * s, unsigned int i,
+                                  u64 bytes)
+{
+        local64_t * cnt;
+
+        if (unlikely(!s))
+                return;
+
+        cnt = get_cpu_ptr(s->pcpu);
+        local64_inc(&cnt[i]);
+        local64_add(bytes, &cnt[i + 1]);
+        put_cpu_ptr(s->pcpu);
+}
+
+#endif
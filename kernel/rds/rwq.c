@@ -27,6 +27,7 @@
 #include "debug.h"
 #include "rmem.h"
 #include "rwq.h"
+#include "rcache.h"
 
 /*
  * RWQ
@@ -40,6 +41,18 @@ struct rwq_work_item {
         struct workqueue_struct * wq;
 };
 
+static struct rcache * work_item_cache;
+
+int rwq_init(void)
+{
+        work_item_cache = rcache_create("rina_rwq_work_item",
+                                        sizeof(struct rwq_work_item));
+        return work_item_cache ? 0 : -1;
+}
+
+void rwq_fini(void)
+{ rcache_destroy(work_item_cache); }
+
 static void rwq_worker(struct work_struct * work)
 {
         struct rwq_work_item * item = (struct rwq_work_item *) work;
@@ -63,7 +76,7 @@ static void rwq_worker(struct work_struct * work)
                         queue_work(item->wq, (struct work_struct *) item);
         } else
                 /* We're the owner of the data, let's free it */
-                rkfree(item);
+                rcache_free(work_item_cache, item);
 
         return;
 }
@@ -122,7 +135,7 @@ static struct rwq_work_item * rwq_work_create_gfp(gfp_t    flags,
         }
         /* The data parameter can be empty ... */
 
-        tmp = rkzalloc(sizeof(struct rwq_work_item), flags);
+        tmp = rcache_zalloc(work_item_cache, flags);
         if (!tmp) {
                 LOG_ERR("Cannot create work item");
                 return NULL;
@@ -159,7 +172,7 @@ struct rwq_work_item * rwq_work_create_single_ni(int  (* work)(void * data),
 EXPORT_SYMBOL(rwq_work_create_single_ni);
 
 void rwq_work_destroy(struct rwq_work_item * item)
-{ rkfree(item); }
+{ rcache_free(work_item_cache, item); }
 EXPORT_SYMBOL(rwq_work_destroy);
 
 int rwq_work_post(struct workqueue_struct * wq,
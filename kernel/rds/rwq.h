@@ -34,6 +34,9 @@
 #define RWQ_RESCHEDULE   1
 
 
+int                       rwq_init(void);
+void                      rwq_fini(void);
+
 struct workqueue_struct * rwq_create(const char * name);
 struct workqueue_struct * rwq_create_hp(const char * name);
 int                       rwq_flush(struct workqueue_struct * q);
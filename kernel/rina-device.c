@@ -24,6 +24,11 @@
 #include <linux/ip.h>
 #include <linux/if.h>
 #include <linux/version.h>
+#include <linux/netdevice.h>
+#include <linux/u64_stats_sync.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,4,0)
+#include <net/gso.h>
+#endif
 
 #define RINA_PREFIX "rina-device"
 
@@ -35,16 +40,73 @@
 #include "rina-device.h"
 
 #define RINA_EXTRA_HEADER_LENGTH 50
+/* Max skbs waiting for a NAPI poll on a receive queue */
+#define RINA_DEV_RX_BACKLOG	 1024
+#define RINA_DEV_NAPI_WEIGHT	 64
+
+/* Multi-queue variant: one TX/RX queue per online CPU, NAPI on receive
+ * (so GRO can coalesce) and GSO on transmit, segmenting to the device
+ * MTU right before handing each segment to the KFA.
+ */
+static bool rina_dev_mq = false;
+module_param(rina_dev_mq, bool, 0644);
+MODULE_PARM_DESC(rina_dev_mq, "Create multi-queue NAPI/GSO RINA IP devices");
+
+struct rina_dev_pcpu_stats {
+	u64			rx_packets;
+	u64			rx_bytes;
+	u64			rx_dropped;
+	u64			tx_packets;
+	u64			tx_bytes;
+	u64			tx_dropped;
+	struct u64_stats_sync	syncp;
+};
+
+struct rina_dev_rxq {
+	struct napi_struct	napi;
+	struct sk_buff_head	backlog;
+	struct rina_device *	rina_dev;
+};
 
 struct rina_device {
-	struct net_device_stats stats;
+	struct rina_dev_pcpu_stats __percpu * stats;
 	struct ipcp_instance* kfa_ipcp;
 	port_id_t port;
 	struct net_device* dev;
+	bool mq;
+	unsigned int num_rxq;
+	struct rina_dev_rxq * rxq;
 };
 
+#define RINA_DEV_STATS_INC(rina_dev, field)				\
+	do {								\
+		struct rina_dev_pcpu_stats * __s;			\
+		__s = get_cpu_ptr((rina_dev)->stats);			\
+		u64_stats_update_begin(&__s->syncp);			\
+		__s->field++;					\
+		u64_stats_update_end(&__s->syncp);			\
+		put_cpu_ptr((rina_dev)->stats);				\
+	} while (0)
+
+#define RINA_DEV_STATS_ADD(rina_dev, dir, len)				\
+	do {								\
+		struct rina_dev_pcpu_stats * __s;			\
+		__s = get_cpu_ptr((rina_dev)->stats);			\
+		u64_stats_update_begin(&__s->syncp);			\
+		__s->dir##_packets++;					\
+		__s->dir##_bytes += (len);				\
+		u64_stats_update_end(&__s->syncp);			\
+		put_cpu_ptr((rina_dev)->stats);				\
+	} while (0)
+
 static int rina_dev_open(struct net_device *dev)
 {
+	struct rina_device* rina_dev = netdev_priv(dev);
+	unsigned int i;
+
+	for (i = 0; i < rina_dev->num_rxq; i++)
+		napi_enable(&rina_dev->rxq[i].napi);
+
 	netif_tx_start_all_queues(dev);
 	LOG_DBG("RINA IP device %s opened...", dev->name);
 
@@ -53,29 +115,99 @@ static int rina_dev_open(struct net_device *dev)
 
 static int rina_dev_close(struct net_device *dev)
 {
+	struct rina_device* rina_dev = netdev_priv(dev);
+	unsigned int i;
+
 	netif_tx_stop_all_queues(dev);
+
+	for (i = 0; i < rina_dev->num_rxq; i++) {
+		napi_disable(&rina_dev->rxq[i].napi);
+		skb_queue_purge(&rina_dev->rxq[i].backlog);
+	}
+
 	LOG_DBG("RINA IP device %s closed...", dev->name);
 
 	return 0;
 }
 
-static struct net_device_stats *rina_dev_get_stats(struct net_device *dev)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,11,0)
+static struct rtnl_link_stats64 *
+rina_dev_get_stats64(struct net_device *dev, struct rtnl_link_stats64 *tot)
+#else
+static void
+rina_dev_get_stats64(struct net_device *dev, struct rtnl_link_stats64 *tot)
+#endif
 {
 	struct rina_device* rina_dev = netdev_priv(dev);
-	if(!rina_dev)
-		return NULL;
-	
-	return &rina_dev->stats;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct rina_dev_pcpu_stats * s;
+		u64 rx_packets, rx_bytes, rx_dropped;
+		u64 tx_packets, tx_bytes, tx_dropped;
+		unsigned int start;
+
+		s = per_cpu_ptr(rina_dev->stats, cpu);
+		do {
+			start      = u64_stats_fetch_begin(&s->syncp);
+			rx_packets = s->rx_packets;
+			rx_bytes   = s->rx_bytes;
+			rx_dropped = s->rx_dropped;
+			tx_packets = s->tx_packets;
+			tx_bytes   = s->tx_bytes;
+			tx_dropped = s->tx_dropped;
+		} while (u64_stats_fetch_retry(&s->syncp, start));
+
+		tot->rx_packets += rx_packets;
+		tot->rx_bytes   += rx_bytes;
+		tot->rx_dropped += rx_dropped;
+		tot->tx_packets += tx_packets;
+		tot->tx_bytes   += tx_bytes;
+		tot->tx_dropped += tx_dropped;
+	}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,11,0)
+	return tot;
+#endif
+}
+
+static int rina_dev_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct rina_dev_rxq * rxq = container_of(napi, struct rina_dev_rxq,
+						 napi);
+	struct rina_device * rina_dev = rxq->rina_dev;
+	struct sk_buff * skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&rxq->backlog))) {
+		RINA_DEV_STATS_ADD(rina_dev, rx, skb->len);
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,5,0)
+		napi_complete(napi);
+#else
+		napi_complete_done(napi, work);
+#endif
+		/* Catch skbs queued between the last dequeue and completion */
+		if (!skb_queue_empty(&rxq->backlog))
+			napi_schedule(napi);
+	}
+
+	return work;
 }
 
 int rina_dev_rcv(struct sk_buff *skb, struct rina_device *rina_dev)
 {
+	struct rina_dev_rxq * rxq;
 	ssize_t len;
 
 	if(!(skb->data[0] & 0xf0)) {
 		LOG_INFO("RINA IP device %s rcv a non IP packet, dropping...",
 			  rina_dev->dev->name);
-		rina_dev->stats.rx_dropped++;
+		RINA_DEV_STATS_INC(rina_dev, rx_dropped);
 		kfree_skb(skb);
 		return -1;
 	}
@@ -84,11 +216,29 @@ int rina_dev_rcv(struct sk_buff *skb, struct rina_device *rina_dev)
 	skb->dev = rina_dev->dev;
 	len = skb->len;
 
+	if (rina_dev->mq) {
+		/* Called from KFA with the instance lock held: only queue the
+		 * skb here and let the NAPI poll feed GRO */
+		skb_reset_network_header(skb);
+		skb_reset_mac_header(skb);
+		rxq = &rina_dev->rxq[raw_smp_processor_id() %
+				     rina_dev->num_rxq];
+		if (unlikely(skb_queue_len(&rxq->backlog) >=
+			     RINA_DEV_RX_BACKLOG)) {
+			RINA_DEV_STATS_INC(rina_dev, rx_dropped);
+			kfree_skb(skb);
+			return 0;
+		}
+		skb_queue_tail(&rxq->backlog, skb);
+		napi_schedule(&rxq->napi);
+
+		return 0;
+	}
+
 	if(likely(netif_rx(skb) == NET_RX_SUCCESS)) {
-		rina_dev->stats.rx_packets++;
-		rina_dev->stats.rx_bytes += len;
+		RINA_DEV_STATS_ADD(rina_dev, rx, len);
 	} else {
-		rina_dev->stats.rx_dropped++;
+		RINA_DEV_STATS_INC(rina_dev, rx_dropped);
 	}
 
 	LOG_DBG("RINA IP device %s rcv a IP packet...",
@@ -97,11 +247,58 @@ int rina_dev_rcv(struct sk_buff *skb, struct rina_device *rina_dev)
 	return 0;
 }
 
+static int rina_dev_xmit_one(struct sk_buff * skb, struct rina_device * rina_dev)
+{
+	ssize_t data_sent;
+
+	data_sent = kfa_flow_skb_write(rina_dev->kfa_ipcp->data,
+				       rina_dev->port, skb, skb->len, false);
+	if (data_sent < 0) {
+		RINA_DEV_STATS_INC(rina_dev, tx_dropped);
+		LOG_ERR("Could not xmit IP packet, unable to send to KFA...");
+		return NET_XMIT_DROP;
+	}
+
+	RINA_DEV_STATS_ADD(rina_dev, tx, data_sent);
+
+	LOG_DBG("RINA IP device %s sent a packet of %zd bytes via port %d",
+		rina_dev->dev->name, data_sent, rina_dev->port);
+
+	return NETDEV_TX_OK;
+}
+
+static int rina_dev_xmit_gso(struct sk_buff * skb, struct rina_device * rina_dev)
+{
+	struct sk_buff * segs, * next;
+	netdev_features_t features;
+	int ret = NETDEV_TX_OK;
+
+	/* Segment to the flow MTU with linear segments, the EFCP/RMT
+	 * path expects the PDU payload in the skb head */
+	features = netif_skb_features(skb) & ~(NETIF_F_SG | NETIF_F_GSO_MASK);
+	segs = skb_gso_segment(skb, features);
+	if (IS_ERR_OR_NULL(segs)) {
+		RINA_DEV_STATS_INC(rina_dev, tx_dropped);
+		kfree_skb(skb);
+		return NET_XMIT_DROP;
+	}
+	consume_skb(skb);
+
+	while (segs) {
+		next = segs->next;
+		segs->next = NULL;
+		if (rina_dev_xmit_one(segs, rina_dev) != NETDEV_TX_OK)
+			ret = NET_XMIT_DROP;
+		segs = next;
+	}
+
+	return ret;
+}
+
 static int rina_dev_start_xmit(struct sk_buff * skb, struct net_device *dev)
 {
 	struct iphdr* iph = NULL;
 	struct rina_device* rina_dev = netdev_priv(dev);
-	ssize_t data_sent;
 	ASSERT(rina_dev);
 
 	skb_orphan(skb);
@@ -113,29 +310,35 @@ static int rina_dev_start_xmit(struct sk_buff * skb, struct net_device *dev)
 	LOG_DBG("Device %s about to send a packet of length %u via port %d",
 		dev->name, skb->len, rina_dev->port);
 
-	data_sent = kfa_flow_skb_write(rina_dev->kfa_ipcp->data,
-				       rina_dev->port, skb, skb->len, false);
-	if (data_sent < 0) {
-		rina_dev->stats.tx_dropped++;
-		LOG_ERR("Could not xmit IP packet, unable to send to KFA...");
+	if (skb_is_gso(skb))
+		return rina_dev_xmit_gso(skb, rina_dev);
+
+	if (skb_is_nonlinear(skb) && skb_linearize(skb)) {
+		RINA_DEV_STATS_INC(rina_dev, tx_dropped);
+		kfree_skb(skb);
 		return NET_XMIT_DROP;
 	}
 
-	rina_dev->stats.tx_packets++;
-	rina_dev->stats.tx_bytes += data_sent;
-
-	LOG_DBG("RINA IP device %s sent a packet of %zd bytes via port %d",
-		dev->name, data_sent, rina_dev->port);
-
-	return NETDEV_TX_OK;
+	return rina_dev_xmit_one(skb, rina_dev);
 }
 
 static void rina_dev_free(struct net_device *dev)
-{ return free_netdev(dev); }
+{
+	struct rina_device* rina_dev = netdev_priv(dev);
+	unsigned int i;
+
+	for (i = 0; i < rina_dev->num_rxq; i++)
+		netif_napi_del(&rina_dev->rxq[i].napi);
+	if (rina_dev->rxq)
+		rkfree(rina_dev->rxq);
+	free_percpu(rina_dev->stats);
+
+	return free_netdev(dev);
+}
 
 static const struct net_device_ops rina_dev_ops = {
 	.ndo_start_xmit	= rina_dev_start_xmit,
-	.ndo_get_stats	= rina_dev_get_stats,
+	.ndo_get_stats64 = rina_dev_get_stats64,
 	.ndo_open	= rina_dev_open,
 	.ndo_stop	= rina_dev_close,
 };
@@ -164,6 +367,11 @@ static void rina_dev_setup(struct net_device *dev)
 #endif
 	netif_keep_dst(dev);
 	dev->features = NETIF_F_HW_CSUM;
+	if (rina_dev_mq) {
+		/* Let TCP hand down super-packets, segmented in xmit */
+		dev->features |= NETIF_F_SG | NETIF_F_GSO_SOFTWARE;
+		dev->hw_features = dev->features;
+	}
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4,11,9)
 	dev->destructor	= rina_dev_free;
 #else
@@ -174,6 +382,33 @@ static void rina_dev_setup(struct net_device *dev)
 	return;
 }
 
+static int rina_dev_rxq_init(struct rina_device * rina_dev)
+{
+	unsigned int i;
+
+	if (!rina_dev->mq)
+		return 0;
+
+	rina_dev->rxq = rkzalloc(rina_dev->num_rxq * sizeof(*rina_dev->rxq),
+				 GFP_KERNEL);
+	if (!rina_dev->rxq)
+		return -1;
+
+	for (i = 0; i < rina_dev->num_rxq; i++) {
+		rina_dev->rxq[i].rina_dev = rina_dev;
+		skb_queue_head_init(&rina_dev->rxq[i].backlog);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,1,0)
+		netif_napi_add(rina_dev->dev, &rina_dev->rxq[i].napi,
+			       rina_dev_napi_poll, RINA_DEV_NAPI_WEIGHT);
+#else
+		netif_napi_add_weight(rina_dev->dev, &rina_dev->rxq[i].napi,
+				      rina_dev_napi_poll, RINA_DEV_NAPI_WEIGHT);
+#endif
+	}
+
+	return 0;
+}
+
 struct rina_device* rina_dev_create(string_t* name,
 				    struct ipcp_instance* kfa_ipcp,
 				    port_id_t port)
@@ -181,6 +416,8 @@ struct rina_device* rina_dev_create(string_t* name,
 	int rv;
 	struct net_device *dev;
 	struct rina_device* rina_dev;
+	unsigned int nqueues;
+	int cpu;
 
 	if (!kfa_ipcp || !name)
 		return NULL;
@@ -191,8 +428,10 @@ struct rina_device* rina_dev_create(string_t* name,
 		return NULL;
 	}
 
-	dev = alloc_netdev(sizeof(struct rina_device), name,
-			   NET_NAME_UNKNOWN, rina_dev_setup);
+	nqueues = rina_dev_mq ? num_online_cpus() : 1;
+	dev = alloc_netdev_mqs(sizeof(struct rina_device), name,
+			       NET_NAME_UNKNOWN, rina_dev_setup,
+			       nqueues, nqueues);
 	if (!dev) {
 		LOG_ERR("Could not allocate RINA IP network device %s", name);
 		return NULL;
@@ -202,17 +441,36 @@ struct rina_device* rina_dev_create(string_t* name,
 	rina_dev->dev = dev;
 	rina_dev->kfa_ipcp = kfa_ipcp;
 	rina_dev->port = port;
-	memset(&rina_dev->stats, 0x00, sizeof(struct net_device_stats));
+	rina_dev->mq = rina_dev_mq;
+	rina_dev->num_rxq = rina_dev_mq ? nqueues : 0;
+	rina_dev->rxq = NULL;
+
+	rina_dev->stats = alloc_percpu(struct rina_dev_pcpu_stats);
+	if (!rina_dev->stats) {
+		LOG_ERR("Could not allocate stats for RINA IP device %s", name);
+		free_netdev(dev);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(rina_dev->stats, cpu)->syncp);
+
+	if (rina_dev_rxq_init(rina_dev)) {
+		LOG_ERR("Could not allocate RX queues for RINA IP device %s",
+			name);
+		free_percpu(rina_dev->stats);
+		free_netdev(dev);
+		return NULL;
+	}
 
 	rv = register_netdev(dev);
 	if(rv) {
 		LOG_ERR("Could not register RINA IP device %s: %d", name, rv);
-		free_netdev(dev);
+		rina_dev_free(dev);
 		return NULL;
 	}
 
-	LOG_DBG("RINA IP device %s (%pk) created with dev %p",
-		name, rina_dev, dev);
+	LOG_DBG("RINA IP device %s (%pk) created with dev %p, %u queue(s)",
+		name, rina_dev, dev, nqueues);
 
 	return rina_dev;
 }
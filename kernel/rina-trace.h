@@ -0,0 +1,148 @@
+/*
+ * Tracepoints for the RINA data path
+ *
+ * They show up under events/rina/ in tracefs and can be used from perf,
+ * ftrace or eBPF, e.g.
+ *
+ *    perf record -e 'rina:*' -a
+ *    echo 1 > /sys/kernel/tracing/events/rina/rmt_drop/enable
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rina
+
+#if !defined(RINA_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define RINA_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* RMT, per N-1 port */
+DECLARE_EVENT_CLASS(rina_rmt_pdu,
+
+	TP_PROTO(int port_id, size_t len, unsigned int qlen),
+
+	TP_ARGS(port_id, len, qlen),
+
+	TP_STRUCT__entry(
+		__field(int,          port_id)
+		__field(size_t,       len)
+		__field(unsigned int, qlen)
+	),
+
+	TP_fast_assign(
+		__entry->port_id = port_id;
+		__entry->len     = len;
+		__entry->qlen    = qlen;
+	),
+
+	TP_printk("port-id=%d len=%zu qlen=%u",
+		  __entry->port_id, __entry->len, __entry->qlen)
+);
+
+DEFINE_EVENT(rina_rmt_pdu, rmt_enqueue,
+	TP_PROTO(int port_id, size_t len, unsigned int qlen),
+	TP_ARGS(port_id, len, qlen)
+);
+
+DEFINE_EVENT(rina_rmt_pdu, rmt_dequeue,
+	TP_PROTO(int port_id, size_t len, unsigned int qlen),
+	TP_ARGS(port_id, len, qlen)
+);
+
+DEFINE_EVENT(rina_rmt_pdu, rmt_drop,
+	TP_PROTO(int port_id, size_t len, unsigned int qlen),
+	TP_ARGS(port_id, len, qlen)
+);
+
+/* DTP, per EFCP connection */
+DECLARE_EVENT_CLASS(rina_dtp_pdu,
+
+	TP_PROTO(int cep_id, unsigned int type, unsigned int seq, size_t len),
+
+	TP_ARGS(cep_id, type, seq, len),
+
+	TP_STRUCT__entry(
+		__field(int,          cep_id)
+		__field(unsigned int, type)
+		__field(unsigned int, seq)
+		__field(size_t,       len)
+	),
+
+	TP_fast_assign(
+		__entry->cep_id = cep_id;
+		__entry->type   = type;
+		__entry->seq    = seq;
+		__entry->len    = len;
+	),
+
+	TP_printk("cep-id=%d type=0x%x seq=%u len=%zu",
+		  __entry->cep_id, __entry->type, __entry->seq, __entry->len)
+);
+
+DEFINE_EVENT(rina_dtp_pdu, dtp_send,
+	TP_PROTO(int cep_id, unsigned int type, unsigned int seq, size_t len),
+	TP_ARGS(cep_id, type, seq, len)
+);
+
+DEFINE_EVENT(rina_dtp_pdu, dtp_receive,
+	TP_PROTO(int cep_id, unsigned int type, unsigned int seq, size_t len),
+	TP_ARGS(cep_id, type, seq, len)
+);
+
+DEFINE_EVENT(rina_dtp_pdu, dtp_retransmit,
+	TP_PROTO(int cep_id, unsigned int type, unsigned int seq, size_t len),
+	TP_ARGS(cep_id, type, seq, len)
+);
+
+/* KFA, per flow */
+DECLARE_EVENT_CLASS(rina_kfa_sdu,
+
+	TP_PROTO(int port_id, ssize_t ret),
+
+	TP_ARGS(port_id, ret),
+
+	TP_STRUCT__entry(
+		__field(int,     port_id)
+		__field(ssize_t, ret)
+	),
+
+	TP_fast_assign(
+		__entry->port_id = port_id;
+		__entry->ret     = ret;
+	),
+
+	TP_printk("port-id=%d ret=%zd", __entry->port_id, __entry->ret)
+);
+
+DEFINE_EVENT(rina_kfa_sdu, kfa_write,
+	TP_PROTO(int port_id, ssize_t ret),
+	TP_ARGS(port_id, ret)
+);
+
+DEFINE_EVENT(rina_kfa_sdu, kfa_read,
+	TP_PROTO(int port_id, ssize_t ret),
+	TP_ARGS(port_id, ret)
+);
+
+#endif /* RINA_TRACE_H */
+
+/* Out of tree: look for this file in the module directory (-I$(src)) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rina-trace
+#include <trace/define_trace.h>
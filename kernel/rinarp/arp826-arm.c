@@ -21,6 +21,8 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/list.h>
+#include <linux/hashtable.h>
+#include <linux/module.h>
 #include <linux/netdevice.h>
 
 /* FIXME: The following dependencies have to be removed */
@@ -37,22 +39,63 @@
 #include "arp826-rxtx.h"
 #include "arp826-arm.h"
 
-struct resolution {
-        struct resolve_data * data;
+/*
+ * Ongoing resolutions are hashed by TPA. Resolutions for the same
+ * (device, ptype, SPA, TPA) share one request: later callers are queued as
+ * waiters and everybody is notified once the reply comes or the request
+ * times out. Timed out TPAs are remembered for a while (negative cache) so
+ * that a storm of resolutions for a dead peer does not flood the segment.
+ */
 
+struct waiter {
         arp826_notify_t       notify;
         void *                opaque;
 
+        struct list_head      next;
+};
+
+struct resolution {
+        struct resolve_data * data;
+
+        /* Protected by resolutions_lock while hashed */
+        struct list_head      waiters;
+
         struct timer_list     timer;
 
-        struct list_head      next;
+        struct hlist_node     hlist;
+        u32                   id;
 
         // rtimer uses 'unsigned int' *shrug*
         unsigned int          timeout;
 };
 
+#define RESOLUTIONS_HASH_BITS 6
+
 static DEFINE_SPINLOCK(resolutions_lock);
-static struct list_head resolutions_ongoing;
+static DEFINE_HASHTABLE(resolutions, RESOLUTIONS_HASH_BITS);
+static u32 resolutions_next_id;
+
+struct neg_entry {
+        /* Held until the entry is removed */
+        struct net_device * dev;
+        uint16_t            ptype;
+        struct gpa *        tpa;
+        unsigned long       expires;
+
+        struct hlist_node   hlist;
+};
+
+#define NEG_CACHE_HASH_BITS 6
+#define NEG_CACHE_MAX       256
+
+/* Protected by resolutions_lock too */
+static DEFINE_HASHTABLE(neg_cache, NEG_CACHE_HASH_BITS);
+static unsigned int neg_cache_size;
+
+static unsigned int neg_cache_ms = 1000;
+module_param(neg_cache_ms, uint, 0644);
+MODULE_PARM_DESC(neg_cache_ms,
+                 "Time a timed out GPA is not resolved again (0 disables)");
 
 struct resolve_data {
         struct net_device * dev;
@@ -76,18 +119,28 @@ static struct dentry *dbg_force_timeout = NULL;
 #ifdef CONFIG_DEBUG_FS
 static int arp826_resolutions_dbg_show(struct seq_file *s, void *v)
 {
-        struct resolution *res, *nxt;
+        struct resolution *res;
+        struct neg_entry *neg;
+        struct waiter *w;
+        unsigned int waiters;
         string_t buf[256];
+        int bkt;
 
         spin_lock_bh(&resolutions_lock);
 
-        list_for_each_entry_safe(res, nxt, &resolutions_ongoing, next) {
+        hash_for_each(resolutions, bkt, res, hlist) {
                 if (!res->data) {
                         seq_printf(s, "Invalid resolution data in resolution list\n");
                         continue;
                 }
                 else {
+                        waiters = 0;
+                        list_for_each_entry(w, &res->waiters, next)
+                                waiters++;
+
+                        seq_printf(s, "Id: %u\n", res->id);
                         seq_printf(s, "Timeout: %u\n", res->timeout);
+                        seq_printf(s, "Waiters: %u\n", waiters);
                         seq_printf(s, "Device: %s\n", res->data->dev->name);
                         seq_printf(s, "Ptype: 0x%04X\n", res->data->ptype);
 
@@ -123,6 +176,15 @@ static int arp826_resolutions_dbg_show(struct seq_file *s, void *v)
                 seq_printf(s, "\n");
         }
 
+        seq_printf(s, "Negative cache: %u entries\n", neg_cache_size);
+        hash_for_each(neg_cache, bkt, neg, hlist) {
+                seq_printf(s, "  %s 0x%04X %s%s\n",
+                           neg->dev->name, neg->ptype,
+                           gpa_address_to_string(neg->tpa, buf, sizeof(buf)),
+                           time_after(jiffies, neg->expires) ?
+                           " (expired)" : "");
+        }
+
         spin_unlock_bh(&resolutions_lock);
 
         return 0;
@@ -146,8 +208,9 @@ static int timeout_resolver(void *);
 static ssize_t arp826_force_timeout_write(struct file *file,
                                           const char __user *user_buf,
                                           size_t count, loff_t *pos) {
-        struct resolution *res, *nxt;
+        struct resolution *res;
         struct rwq_work_item *r;
+        int bkt;
 
         LOG_DBG("Forcing timeout of all pending RINA ARP requests");
 
@@ -157,12 +220,13 @@ static ssize_t arp826_force_timeout_write(struct file *file,
 
         spin_lock_bh(&resolutions_lock);
 
-        list_for_each_entry_safe(res, nxt, &resolutions_ongoing, next) {
-                res->data->timed_out = 1;
-                r = rwq_work_create_ni(timeout_resolver, res);
+        hash_for_each(resolutions, bkt, res, hlist) {
+                r = rwq_work_create_ni(timeout_resolver,
+                                       (void *) (unsigned long) res->id);
                 if (!r) {
                         LOG_CRIT("Cannot create work item for ARP timeout");
-                        return -1;
+                        spin_unlock_bh(&resolutions_lock);
+                        return -ENOMEM;
                 }
 
                 /* Takes the ownership ... and disposes everything */
@@ -267,41 +331,244 @@ static struct resolve_data * resolve_data_create(struct net_device * dev,
                                                  struct gha *        tha)
 { return resolve_data_create_gfp(GFP_KERNEL, dev, ptype, spa, sha, tpa, tha); }
 
+static bool is_resolution_matching(const struct resolution * res,
+                                   struct net_device *       dev,
+                                   uint16_t                  ptype,
+                                   const struct gpa *        spa,
+                                   const struct gpa *        tpa)
+{
+        return res->data->dev   == dev   &&
+               res->data->ptype == ptype &&
+               gpa_is_equal(res->data->tpa, tpa) &&
+               gpa_is_equal(res->data->spa, spa);
+}
+
+/* Must be called with resolutions_lock held */
+static struct resolution * resolution_find(struct net_device * dev,
+                                           uint16_t            ptype,
+                                           const struct gpa *  spa,
+                                           const struct gpa *  tpa)
+{
+        struct resolution * pos;
+
+        hash_for_each_possible(resolutions, pos, hlist, gpa_hash(tpa)) {
+                if (is_resolution_matching(pos, dev, ptype, spa, tpa))
+                        return pos;
+        }
+
+        return NULL;
+}
+
+/* Must be called with resolutions_lock held */
+static struct resolution * resolution_find_id(u32 id)
+{
+        struct resolution * pos;
+        int                 bkt;
+
+        hash_for_each(resolutions, bkt, pos, hlist) {
+                if (pos->id == id)
+                        return pos;
+        }
+
+        return NULL;
+}
+
+/* The resolution must not be hashed anymore (or never was) */
 static void resolution_destroy(struct resolution *res) {
-        /* Remove the resolution in the list of pending
-         * resolutions. */
-        spin_lock(&resolutions_lock);
-        list_del(&res->next);
-        spin_unlock(&resolutions_lock);
-
-        /* Destroy the pending resolution object data and stop the
-           timeout timer. */
+        struct waiter *pos, *nxt;
+
+        /* Stop the timeout timer, waiting for its handler to finish */
+        del_timer_sync(&res->timer);
+
+        list_for_each_entry_safe(pos, nxt, &res->waiters, next) {
+                list_del(&pos->next);
+                rkfree(pos);
+        }
+
         resolve_data_destroy(res->data);
-        rtimer_stop(&res->timer);
         rkfree(res);
 }
 
+/* Notifies all the waiters of a resolution that is not hashed anymore */
+static void resolution_notify(struct resolution *  res,
+                              bool                 timed_out,
+                              const struct gpa *   tpa,
+                              const struct gha *   tha)
+{
+        struct waiter *pos;
+
+        list_for_each_entry(pos, &res->waiters, next)
+                pos->notify(pos->opaque, timed_out, tpa, tha);
+}
+
+/* Must be called with resolutions_lock held */
+static struct neg_entry * neg_find(struct net_device * dev,
+                                   uint16_t            ptype,
+                                   const struct gpa *  tpa)
+{
+        struct neg_entry * pos;
+
+        hash_for_each_possible(neg_cache, pos, hlist, gpa_hash(tpa)) {
+                if (pos->dev == dev && pos->ptype == ptype &&
+                    gpa_is_equal(pos->tpa, tpa))
+                        return pos;
+        }
+
+        return NULL;
+}
+
+/* Must be called with resolutions_lock held */
+static void neg_remove(struct neg_entry * neg)
+{
+        hash_del(&neg->hlist);
+        neg_cache_size--;
+        dev_put(neg->dev);
+        gpa_destroy(neg->tpa);
+        rkfree(neg);
+}
+
+/* Must be called with resolutions_lock held */
+static void neg_purge(bool all)
+{
+        struct neg_entry * pos;
+        struct hlist_node * tmp;
+        int bkt;
+
+        hash_for_each_safe(neg_cache, bkt, tmp, pos, hlist) {
+                if (all || time_after(jiffies, pos->expires))
+                        neg_remove(pos);
+        }
+}
+
+/* Must be called with resolutions_lock held */
+static void neg_purge_dev(struct net_device * dev)
+{
+        struct neg_entry * pos;
+        struct hlist_node * tmp;
+        int bkt;
+
+        hash_for_each_safe(neg_cache, bkt, tmp, pos, hlist) {
+                if (pos->dev == dev)
+                        neg_remove(pos);
+        }
+}
+
+/* Must be called with resolutions_lock held */
+static void neg_add(struct net_device * dev,
+                    uint16_t            ptype,
+                    const struct gpa *  tpa)
+{
+        struct neg_entry * neg;
+        unsigned long      expires;
+
+        if (!neg_cache_ms)
+                return;
+
+        expires = jiffies + msecs_to_jiffies(neg_cache_ms);
+
+        neg = neg_find(dev, ptype, tpa);
+        if (neg) {
+                neg->expires = expires;
+                return;
+        }
+
+        if (neg_cache_size >= NEG_CACHE_MAX) {
+                neg_purge(false);
+                if (neg_cache_size >= NEG_CACHE_MAX)
+                        return;
+        }
+
+        neg = rkmalloc(sizeof(*neg), GFP_ATOMIC);
+        if (!neg)
+                return;
+
+        neg->tpa = gpa_dup_gfp(GFP_ATOMIC, tpa);
+        if (!neg->tpa) {
+                rkfree(neg);
+                return;
+        }
+        dev_hold(dev);
+        neg->dev     = dev;
+        neg->ptype   = ptype;
+        neg->expires = expires;
+
+        hash_add(neg_cache, &neg->hlist, gpa_hash(neg->tpa));
+        neg_cache_size++;
+}
+
+/* Must be called with resolutions_lock held */
+static bool neg_is_cached(struct net_device * dev,
+                          uint16_t            ptype,
+                          const struct gpa *  tpa)
+{
+        struct neg_entry * neg;
+
+        if (!neg_cache_size)
+                return false;
+
+        neg = neg_find(dev, ptype, tpa);
+        if (!neg)
+                return false;
+
+        if (time_after(jiffies, neg->expires)) {
+                neg_remove(neg);
+                return false;
+        }
+
+        return true;
+}
+
+/* The negative cache holds its devices, let them go on unregistration */
+static int arm_netdev_notify(struct notifier_block * nb,
+                             unsigned long           event,
+                             void *                  opaque)
+{
+        struct net_device * dev;
+
+        if (event != NETDEV_UNREGISTER)
+                return NOTIFY_DONE;
+
+        dev = netdev_notifier_info_to_dev(opaque);
+
+        spin_lock_bh(&resolutions_lock);
+        neg_purge_dev(dev);
+        spin_unlock_bh(&resolutions_lock);
+
+        return NOTIFY_DONE;
+}
+
+static struct notifier_block arm_netdev_nb = {
+        .notifier_call = arm_netdev_notify,
+};
+
 static int timeout_resolver(void *o) {
         struct resolution *res;
+        u32 id = (u32) (unsigned long) o;
 
         LOG_DBG("In the ARP timeout resolver, calling the timed out notifier");
 
-        res = (struct resolution *)o;
-        if (!res) return -1;
+        spin_lock_bh(&resolutions_lock);
+        res = resolution_find_id(id);
+        if (!res) {
+                /* The reply won the race */
+                spin_unlock_bh(&resolutions_lock);
+                return 0;
+        }
+        hash_del(&res->hlist);
+        res->data->timed_out = 1;
+        neg_add(res->data->dev, res->data->ptype, res->data->tpa);
+        spin_unlock_bh(&resolutions_lock);
 
-        ASSERT(res);
         ASSERT(res->data);
-        ASSERT(res->tpa);
-        ASSERT(res->tha);
 
         /* If the request timed out, we have to use the target address
          * in the resolve_data object since this is what is used by
          * the notifier object to find the ARP request corresponding
          * to an ARP reply. */
-        res->notify(res->opaque,
-                    res->data->timed_out,
-                    res->data->tpa,
-                    res->data->tha);
+        resolution_notify(res,
+                          res->data->timed_out,
+                          res->data->tpa,
+                          res->data->tha);
 
         resolution_destroy(res);
 
@@ -315,7 +582,8 @@ static int timeout_resolver(void *o) {
 static int reply_resolver(void *o)
 {
         struct resolve_data *tmp;
-        struct resolution *pos, *nxt;
+        struct resolution *pos, *res;
+        struct neg_entry *neg;
 
         LOG_DBG("In the ARP resolver, looking for the right handler");
 
@@ -334,24 +602,30 @@ static int reply_resolver(void *o)
                 return -1;
         }
 
-        spin_lock(&resolutions_lock);
+        res = NULL;
+
+        spin_lock_bh(&resolutions_lock);
 
         /* Find the resolution that matches this reply. */
-        list_for_each_entry_safe(pos, nxt, &resolutions_ongoing, next) {
+        hash_for_each_possible(resolutions, pos, hlist, gpa_hash(tmp->spa)) {
                 if (is_resolve_data_matching(pos->data, tmp)) {
-                        spin_unlock(&resolutions_lock);
-
-                        pos->notify(pos->opaque,
-                                    tmp->timed_out,
-                                    tmp->spa,
-                                    tmp->sha);
-
-                        resolution_destroy(pos);
+                        hash_del(&pos->hlist);
+                        res = pos;
                         break;
                 }
         }
 
-        spin_unlock(&resolutions_lock);
+        /* The peer is alive after all */
+        neg = neg_find(tmp->dev, tmp->ptype, tmp->spa);
+        if (neg)
+                neg_remove(neg);
+
+        spin_unlock_bh(&resolutions_lock);
+
+        if (res) {
+                resolution_notify(res, tmp->timed_out, tmp->spa, tmp->sha);
+                resolution_destroy(res);
+        }
 
         /* Finally destroy the data */
         resolve_data_destroy(tmp);
@@ -378,11 +652,13 @@ static void resolution_timeout(struct timer_list *tl)
 
         ASSERT(arm_wq);
 
-        res->data->timed_out = 1;
-
-        r = rwq_work_create_ni(timeout_resolver, res);
+        /* The resolution may be gone by the time the work runs, so the
+         * resolver looks it up again by id */
+        r = rwq_work_create_ni(timeout_resolver,
+                               (void *) (unsigned long) res->id);
         if (!r) {
-                LOG_CRIT("Cannot create work item for ARP timeout");
+                LOG_CRIT("Cannot create work item for ARP timeout, retrying");
+                rtimer_start(&res->timer, 10);
                 return;
         }
 
@@ -434,6 +710,9 @@ int arp826_resolve_gpa(struct net_device * dev,
                        void *              opaque)
 {
         struct resolution * resolution;
+        struct resolution * ongoing;
+        struct waiter *     waiter;
+        u32                 id;
 
         struct gpa * tmp_spa;
         struct gpa * tmp_tpa;
@@ -456,61 +735,112 @@ int arp826_resolve_gpa(struct net_device * dev,
                 return -1;
         }
 
-        tmp_spa = gpa_dup(spa);
-        if (!tmp_spa)
+        waiter = rkzalloc(sizeof(*waiter), GFP_KERNEL);
+        if (!waiter)
                 return -1;
-        tmp_tpa = gpa_dup(tpa);
-        if (!tmp_tpa) {
-                gpa_destroy(tmp_spa);
+        waiter->notify = notify;
+        waiter->opaque = opaque;
+        INIT_LIST_HEAD(&waiter->next);
+
+        spin_lock_bh(&resolutions_lock);
+        if (neg_is_cached(dev, ptype, tpa)) {
+                spin_unlock_bh(&resolutions_lock);
+                gpa_log_dbg("Recently timed out, not resolving", tpa);
+                rkfree(waiter);
                 return -1;
         }
-        tmp_sha = gha_dup(sha);
-        if (!tmp_sha) {
-                gpa_destroy(tmp_spa);
-                gpa_destroy(tmp_tpa);
-                return -1;
+        ongoing = resolution_find(dev, ptype, spa, tpa);
+        if (ongoing) {
+                LOG_DBG("Joining ongoing resolution %u", ongoing->id);
+                list_add_tail(&waiter->next, &ongoing->waiters);
+                spin_unlock_bh(&resolutions_lock);
+                return 0;
         }
+        spin_unlock_bh(&resolutions_lock);
+
+        tmp_spa = gpa_dup(spa);
+        if (!tmp_spa)
+                goto fail_spa;
+        tmp_tpa = gpa_dup(tpa);
+        if (!tmp_tpa)
+                goto fail_tpa;
+        tmp_sha = gha_dup(sha);
+        if (!tmp_sha)
+                goto fail_sha;
 
         resolution = rkzalloc(sizeof(*resolution), GFP_KERNEL);
-        if (!resolution) {
-                gpa_destroy(tmp_spa);
-                gpa_destroy(tmp_tpa);
-                gha_destroy(tmp_sha);
-                return -1;
-        }
+        if (!resolution)
+                goto fail_res;
 
         resolution->data = resolve_data_create(dev, ptype,
                                                tmp_spa, tmp_sha,
                                                tmp_tpa, NULL);
-        if (!resolution->data) {
-                gpa_destroy(tmp_spa);
-                gpa_destroy(tmp_tpa);
-                gha_destroy(tmp_sha);
-                rkfree(resolution);
-                return -1;
-        }
+        if (!resolution->data)
+                goto fail_data;
 
-        resolution->notify = notify;
-        resolution->opaque = opaque;
+        INIT_LIST_HEAD(&resolution->waiters);
+        INIT_HLIST_NODE(&resolution->hlist);
         rtimer_init(resolution_timeout, &resolution->timer, resolution);
+        resolution->timeout = timeout_ms;
 
-        INIT_LIST_HEAD(&resolution->next);
-
-        LOG_DBG("Adding new resolution to the ongoing list");
-        spin_lock(&resolutions_lock);
-        list_add(&resolution->next, &resolutions_ongoing);
-        spin_unlock(&resolutions_lock);
+        spin_lock_bh(&resolutions_lock);
+        /* Somebody may have been faster */
+        ongoing = resolution_find(dev, ptype, spa, tpa);
+        if (ongoing) {
+                list_add_tail(&waiter->next, &ongoing->waiters);
+                spin_unlock_bh(&resolutions_lock);
+                resolution_destroy(resolution);
+                return 0;
+        }
 
-        resolution->timeout = timeout_ms;
+        LOG_DBG("Adding new resolution to the ongoing ones");
+        if (!++resolutions_next_id)
+                ++resolutions_next_id;
+        resolution->id = resolutions_next_id;
+        id = resolution->id;
+        list_add_tail(&waiter->next, &resolution->waiters);
+        hash_add(resolutions, &resolution->hlist, gpa_hash(tpa));
         rtimer_start(&resolution->timer, resolution->timeout);
+        spin_unlock_bh(&resolutions_lock);
 
         if (arp_send_request(dev, ptype, spa, sha, tpa)) {
                 LOG_ERR("Cannot send request, cannot resolve GPA");
+
+                /* A reply or the timeout may have freed it meanwhile */
+                spin_lock_bh(&resolutions_lock);
+                resolution = resolution_find_id(id);
+                if (!resolution) {
+                        /* Already being resolved, we'll be notified */
+                        spin_unlock_bh(&resolutions_lock);
+                        return 0;
+                }
+                list_del(&waiter->next);
+                rkfree(waiter);
+                if (!list_empty(&resolution->waiters)) {
+                        /* The others wait for the timeout */
+                        spin_unlock_bh(&resolutions_lock);
+                        return -1;
+                }
+                hash_del(&resolution->hlist);
+                spin_unlock_bh(&resolutions_lock);
+
                 resolution_destroy(resolution);
                 return -1;
         }
 
         return 0;
+
+ fail_data:
+        rkfree(resolution);
+ fail_res:
+        gha_destroy(tmp_sha);
+ fail_sha:
+        gpa_destroy(tmp_tpa);
+ fail_tpa:
+        gpa_destroy(tmp_spa);
+ fail_spa:
+        rkfree(waiter);
+        return -1;
 }
 EXPORT_SYMBOL(arp826_resolve_gpa);
 
@@ -520,8 +850,16 @@ int arm_init(void)
         if (!arm_wq)
                 return -1;
 
-        spin_lock_init(&resolutions_lock);
-        INIT_LIST_HEAD(&resolutions_ongoing);
+        hash_init(resolutions);
+        hash_init(neg_cache);
+        neg_cache_size = 0;
+
+        if (register_netdevice_notifier(&arm_netdev_nb)) {
+                LOG_ERR("Cannot register the netdevice notifier");
+                rwq_destroy(arm_wq);
+                arm_wq = NULL;
+                return -1;
+        }
 
 #ifdef CONFIG_DEBUG_FS
         dbg = debugfs_create_dir("arp826", NULL);
@@ -545,10 +883,24 @@ int arm_init(void)
 
 int arm_fini(void)
 {
-        struct resolution * pos, * nxt;
+        struct resolution * pos;
+        struct hlist_node * nxt;
+        HLIST_HEAD(gone);
+        int                 bkt;
         int                 ret;
 
-        list_for_each_entry_safe(pos, nxt, &resolutions_ongoing, next) {
+        unregister_netdevice_notifier(&arm_netdev_nb);
+
+        spin_lock_bh(&resolutions_lock);
+        hash_for_each_safe(resolutions, bkt, nxt, pos, hlist) {
+                hash_del(&pos->hlist);
+                hlist_add_head(&pos->hlist, &gone);
+        }
+        neg_purge(true);
+        spin_unlock_bh(&resolutions_lock);
+
+        hlist_for_each_entry_safe(pos, nxt, &gone, hlist) {
+                hlist_del(&pos->hlist);
                 resolution_destroy(pos);
         }
 
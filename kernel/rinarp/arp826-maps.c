@@ -20,6 +20,7 @@
 
 #include <linux/types.h>
 #include <linux/hashtable.h>
+#include <linux/rculist.h>
 
 /* FIXME: The following dependencies have to be removed */
 #define RINA_PREFIX "arp826-maps"
@@ -36,6 +37,9 @@
  *        ... we had no time to do any better. This code will be replaced
  *        completely with a better implementation once we'be able to find
  *        time to breathe again ...
+ *
+ *        Lookups may run under RCU, additions and removals are serialized
+ *        by the caller.
  */
 
 struct tmap {
@@ -50,6 +54,7 @@ struct tmap_entry {
         struct table *   value;
 
         struct list_head next;
+        struct rcu_head  rcu;
 };
 
 static struct tmap * tmap_create_gfp(gfp_t flags)
@@ -122,7 +127,7 @@ static int tmap_entry_add_gfp(gfp_t               flags,
         tmp->value      = value;
         INIT_LIST_HEAD(&tmp->next);
 
-        list_add(&tmp->next, &map->head);
+        list_add_rcu(&tmp->next, &map->head);
 
         return 0;
 }
@@ -148,7 +153,7 @@ struct tmap_entry * tmap_entry_find(struct tmap *       map,
         if (!tmap_is_ok(map))
                 return NULL;
 
-        list_for_each_entry(tmp, &map->head, next) {
+        list_for_each_entry_rcu(tmp, &map->head, next) {
                 if ((tmp->key.device == key_device) &&
                     (tmp->key.ptype  == key_ptype))
                         return tmp;
@@ -165,7 +170,7 @@ int tmap_entry_remove(struct tmap_entry * entry)
         if (!tmap_entry_is_ok(entry))
                 return -1;
 
-        list_del(&entry->next);
+        list_del_rcu(&entry->next);
 
         return 0;
 }
@@ -178,12 +183,15 @@ struct table * tmap_entry_value(struct tmap_entry * entry)
         return entry->value;
 }
 
+static void tmap_entry_free_rcu(struct rcu_head * head)
+{ rkfree(container_of(head, struct tmap_entry, rcu)); }
+
 int tmap_entry_destroy(struct tmap_entry * entry)
 {
         if (!tmap_entry_is_ok(entry))
                 return -1;
 
-        rkfree(entry);
+        call_rcu(&entry->rcu, tmap_entry_free_rcu);
 
         return 0;
 }
@@ -405,11 +405,12 @@ static int process(const struct sk_buff * skb,
                 struct table *             tbl       = NULL;
                 const struct table_entry * entry     = NULL;
                 const struct table_entry * req_addr  = NULL;
-                const struct gha *         target_ha = NULL;
+                struct gha *               target_ha = NULL;
 
                 /* FIXME: Should we add all ARP Requests? */
 
-                /* Do we have it in the cache ? */
+                /* Do we have it in the cache ? arp_receive() holds the
+                 * RCU read lock */
                 tbl = tbls_find(dev, ptype);
                 if (!tbl) {
                         LOG_ERR("I don't have a table for ptype 0x%04X",
@@ -425,7 +426,10 @@ static int process(const struct sk_buff * skb,
                  * FIXME: We do a double lookup here. Please remove it, all
                  *        the CPUs (and trees) out there will apreciate that...
                  */
+                rcu_read_lock();
                 entry = tbl_find_by_gpa(tbl, tmp_spa);
+                rcu_read_unlock();
+                /* Only tells whether to add or to update */
                 if (!entry) {
                         struct table_entry * tmp;
 
@@ -459,7 +463,12 @@ static int process(const struct sk_buff * skb,
                         }
                 }
 
+                /* The entry can be replaced once out of the RCU section */
+                rcu_read_lock();
                 req_addr = tbl_find_by_gpa(tbl, tmp_tpa);
+                if (req_addr)
+                        target_ha = gha_dup_ni(tble_ha(req_addr));
+                rcu_read_unlock();
                 if (!req_addr) {
                         LOG_DBG("Cannot find this TPA in my tables, "
                                 "bailing out");
@@ -470,7 +479,6 @@ static int process(const struct sk_buff * skb,
                         return -1;
                 }
 
-                target_ha = tble_ha(req_addr);
                 if (!target_ha) {
                         LOG_ERR("Cannot get a good target HA");
                         gpa_destroy(tmp_spa);
@@ -487,12 +495,14 @@ static int process(const struct sk_buff * skb,
                                    tmp_tpa, target_ha,
                                    tmp_spa, tmp_sha)) {
                         LOG_ERR("Couldn't send reply");
+                        gha_destroy(target_ha);
                         gpa_destroy(tmp_spa);
                         gpa_destroy(tmp_tpa);
                         gha_destroy(tmp_sha);
                         gha_destroy(tmp_tha);
                         return -1;
                 }
+                gha_destroy(target_ha);
                 gpa_destroy(tmp_spa);
                 gpa_destroy(tmp_tpa);
                 gha_destroy(tmp_sha);
@@ -584,9 +594,13 @@ int arp_receive(struct sk_buff *     skb,
                 return 0;
         }
 
+        /* The table is freed a grace period after tbls_destroy() */
+        rcu_read_lock();
+
         /* FIXME: There's no need to lookup it here ... */
         cl = tbls_find(dev, ntohs(header->ptype));
         if (!cl) {
+                rcu_read_unlock();
 #if 0
                 /* This log is too noisy ... but necessary for now :) */
                 LOG_DBG("I don't have a table to handle this ARP "
@@ -604,16 +618,20 @@ int arp_receive(struct sk_buff *     skb,
                 LOG_WARN("Got an ARP header "
                          "without 2 devices and 2 network addresses "
                          "(step #2)");
+                rcu_read_unlock();
                 kfree_skb(skb);
                 return 0;
         }
 
         if (process(skb, cl, dev)) {
+                rcu_read_unlock();
                 LOG_DBG("Cannot process this ARP");
                 kfree_skb(skb);
                 return 0;
         }
 
+        rcu_read_unlock();
+
         consume_skb(skb);
 
         return 0;
@@ -19,14 +19,15 @@
  */
 
 /*
- * NOTE: This cache implementation is far far far away to be a performance-wise
- *       one. Its scope is to server the upper-layers, nothing else. If we will
- *       have the time, a performance-wise implementation will obsolete this
- *       one completely.
+ * NOTE: Every table is indexed twice, by GPA and by GHA. Lookups run under
+ *       RCU, updates are serialized by the table lock and entries are freed
+ *       after a grace period. The same goes for the tables map.
  */
 
 #include <linux/types.h>
 #include <linux/netdevice.h>
+#include <linux/hashtable.h>
+#include <linux/rcupdate.h>
 
 /* FIXME: The following dependencies have to be removed */
 #define RINA_PREFIX "arp826-tables"
@@ -43,10 +44,12 @@
 #include "arp826-tables.h"
 
 struct table_entry {
-        struct gpa *     pa; /* Protocol address */
-        struct gha *     ha; /* Hardware address */
+        struct gpa *      pa; /* Protocol address */
+        struct gha *      ha; /* Hardware address */
 
-        struct list_head next;
+        struct hlist_node by_gpa;
+        struct hlist_node by_gha;
+        struct rcu_head   rcu;
 };
 
 static void tble_fini(struct table_entry * entry)
@@ -78,6 +81,13 @@ int tble_destroy(struct table_entry * entry)
 }
 EXPORT_SYMBOL(tble_destroy);
 
+static void tble_free_rcu(struct rcu_head * head)
+{ tble_destroy(container_of(head, struct table_entry, rcu)); }
+
+/* For entries that have been in a table, readers may still see them */
+static void tble_destroy_rcu(struct table_entry * entry)
+{ call_rcu(&entry->rcu, tble_free_rcu); }
+
 /* Takes the ownership of the input GPA */
 static int tble_init(struct table_entry * entry,
                      struct gpa *         pa,
@@ -94,7 +104,8 @@ static int tble_init(struct table_entry * entry,
         entry->pa = pa;
         entry->ha = ha;
 
-        INIT_LIST_HEAD(&entry->next);
+        INIT_HLIST_NODE(&entry->by_gpa);
+        INIT_HLIST_NODE(&entry->by_gha);
 
         return 0;
 }
@@ -183,10 +194,14 @@ const struct gha * tble_ha(const struct table_entry * entry)
         return entry->ha;
 }
 
+#define TBL_HASH_BITS 8
+
 struct table {
         size_t           hal;     /* Hardware address length */
-        spinlock_t       lock;
-        struct list_head entries;
+        spinlock_t       lock;    /* Writers only */
+        DECLARE_HASHTABLE(by_gpa, TBL_HASH_BITS);
+        DECLARE_HASHTABLE(by_gha, TBL_HASH_BITS);
+        struct rcu_head  rcu;
 };
 
 static struct table * tbl_create_gfp(gfp_t  flags,
@@ -208,7 +223,8 @@ static struct table * tbl_create_gfp(gfp_t  flags,
         LOG_DBG("Got memory, fillin' it up");
 
         instance->hal = ha_length;
-        INIT_LIST_HEAD(&instance->entries);
+        hash_init(instance->by_gpa);
+        hash_init(instance->by_gha);
         spin_lock_init(&instance->lock);
 
         LOG_DBG("Table instance created successfully");
@@ -216,33 +232,64 @@ static struct table * tbl_create_gfp(gfp_t  flags,
         return instance;
 }
 
+/* No readers left, no need for the lock */
 static void tbl_destroy(struct table * instance)
 {
-        struct table_entry * pos, * q;
+        struct table_entry * pos;
+        struct hlist_node *  q;
+        int                  bkt;
 
         if (!instance) {
                 LOG_ERR("Bogus input parameter, cannot destroy table");
                 return;
         }
 
-        spin_lock(&instance->lock);
-
-        list_for_each_entry_safe(pos, q, &instance->entries, next) {
+        hash_for_each_safe(instance->by_gpa, bkt, q, pos, by_gpa) {
                 ASSERT(pos);
+                hash_del(&pos->by_gpa);
                 tble_destroy(pos);
         }
 
-        spin_unlock(&instance->lock);
-
         rkfree(instance);
 }
 
+static void tbl_free_rcu(struct rcu_head * head)
+{ tbl_destroy(container_of(head, struct table, rcu)); }
+
+static struct table_entry * __tbl_find_by_gpa(struct table *     instance,
+                                              const struct gpa * address)
+{
+        struct table_entry * pos;
+
+        hash_for_each_possible_rcu(instance->by_gpa, pos, by_gpa,
+                                   gpa_hash(address)) {
+                if (gpa_is_equal(pos->pa, address))
+                        return pos;
+        }
+
+        return NULL;
+}
+
+static struct table_entry * __tbl_find_by_gha(struct table *     instance,
+                                              const struct gha * address)
+{
+        struct table_entry * pos;
+
+        hash_for_each_possible_rcu(instance->by_gha, pos, by_gha,
+                                   gha_hash(address)) {
+                if (gha_is_equal(pos->ha, address))
+                        return pos;
+        }
+
+        return NULL;
+}
+
 int tbl_update_by_gpa(struct table *     instance,
                       const struct gpa * pa,
                       struct gha *       ha,
                       gfp_t              flags)
 {
-        struct table_entry * pos;
+        struct table_entry * pos, * tmp;
 
         if (!instance) {
                 LOG_ERR("Bogus instance, cannot update GPA");
@@ -257,61 +304,35 @@ int tbl_update_by_gpa(struct table *     instance,
                 return -1;
         }
 
-        spin_lock(&instance->lock);
-
-        list_for_each_entry(pos, &instance->entries, next) {
-                if (gpa_is_equal(pos->pa, pa)) {
-                        gha_destroy(pos->ha);
-                        pos->ha = gha_dup_gfp(flags, ha);
-                        spin_unlock(&instance->lock);
-                        return 0;
-                }
-        }
-
-        spin_unlock(&instance->lock);
-
-        return -1;
-}
+        /* Readers may be looking at the old entry: replace it */
+        tmp = tble_create_gfp(flags, (struct gpa *) pa, ha);
+        if (!tmp)
+                return -1;
 
-struct table_entry * tbl_find(struct table *     instance,
-                              const struct gpa * pa,
-                              const struct gha * ha)
-{
-        struct table_entry * pos;
+        spin_lock_bh(&instance->lock);
 
-        if (!instance) {
-                LOG_ERR("Bogus instance, cannot find entry");
-                return NULL;
-        }
-        if (!gpa_is_ok(pa)) {
-                LOG_ERR("Bogus PA, cannot find entry");
-                return NULL;
-        }
-        if (!gha_is_ok(ha)) {
-                LOG_ERR("Bogus HA, cannot find entry");
-                return NULL;
+        pos = __tbl_find_by_gpa(instance, pa);
+        if (!pos) {
+                spin_unlock_bh(&instance->lock);
+                tble_destroy(tmp);
+                return -1;
         }
 
-        spin_lock(&instance->lock);
+        hlist_replace_rcu(&pos->by_gpa, &tmp->by_gpa);
+        hash_del_rcu(&pos->by_gha);
+        hash_add_rcu(instance->by_gha, &tmp->by_gha, gha_hash(tmp->ha));
 
-        list_for_each_entry(pos, &instance->entries, next) {
-                if (gpa_is_equal(pos->pa, pa) &&
-                    gha_is_equal(pos->ha, ha)) {
-                        spin_unlock(&instance->lock);
-                        return pos;
-                }
-        }
+        spin_unlock_bh(&instance->lock);
 
-        spin_unlock(&instance->lock);
+        tble_destroy_rcu(pos);
 
-        return NULL;
+        return 0;
 }
 
+/* Must be called under rcu_read_lock(), the entry can be freed after it */
 struct table_entry * tbl_find_by_gha(struct table *     instance,
                                      const struct gha * address)
 {
-        struct table_entry * pos;
-
         if (!instance) {
                 LOG_ERR("Bogus instance, cannot find by GHA");
                 return NULL;
@@ -321,20 +342,10 @@ struct table_entry * tbl_find_by_gha(struct table *     instance,
                 return NULL;
         }
 
-        spin_lock(&instance->lock);
-
-        list_for_each_entry(pos, &instance->entries, next) {
-                if (gha_is_equal(pos->ha, address)) {
-                        spin_unlock(&instance->lock);
-                        return pos;
-                }
-        }
-
-        spin_unlock(&instance->lock);
-
-        return NULL;
+        return __tbl_find_by_gha(instance, address);
 }
 
+/* Must be called under rcu_read_lock(), the entry can be freed after it */
 struct table_entry * tbl_find_by_gpa(struct table *     instance,
                                      const struct gpa * address)
 {
@@ -351,18 +362,11 @@ struct table_entry * tbl_find_by_gpa(struct table *     instance,
 
         gpa_log_dbg("Looking for GPA: %s", address);
 
-        spin_lock(&instance->lock);
-        list_for_each_entry(pos, &instance->entries, next) {
-                if (gpa_is_equal(pos->pa, address)) {
-                        spin_unlock(&instance->lock);
-                        return pos;
-                }
-        }
-        spin_unlock(&instance->lock);
-
-        LOG_DBG("Got no matching address");
+        pos = __tbl_find_by_gpa(instance, address);
+        if (!pos)
+                LOG_DBG("Got no matching address");
 
-        return NULL;
+        return pos;
 }
 
 int tbl_add(struct table *       instance,
@@ -381,72 +385,71 @@ int tbl_add(struct table *       instance,
 
         LOG_DBG("Adding entry %pK to the table", entry);
 
-        spin_lock(&instance->lock);
+        spin_lock_bh(&instance->lock);
 
-        list_for_each_entry(pos, &instance->entries, next) {
+        pos = __tbl_find_by_gpa(instance, tble_pa(entry));
+        if (pos) {
                 if (tble_is_equal(pos, entry)) {
                         LOG_WARN("We already have an equal entry ...");
-                        spin_unlock(&instance->lock);
+                        spin_unlock_bh(&instance->lock);
                         return 0;
                 }
 
-                /* FIXME: What about the other conditions ??? */
-                if (gha_is_equal(tble_ha(pos), tble_ha(entry))) {
-                        /* FIXME: What should we do here? */
-
-                        /* Remember to: spin_unlock(&instance->lock); */
-                }
-
-                if (gpa_is_equal(tble_pa(pos), tble_pa(entry))) {
-                        LOG_WARN("We already have the same GPA in the cache");
-
-                        /* FIXME: What should we do here? */
-
-                        /* Remember to: spin_unlock(&instance->lock); */
-                }
+                /* FIXME: What should we do here? */
+                LOG_WARN("We already have the same GPA in the cache");
         }
 
-        list_add(&entry->next, &instance->entries);
+        hash_add_rcu(instance->by_gpa, &entry->by_gpa,
+                     gpa_hash(tble_pa(entry)));
+        hash_add_rcu(instance->by_gha, &entry->by_gha,
+                     gha_hash(tble_ha(entry)));
 
-        spin_unlock(&instance->lock);
+        spin_unlock_bh(&instance->lock);
 
         LOG_DBG("Entry %pK added successfully to the table", entry);
 
         return 0;
 }
 
-int tbl_remove(struct table *             instance,
-               const struct table_entry * entry)
+/* Looks up and unlinks the entry in one go, so that a concurrent update
+ * cannot free it in between. The entry has to be disposed with
+ * tble_destroy_rcu() afterwards */
+struct table_entry * tbl_remove(struct table *     instance,
+                                const struct gpa * pa,
+                                const struct gha * ha)
 {
-        struct table_entry * pos, * q;
+        struct table_entry * pos;
 
         if (!instance) {
                 LOG_ERR("Bogus instance, cannot remove entry from table");
-                return -1;
+                return NULL;
         }
-        if (!entry) {
-                LOG_ERR("Bogus entry, cannot remove entry from table");
-                return -1;
+        if (!gpa_is_ok(pa) || !gha_is_ok(ha)) {
+                LOG_ERR("Bogus addresses, cannot remove entry from table");
+                return NULL;
         }
 
-        spin_lock(&instance->lock);
+        spin_lock_bh(&instance->lock);
 
-        list_for_each_entry_safe(pos, q, &instance->entries, next) {
-                if (pos == entry) {
-                        list_del(&pos->next);
-                        spin_unlock(&instance->lock);
-                        return 0;
-                }
+        pos = __tbl_find_by_gpa(instance, pa);
+        if (!pos || !gha_is_equal(pos->ha, ha)) {
+                spin_unlock_bh(&instance->lock);
+                return NULL;
         }
 
-        spin_unlock(&instance->lock);
+        hash_del_rcu(&pos->by_gpa);
+        hash_del_rcu(&pos->by_gha);
 
-        return -1;
+        spin_unlock_bh(&instance->lock);
+
+        return pos;
 }
 
 static DEFINE_SPINLOCK(tables_lock);
 static struct tmap * tables = NULL;
 
+/* Must be called under rcu_read_lock(), the table is only valid until
+ * rcu_read_unlock() */
 struct table * tbls_find(struct net_device * device, uint16_t ptype)
 {
         struct tmap_entry * e;
@@ -454,15 +457,9 @@ struct table * tbls_find(struct net_device * device, uint16_t ptype)
         if (!device)
                 return NULL;
 
-        spin_lock_bh(&tables_lock);
-
         e = tmap_entry_find(tables, device, ptype);
-        if (!e) {
-                spin_unlock_bh(&tables_lock);
+        if (!e)
                 return NULL;
-        }
-
-        spin_unlock_bh(&tables_lock);
 
         return tmap_entry_value(e);
 }
@@ -474,7 +471,9 @@ static struct table * tbls_create_gfp(gfp_t               flags,
 {
         struct table * cl;
 
+        rcu_read_lock();
         cl = tbls_find(device, ptype);
+        rcu_read_unlock();
         if (cl) {
                 LOG_ERR("Table for ptype 0x%04X already created", ptype);
                 return NULL;
@@ -521,24 +520,25 @@ int tbls_destroy(struct net_device * device, uint16_t ptype)
         struct tmap_entry * e;
         struct table *      cl;
 
-        spin_lock(&tables_lock);
+        spin_lock_bh(&tables_lock);
 
         e = tmap_entry_find(tables, device, ptype);
         if (!e) {
                 LOG_DBG("Table for ptype 0x%04X is missing, cannot destroy",
                          ptype);
-                spin_unlock(&tables_lock);
+                spin_unlock_bh(&tables_lock);
                 return -1;
         }
         tmap_entry_remove(e);
 
-        spin_unlock(&tables_lock); /* No need to hold the lock anymore */
+        spin_unlock_bh(&tables_lock); /* No need to hold the lock anymore */
 
         cl = tmap_entry_value(e);
 
         ASSERT(cl);
 
-        tbl_destroy(cl);
+        /* Both get freed once the readers are done with them */
+        call_rcu(&cl->rcu, tbl_free_rcu);
         tmap_entry_destroy(e);
 
         LOG_DBG("Table for ptype 0x%04X destroyed successfully", ptype);
@@ -573,6 +573,9 @@ void tbls_fini(void)
 
         ASSERT(tmap_is_empty(tables));
 
+        /* The RCU callbacks live in this module */
+        rcu_barrier();
+
         tmap_destroy(tables);
 
         tables = NULL;
@@ -601,16 +604,6 @@ int arp826_add(struct net_device * device,
 
         LOG_DBG("Adding GPA/GHA couple to the 0x%04x ptype table", ptype);
 
-        cl = tbls_find(device, ptype);
-        if (!cl) {
-                LOG_DBG("No table exists for this device yet, creating it");
-                cl = tbls_create(device, ETH_P_RINA, 6);
-                if (cl == NULL) {
-                           LOG_ERR("Cannot create a new table");
-                           return -1;
-                }
-        }
-
         tmp_pa = gpa_dup_gfp(GFP_ATOMIC, pa);
         if (!tmp_pa)
                 return -1;
@@ -632,13 +625,31 @@ int arp826_add(struct net_device * device,
         gpa_destroy(tmp_pa);
         gha_destroy(tmp_ha);
 
+        rcu_read_lock();
+        cl = tbls_find(device, ptype);
+        if (!cl) {
+                rcu_read_unlock();
+
+                LOG_DBG("No table exists for this device yet, creating it");
+                if (!tbls_create(device, ptype, 6)) {
+                        LOG_ERR("Cannot create a new table");
+                        tble_destroy(e);
+                        return -1;
+                }
+
+                rcu_read_lock();
+                cl = tbls_find(device, ptype);
+        }
+
         LOG_DBG("Adding the GPA/GHA entry to the 0x%x04 table", ptype);
 
-        if (tbl_add(cl, e)) {
+        if (!cl || tbl_add(cl, e)) {
+                rcu_read_unlock();
                 LOG_ERR("Cannot add to the 0x%x04 table, rolling back", ptype);
                 tble_destroy(e);
                 return -1;
         }
+        rcu_read_unlock();
 
         LOG_DBG("GPA/GHA couple for ptype 0x%04x added successfully", ptype);
         return 0;
@@ -662,43 +673,40 @@ int arp826_remove(struct net_device * device,
                 return -1;
         }
 
+        rcu_read_lock();
         cl = tbls_find(device, ptype);
-        if (!cl)
-                return -1;
-
-        ce = tbl_find(cl, pa, ha);
+        ce = cl ? tbl_remove(cl, pa, ha) : NULL;
+        rcu_read_unlock();
         if (!ce)
                 return -1;
 
-        if (tbl_remove(cl, ce))
-                return -1;
-
-        tble_destroy(ce);
+        tble_destroy_rcu(ce);
 
         return 0;
 }
 EXPORT_SYMBOL(arp826_remove);
 
-const struct gpa * arp826_find_gpa(struct net_device * device,
-                                   uint16_t            ptype,
-                                   const struct gha *  ha)
+struct gpa * arp826_find_gpa(struct net_device * device,
+                             uint16_t            ptype,
+                             const struct gha *  ha)
 {
         struct table *             cl;
         const struct table_entry * ce;
+        struct gpa *               pa = NULL;
 
         if (!gha_is_ok(ha)) {
                 LOG_ERR("Cannot resolve, bad HA");
                 return NULL;
         }
 
+        /* The entry can be replaced as soon as we leave, copy the PA */
+        rcu_read_lock();
         cl = tbls_find(device, ptype);
-        if (!cl)
-                return NULL;
-
-        ce = tbl_find_by_gha(cl, ha);
-        if (!ce)
-                return NULL;
+        ce = cl ? tbl_find_by_gha(cl, ha) : NULL;
+        if (ce)
+                pa = gpa_dup_ni(tble_pa(ce));
+        rcu_read_unlock();
 
-        return tble_pa(ce);
+        return pa;
 }
 EXPORT_SYMBOL(arp826_find_gpa);
@@ -54,8 +54,10 @@ struct table;
  */
 int                  tbl_add(struct table *       instance,
                              struct table_entry * entry);
-int                  tbl_remove(struct table *             instance,
-                                const struct table_entry * entry);
+/* Returns the unlinked entry, to be freed with tble_destroy_rcu() */
+struct table_entry * tbl_remove(struct table *     instance,
+                                const struct gpa * pa,
+                                const struct gha * ha);
 
 /* Replaces the old gha with the new one, takes the ownership */
 int                  tbl_update_by_gpa(struct table *     instance,
@@ -63,9 +65,7 @@ int                  tbl_update_by_gpa(struct table *     instance,
                                        struct gha *       gha,
                                        gfp_t              flags);
 
-struct table_entry * tbl_find(struct table *     instance,
-                              const struct gpa * pa,
-                              const struct gha * ha);
+/* Only valid under rcu_read_lock(), until rcu_read_unlock() */
 struct table_entry * tbl_find_by_gha(struct table *     instance,
                                      const struct gha * address);
 struct table_entry * tbl_find_by_gpa(struct table *     instance,
@@ -25,6 +25,7 @@
 #include <linux/netdevice.h>
 #include <linux/slab.h>
 #include <linux/if_ether.h>
+#include <linux/jhash.h>
 
 /* FIXME: The following dependencies have to be removed */
 #define RINA_PREFIX "arp826-utils"
@@ -194,7 +195,7 @@ EXPORT_SYMBOL(gpa_address_length);
 void gpa_log_dbg(const char *s, const struct gpa *gpa) {
         char *sgpa, buf[256];
 
-        if (irati_verbosity >= LOG_VERB_DBG) {
+        if (LOG_ENABLED(LOG_VERB_DBG)) {
                 sgpa = gpa_address_to_string_gfp(GFP_KERNEL, gpa);
 
                 if (s) {
@@ -305,6 +306,15 @@ int gpa_address_grow_ni(struct gpa * gpa, size_t length, uint8_t filler)
 { return gpa_address_grow_gfp(GFP_ATOMIC, gpa, length, filler); }
 EXPORT_SYMBOL(gpa_address_grow_ni);
 
+u32 gpa_hash(const struct gpa * gpa)
+{
+        if (!gpa_is_ok(gpa))
+                return 0;
+
+        return jhash(gpa->address, gpa->length, 0);
+}
+EXPORT_SYMBOL(gpa_hash);
+
 bool gpa_is_equal(const struct gpa * a, const struct gpa * b)
 {
         if (!gpa_is_ok(a)) {
@@ -362,7 +372,7 @@ void gha_log_dbg(const char *s, const struct gha *gha)
 {
         char buf[256];
 
-        if (irati_verbosity >= LOG_VERB_DBG && gha->type == MAC_ADDR_802_3) {
+        if (LOG_ENABLED(LOG_VERB_DBG) && gha->type == MAC_ADDR_802_3) {
                 snprintf(buf, sizeof(buf), "%s: %02X:%02X:%02X:%02X:%02X:%02X", s,
                          gha->data.mac_802_3[5], gha->data.mac_802_3[4],
                          gha->data.mac_802_3[3], gha->data.mac_802_3[2],
@@ -508,6 +518,15 @@ struct gha * gha_dup_ni(const struct gha * gha)
 { return gha_dup_gfp(GFP_ATOMIC, gha); }
 EXPORT_SYMBOL(gha_dup_ni);
 
+u32 gha_hash(const struct gha * gha)
+{
+        if (!gha_is_ok(gha))
+                return 0;
+
+        return jhash(gha_address(gha), gha_address_length(gha), 0);
+}
+EXPORT_SYMBOL(gha_hash);
+
 size_t gha_address_length(const struct gha * gha)
 {
         size_t tmp;
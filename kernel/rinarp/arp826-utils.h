@@ -71,6 +71,8 @@ int             gpa_address_shrink_gfp(gfp_t        flags,
                                        struct gpa * gpa,
                                        uint8_t      filler);
 void            gpa_log_dbg(const char *fmt, const struct gpa *gpa);
+/* For hash tables, equal GPAs hash the same */
+u32             gpa_hash(const struct gpa * gpa);
 
 typedef enum {
         MAC_ADDR_802_3
@@ -111,6 +113,7 @@ bool                gha_is_equal(const struct gha * a,
 string_t *          gha_address_to_string(const struct gha *gha, string_t *buf, size_t n);
 
 void                gha_log_dbg(const char *fmt, const struct gha *gha);
+u32                 gha_hash(const struct gha * gha);
 
 /*
  * Miscellaneous
@@ -52,7 +52,8 @@ int                arp826_resolve_gpa(struct net_device * dev,
                                       arp826_notify_t     notify,
                                       uint32_t            timeout_ms,
                                       void *              opaque);
-const struct gpa * arp826_find_gpa(struct net_device * dev,
+/* Returns a copy of the PA, the caller has to destroy it */
+struct gpa *       arp826_find_gpa(struct net_device * dev,
                                    uint16_t            ptype,
                                    const struct gha *  ha);
 
@@ -145,8 +145,8 @@ int rinarp_resolve_gpa(struct rinarp_handle * handle,
 }
 EXPORT_SYMBOL(rinarp_resolve_gpa);
 
-const struct gpa * rinarp_find_gpa(struct rinarp_handle * handle,
-                                   const struct gha *     ha)
+struct gpa * rinarp_find_gpa(struct rinarp_handle * handle,
+                             const struct gha *     ha)
 {
         if (!handle_is_ok(handle) || !gha_is_ok(ha)) {
                 LOG_ERR("Cannot find GPA, bad input parameters");
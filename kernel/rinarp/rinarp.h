@@ -47,8 +47,8 @@ int                    rinarp_resolve_gpa(struct rinarp_handle * handle,
                                           uint32_t               timeout_ms,
                                           void *                 opaque);
 
-/* FIXME: Should return a copy */
-const struct gpa *     rinarp_find_gpa(struct rinarp_handle * handle,
+/* Returns a copy of the GPA, the caller has to destroy it */
+struct gpa *           rinarp_find_gpa(struct rinarp_handle * handle,
                                        const struct gha *     tha);
 
 #endif
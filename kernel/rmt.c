@@ -48,6 +48,7 @@
 #include "ipcp-utils.h"
 #include "du.h"
 #include "rmt-ps-default.h"
+#include "rina-trace.h"
 
 #define rmap_hash(T, K) hash_min(K, HASH_BITS(T))
 #define MAX_PDUS_SENT_PER_CYCLE 10
@@ -82,6 +83,9 @@ struct rmt {
 	struct rmt_config *rmt_cfg;
 	struct sdup *sdup;
 	struct robject robj;
+	/* Max of the N-1 ports, see rmt_du_room_update() */
+	size_t du_headroom;
+	size_t du_tailroom;
 };
 
 #define stats_get(name, n1_port, retval)				\
@@ -89,9 +93,13 @@ struct rmt {
         retval = n1_port->stats.name;					\
         spin_unlock_bh(&n1_port->lock);
 
-#define stats_inc(name, n1_port, bytes)					\
-        n1_port->stats.name##_pdus++;					\
-	n1_port->stats.name##_bytes += (unsigned int) bytes;		\
+/* Counters are per-CPU and lockless, they are only summed up here */
+#define stats_read(NAME, n1_port)					\
+	rstats_read(n1_port->stats.counters, N1_PORT_##NAME)
+
+#define stats_inc(NAME, n1_port, bytes)					\
+	rstats_add_pdu(n1_port->stats.counters, N1_PORT_##NAME##_PDUS,	\
+		       bytes)
 
 static ssize_t rmt_attr_show(struct robject *        robj,
                              struct robj_attribute * attr,
@@ -127,28 +135,22 @@ static ssize_t rmt_n1_port_attr_show(struct robject *        robj,
 		return sprintf(buf, "%u\n", stats_ret);
 	}
 	if (strcmp(robject_attr_name(attr), "drop_pdus") == 0) {
-		stats_get(drop_pdus, n1_port, stats_ret);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_read(DROP_PDUS, n1_port));
 	}
 	if (strcmp(robject_attr_name(attr), "err_pdus") == 0) {
-		stats_get(err_pdus, n1_port, stats_ret);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_read(ERR_PDUS, n1_port));
 	}
 	if (strcmp(robject_attr_name(attr), "tx_pdus") == 0) {
-		stats_get(tx_pdus, n1_port, stats_ret);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_read(TX_PDUS, n1_port));
 	}
 	if (strcmp(robject_attr_name(attr), "rx_pdus") == 0) {
-		stats_get(rx_pdus, n1_port, stats_ret);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_read(RX_PDUS, n1_port));
 	}
 	if (strcmp(robject_attr_name(attr), "tx_bytes") == 0) {
-		stats_get(tx_bytes, n1_port, stats_ret);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_read(TX_BYTES, n1_port));
 	}
 	if (strcmp(robject_attr_name(attr), "rx_bytes") == 0) {
-		stats_get(rx_bytes, n1_port, stats_ret);
-		return sprintf(buf, "%u\n", stats_ret);
+		return sprintf(buf, "%llu\n", stats_read(RX_BYTES, n1_port));
 	}
 	if (strcmp(robject_attr_name(attr), "wbusy") == 0) {
 		spin_lock_bh(&n1_port->lock);
@@ -193,12 +195,11 @@ static struct rmt_n1_port *n1_port_create(port_id_t id,
 	atomic_set(&tmp->refs_c, 0);
 	tmp->wbusy = false;
 	tmp->stats.plen = 0;
-	tmp->stats.drop_pdus = 0;
-	tmp->stats.err_pdus = 0;
-	tmp->stats.tx_pdus = 0;
-	tmp->stats.tx_bytes = 0;
-	tmp->stats.rx_pdus = 0;
-	tmp->stats.rx_bytes = 0;
+	tmp->stats.counters = rstats_create_ni(N1_PORT_COUNTERS);
+	if (!tmp->stats.counters) {
+		rkfree(tmp);
+		return NULL;
+	}
 	tmp->sdup_port = 0;
 	spin_lock_init(&tmp->lock);
 
@@ -242,6 +243,7 @@ static int n1_port_destroy(struct rmt_n1_port *n1p)
 	if (n1p->wbusy)
 		LOG_WARN("Deleting n1_port with bussy writer... there may be something wrong...");
 
+	rstats_destroy(n1p->stats.counters);
 	rkfree(n1p);
 
 	return 0;
@@ -692,8 +694,11 @@ static int n1_port_write_du(struct rmt *rmt,
 	if (ret == -EAGAIN) {
 		n1_port_lock(n1_port);
 		if (n1_port->pending_du) {
-			LOG_ERR("Already a pending SDU present for port %d",
-					n1_port->port_id);
+			LOG_ERR_RL("Already a pending SDU present for port %d",
+				   n1_port->port_id);
+			trace_rmt_drop(n1_port->port_id,
+				       du_len(n1_port->pending_du),
+				       n1_port->stats.plen);
 			du_destroy(n1_port->pending_du);
 			n1_port->stats.plen--;
 		}
@@ -811,8 +816,13 @@ static void send_worker(unsigned long o)
 				pendu = n1_port->pending_du;
 				n1_port->pending_du = NULL;
 				n1_port->stats.plen--;
+				trace_rmt_dequeue(n1_port->port_id,
+						  du_len(pendu),
+						  n1_port->stats.plen);
 			} else {
-				du = ps->rmt_dequeue_policy(ps, n1_port);
+				du = ps_call(ps, rmt_dequeue_policy,
+					     default_rmt_dequeue_policy,
+					     ps, n1_port);
 				if (!du) {
 					if (n1_port->stats.plen)
 						LOG_ERR("rmt_dequeue_policy returned no pdu but plen is %u",
@@ -820,6 +830,9 @@ static void send_worker(unsigned long o)
 					break;
 				}
 				n1_port->stats.plen--;
+				trace_rmt_dequeue(n1_port->port_id,
+						  du_len(du),
+						  n1_port->stats.plen);
 			}
 
 			spin_unlock(&n1_port->lock);
@@ -833,7 +846,7 @@ static void send_worker(unsigned long o)
 				break;
 
 			pdus_sent++;
-			stats_inc(tx, n1_port, ret);
+			stats_inc(TX, n1_port, ret);
 		}
 
 		if ((n1_port->state == N1_PORT_STATE_ENABLED ||
@@ -871,6 +884,7 @@ int rmt_send_port_id(struct rmt *instance,
 	struct rmt_ps *ps;
 	int ret;
 	bool must_enqueue;
+	size_t len = du_len(du);
 
 	rcu_read_lock();
 	ps = container_of(rcu_dereference(instance->base.ps),
@@ -878,7 +892,7 @@ int rmt_send_port_id(struct rmt *instance,
 
 	if (!ps || !ps->rmt_enqueue_policy) {
 		rcu_read_unlock();
-		LOG_ERR("PS or enqueue policy null, dropping pdu");
+		LOG_ERR_RL("PS or enqueue policy null, dropping pdu");
 		du_destroy(du);
 		return -1;
 	}
@@ -886,7 +900,7 @@ int rmt_send_port_id(struct rmt *instance,
 	n1_port = n1pmap_find(instance, id);
 	if (!n1_port) {
 		rcu_read_unlock();
-		LOG_ERR("Could not find the N-1 port");
+		LOG_ERR_RL("Could not find the N-1 port %d", id);
 		du_destroy(du);
 		return -1;
 	}
@@ -900,29 +914,33 @@ int rmt_send_port_id(struct rmt *instance,
 		must_enqueue = true;
 	}
 
-	ret = ps->rmt_enqueue_policy(ps, n1_port, du, must_enqueue);
+	ret = ps_call(ps, rmt_enqueue_policy, default_rmt_enqueue_policy,
+		      ps, n1_port, du, must_enqueue);
 	rcu_read_unlock();
 	switch (ret) {
 	case RMT_PS_ENQ_SCHED:
 		n1_port->stats.plen++;
+		trace_rmt_enqueue(id, len, n1_port->stats.plen);
 		tasklet_hi_schedule(&instance->egress_tasklet);
 		ret = 0;
 		break;
 	case RMT_PS_ENQ_DROP:
-		n1_port->stats.drop_pdus++;
-		LOG_ERR("PDU dropped while enqueing");
+		rstats_inc(n1_port->stats.counters, N1_PORT_DROP_PDUS);
+		trace_rmt_drop(id, len, n1_port->stats.plen);
+		LOG_ERR_RL("PDU dropped while enqueing");
 		ret = 0;
 		break;
 	case RMT_PS_ENQ_ERR:
-		n1_port->stats.err_pdus++;
-		LOG_ERR("Some error occurred while enqueuing PDU");
+		rstats_inc(n1_port->stats.counters, N1_PORT_ERR_PDUS);
+		trace_rmt_drop(id, len, n1_port->stats.plen);
+		LOG_ERR_RL("Some error occurred while enqueuing PDU");
 		ret = 0;
 		break;
 	case RMT_PS_ENQ_SEND:
 		if (must_enqueue) {
 			LOG_ERR("Wrong behaviour of the policy");
 			du_destroy(du);
-			n1_port->stats.err_pdus++;
+			rstats_inc(n1_port->stats.counters, N1_PORT_ERR_PDUS);
 			LOG_DBG("Policy should have enqueue, returned SEND");
 			ret = -1;
 			break;
@@ -936,7 +954,7 @@ int rmt_send_port_id(struct rmt *instance,
 		n1_port_lock(n1_port);
 		n1_port->wbusy = false;
 		if (ret >= 0) {
-			stats_inc(tx, n1_port, ret);
+			stats_inc(TX, n1_port, ret);
 			ret = 0;
 		} else if (ret == -EAGAIN)
 			ret = 0;
@@ -967,7 +985,7 @@ int rmt_send(struct rmt *instance,
 	if (pff_nhop(instance->pff, &du->pci,
 		     &(instance->cache.pids),
 		     &(instance->cache.count))) {
-		LOG_ERR("Cannot get the NHOP for this PDU (saddr: %u daddr: %u type: %u)",
+		LOG_ERR_RL("Cannot get the NHOP for this PDU (saddr: %u daddr: %u type: %u)",
 				pci_source(&du->pci), pci_destination(&du->pci),
 				pci_type(&du->pci));
 
@@ -976,7 +994,7 @@ int rmt_send(struct rmt *instance,
 	}
 
 	if (instance->cache.count == 0) {
-		LOG_WARN("No NHOP for this PDU ...");
+		LOG_WARN_RL("No NHOP for this PDU ...");
 		du_destroy(du);
 		return 0;
 	}
@@ -1097,6 +1115,39 @@ exit:
 }
 EXPORT_SYMBOL(rmt_disable_port_id);
 
+/* Recomputes the worst case room the N-1 ports need in outgoing PDUs */
+static void rmt_du_room_update(struct rmt *instance)
+{
+	struct rmt_n1_port *entry;
+	struct n1pmap *m;
+	size_t headroom = 0, tailroom = 0;
+	int bucket;
+
+	m = instance->n1_ports;
+	if (!m)
+		return;
+
+	spin_lock_bh(&m->lock);
+	hash_for_each(m->n1_ports, bucket, entry, hlist) {
+		if (entry->state == N1_PORT_STATE_DEALLOCATED)
+			continue;
+		headroom = max(headroom, entry->du_headroom);
+		tailroom = max(tailroom, entry->du_tailroom);
+	}
+	spin_unlock_bh(&m->lock);
+
+	WRITE_ONCE(instance->du_headroom, headroom);
+	WRITE_ONCE(instance->du_tailroom, tailroom);
+}
+
+size_t rmt_du_headroom(struct rmt *instance)
+{ return instance ? READ_ONCE(instance->du_headroom) : 0; }
+EXPORT_SYMBOL(rmt_du_headroom);
+
+size_t rmt_du_tailroom(struct rmt *instance)
+{ return instance ? READ_ONCE(instance->du_tailroom) : 0; }
+EXPORT_SYMBOL(rmt_du_tailroom);
+
 int rmt_n1port_bind(struct rmt *instance,
 		    port_id_t id,
 		    struct ipcp_instance *n1_ipcp)
@@ -1104,6 +1155,7 @@ int rmt_n1port_bind(struct rmt *instance,
 	struct rmt_n1_port *tmp;
 	struct rmt_ps *ps;
 	const struct name *dif_name;
+	size_t headroom, tailroom;
 
 	if (!instance) {
 		LOG_ERR("Bogus instance passed");
@@ -1169,6 +1221,16 @@ int rmt_n1port_bind(struct rmt *instance,
 		return -1;
 	}
 
+	/* Room for the SDU protection and for whatever the N-1 IPCP adds */
+	sdup_port_room(tmp->sdup_port, &headroom, &tailroom);
+	if (n1_ipcp->ops->du_headroom)
+		headroom += n1_ipcp->ops->du_headroom(n1_ipcp->data);
+	if (n1_ipcp->ops->du_tailroom)
+		tailroom += n1_ipcp->ops->du_tailroom(n1_ipcp->data);
+	tmp->du_headroom = headroom;
+	tmp->du_tailroom = tailroom;
+	rmt_du_room_update(instance);
+
 	return 0;
 }
 EXPORT_SYMBOL(rmt_n1port_bind);
@@ -1206,6 +1268,7 @@ int rmt_n1port_unbind(struct rmt *instance,
 	 * not wrong since once in N1_PORT_STATE_DEALLOCATED no other action
 	 * will be performed on the n1_port but this action should be atomic */
 	n1pmap_release(instance, n1_port);
+	rmt_du_room_update(instance);
 	return 0;
 }
 EXPORT_SYMBOL(rmt_n1port_unbind);
@@ -1221,28 +1284,24 @@ static inline int process_mgmt_pdu(struct rmt *rmt,
 
 static int process_dt_pdu(struct rmt *rmt,
 			  port_id_t port_id,
-			  struct du *du)
+			  struct du *du,
+			  const struct pci_fields *f)
 {
-	address_t dst_addr;
 	cep_id_t c;
-	pdu_type_t pdu_type;
 
-	dst_addr = pci_destination(&du->pci);
-	if (!is_address_ok(dst_addr)) {
+	if (!is_address_ok(f->destination)) {
 		LOG_ERR("PDU has wrong destination address");
 		du_destroy(du);
 		return -1;
 	}
 
-	pdu_type = pci_type(&du->pci);
-
-	if (pdu_type == PDU_TYPE_MGMT) {
+	if (f->type == PDU_TYPE_MGMT) {
 		LOG_ERR("MGMT should not be here");
 		du_destroy(du);
 		return -1;
 	}
 
-	c = pci_cep_destination(&du->pci);
+	c = f->cep_dst;
 	if (!is_cep_id_ok(c)) {
 		LOG_ERR("Wrong CEP-id in PDU");
 		du_destroy(du);
@@ -1278,6 +1337,7 @@ int rmt_receive(struct rmt *rmt,
 		struct du * du,
 		port_id_t from)
 {
+	struct pci_fields f;
 	pdu_type_t pdu_type;
 	address_t dst_addr;
 	qos_id_t qos_id;
@@ -1304,7 +1364,7 @@ int rmt_receive(struct rmt *rmt,
                 du_destroy(du);
 		return -1;
 	}
-	stats_inc(rx, n1_port, bytes);
+	stats_inc(RX, n1_port, bytes);
 
 	/* SDU Protection */
 	if (sdup_unprotect_pdu(n1_port->sdup_port, du)) {
@@ -1329,9 +1389,10 @@ int rmt_receive(struct rmt *rmt,
 		return -1;
 	}
 
-	pdu_type = pci_type(&du->pci);
-	dst_addr = pci_destination(&du->pci);
-	qos_id = pci_qos_id(&du->pci);
+	pci_parse(&du->pci, &f);
+	pdu_type = f.type;
+	dst_addr = f.destination;
+	qos_id = f.qos_id;
 	if (!pdu_type_is_ok(pdu_type) ||
 		!is_address_ok(dst_addr)  ||
 		!is_qos_id_ok(qos_id)) {
@@ -1362,7 +1423,7 @@ int rmt_receive(struct rmt *rmt,
 			 * enqueue PDU in pdus_dt[dest-addr, qos-id]
 			 * don't process it now ...
 			 */
-			return process_dt_pdu(rmt, from, du);
+			return process_dt_pdu(rmt, from, du, &f);
 
 		default:
 			LOG_ERR("Unknown PDU type %d", pdu_type);
@@ -1379,7 +1440,7 @@ int rmt_receive(struct rmt *rmt,
 			if (unlikely(du_encap(du, pdu_type)))
 				return -1;
 			if (sdup_dec_check_lifetime_limit(n1_port->sdup_port, du)) {
-				LOG_ERR("Lifetime of PDU reached dropping PDU!");
+				LOG_ERR_RL("Lifetime of PDU reached dropping PDU!");
 				du_destroy(du);
 				return -1;
 			}
@@ -33,6 +33,7 @@
 #include "ps-factory.h"
 #include "sdup.h"
 #include "rds/robjects.h"
+#include "rds/rstats.h"
 
 struct rmt;
 
@@ -64,14 +65,20 @@ enum flow_state {
 	N1_PORT_STATE_DEALLOCATED,
 };
 
+/* Per-CPU counters of an N-1 port, see rds/rstats.h */
+enum n1_port_counter {
+	N1_PORT_DROP_PDUS = 0,
+	N1_PORT_ERR_PDUS,
+	N1_PORT_TX_PDUS,
+	N1_PORT_TX_BYTES,
+	N1_PORT_RX_PDUS,
+	N1_PORT_RX_BYTES,
+	N1_PORT_COUNTERS
+};
+
 struct n1_port_stats {
 	unsigned int plen; /* port len, all pdus enqueued in PS queue/s */
-	unsigned int drop_pdus;
-	unsigned int err_pdus;
-	unsigned int tx_pdus;
-	unsigned int tx_bytes;
-	unsigned int rx_pdus;
-	unsigned int rx_bytes;
+	struct rstats * counters;
 };
 
 struct rmt_n1_port {
@@ -83,6 +90,8 @@ struct rmt_n1_port {
 	atomic_t		refs_c;
 	struct du		*pending_du;
 	struct sdup_port 	*sdup_port;
+	size_t			du_headroom;
+	size_t			du_tailroom;
 	struct n1_port_stats	stats;
 	bool			wbusy;
 	void 			*rmt_ps_queues;
@@ -102,6 +111,9 @@ int		   rmt_n1port_bind(struct rmt *instance,
 				   struct ipcp_instance *n1_ipcp);
 int		   rmt_n1port_unbind(struct rmt *instance,
 				     port_id_t id);
+/* Worst case room the N-1 ports (SDU protection and N-1 IPCPs) need */
+size_t		   rmt_du_headroom(struct rmt *instance);
+size_t		   rmt_du_tailroom(struct rmt *instance);
 int		   rmt_pff_add(struct rmt *instance,
 			       struct mod_pff_entry *entry);
 int		   rmt_pff_remove(struct rmt *instance,
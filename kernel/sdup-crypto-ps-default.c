@@ -1120,6 +1120,10 @@ struct ps_base * sdup_crypto_ps_default_create(struct rina_component * component
 	ps->dm          = sdup_port;
 	ps->priv        = data;
 
+	/* Sequence number and IV in front, padding and HMAC behind */
+	ps->max_headroom = sizeof(data->tx_seq_num) + MAX_CIPHER_IV_SIZE;
+	ps->max_tailroom = MAX_CIPHER_BLOCK_SIZE + MAX_HMAC_DIGEST_SIZE;
+
 	if (conf->encrypt) {
 		parameter = policy_param_find(conf->encrypt,
 					      "seq_win_size");
@@ -27,6 +27,12 @@
 //based on TLS - can optionally be made a policy parameter
 #define MAX_COMP_INFLATION 1024
 
+/* Worst case room taken by the supported ciphers and HMACs, used to size
+ * the DUs. Compression inflation is not accounted for, it is rare */
+#define MAX_CIPHER_IV_SIZE    16
+#define MAX_CIPHER_BLOCK_SIZE 16
+#define MAX_HMAC_DIGEST_SIZE  64
+
 int default_sdup_apply_crypto(struct sdup_crypto_ps * ps,
 			      struct du * pdu);
 
@@ -41,6 +41,10 @@ struct sdup_crypto_ps {
 	int (* sdup_update_crypto_state)(struct sdup_crypto_ps *,
 					 struct sdup_crypto_state *);
 
+	/* Worst case bytes added in front of and after a PDU */
+	size_t max_headroom;
+	size_t max_tailroom;
+
 	/* Reference used to access the SDUP data model. */
 	struct sdup_port * dm;
 
@@ -108,6 +108,7 @@ struct ps_base * sdup_errc_ps_default_create(struct rina_component * component)
 		return NULL;
 
 	ps->dm          = sdup_comp->parent;
+	ps->max_tailroom = sizeof(u32);
         ps->priv        = NULL;
 
 	/* SDUP policy functions*/
@@ -178,6 +178,7 @@ struct ps_base * sdup_ttl_ps_default_create(struct rina_component * component)
 	}
 
 	ps->dm          = sdup_port;
+	ps->max_headroom = sizeof(data->initial_ttl_value);
         ps->priv        = data;
         ps->base.set_policy_set_param = sdu_ttl_ps_default_set_policy_set_param;
 
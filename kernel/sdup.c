@@ -42,6 +42,9 @@
 #include "sdup-crypto-ps.h"
 #include "sdup-errc-ps.h"
 #include "sdup-ttl-ps.h"
+#include "sdup-crypto-ps-default.h"
+#include "sdup-errc-ps-default.h"
+#include "sdup-ttl-ps-default.h"
 #include "irati/kucommon.h"
 
 static struct policy_set_list crypto_policy_sets = {
@@ -723,7 +726,8 @@ int sdup_protect_pdu(struct sdup_port * instance,
 				         struct sdup_crypto_ps,
 				         base);
 
-		if (crypto_ps->sdup_apply_crypto(crypto_ps, du)) {
+		if (ps_call(crypto_ps, sdup_apply_crypto,
+			    default_sdup_apply_crypto, crypto_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
@@ -734,7 +738,9 @@ int sdup_protect_pdu(struct sdup_port * instance,
 				       struct sdup_errc_ps,
 				       base);
 
-		if (errc_ps->sdup_add_error_check_policy(errc_ps, du)) {
+		if (ps_call(errc_ps, sdup_add_error_check_policy,
+			    default_sdup_add_error_check_policy,
+			    errc_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
@@ -766,18 +772,24 @@ int sdup_unprotect_pdu(struct sdup_port * instance,
 				       struct sdup_errc_ps,
 				       base);
 
-		if (errc_ps->sdup_check_error_check_policy(errc_ps, du)) {
+		if (ps_call(errc_ps, sdup_check_error_check_policy,
+			    default_sdup_check_error_check_policy,
+			    errc_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
 	}
 
+	/* The lower IPCP only vouches for the hop the PDU came from */
+	du->hw_verified = false;
+
 	if (instance->crypto) {
 		crypto_ps = container_of(rcu_dereference(instance->crypto->base.ps),
 				         struct sdup_crypto_ps,
 				         base);
 
-		if (crypto_ps->sdup_remove_crypto(crypto_ps, du)) {
+		if (ps_call(crypto_ps, sdup_remove_crypto,
+			    default_sdup_remove_crypto, crypto_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
@@ -790,6 +802,48 @@ int sdup_unprotect_pdu(struct sdup_port * instance,
 }
 EXPORT_SYMBOL(sdup_unprotect_pdu);
 
+void sdup_port_room(struct sdup_port * instance,
+		    size_t *           headroom,
+		    size_t *           tailroom)
+{
+	struct sdup_crypto_ps * crypto_ps;
+	struct sdup_errc_ps * errc_ps;
+	struct sdup_ttl_ps * ttl_ps;
+
+	*headroom = 0;
+	*tailroom = 0;
+
+	if (!instance)
+		return;
+
+	rcu_read_lock();
+	if (instance->crypto) {
+		crypto_ps = container_of(rcu_dereference(instance->crypto->base.ps),
+				         struct sdup_crypto_ps,
+				         base);
+		*headroom += crypto_ps->max_headroom;
+		*tailroom += crypto_ps->max_tailroom;
+	}
+
+	if (instance->errc) {
+		errc_ps = container_of(rcu_dereference(instance->errc->base.ps),
+				       struct sdup_errc_ps,
+				       base);
+		*headroom += errc_ps->max_headroom;
+		*tailroom += errc_ps->max_tailroom;
+	}
+
+	if (instance->ttl) {
+		ttl_ps = container_of(rcu_dereference(instance->ttl->base.ps),
+				      struct sdup_ttl_ps,
+				      base);
+		*headroom += ttl_ps->max_headroom;
+		*tailroom += ttl_ps->max_tailroom;
+	}
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL(sdup_port_room);
+
 int sdup_set_lifetime_limit(struct sdup_port * instance,
 			    struct du * du)
 {
@@ -807,7 +861,9 @@ int sdup_set_lifetime_limit(struct sdup_port * instance,
 				      struct sdup_ttl_ps,
 				      base);
 
-		if (ttl_ps->sdup_set_lifetime_limit_policy(ttl_ps, du)) {
+		if (ps_call(ttl_ps, sdup_set_lifetime_limit_policy,
+			    default_sdup_set_lifetime_limit_policy,
+			    ttl_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
@@ -835,7 +891,9 @@ int sdup_get_lifetime_limit(struct sdup_port * instance,
 				      struct sdup_ttl_ps,
 				      base);
 
-		if (ttl_ps->sdup_get_lifetime_limit_policy(ttl_ps, du)) {
+		if (ps_call(ttl_ps, sdup_get_lifetime_limit_policy,
+			    default_sdup_get_lifetime_limit_policy,
+			    ttl_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
@@ -863,7 +921,9 @@ int sdup_dec_check_lifetime_limit(struct sdup_port * instance,
 				      struct sdup_ttl_ps,
 				      base);
 
-		if (ttl_ps->sdup_dec_check_lifetime_limit_policy(ttl_ps, du)) {
+		if (ps_call(ttl_ps, sdup_dec_check_lifetime_limit_policy,
+			    default_sdup_dec_check_lifetime_limit_policy,
+			    ttl_ps, du)) {
 			rcu_read_unlock();
 			return -1;
 		}
@@ -129,6 +129,11 @@ int sdup_protect_pdu(struct sdup_port * instance,
 int sdup_unprotect_pdu(struct sdup_port * instance,
 		       struct du * du);
 
+/* Worst case bytes the policies of the port add in front of/after a PDU */
+void sdup_port_room(struct sdup_port * instance,
+		    size_t *           headroom,
+		    size_t *           tailroom);
+
 int sdup_set_lifetime_limit(struct sdup_port * instance,
 			    struct du * du);
 
@@ -0,0 +1,430 @@
+/*
+ * A loopback vmpi-impl guest interface
+ *
+ * Two endpoints are paired back to back inside the kernel, each one showing
+ * up as a guest VMPI provider, so that the shim-hv IPCP (and vmpi-test) can
+ * be run and measured on a plain Linux host. What one endpoint writes is
+ * placed in the receive ring of the other, with the same vmpi_hdr framing
+ * used by the virtio implementation.
+ *
+ * Module parameters:
+ *
+ *    ring_size      slots in each receive ring (a power of two)
+ *    kick_batch     buffers written before the peer is kicked
+ *    kick_delay_us  how long a partial batch may wait for its kick
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/log2.h>
+#include <linux/version.h>
+
+#include "vmpi-guest-impl.h"
+#include "vmpi.h"
+
+
+static unsigned int ring_size = VMPI_RING_SIZE;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "Slots in each receive ring (power of two)");
+
+static unsigned int kick_batch = 1;
+module_param(kick_batch, uint, 0644);
+MODULE_PARM_DESC(kick_batch, "Buffers written before kicking the peer");
+
+static unsigned int kick_delay_us = 50;
+module_param(kick_delay_us, uint, 0644);
+MODULE_PARM_DESC(kick_delay_us, "Max delay of a kick for a partial batch");
+
+#define VMPI_LOOP_RING_SIZE_MAX         4096
+#define VMPI_LOOP_ENDPOINTS             2
+
+struct vmpi_loop_slot {
+        struct vmpi_buf *vb;
+};
+
+/* Single producer (under the peer write lock), single consumer (under the
+ * receive worker lock), the ring lock only orders the two. */
+struct vmpi_loop_ring {
+        spinlock_t lock;
+        struct vmpi_loop_slot *slots;
+        unsigned int mask;
+        unsigned int head;
+        unsigned int tail;
+};
+
+struct vmpi_impl_info {
+        struct vmpi_impl_info *peer;
+
+        /* Buffers written by the peer */
+        struct vmpi_loop_ring rx;
+
+        vmpi_impl_callback_t xmit_cb;
+        vmpi_impl_callback_t recv_cb;
+        bool xmit_cb_enabled;
+        bool recv_cb_enabled;
+
+        /* Kick batching: counted under the write lock of vmpi-guest,
+         * a late kick from the timer just resets it */
+        unsigned int pending;
+        struct hrtimer kick_timer;
+        struct tasklet_struct kick_tasklet;
+
+        unsigned long kicks;
+
+        void *private;
+};
+
+static struct vmpi_impl_info *endpoints[VMPI_LOOP_ENDPOINTS];
+
+vmpi_info_t *
+vmpi_info_from_vmpi_impl_info(vmpi_impl_info_t *vi)
+{
+        return vi->private;
+}
+
+static unsigned int
+ring_used(struct vmpi_loop_ring *r)
+{
+        return r->tail - r->head;
+}
+
+static unsigned int
+ring_free(struct vmpi_loop_ring *r)
+{
+        return r->mask + 1 - ring_used(r);
+}
+
+/* Runs the receive callback of the peer, as an interrupt would. */
+static void
+vmpi_loop_kick(struct vmpi_impl_info *vi)
+{
+        struct vmpi_impl_info *peer = vi->peer;
+        bool notify;
+
+        vi->pending = 0;
+        vi->kicks++;
+
+        spin_lock_bh(&peer->rx.lock);
+        notify = peer->recv_cb_enabled && ring_used(&peer->rx);
+        spin_unlock_bh(&peer->rx.lock);
+
+        if (notify && likely(peer->recv_cb)) {
+                peer->recv_cb(peer);
+        }
+}
+
+static void
+vmpi_loop_kick_tasklet(unsigned long data)
+{
+        struct vmpi_impl_info *vi = (struct vmpi_impl_info *)data;
+
+        vmpi_loop_kick(vi);
+}
+
+static enum hrtimer_restart
+vmpi_loop_kick_timeout(struct hrtimer *timer)
+{
+        struct vmpi_impl_info *vi =
+                container_of(timer, struct vmpi_impl_info, kick_timer);
+
+        tasklet_hi_schedule(&vi->kick_tasklet);
+
+        return HRTIMER_NORESTART;
+}
+
+/* To be called under lock. */
+int
+vmpi_impl_write_buf(struct vmpi_impl_info *vi, struct vmpi_buf *vb,
+                    unsigned int channel)
+{
+        struct vmpi_loop_ring *r = &vi->peer->rx;
+
+        vmpi_buf_push(vb, sizeof(struct vmpi_hdr));
+        ((struct vmpi_hdr *)vmpi_buf_data(vb))->channel = channel;
+
+        spin_lock_bh(&r->lock);
+        if (unlikely(!ring_free(r))) {
+                spin_unlock_bh(&r->lock);
+                vmpi_buf_pop(vb, sizeof(struct vmpi_hdr));
+                return -ENOSPC;
+        }
+        r->slots[r->tail & r->mask].vb = vb;
+        r->tail++;
+        spin_unlock_bh(&r->lock);
+
+        vi->pending++;
+
+        return 0;
+}
+
+void
+vmpi_impl_txkick(struct vmpi_impl_info *vi)
+{
+        if (!vi->pending) {
+                return;
+        }
+
+        if (vi->pending >= kick_batch || !kick_delay_us) {
+                hrtimer_try_to_cancel(&vi->kick_timer);
+                vmpi_loop_kick(vi);
+                return;
+        }
+
+        if (!hrtimer_active(&vi->kick_timer)) {
+                hrtimer_start(&vi->kick_timer,
+                              ktime_set(0, kick_delay_us * NSEC_PER_USEC),
+                              HRTIMER_MODE_REL);
+        }
+}
+
+bool
+vmpi_impl_tx_should_stop(struct vmpi_impl_info *vi)
+{
+        struct vmpi_loop_ring *r = &vi->peer->rx;
+        bool stop;
+
+        spin_lock_bh(&r->lock);
+        stop = !ring_free(r);
+        spin_unlock_bh(&r->lock);
+
+        return stop;
+}
+
+/* The peer owns the buffers as soon as they are in its ring, there is
+ * nothing to reclaim on the transmit side. */
+struct vmpi_buf *
+vmpi_impl_get_written_buffer(struct vmpi_impl_info *vi)
+{
+        return NULL;
+}
+
+/* To be called under lock. */
+struct vmpi_buf *
+vmpi_impl_read_buffer(struct vmpi_impl_info *vi, unsigned *channel)
+{
+        struct vmpi_impl_info *peer = vi->peer;
+        struct vmpi_loop_ring *r = &vi->rx;
+        struct vmpi_buf *vb;
+        struct vmpi_hdr *hdr;
+        bool restart;
+
+        spin_lock_bh(&r->lock);
+        if (!ring_used(r)) {
+                spin_unlock_bh(&r->lock);
+                return NULL;
+        }
+        vb = r->slots[r->head & r->mask].vb;
+        r->head++;
+        /* Like enable_cb_delayed(), restart the writer once a quarter of
+         * the ring is free again. */
+        restart = peer->xmit_cb_enabled && ring_free(r) > (r->mask >> 2);
+        if (restart) {
+                peer->xmit_cb_enabled = false;
+        }
+        spin_unlock_bh(&r->lock);
+
+        hdr = (struct vmpi_hdr *)vmpi_buf_data(vb);
+        *channel = hdr->channel;
+        vmpi_buf_pop(vb, sizeof(struct vmpi_hdr));
+
+        if (restart && likely(peer->xmit_cb)) {
+                peer->xmit_cb(peer);
+        }
+
+        return vb;
+}
+
+/* Returns false if the writer may go ahead right away. */
+bool
+vmpi_impl_send_cb(struct vmpi_impl_info *vi, int enable)
+{
+        struct vmpi_loop_ring *r = &vi->peer->rx;
+        bool ret = true;
+
+        spin_lock_bh(&r->lock);
+        vi->xmit_cb_enabled = enable;
+        if (enable && ring_free(r)) {
+                ret = false;
+        }
+        spin_unlock_bh(&r->lock);
+
+        return ret;
+}
+
+/* Returns false if there are buffers to be read already. */
+bool
+vmpi_impl_receive_cb(struct vmpi_impl_info *vi, int enable)
+{
+        struct vmpi_loop_ring *r = &vi->rx;
+        bool ret = true;
+
+        spin_lock_bh(&r->lock);
+        vi->recv_cb_enabled = enable;
+        if (enable && ring_used(r)) {
+                ret = false;
+        }
+        spin_unlock_bh(&r->lock);
+
+        return ret;
+}
+
+void
+vmpi_impl_callbacks_register(struct vmpi_impl_info *vi,
+                             vmpi_impl_callback_t xmit,
+                             vmpi_impl_callback_t recv)
+{
+        vi->xmit_cb = xmit;
+        vi->recv_cb = recv;
+        vi->recv_cb_enabled = true;
+}
+
+void
+vmpi_impl_callbacks_unregister(struct vmpi_impl_info *vi)
+{
+        vi->xmit_cb = NULL;
+        vi->recv_cb = NULL;
+        vi->recv_cb_enabled = false;
+}
+
+static struct vmpi_impl_info *
+vmpi_loop_endpoint_create(void)
+{
+        struct vmpi_impl_info *vi;
+
+        vi = kzalloc(sizeof(*vi), GFP_KERNEL);
+        if (!vi) {
+                return NULL;
+        }
+
+        vi->rx.slots = kcalloc(ring_size, sizeof(*vi->rx.slots), GFP_KERNEL);
+        if (!vi->rx.slots) {
+                kfree(vi);
+                return NULL;
+        }
+        vi->rx.mask = ring_size - 1;
+        spin_lock_init(&vi->rx.lock);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,13,0)
+        hrtimer_init(&vi->kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        vi->kick_timer.function = vmpi_loop_kick_timeout;
+#else
+        hrtimer_setup(&vi->kick_timer, vmpi_loop_kick_timeout,
+                      CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#endif
+        tasklet_init(&vi->kick_tasklet, vmpi_loop_kick_tasklet,
+                     (unsigned long)vi);
+
+        return vi;
+}
+
+static void
+vmpi_loop_endpoint_destroy(struct vmpi_impl_info *vi)
+{
+        struct vmpi_loop_ring *r = &vi->rx;
+
+        hrtimer_cancel(&vi->kick_timer);
+        tasklet_kill(&vi->kick_tasklet);
+
+        while (ring_used(r)) {
+                vmpi_buf_free(r->slots[r->head & r->mask].vb);
+                r->head++;
+        }
+
+        printk("vmpi-loop: endpoint %p destroyed, %lu kicks\n", vi,
+               vi->kicks);
+
+        kfree(r->slots);
+        kfree(vi);
+}
+
+static int __init
+vmpi_loop_init(void)
+{
+        int err = -ENOMEM;
+        int i;
+
+        if (!is_power_of_2(ring_size) || ring_size < 4 ||
+                        ring_size > VMPI_LOOP_RING_SIZE_MAX) {
+                printk("vmpi-loop: invalid ring_size %u\n", ring_size);
+                return -EINVAL;
+        }
+        if (!kick_batch) {
+                kick_batch = 1;
+        }
+
+        for (i = 0; i < VMPI_LOOP_ENDPOINTS; i++) {
+                endpoints[i] = vmpi_loop_endpoint_create();
+                if (!endpoints[i]) {
+                        goto endpoints;
+                }
+        }
+        endpoints[0]->peer = endpoints[1];
+        endpoints[1]->peer = endpoints[0];
+
+        for (i = 0; i < VMPI_LOOP_ENDPOINTS; i++) {
+                endpoints[i]->private = vmpi_init(endpoints[i], &err);
+                if (!endpoints[i]->private) {
+                        printk("vmpi_init() failed\n");
+                        goto vmpi_ini;
+                }
+        }
+
+        printk("vmpi-loop: ring_size %u, kick_batch %u, kick_delay_us %u\n",
+               ring_size, kick_batch, kick_delay_us);
+
+        return 0;
+
+ vmpi_ini:
+        while (--i >= 0) {
+                vmpi_fini(endpoints[i]->private);
+        }
+        i = VMPI_LOOP_ENDPOINTS;
+ endpoints:
+        while (--i >= 0) {
+                vmpi_loop_endpoint_destroy(endpoints[i]);
+        }
+
+        return err;
+}
+
+static void __exit
+vmpi_loop_fini(void)
+{
+        int i;
+
+        /* Both sides must be quiet before any ring goes away */
+        for (i = 0; i < VMPI_LOOP_ENDPOINTS; i++) {
+                vmpi_fini(endpoints[i]->private);
+        }
+        for (i = 0; i < VMPI_LOOP_ENDPOINTS; i++) {
+                hrtimer_cancel(&endpoints[i]->kick_timer);
+                tasklet_kill(&endpoints[i]->kick_tasklet);
+        }
+        for (i = 0; i < VMPI_LOOP_ENDPOINTS; i++) {
+                vmpi_loop_endpoint_destroy(endpoints[i]);
+        }
+}
+
+module_init(vmpi_loop_init);
+module_exit(vmpi_loop_fini);
+
+MODULE_DESCRIPTION("Loopback VMPI provider");
+MODULE_LICENSE("GPL");
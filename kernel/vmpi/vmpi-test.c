@@ -3,6 +3,19 @@
  *
  *    Vincenzo Maffione <v.maffione@nextworks.it>
  *
+ * vmpi-loop and vmpi-test are built when the tree is configured with
+ * --with-vmpi-loop. Loading the module with bench_peer_id set also runs a benchmark between
+ * the vmpi_id and bench_peer_id instances (e.g. the two vmpi-loop
+ * endpoints), results go to the kernel log:
+ *
+ *    insmod vmpi-provider.ko && insmod shim-hv.ko && insmod vmpi-loop.ko
+ *    insmod vmpi-test.ko vmpi_id=0 bench_peer_id=1 bench_size=1400 \
+ *                        bench_count=1000000 bench_channels=4
+ *
+ * Throughput is measured writing bench_count buffers spread over
+ * bench_channels channels, latency writing one buffer at a time and
+ * timing its arrival at the peer.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -25,6 +38,8 @@
 #include <linux/moduleparam.h>
 #include <linux/uio.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include "vmpi.h"
 #include "vmpi-bufs.h"
@@ -41,6 +56,21 @@ module_param(write_channel, uint, 0644);
 static unsigned int read_channel = 0;
 module_param(read_channel, uint, 0644);
 
+static int bench_peer_id = -1;
+module_param(bench_peer_id, int, 0444);
+
+static unsigned int bench_count = 100000;
+module_param(bench_count, uint, 0444);
+
+static unsigned int bench_size = 1024;
+module_param(bench_size, uint, 0444);
+
+static unsigned int bench_channels = 1;
+module_param(bench_channels, uint, 0444);
+
+static unsigned int bench_lat_count = 1000;
+module_param(bench_lat_count, uint, 0444);
+
 struct test_queue {
         struct list_head        entries;
         unsigned int            len;
@@ -77,7 +107,7 @@ vmpi_test_write_iter(struct kiocb *iocb, struct iov_iter *from)
                 printk("%s: Out of memory\n", __func__);
                 return -ENOMEM;
         }
-        copy_from_iter(vmpi_buf_data(vb), vmpi_buf_size(vb), from);
+        copy_from_iter(vmpi_buf_data(vb), vmpi_buf_len(vb), from);
 
         add_wait_queue(&vt->write_wqh, &wait);
 
@@ -284,12 +314,13 @@ vmpi_test_release(struct inode *inode, struct file *f)
 
         /* Clean up queues. */
         for (i = 0; i < VMPI_MAX_CHANNELS; i++) {
-                struct vmpi_buf *vb, *tmp;
+                struct vmpi_buf_node *vbn, *tmp;
 
-                list_for_each_entry_safe(vb, tmp, &vt->readqueues[i].entries,
+                list_for_each_entry_safe(vbn, tmp, &vt->readqueues[i].entries,
                                          node) {
-                        list_del(&vb->node);
-                        vmpi_buf_free(vb);
+                        list_del(&vbn->node);
+                        vmpi_buf_free(vbn->vb);
+                        vmpi_buf_node_free(vbn);
                 }
         }
 
@@ -302,6 +333,213 @@ vmpi_test_release(struct inode *inode, struct file *f)
         return 0;
 }
 
+struct vmpi_bench {
+        struct vmpi_ops tx_ops;
+        struct vmpi_ops rx_ops;
+
+        wait_queue_head_t wqh;
+        atomic_t restarts;
+        atomic_t received;
+        atomic64_t rx_bytes;
+        u64 rx_ns;
+};
+
+static void
+bench_write_restart_callback(void *opaque)
+{
+        struct vmpi_bench *b = opaque;
+
+        atomic_inc(&b->restarts);
+        wake_up(&b->wqh);
+}
+
+static void
+bench_read_callback(void *opaque, unsigned int channel, struct vmpi_buf *vb)
+{
+        struct vmpi_bench *b = opaque;
+
+        b->rx_ns = ktime_get_ns();
+        atomic64_add(vmpi_buf_len(vb), &b->rx_bytes);
+        vmpi_buf_free(vb);
+        /* rx_ns before the count, bench_latency() reads them the other
+         * way around */
+        smp_wmb();
+        atomic_inc(&b->received);
+        wake_up(&b->wqh);
+}
+
+static void
+bench_tx_read_callback(void *opaque, unsigned int channel,
+                       struct vmpi_buf *vb)
+{
+        vmpi_buf_free(vb);
+}
+
+/* Blocks like vmpi_test_write_iter() does while the ring is full. */
+static int
+bench_write(struct vmpi_bench *b, unsigned int channel)
+{
+        struct vmpi_buf *vb;
+        int restarts;
+        ssize_t ret;
+
+        vb = vmpi_buf_alloc(bench_size, 0, GFP_KERNEL);
+        if (!vb) {
+                return -ENOMEM;
+        }
+        memset(vmpi_buf_data(vb), 0x5a, bench_size);
+
+        for (;;) {
+                restarts = atomic_read(&b->restarts);
+                ret = b->tx_ops.write(&b->tx_ops, channel, vb);
+                if (likely(ret != -EAGAIN)) {
+                        break;
+                }
+                wait_event_timeout(b->wqh,
+                                   atomic_read(&b->restarts) != restarts,
+                                   HZ / 100);
+        }
+
+        if (ret < 0) {
+                vmpi_buf_free(vb);
+                return ret;
+        }
+
+        return 0;
+}
+
+static int
+bench_throughput(struct vmpi_bench *b)
+{
+        u64 t0, ns, rate;
+        unsigned int i;
+        int ret;
+
+        atomic_set(&b->received, 0);
+        atomic64_set(&b->rx_bytes, 0);
+
+        t0 = ktime_get_ns();
+        for (i = 0; i < bench_count; i++) {
+                ret = bench_write(b, i % bench_channels);
+                if (ret) {
+                        printk("vmpi-bench: write failed [%d]\n", ret);
+                        return ret;
+                }
+        }
+        if (!wait_event_timeout(b->wqh,
+                                atomic_read(&b->received) == bench_count,
+                                10 * HZ)) {
+                printk("vmpi-bench: %d/%u buffers received\n",
+                       atomic_read(&b->received), bench_count);
+                return -ETIMEDOUT;
+        }
+        ns = ktime_get_ns() - t0;
+        if (!ns) {
+                ns = 1;
+        }
+
+        rate = div64_u64((u64)bench_count * NSEC_PER_SEC, ns);
+        printk("vmpi-bench: %u x %u bytes on %u channels: %llu buf/s, "
+               "%llu Mbit/s\n", bench_count, bench_size, bench_channels,
+               rate, div64_u64(atomic64_read(&b->rx_bytes) * 8000, ns));
+
+        return 0;
+}
+
+static int
+bench_latency(struct vmpi_bench *b)
+{
+        u64 t0, lat, min = U64_MAX, max = 0, sum = 0;
+        unsigned int i;
+        int ret;
+
+        atomic_set(&b->received, 0);
+
+        for (i = 0; i < bench_lat_count; i++) {
+                t0 = ktime_get_ns();
+                ret = bench_write(b, 0);
+                if (ret) {
+                        return ret;
+                }
+                if (!wait_event_timeout(b->wqh,
+                                        atomic_read(&b->received) == i + 1,
+                                        HZ)) {
+                        printk("vmpi-bench: buffer %u lost\n", i);
+                        return -ETIMEDOUT;
+                }
+                smp_rmb();
+                lat = b->rx_ns - t0;
+                sum += lat;
+                min = min(min, lat);
+                max = max(max, lat);
+        }
+
+        if (bench_lat_count) {
+                printk("vmpi-bench: latency over %u buffers: min %llu ns, "
+                       "avg %llu ns, max %llu ns\n", bench_lat_count, min,
+                       div64_u64(sum, bench_lat_count), max);
+        }
+
+        return 0;
+}
+
+static int
+vmpi_bench_run(void)
+{
+        unsigned int provider = VMPI_PROVIDER_AUTO;
+        struct vmpi_bench *b;
+        int ret;
+
+        if (!bench_channels || bench_channels > VMPI_MAX_CHANNELS ||
+                        !bench_size ||
+                        bench_size > vmpi_get_max_payload_size() -
+                                     sizeof(struct vmpi_hdr)) {
+                printk("vmpi-bench: invalid parameters\n");
+                return -EINVAL;
+        }
+
+        b = kzalloc(sizeof(*b), GFP_KERNEL);
+        if (!b) {
+                return -ENOMEM;
+        }
+        init_waitqueue_head(&b->wqh);
+
+        ret = vmpi_provider_find_instance(provider, vmpi_id, &b->tx_ops);
+        if (!ret) {
+                ret = vmpi_provider_find_instance(provider, bench_peer_id,
+                                                  &b->rx_ops);
+        }
+        if (ret) {
+                printk("vmpi-bench: cannot find VMPI %u and %d\n", vmpi_id,
+                       bench_peer_id);
+                goto out;
+        }
+
+        ret = b->tx_ops.register_cbs(&b->tx_ops, bench_tx_read_callback,
+                                     bench_write_restart_callback, b);
+        if (ret) {
+                goto out;
+        }
+        ret = b->rx_ops.register_cbs(&b->rx_ops, bench_read_callback,
+                                     bench_write_restart_callback, b);
+        if (ret) {
+                goto unreg_tx;
+        }
+
+        ret = bench_throughput(b);
+        if (!ret) {
+                ret = bench_latency(b);
+        }
+
+        b->rx_ops.unregister_cbs(&b->rx_ops);
+ unreg_tx:
+        b->tx_ops.unregister_cbs(&b->tx_ops);
+ out:
+        kfree(b);
+
+        return ret;
+}
+
 static const struct file_operations vmpi_test_fops = {
         .owner          = THIS_MODULE,
         .release        = vmpi_test_release,
@@ -331,6 +569,13 @@ vmpi_test_init(void)
                 return ret;
         }
 
+        if (bench_peer_id >= 0) {
+                ret = vmpi_bench_run();
+                if (ret) {
+                        printk("vmpi-bench failed [%d]\n", ret);
+                }
+        }
+
         printk("vmpi_test_init completed\n");
 
         return 0;
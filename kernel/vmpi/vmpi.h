@@ -76,7 +76,10 @@ struct vmpi_hdr {
 
 #define VMPI_BUF_CAN_PUSH
 
+/* Per buffer traces, they dominate the cost of the data path */
+#ifdef CONFIG_VMPI_VERBOSE
 #define VERBOSE
+#endif
 #ifdef VERBOSE
 #define IFV(x) x
 #else   /* !VERBOSE */
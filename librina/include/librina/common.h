@@ -636,6 +636,26 @@ class IPCEventProducer {
 public:
 	/** Blocks until there is an event available */
 	IPCEvent * eventWait();
+
+	/**
+	 * Blocks until there is an event available, then appends to events
+	 * all the pending ones (at most max, 0 means no limit) in one go.
+	 * The vector can be reused across calls. Returns the number of
+	 * events appended, 0 on error.
+	 */
+	unsigned int eventsWait(std::vector<IPCEvent *>& events,
+				unsigned int max = 0);
+
+	/** Like eventsWait(), but returns 0 right away if none is pending */
+	unsigned int eventsPoll(std::vector<IPCEvent *>& events,
+				unsigned int max = 0);
+
+	/**
+	 * A descriptor that is readable (poll, epoll, select) while events
+	 * are pending, to multiplex the events with timers and sockets.
+	 * Events must then be read with eventsPoll() or eventsWait().
+	 */
+	int getFd();
 };
 
 /**
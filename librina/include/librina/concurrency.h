@@ -26,6 +26,8 @@
 #ifdef __cplusplus
 
 #include <pthread.h>
+#include <time.h>
+#include <climits>
 
 #include <list>
 #include <map>
@@ -236,25 +238,82 @@ private:
 };
 
 
+/**
+ * A word threads can sleep on (a Linux futex). Sleepers announce
+ * themselves with prepare(), so that wake() costs no system call when
+ * nobody is sleeping.
+ */
+class FutexWord {
+public:
+        FutexWord() : word_(0), waiters_(0) { };
+
+        /**
+         * Announce a sleeper. The caller must check its condition again
+         * after this, and then either wait() with the returned value or
+         * cancel()
+         */
+        int prepare();
+        void cancel();
+
+        /**
+         * Sleep until wake() is called, or until the relative timeout
+         * expires (NULL means no timeout)
+         */
+        void wait(int val, const struct timespec * timeout);
+
+        /** Wake up to n sleepers, if there are any */
+        void wake(int n);
+
+private:
+        int word_;
+        int waiters_;
+};
+
 /**
  * A queue that provides a blocking behaviour when trying to take
- * an element when the queue is empty
+ * an element when the queue is empty.
+ *
+ * Bounded multi-producer/multi-consumer ring: put() and take() do not
+ * allocate nor take a lock, each slot carries a sequence number telling
+ * whether it is free or full for the current lap. Consumers (resp.
+ * producers) only sleep when the queue is empty (resp. full), and are
+ * only woken up when somebody is actually sleeping. put() blocks while
+ * the queue is full, until it is half empty.
  */
-template <class T> class BlockingFIFOQueue: public ConditionVariable {
+template <class T> class BlockingFIFOQueue {
 public:
-BlockingFIFOQueue():ConditionVariable() { };
-        ~BlockingFIFOQueue() throw() { };
+        BlockingFIFOQueue(unsigned int capacity = 4096) : head(0), tail(0) {
+                unsigned int size = 2;
+
+                while (size < capacity)
+                        size <<= 1;
+                mask = size - 1;
+                cells = new Cell[size];
+                for (unsigned int i = 0; i < size; i++) {
+                        cells[i].seq = i;
+                        cells[i].data = 0;
+                }
+        };
+        ~BlockingFIFOQueue() throw() { delete[] cells; };
 
         /** Insert an element at the end of the queue */
         void put(T * element) {
-                lock();
-
-                queue.push_back(element);
-                if (queue.size() == 1) {
-                        broadcast();
+                unsigned long pos;
+                int val;
+
+                while (!enqueue(element, pos)) {
+                        val = notFull.prepare();
+                        if (enqueue(element, pos)) {
+                                notFull.cancel();
+                                break;
+                        }
+                        notFull.wait(val, 0);
                 }
 
-                unlock();
+                /* Only wake up a consumer if the queue was empty */
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                if (__atomic_load_n(&head, __ATOMIC_RELAXED) == pos)
+                        notEmpty.wake(1);
         }
 
         /**
@@ -264,17 +323,18 @@ BlockingFIFOQueue():ConditionVariable() { };
          */
         T * take() {
                 T* result;
+                int val;
 
-                lock();
-
-                while(queue.size() == 0) {
-                        doWait();
+                while (!dequeue(result)) {
+                        val = notEmpty.prepare();
+                        if (dequeue(result)) {
+                                notEmpty.cancel();
+                                break;
+                        }
+                        notEmpty.wait(val, 0);
                 }
 
-                result = queue.front();
-                queue.pop_front();
-
-                unlock();
+                taken();
 
                 return result;
         }
@@ -288,22 +348,24 @@ BlockingFIFOQueue():ConditionVariable() { };
          */
 
         T* timedtake(long seconds, long nanoseconds) {
+                struct timespec timeout;
                 T* result = 0;
-
-                lock();
-                if (queue.size() == 0) {
-                        try {
-                                timedwait(seconds, nanoseconds);
-                        } catch(ConcurrentException &e) {
+                int val;
+
+                if (!dequeue(result)) {
+                        val = notEmpty.prepare();
+                        if (dequeue(result)) {
+                                notEmpty.cancel();
+                        } else {
+                                timeout.tv_sec = seconds;
+                                timeout.tv_nsec = nanoseconds;
+                                notEmpty.wait(val, &timeout);
+                                if (!dequeue(result))
+                                        return 0;
                         }
                 }
 
-                if (queue.size() > 0) {
-                        result = queue.front();
-                        queue.pop_front();
-                }
-
-                unlock();
+                taken();
 
                 return result;
         }
@@ -315,14 +377,10 @@ BlockingFIFOQueue():ConditionVariable() { };
         T * poll() {
                 T * result;
 
-                lock();
-                if (queue.size() == 0) {
-                        result = 0;
-                } else {
-                        result = queue.front();
-                        queue.pop_front();
-                }
-                unlock();
+                if (!dequeue(result))
+                        return 0;
+
+                taken();
 
                 return result;
         }
@@ -330,24 +388,127 @@ BlockingFIFOQueue():ConditionVariable() { };
         /**
          * Get the element at the begining of the queue. It will not remove
          * the item from the queue. If the queue is
-         * empty it will return a NULL pointer.
+         * empty it will return a NULL pointer. The element may be taken by
+         * another consumer right after.
          */
         T * peek() {
-                T * result;
+                unsigned long pos;
+                Cell * cell;
 
-                lock();
-                if (queue.size() == 0) {
-                        result = 0;
-                } else {
-                        result = queue.front();
-                }
-                unlock();
+                pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+                cell = &cells[pos & mask];
+                if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1)
+                        return 0;
 
-                return result;
+                return cell->data;
+        }
+
+        /** Number of elements currently in the queue */
+        unsigned int size() {
+                unsigned long h, t;
+
+                h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+                t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+
+                return t > h ? (unsigned int) (t - h) : 0;
         }
 
 private:
-        std::list<T*> queue;
+        struct Cell {
+                unsigned long seq;
+                T * data;
+        };
+
+        /*
+         * Producers blocked on a full queue are only woken up once it is
+         * half empty, so that they do not ping-pong with the consumers one
+         * element at a time
+         */
+        void taken() {
+                unsigned int n = size();
+
+                if (n <= (mask + 1) / 2)
+                        notFull.wake(INT_MAX);
+                /* put() only wakes one consumer on empty to non-empty, pass
+                 * it on if there is more to take */
+                if (n)
+                        notEmpty.wake(1);
+        }
+
+        bool enqueue(T * element, unsigned long & pos) {
+                unsigned long seq;
+                Cell * cell;
+                long dif;
+
+                pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+                for (;;) {
+                        cell = &cells[pos & mask];
+                        seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+                        dif = (long) seq - (long) pos;
+                        if (dif == 0) {
+                                if (__atomic_compare_exchange_n(&tail, &pos,
+                                                pos + 1, true,
+                                                __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED))
+                                        break;
+                        } else if (dif < 0) {
+                                return false;
+                        } else {
+                                pos = __atomic_load_n(&tail,
+                                                      __ATOMIC_RELAXED);
+                        }
+                }
+
+                cell->data = element;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+                return true;
+        }
+
+        bool dequeue(T *& element) {
+                unsigned long pos, seq;
+                Cell * cell;
+                long dif;
+
+                pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+                for (;;) {
+                        cell = &cells[pos & mask];
+                        seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+                        dif = (long) seq - (long) (pos + 1);
+                        if (dif == 0) {
+                                if (__atomic_compare_exchange_n(&head, &pos,
+                                                pos + 1, true,
+                                                __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED))
+                                        break;
+                        } else if (dif < 0) {
+                                return false;
+                        } else {
+                                pos = __atomic_load_n(&head,
+                                                      __ATOMIC_RELAXED);
+                        }
+                }
+
+                element = cell->data;
+                __atomic_store_n(&cell->seq, pos + mask + 1,
+                                 __ATOMIC_RELEASE);
+
+                return true;
+        }
+
+        BlockingFIFOQueue(const BlockingFIFOQueue &);
+        BlockingFIFOQueue & operator=(const BlockingFIFOQueue &);
+
+        Cell * cells;
+        unsigned long mask;
+        /* Producers and consumers should not share cache lines */
+        char pad0[64];
+        unsigned long head;
+        char pad1[64];
+        unsigned long tail;
+        char pad2[64];
+        FutexWord notEmpty;
+        FutexWord notFull;
 };
 
 /// Wrapper to sleep a thread
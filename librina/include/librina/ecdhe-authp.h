@@ -0,0 +1,304 @@
+/*
+ * Authentication policy based on an X25519 key exchange and Ed25519
+ * signatures
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#ifndef LIBRINA_ECDHE_AUTHP_H
+#define LIBRINA_ECDHE_AUTHP_H
+
+#ifdef __cplusplus
+
+#include <list>
+#include <map>
+#include <sys/types.h>
+#include <time.h>
+#include <openssl/evp.h>
+
+#include "librina/security-manager.h"
+
+// X25519 and Ed25519 are available through EVP from OpenSSL 1.1.1 on
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define LIBRINA_HAVE_ECDHE_AUTH
+
+namespace rina {
+
+/// A pool of X25519 key pairs, refilled by a background thread, so that
+/// generating the ephemeral keys is out of the enrollment path. It only
+/// pays off when the CPU is idle between bursts of enrollments: under a
+/// sustained load the thread competes for the same cores as the
+/// handshakes. The thread is started the first time the size is not 0
+class X25519KeyPool : public ConditionVariable {
+public:
+	X25519KeyPool(unsigned int size);
+	~X25519KeyPool() throw();
+
+	/// Takes a key pair from the pool, or generates one if the pool is
+	/// empty. The caller owns the key, NULL on failure
+	EVP_PKEY * get();
+
+	/// Changes the number of key pairs kept in the pool
+	void resize(unsigned int size);
+
+	/// Number of get() calls that found the pool empty
+	unsigned int get_misses();
+
+	/// Generates an X25519 key pair, NULL on failure
+	static EVP_PKEY * generate();
+
+	static void * refill_function(void * opaque);
+
+	/// Seconds the refill thread waits after a failed key generation
+	static const int RETRY_INTERVAL;
+
+private:
+	void refill();
+	void start_worker();
+
+	std::list<EVP_PKEY *> keys;
+	unsigned int size;
+	unsigned int misses;
+	bool keep_on_running;
+	Thread * worker;
+};
+
+/// Options that the ECDHE authentication policy exchanges with its peer
+class ECDHEAuthOptions {
+public:
+	ECDHEAuthOptions() { };
+	~ECDHEAuthOptions() { };
+
+	/// Supported encryption algorithms
+	std::list<std::string> encrypt_algs;
+
+	/// Supported MAC algorithms
+	std::list<std::string> mac_algs;
+
+	/// Supported compression algorithms
+	std::list<std::string> compress_algs;
+
+	/// X25519 ephemeral public key
+	UcharArray public_key;
+
+	/// Ed25519 signature of the exchange (server to client only)
+	UcharArray signature;
+};
+
+///Captures all data of the ECDHE security context
+class ECDHESecurityContext : public ISecurityContext {
+public:
+	ECDHESecurityContext(int session_id,
+			     const std::string& peer_ap_name,
+			     const AuthSDUProtectionProfile& profile);
+	~ECDHESecurityContext();
+	CryptoState get_crypto_state(bool enable_crypto_tx,
+				     bool enable_crypto_rx,
+				     bool isserver);
+
+	static const std::string ENCRYPTION_ALGORITHM;
+	static const std::string MAC_ALGORITHM;
+	static const std::string COMPRESSION_ALGORITHM;
+	static const std::string KEYSTORE_PATH;
+	static const std::string KEY;
+
+        enum State {
+        	BEGIN,
+                WAIT_SERVER_EXCHANGE,
+                VERIFY_SERVER_EXCHANGE,
+                REQUESTED_ENABLE_DECRYPTION_SERVER,
+                REQUESTED_ENABLE_ENCRYPTION_SERVER,
+                REQUESTED_ENABLE_ENCRYPTION_DECRYPTION_CLIENT,
+                WAIT_CLIENT_SIGNATURE,
+                DONE
+        };
+
+        State state;
+
+	/// Negotiated algorithms
+	std::string encrypt_alg;
+	std::string mac_alg;
+	std::string compress_alg;
+
+	/// Algorithms proposed by the client, signed with the exchange
+	std::list<std::string> offered_encrypt_algs;
+	std::list<std::string> offered_mac_algs;
+	std::list<std::string> offered_compress_algs;
+
+	/// Authentication keystore path
+	std::string keystore_path;
+
+	/// Encryption policy configuration
+	PolicyConfig encrypt_policy_config;
+
+	/// My X25519 ephemeral key pair, freed once the secret is derived
+	EVP_PKEY * ephemeral_key;
+
+	/// The X25519 public keys of both ends
+	UcharArray client_pub_key;
+	UcharArray server_pub_key;
+
+	///The encryption keys
+	UcharArray encrypt_key_client;
+	UcharArray encrypt_key_server;
+
+	///The hmac keys
+	UcharArray mac_key_client;
+	UcharArray mac_key_server;
+
+	/// My Ed25519 key pair and the public key of the peer
+	EVP_PKEY * auth_key;
+	EVP_PKEY * peer_auth_key;
+
+	/// My signature of the exchange, computed before taking the policy
+	/// lock to send it
+	UcharArray signature;
+
+	/// The server got the signature of the client before it was done
+	/// enabling encryption
+	bool peer_authenticated;
+
+	bool crypto_tx_enabled;
+	bool crypto_rx_enabled;
+
+	/// Application process name of the IPCP I'm authenticating against
+	std::string peer_ap_name;
+
+	/// Application process names of both ends, signed with the exchange
+	std::string client_ap_name;
+	std::string server_ap_name;
+};
+
+/// Authentication policy set in the lines of the SSH2 one, with an X25519
+/// key exchange instead of 2048-bit DH and Ed25519 signatures of the
+/// exchange instead of RSA encrypted challenges. It takes two messages
+/// after the M_CONNECT instead of four:
+/// 1: Client: algorithms and its X25519 public key in the M_CONNECT
+/// 2: Server: its X25519 public key, signed with its Ed25519 key
+/// 3: Client: signature of the exchange with its Ed25519 key
+/// The signatures cover both names, the algorithms proposed and the ones
+/// selected, so that a man in the middle cannot downgrade them. Ephemeral
+/// keys come from an X25519KeyPool (off by default) and the Ed25519 keys
+/// are cached until their keystore file changes. The policy lock only
+/// covers the security contexts and their states, the crypto runs
+/// outside of it so that enrollments proceed in parallel.
+class AuthECDHEPolicySet : public IAuthPolicySet {
+public:
+	static const std::string SERVER_EXCHANGE;
+	static const std::string CLIENT_SIGNATURE;
+	static const std::string KEY_POOL_SIZE;
+	static const unsigned int DEFAULT_KEY_POOL_SIZE;
+	static const int X25519_KEY_LENGTH;
+
+	AuthECDHEPolicySet(rib::RIBDaemonProxy * ribd, ISecurityManager * sm);
+	virtual ~AuthECDHEPolicySet();
+	cdap_rib::auth_policy_t get_auth_policy(int session_id,
+						const cdap_rib::ep_info_t& peer_ap,
+				   	        const AuthSDUProtectionProfile& profile);
+	AuthStatus initiate_authentication(const cdap_rib::auth_policy_t& auth_policy,
+				           const AuthSDUProtectionProfile& profile,
+				           const cdap_rib::ep_info_t& peer_ap,
+					   int session_id);
+	int process_incoming_message(const cdap::CDAPMessage& message, int session_id);
+	int set_policy_set_param(const std::string& name,
+	                         const std::string& value);
+	AuthStatus crypto_state_updated(int port_id);
+
+	/// Raw X25519 public key of a key pair. 0 if successful, -1 otherwise
+	static int x25519_public_key(EVP_PKEY * key, UcharArray& pub_key);
+
+	/// X25519 shared secret. 0 if successful, -1 otherwise
+	static int x25519_derive(EVP_PKEY * key, const UcharArray& peer_pub_key,
+				 UcharArray& secret);
+
+	/// Ed25519 signature of data. 0 if successful, -1 otherwise
+	static int ed25519_sign(EVP_PKEY * key, const UcharArray& data,
+				UcharArray& signature);
+
+	/// 0 if signature is a valid Ed25519 signature of data, -1 otherwise
+	static int ed25519_verify(EVP_PKEY * key, const UcharArray& data,
+				  const UcharArray& signature);
+
+private:
+	AuthStatus decryption_enabled_server(ECDHESecurityContext * sc);
+	AuthStatus encryption_enabled_server(ECDHESecurityContext * sc);
+	AuthStatus encryption_decryption_enabled_client(ECDHESecurityContext * sc);
+
+	int process_server_exchange_message(const cdap::CDAPMessage& message,
+					    int session_id);
+	int process_client_signature_message(const cdap::CDAPMessage& message,
+					     int session_id);
+
+	/// Destroys a security context in an unexpected state, unless it is
+	/// being verified outside the lock
+	AuthStatus wrong_state(ECDHESecurityContext * sc);
+
+	/// Picks the algorithms proposed by the client, -1 if not supported
+	int select_algorithms(ECDHESecurityContext * sc,
+			      const ECDHEAuthOptions& options);
+
+	/// Checks that the algorithms selected by the server were proposed,
+	/// -1 otherwise
+	int check_selected_algorithms(ECDHESecurityContext * sc,
+				      const ECDHEAuthOptions& options);
+
+	/// Applies the policy set parameters of the auth policy of a profile
+	void configure(const AuthSDUProtectionProfile& profile);
+
+	/// Application process name of the IPCP running this policy set
+	std::string my_ap_name();
+
+	/// Gets the Ed25519 keys of the security context from the cache,
+	/// reading them from the keystore the first time and whenever the
+	/// keystore file changes
+	int load_authentication_keys(ECDHESecurityContext * sc);
+	EVP_PKEY * get_cached_key(const std::string& path, bool priv);
+	static EVP_PKEY * read_key(const std::string& path, bool priv);
+
+	/// Derives the shared secret and the encryption and MAC keys
+	int generate_keys(ECDHESecurityContext * sc, bool isserver);
+
+	/// The data signed by the server ("S") or client ("C"): the label,
+	/// both names, the proposed and selected algorithms and both X25519
+	/// public keys
+	void exchange_hash_input(ECDHESecurityContext * sc, const char * who,
+				 UcharArray& result);
+
+	rib::RIBDaemonProxy * rib_daemon;
+	ISecurityManager * sec_man;
+	Lockable lock;
+	X25519KeyPool key_pool;
+
+	/// An Ed25519 key read from the keystore, with the modification
+	/// time and size of its file when it was read
+	struct CachedKey {
+		EVP_PKEY * key;
+		struct timespec mtime;
+		off_t size;
+	};
+
+	/// Ed25519 keys read from the keystore, by path
+	std::map<std::string, CachedKey> keys_cache;
+	Lockable keys_cache_lock;
+};
+
+}
+
+#endif
+
+#endif
+
+#endif
@@ -1072,6 +1072,9 @@ public:
         /** The ID of the IPC Process */
         unsigned short ipcProcessId;
 
+        KernelIPCProcess();
+        ~KernelIPCProcess();
+
         void setIPCProcessId(unsigned short ipcProcessId);
         unsigned short getIPCProcessId() const;
 
@@ -1215,7 +1218,63 @@ public:
          * @throws WriteSDUException
          */
         unsigned int writeMgmgtSDUToPortId(void * sdu, int size, unsigned int portId);
+
+        /**
+         * Binds to the management SDU channel of the Kernel IPC Process.
+         * From then on management SDUs are no longer notified through
+         * events: they have to be read with readMgmtSDUs(), and
+         * writeMgmgtSDUToPortId() writes them to the channel.
+         *
+         * @return the file descriptor of the channel, or -1 if the kernel
+         * does not provide it
+         */
+        int openMgmtSDUChannel();
+
+        /**
+         * Blocks until management SDUs are available and reads as many
+         * as fit in the buffer, to be walked with a MgmtSDUBatch.
+         *
+         * @return the number of bytes read, 0 if the Kernel IPC Process is
+         * gone or stopMgmtSDUReader() was called, a negative value on error
+         */
+        int readMgmtSDUs(unsigned char * buf, int size);
+
+        /**
+         * Makes readMgmtSDUs() return 0, now or on its next call, so that
+         * the thread reading the channel can be joined.
+         */
+        void stopMgmtSDUReader();
+
+private:
+        int mgmtFd;
+        /* eventfd written by stopMgmtSDUReader() */
+        int mgmtStopFd;
+};
+
+#ifndef SWIG
+/**
+ * Walks a batch of management SDUs read from the management SDU channel.
+ * The SDUs point into the buffer passed to the constructor.
+ */
+class MgmtSDUBatch {
+public:
+        MgmtSDUBatch(const unsigned char * buf, int size);
+
+        /// Moves to the next SDU of the batch, false if there are no more
+        bool next(unsigned int& portId, const unsigned char *& sdu,
+                  int& size);
+
+        /// Appends an SDU the way the kernel lays it out, false if it does
+        /// not fit in a buffer of bufSize bytes
+        static bool append(unsigned char * buf, int bufSize, int& offset,
+                           unsigned int portId, const void * sdu, int size);
+
+private:
+        const unsigned char * buf;
+        int size;
+        int offset;
 };
+#endif
 
 /**
  * Make Kernel IPC Process singleton
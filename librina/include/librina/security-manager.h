@@ -59,6 +59,7 @@ public:
 	static const std::string AUTH_PASSWORD;
 	static const std::string AUTH_SSH2;
 	static const std::string AUTH_TLSHAND;
+	static const std::string AUTH_ECDHE;
 
 	IAuthPolicySet(const std::string& type_);
 	virtual ~IAuthPolicySet() { };
@@ -32,6 +32,10 @@
 
 #include "CDAP.pb.h"
 
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
 namespace rina {
 namespace cdap {
 
@@ -624,6 +628,23 @@ class AppCDAPIOHandler : public CDAPIOHandler
         std::map<unsigned int, int> fds_map;
 };
 
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+/// Tags of the objValue field of CDAPMessage and of the byteval field of
+/// objVal_t, which the GPB serializer encodes and decodes by hand
+#define GPB_OBJVALUE_TAG	WireFormatLite::MakeTag(		\
+		messages::CDAPMessage::kObjValueFieldNumber,		\
+		WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+#define GPB_BYTEVAL_TAG		WireFormatLite::MakeTag(		\
+		messages::objVal_t::kBytevalFieldNumber,		\
+		WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+
+/// Size of the on-stack initial block of the arena holding the protobuf
+/// CDAP message while encoding or decoding; enough for the header fields
+/// of the usual messages, so that they do not hit the heap
+#define GPB_ARENA_BLOCK_SIZE	1024
+
 /// Google Protocol Buffers Wire Message Provider
 class GPBSerializer : public SerializerInterface
 {
@@ -2730,12 +2751,95 @@ cdap_rib::con_handle_t & CDAPSessionManager::get_con_handle(int port_id)
 }
 
 // CLASS GPBWireMessageProvider
+/// Locates the objValue field of an encoded CDAP message and the bytes
+/// value inside it, so that the (possibly large) object value can be copied
+/// straight from the wire buffer instead of going through the protobuf
+/// object. Returns false if there is no objValue field, if it is repeated
+/// or if the message is malformed; the caller falls back to a regular parse
+static bool gpb_find_obj_value(const unsigned char * buf, int size,
+			       int& field_start, int& field_end,
+			       const unsigned char *& value, int& value_size)
+{
+	google::protobuf::io::CodedInputStream in(buf, size);
+	uint32_t tag, len;
+	bool found = false;
+	int pos;
+
+	while (true) {
+		pos = in.CurrentPosition();
+		tag = in.ReadTag();
+		if (tag == 0)
+			break;
+
+		if (tag != GPB_OBJVALUE_TAG) {
+			if (!WireFormatLite::SkipField(&in, tag))
+				return false;
+			continue;
+		}
+
+		if (found || !in.ReadVarint32(&len) ||
+				len > (uint32_t) (size - in.CurrentPosition()))
+			return false;
+
+		field_start = pos;
+		field_end = in.CurrentPosition() + len;
+		value = 0;
+		value_size = 0;
+
+		google::protobuf::io::CodedInputStream vin(buf + in.CurrentPosition(),
+							   len);
+		while ((tag = vin.ReadTag()) != 0) {
+			if (tag != GPB_BYTEVAL_TAG) {
+				if (!WireFormatLite::SkipField(&vin, tag))
+					return false;
+				continue;
+			}
+
+			if (!vin.ReadVarint32(&len))
+				return false;
+			value = buf + in.CurrentPosition() + vin.CurrentPosition();
+			value_size = len;
+			if (!vin.Skip(len))
+				return false;
+		}
+
+		if (!in.Skip(field_end - in.CurrentPosition()))
+			return false;
+		found = true;
+	}
+
+	return found;
+}
+
 void GPBSerializer::deserializeMessage(const ser_obj_t &message,
 				       cdap_m_t& result)
 {
-	messages::CDAPMessage gpfCDAPMessage;
-
-	gpfCDAPMessage.ParseFromArray(message.message_, message.size_);
+	char arena_block[GPB_ARENA_BLOCK_SIZE];
+	google::protobuf::ArenaOptions arena_opts;
+	const unsigned char * obj_value = 0;
+	int obj_value_size = 0;
+	int obj_start, obj_end;
+	bool has_obj_value;
+
+	arena_opts.initial_block = arena_block;
+	arena_opts.initial_block_size = sizeof(arena_block);
+	google::protobuf::Arena arena(arena_opts);
+	messages::CDAPMessage& gpfCDAPMessage =
+		*google::protobuf::Arena::CreateMessage<messages::CDAPMessage>(&arena);
+
+	// Parse everything but the object value, which is copied only once,
+	// directly from the wire buffer
+	has_obj_value = gpb_find_obj_value(message.message_, message.size_,
+					   obj_start, obj_end,
+					   obj_value, obj_value_size);
+	if (has_obj_value) {
+		google::protobuf::io::CodedInputStream rest(message.message_ + obj_end,
+							    message.size_ - obj_end);
+		gpfCDAPMessage.ParsePartialFromArray(message.message_, obj_start);
+		gpfCDAPMessage.MergePartialFromCodedStream(&rest);
+	} else {
+		gpfCDAPMessage.ParseFromArray(message.message_, message.size_);
+	}
 	// ABS_SYNTAX
 	if (gpfCDAPMessage.has_abssyntax())
 		result.abs_syntax_ = gpfCDAPMessage.abssyntax();
@@ -2790,14 +2894,17 @@ void GPBSerializer::deserializeMessage(const ser_obj_t &message,
 	if (gpfCDAPMessage.has_objname())
 		result.obj_name_ = gpfCDAPMessage.objname();
 	// OBJ_VALUE
-	if (gpfCDAPMessage.has_objvalue()) {
-		messages::objVal_t obj_val_t = gpfCDAPMessage.objvalue();
-		char unsigned *byte_val = new
-				unsigned char[obj_val_t.byteval().size()];
-		memcpy(byte_val, obj_val_t.byteval().data(),
-		       obj_val_t.byteval().size());
-		result.obj_value_.message_ = byte_val;
-		result.obj_value_.size_ = obj_val_t.byteval().size();
+	if (has_obj_value) {
+		result.obj_value_.message_ = new unsigned char[obj_value_size];
+		memcpy(result.obj_value_.message_, obj_value, obj_value_size);
+		result.obj_value_.size_ = obj_value_size;
+	} else if (gpfCDAPMessage.has_objvalue()) {
+		// Fallback parse, the value went through the protobuf object
+		const std::string& byte_val = gpfCDAPMessage.objvalue().byteval();
+		result.obj_value_.message_ = new unsigned char[byte_val.size()];
+		memcpy(result.obj_value_.message_, byte_val.data(),
+		       byte_val.size());
+		result.obj_value_.size_ = byte_val.size();
 	}
 	// OP_CODE
 	if (gpfCDAPMessage.has_opcode()) {
@@ -2835,11 +2942,18 @@ void GPBSerializer::deserializeMessage(const ser_obj_t &message,
 void GPBSerializer::serializeMessage(const cdap_m_t &cdapMessage,
 				     ser_obj_t& result)
 {
-	messages::CDAPMessage gpfCDAPMessage;
+	char arena_block[GPB_ARENA_BLOCK_SIZE];
+	google::protobuf::ArenaOptions arena_opts;
+
+	arena_opts.initial_block = arena_block;
+	arena_opts.initial_block_size = sizeof(arena_block);
+	google::protobuf::Arena arena(arena_opts);
+	messages::CDAPMessage& gpfCDAPMessage =
+		*google::protobuf::Arena::CreateMessage<messages::CDAPMessage>(&arena);
 	// ABS_SYNTAX
 	gpfCDAPMessage.set_abssyntax(cdapMessage.abs_syntax_);
 	// AUTH_POLICY
-	messages::authPolicy_t *gpb_auth_policy = new messages::authPolicy_t();
+	messages::authPolicy_t *gpb_auth_policy = gpfCDAPMessage.mutable_authpolicy();
 	gpb_auth_policy->set_name(cdapMessage.auth_policy_.name);
 	std::list<std::string> versions = cdapMessage.auth_policy_.versions;
 	for(std::list<std::string>::iterator it = versions.begin();
@@ -2847,14 +2961,9 @@ void GPBSerializer::serializeMessage(const cdap_m_t &cdapMessage,
 		gpb_auth_policy->add_versions(*it);
 	}
 	if (cdapMessage.auth_policy_.options.size_ > 0) {
-		char * gpb_opts = new char[cdapMessage.auth_policy_.options.size_];
-		memcpy(gpb_opts,
-		       cdapMessage.auth_policy_.options.message_,
-		       cdapMessage.auth_policy_.options.size_);
-		gpb_auth_policy->set_options(gpb_opts,
+		gpb_auth_policy->set_options(cdapMessage.auth_policy_.options.message_,
 					     cdapMessage.auth_policy_.options.size_);
 	}
-	gpfCDAPMessage.set_allocated_authpolicy(gpb_auth_policy);
 	// DEST_AE_INST
 	gpfCDAPMessage.set_destaeinst(cdapMessage.dest_ae_inst_);
 	// DEST_AE_NAME
@@ -2882,17 +2991,7 @@ void GPBSerializer::serializeMessage(const cdap_m_t &cdapMessage,
 	gpfCDAPMessage.set_objinst(cdapMessage.obj_inst_);
 	// OBJ_NAME
 	gpfCDAPMessage.set_objname(cdapMessage.obj_name_);
-	// OBJ_VALUE
-	if (cdapMessage.obj_value_.size_ > 0) {
-		messages::objVal_t *gpb_obj_val = new messages::objVal_t();
-		char * gpb_val = new char[cdapMessage.obj_value_.size_];
-		memcpy(gpb_val,
-		       cdapMessage.obj_value_.message_,
-		       cdapMessage.obj_value_.size_);
-		gpb_obj_val->set_byteval(gpb_val,
-					 cdapMessage.obj_value_.size_);
-		gpfCDAPMessage.set_allocated_objvalue(gpb_obj_val);
-	}
+	// OBJ_VALUE is appended by hand below, see the end of the function
 	// OP_CODE
 	if (!messages::opCode_t_IsValid(cdapMessage.op_code_)) {
 		throw CDAPException("Serializing Message: Not a valid OpCode");
@@ -2915,10 +3014,32 @@ void GPBSerializer::serializeMessage(const cdap_m_t &cdapMessage,
 	// VERSION
 	gpfCDAPMessage.set_version(cdapMessage.version_);
 
-	int size = gpfCDAPMessage.ByteSizeLong();
+	// The object value is written as an objValue field after the rest of
+	// the message (protobuf accepts fields in any order), straight into
+	// the output buffer, so that it is copied only once
+	uint32_t value_size = cdapMessage.obj_value_.size_ > 0 ?
+			cdapMessage.obj_value_.size_ : 0;
+	uint32_t objval_size = 0;
+	size_t size = gpfCDAPMessage.ByteSizeLong();
+
+	if (value_size > 0) {
+		objval_size = CodedOutputStream::VarintSize32(GPB_BYTEVAL_TAG) +
+			CodedOutputStream::VarintSize32(value_size) + value_size;
+		size += CodedOutputStream::VarintSize32(GPB_OBJVALUE_TAG) +
+			CodedOutputStream::VarintSize32(objval_size) + objval_size;
+	}
+
 	result.message_ = new unsigned char[size];
 	result.size_ = size;
-	gpfCDAPMessage.SerializeToArray(result.message_, size);
+
+	uint8_t * p = gpfCDAPMessage.SerializeWithCachedSizesToArray(result.message_);
+	if (value_size > 0) {
+		p = CodedOutputStream::WriteTagToArray(GPB_OBJVALUE_TAG, p);
+		p = CodedOutputStream::WriteVarint32ToArray(objval_size, p);
+		p = CodedOutputStream::WriteTagToArray(GPB_BYTEVAL_TAG, p);
+		p = CodedOutputStream::WriteVarint32ToArray(value_size, p);
+		memcpy(p, cdapMessage.obj_value_.message_, value_size);
+	}
 }
 
 class CDAPProvider : public CDAPProviderInterface
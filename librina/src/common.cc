@@ -887,6 +887,37 @@ IPCEvent * IPCEventProducer::eventWait()
 #endif
 }
 
+unsigned int IPCEventProducer::eventsWait(std::vector<IPCEvent *>& events,
+					  unsigned int max)
+{
+#if STUB_API
+	events.push_back(getIPCEvent());
+	return 1;
+#else
+	return irati_ctrl_mgr->get_pending_ctrl_msgs(events, true, max);
+#endif
+}
+
+unsigned int IPCEventProducer::eventsPoll(std::vector<IPCEvent *>& events,
+					  unsigned int max)
+{
+#if STUB_API
+	events.push_back(getIPCEvent());
+	return 1;
+#else
+	return irati_ctrl_mgr->get_pending_ctrl_msgs(events, false, max);
+#endif
+}
+
+int IPCEventProducer::getFd()
+{
+#if STUB_API
+	return -1;
+#else
+	return irati_ctrl_mgr->get_ctrl_fd();
+#endif
+}
+
 Singleton<IPCEventProducer> ipcEventProducer;
 
 /* CLASS IPC EXCEPTION */
@@ -23,6 +23,8 @@
 #include <cerrno>
 #include <pthread.h>
 #include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #define RINA_PREFIX "librina.concurrency"
 
@@ -469,6 +471,50 @@ void ConditionVariable::timedwait(long seconds, long nanoseconds){
 			ConcurrentException::error_wait_cond);
 }
 
+// Class FutexWord
+int FutexWord::prepare()
+{
+	__atomic_add_fetch(&waiters_, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&word_, __ATOMIC_SEQ_CST);
+}
+
+void FutexWord::cancel()
+{
+	__atomic_sub_fetch(&waiters_, 1, __ATOMIC_SEQ_CST);
+}
+
+void FutexWord::wait(int val, const struct timespec * timeout)
+{
+	struct timespec ts;
+
+	if (timeout) {
+		ts = *timeout;
+		while (ts.tv_nsec >= CONCURRENCY_1S_TO_NS) {
+			ts.tv_sec++;
+			ts.tv_nsec -= CONCURRENCY_1S_TO_NS;
+		}
+		timeout = &ts;
+	}
+
+	/* Returns right away if a wake() came after prepare() */
+	syscall(SYS_futex, &word_, FUTEX_WAIT_PRIVATE, val, timeout, 0, 0);
+	cancel();
+}
+
+void FutexWord::wake(int n)
+{
+	/* Pairs with the fence in prepare(): either the sleeper sees the
+	 * caller's update, or the caller sees the sleeper */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&waiters_, __ATOMIC_RELAXED))
+		return;
+
+	__atomic_add_fetch(&word_, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &word_, FUTEX_WAKE_PRIVATE, n, 0, 0, 0);
+}
+
 // Class Sleep
 bool Sleep::sleep(int sec, int milisec) {
 	return usleep(sec * 1000000 + milisec * 1000);
@@ -56,6 +56,8 @@ IRATICtrlManager::IRATICtrlManager()
 	ctrl_port = 0;
 	cfd = 0;
 	next_seq_number = 1;
+	read_buf = 0;
+	read_buf_len = 0;
 }
 
 void IRATICtrlManager::initialize()
@@ -97,6 +99,7 @@ IRATICtrlManager::~IRATICtrlManager()
 		LOG_ERR("Problems closing file descriptor %d in control device",
 			cfd);
 	}
+	free(read_buf);
 }
 
 unsigned int IRATICtrlManager::get_next_seq_number()
@@ -685,6 +688,39 @@ IPCEvent * IRATICtrlManager::get_next_ctrl_msg()
 	return event;
 }
 
+unsigned int IRATICtrlManager::get_pending_ctrl_msgs(std::vector<IPCEvent *>& events,
+						     bool block,
+						     unsigned int max)
+{
+	struct irati_msg_base * msg;
+	IPCEvent * event;
+	unsigned int n = 0;
+
+	while (!max || n < max) {
+		msg = irati_read_next_msg_buf(cfd, &read_buf, &read_buf_len,
+					      block && n == 0);
+		if (!msg) {
+			if (errno != EAGAIN)
+				LOG_ERR("Could not retrieve next ctrl message for fd %d. Errno (%d): %s",
+					cfd, errno, strerror(errno));
+			break;
+		}
+
+		event = IRATICtrlManager::irati_ctrl_msg_to_ipc_event(msg);
+		if (!event)
+			LOG_WARN("Event is null for message type %d",
+				 msg->msg_type);
+		irati_ctrl_msg_free(msg);
+		if (!event)
+			continue;
+
+		events.push_back(event);
+		n++;
+	}
+
+	return n;
+}
+
 Singleton<IRATICtrlManager> irati_ctrl_mgr;
 
 }
@@ -59,6 +59,10 @@ class IRATICtrlManager {
 	/** Linear sequence number generator */
 	unsigned int next_seq_number;
 
+	/** Buffer reused to read ctrl messages in get_pending_ctrl_msgs() */
+	char * read_buf;
+	size_t read_buf_len;
+
 	unsigned int get_next_seq_number();
 
 public:
@@ -77,6 +81,14 @@ public:
 
 	IPCEvent * get_next_ctrl_msg();
 
+	/**
+	 * Appends to events the ones for all the pending ctrl messages, up
+	 * to max (0 means no limit). If block, waits until there is at least
+	 * one. Returns the number of events appended.
+	 */
+	unsigned int get_pending_ctrl_msgs(std::vector<IPCEvent *>& events,
+					   bool block, unsigned int max);
+
 	static IPCEvent * irati_ctrl_msg_to_ipc_event(struct irati_msg_base *msg);
 
 	/**
@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 
 #define RINA_PREFIX "librina.ctrldev"
@@ -39,6 +40,7 @@
 #include "irati/kernel-msg.h"
 
 #define IRATI_MAX_CTRL_MSG_SIZE 1000000
+#define IRATI_CTRL_READ_BUF_SIZE 8192
 
 struct irati_msg_base * irati_read_next_msg(int cfd)
 {
@@ -82,6 +84,79 @@ struct irati_msg_base * irati_read_next_msg(int cfd)
 	return resp;
 }
 
+/*
+ * Like irati_read_next_msg(), but reads into *buf, which is allocated on
+ * the first call and grown as needed, with a single read() for messages
+ * that fit. If !block and no message is pending, it returns NULL with
+ * errno set to EAGAIN.
+ */
+struct irati_msg_base * irati_read_next_msg_buf(int cfd, char ** buf,
+						size_t * buflen, int block)
+{
+	struct irati_msg_base *resp;
+	struct pollfd pfd;
+	uint32_t size;
+	char * tmp;
+	int ret;
+
+	if (!block) {
+		pfd.fd = cfd;
+		pfd.events = POLLIN;
+		ret = poll(&pfd, 1, 0);
+		if (ret <= 0) {
+			if (ret == 0)
+				errno = EAGAIN;
+			return NULL;
+		}
+	}
+
+	if (!*buf) {
+		*buf = malloc(IRATI_CTRL_READ_BUF_SIZE);
+		if (!*buf) {
+			LOG_ERR("Cannot allocate memory");
+			errno = ENOMEM;
+			return NULL;
+		}
+		*buflen = IRATI_CTRL_READ_BUF_SIZE;
+	}
+
+	ret = read(cfd, *buf, *buflen);
+	if (ret < 0 && errno == ENOBUFS) {
+		/* Does not fit, ask for the size and grow the buffer */
+		ret = read(cfd, &size, 0);
+		if (ret <= 0) {
+			LOG_ERR("read(cfd) returned %d", ret);
+			return NULL;
+		}
+
+		tmp = realloc(*buf, size);
+		if (!tmp) {
+			LOG_ERR("Cannot allocate memory");
+			errno = ENOMEM;
+			return NULL;
+		}
+		*buf = tmp;
+		*buflen = size;
+
+		ret = read(cfd, *buf, *buflen);
+	}
+	if (ret <= 0) {
+		LOG_ERR("read(cfd) returned %d", ret);
+		return NULL;
+	}
+
+	resp = (struct irati_msg_base *) deserialize_irati_msg(irati_ker_numtables,
+							       RINA_C_MAX,
+							       *buf, ret);
+	if (!resp) {
+		LOG_ERR("Problems during deserialization [%d]\n", ret);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	return resp;
+}
+
 int irati_write_msg(int cfd, struct irati_msg_base *msg)
 {
 	char * serbuf;
@@ -191,3 +266,21 @@ int irati_open_io_port(int port_id)
 
         return fd;
 }
+
+int irati_open_mgmt_port(ipc_process_id_t ipcp_id)
+{
+        struct irati_mgmtdev_ctldata mdata;
+        int fd;
+
+        fd = open("/dev/irati", O_RDWR);
+        if (fd < 0)
+                return fd;
+
+        mdata.ipcp_id = ipcp_id;
+        if (ioctl(fd, IRATI_MGMT_BIND, &mdata)) {
+                close(fd);
+                return -1;
+        }
+
+        return fd;
+}
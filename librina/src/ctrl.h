@@ -32,12 +32,15 @@ extern "C" {
 #endif
 
 struct irati_msg_base * irati_read_next_msg(int cfd);
+struct irati_msg_base * irati_read_next_msg_buf(int cfd, char ** buf,
+						size_t * buflen, int block);
 int irati_write_msg(int cfd, struct irati_msg_base *msg);
 int irati_open_ctrl_port(irati_msg_port_t port_id);
 void irati_ctrl_msg_free(struct irati_msg_base *msg);
 int close_port(int cfd);
 irati_msg_port_t get_app_ctrl_port_from_cfd(int cfd);
 int irati_open_io_port(int port_id);
+int irati_open_mgmt_port(ipc_process_id_t ipcp_id);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,1319 @@
+//
+// Authentication policy based on an X25519 key exchange and Ed25519
+// signatures
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <sys/stat.h>
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+
+#define RINA_PREFIX "librina.ecdhe-auth"
+
+#include "librina/logs.h"
+#include "librina/ecdhe-authp.h"
+#include "auth-policies.pb.h"
+
+#ifdef LIBRINA_HAVE_ECDHE_AUTH
+
+namespace rina {
+
+//Class X25519KeyPool
+const int X25519KeyPool::RETRY_INTERVAL = 1;
+
+X25519KeyPool::X25519KeyPool(unsigned int size_)
+{
+	size = size_;
+	misses = 0;
+	keep_on_running = true;
+	worker = NULL;
+	if (size > 0) {
+		start_worker();
+	}
+}
+
+X25519KeyPool::~X25519KeyPool() throw()
+{
+	void * status;
+
+	lock();
+	keep_on_running = false;
+	signal();
+	unlock();
+	if (worker) {
+		worker->join(&status);
+		delete worker;
+	}
+
+	while (!keys.empty()) {
+		EVP_PKEY_free(keys.front());
+		keys.pop_front();
+	}
+}
+
+EVP_PKEY * X25519KeyPool::generate()
+{
+	EVP_PKEY_CTX * ctx;
+	EVP_PKEY * key = NULL;
+
+	ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, NULL);
+	if (!ctx) {
+		return NULL;
+	}
+
+	if (EVP_PKEY_keygen_init(ctx) != 1 ||
+			EVP_PKEY_keygen(ctx, &key) != 1) {
+		LOG_ERR("Error generating X25519 key pair: %s",
+			ERR_error_string(ERR_get_error(), NULL));
+		key = NULL;
+	}
+
+	EVP_PKEY_CTX_free(ctx);
+
+	return key;
+}
+
+EVP_PKEY * X25519KeyPool::get()
+{
+	EVP_PKEY * key = NULL;
+
+	lock();
+	if (!keys.empty()) {
+		key = keys.front();
+		keys.pop_front();
+	} else if (size > 0) {
+		misses++;
+	}
+	signal();
+	unlock();
+
+	if (!key) {
+		key = generate();
+	}
+
+	return key;
+}
+
+void X25519KeyPool::resize(unsigned int size_)
+{
+	lock();
+	size = size_;
+	while (keys.size() > size) {
+		EVP_PKEY_free(keys.back());
+		keys.pop_back();
+	}
+	if (size > 0 && !worker) {
+		start_worker();
+	}
+	signal();
+	unlock();
+}
+
+void X25519KeyPool::start_worker()
+{
+	worker = new Thread(refill_function, this,
+			    std::string("x25519-pool"), false);
+	worker->start();
+}
+
+unsigned int X25519KeyPool::get_misses()
+{
+	unsigned int result;
+
+	lock();
+	result = misses;
+	unlock();
+
+	return result;
+}
+
+void X25519KeyPool::refill()
+{
+	EVP_PKEY * key;
+
+	lock();
+	while (keep_on_running) {
+		if (keys.size() >= size) {
+			doWait();
+			continue;
+		}
+
+		// Key generation takes the bulk of the time, do it unlocked
+		unlock();
+		key = generate();
+		lock();
+
+		if (!key) {
+			// Not fatal, get() generates the keys inline meanwhile
+			LOG_ERR("Could not refill the X25519 key pool, "
+				"retrying in %d s", RETRY_INTERVAL);
+			try {
+				timedwait(RETRY_INTERVAL, 0);
+			} catch (ConcurrentException &e) {
+			}
+			continue;
+		}
+
+		if (keys.size() < size) {
+			keys.push_back(key);
+		} else {
+			EVP_PKEY_free(key);
+		}
+	}
+	unlock();
+}
+
+void * X25519KeyPool::refill_function(void * opaque)
+{
+	X25519KeyPool * pool = (X25519KeyPool *) opaque;
+
+	pool->refill();
+
+	return NULL;
+}
+
+//ECDHEAuthOptions encoder and decoder operations
+void decode_ecdhe_auth_options(const ser_obj_t &message,
+			       ECDHEAuthOptions &options)
+{
+	rina::auth::policies::googleprotobuf::authOptsECDHE_t gpb_options;
+
+	gpb_options.ParseFromArray(message.message_, message.size_);
+
+	for(int i=0; i<gpb_options.encrypt_algs_size(); i++) {
+		options.encrypt_algs.push_back(gpb_options.encrypt_algs(i));
+	}
+
+	for(int i=0; i<gpb_options.mac_algs_size(); i++) {
+		options.mac_algs.push_back(gpb_options.mac_algs(i));
+	}
+
+	for(int i=0; i<gpb_options.compress_algs_size(); i++) {
+		options.compress_algs.push_back(gpb_options.compress_algs(i));
+	}
+
+	if (gpb_options.has_public_key()) {
+		options.public_key.data =
+				new unsigned char[gpb_options.public_key().size()];
+		memcpy(options.public_key.data,
+		       gpb_options.public_key().data(),
+		       gpb_options.public_key().size());
+		options.public_key.length = gpb_options.public_key().size();
+	}
+
+	if (gpb_options.has_signature()) {
+		options.signature.data =
+				new unsigned char[gpb_options.signature().size()];
+		memcpy(options.signature.data,
+		       gpb_options.signature().data(),
+		       gpb_options.signature().size());
+		options.signature.length = gpb_options.signature().size();
+	}
+}
+
+void encode_ecdhe_auth_options(const ECDHEAuthOptions& options,
+			       ser_obj_t& result)
+{
+	rina::auth::policies::googleprotobuf::authOptsECDHE_t gpb_options;
+
+	for(std::list<std::string>::const_iterator it = options.encrypt_algs.begin();
+			it != options.encrypt_algs.end(); ++it) {
+		gpb_options.add_encrypt_algs(*it);
+	}
+
+	for(std::list<std::string>::const_iterator it = options.mac_algs.begin();
+			it != options.mac_algs.end(); ++it) {
+		gpb_options.add_mac_algs(*it);
+	}
+
+	for(std::list<std::string>::const_iterator it = options.compress_algs.begin();
+			it != options.compress_algs.end(); ++it) {
+		gpb_options.add_compress_algs(*it);
+	}
+
+	if (options.public_key.length > 0) {
+		gpb_options.set_public_key(options.public_key.data,
+					   options.public_key.length);
+	}
+
+	if (options.signature.length > 0) {
+		gpb_options.set_signature(options.signature.data,
+					  options.signature.length);
+	}
+
+	int size = gpb_options.ByteSizeLong();
+	result.message_ = new unsigned char[size];
+	result.size_ = size;
+	gpb_options.SerializeToArray(result.message_, size);
+}
+
+// Class ECDHESecurityContext
+const std::string ECDHESecurityContext::ENCRYPTION_ALGORITHM = "encryptAlg";
+const std::string ECDHESecurityContext::MAC_ALGORITHM = "macAlg";
+const std::string ECDHESecurityContext::COMPRESSION_ALGORITHM = "compressAlg";
+const std::string ECDHESecurityContext::KEYSTORE_PATH = "keystore";
+const std::string ECDHESecurityContext::KEY = "key";
+
+ECDHESecurityContext::ECDHESecurityContext(int session_id,
+					   const std::string& peer_app_name,
+					   const AuthSDUProtectionProfile& profile)
+		: ISecurityContext(session_id, IAuthPolicySet::AUTH_ECDHE)
+{
+	encrypt_alg = profile.encryptPolicy.get_param_value_as_string(ENCRYPTION_ALGORITHM);
+	mac_alg = profile.encryptPolicy.get_param_value_as_string(MAC_ALGORITHM);
+	compress_alg = profile.encryptPolicy.get_param_value_as_string(COMPRESSION_ALGORITHM);
+	keystore_path = profile.authPolicy.get_param_value_as_string(KEYSTORE_PATH);
+	crcPolicy = profile.crcPolicy;
+	ttlPolicy = profile.ttlPolicy;
+	encrypt_policy_config = profile.encryptPolicy;
+	con.port_id = session_id;
+	peer_ap_name = peer_app_name;
+	crypto_rx_enabled = false;
+	crypto_tx_enabled = false;
+	peer_authenticated = false;
+
+	ephemeral_key = NULL;
+	auth_key = NULL;
+	peer_auth_key = NULL;
+
+	state = BEGIN;
+}
+
+ECDHESecurityContext::~ECDHESecurityContext()
+{
+	if (ephemeral_key) {
+		EVP_PKEY_free(ephemeral_key);
+		ephemeral_key = NULL;
+	}
+
+	if (auth_key) {
+		EVP_PKEY_free(auth_key);
+		auth_key = NULL;
+	}
+
+	if (peer_auth_key) {
+		EVP_PKEY_free(peer_auth_key);
+		peer_auth_key = NULL;
+	}
+}
+
+CryptoState ECDHESecurityContext::get_crypto_state(bool enable_crypto_tx,
+						   bool enable_crypto_rx,
+						   bool isserver)
+{
+	CryptoState result;
+
+	result.encrypt_alg = encrypt_alg;
+	result.mac_alg = mac_alg;
+	result.compress_alg = compress_alg;
+
+	result.enable_crypto_tx = enable_crypto_tx;
+	result.enable_crypto_rx = enable_crypto_rx;
+	result.port_id = id;
+	if (isserver) {
+		result.encrypt_key_rx = encrypt_key_client;
+		result.encrypt_key_tx = encrypt_key_server;
+		result.mac_key_rx = mac_key_client;
+		result.mac_key_tx = mac_key_server;
+	} else {
+		result.encrypt_key_tx = encrypt_key_client;
+		result.encrypt_key_rx = encrypt_key_server;
+		result.mac_key_tx = mac_key_client;
+		result.mac_key_rx = mac_key_server;
+	}
+
+	return result;
+}
+
+//Class AuthECDHE
+const std::string AuthECDHEPolicySet::SERVER_EXCHANGE = "ECDHE server exchange";
+const std::string AuthECDHEPolicySet::CLIENT_SIGNATURE = "ECDHE client signature";
+const std::string AuthECDHEPolicySet::KEY_POOL_SIZE = "keyPoolSize";
+const unsigned int AuthECDHEPolicySet::DEFAULT_KEY_POOL_SIZE = 0;
+const int AuthECDHEPolicySet::X25519_KEY_LENGTH = 32;
+
+AuthECDHEPolicySet::AuthECDHEPolicySet(rib::RIBDaemonProxy * ribd,
+				       ISecurityManager * sm) :
+		IAuthPolicySet(IAuthPolicySet::AUTH_ECDHE),
+		key_pool(DEFAULT_KEY_POOL_SIZE)
+{
+	rib_daemon = ribd;
+	sec_man = sm;
+}
+
+AuthECDHEPolicySet::~AuthECDHEPolicySet()
+{
+	std::map<std::string, CachedKey>::iterator it;
+
+	for (it = keys_cache.begin(); it != keys_cache.end(); ++it) {
+		EVP_PKEY_free(it->second.key);
+	}
+	keys_cache.clear();
+}
+
+int AuthECDHEPolicySet::x25519_public_key(EVP_PKEY * key, UcharArray& pub_key)
+{
+	size_t len = X25519_KEY_LENGTH;
+
+	pub_key.data = new unsigned char[len];
+	if (EVP_PKEY_get_raw_public_key(key, pub_key.data, &len) != 1) {
+		LOG_ERR("Error getting X25519 public key: %s",
+			ERR_error_string(ERR_get_error(), NULL));
+		return -1;
+	}
+	pub_key.length = len;
+
+	return 0;
+}
+
+int AuthECDHEPolicySet::x25519_derive(EVP_PKEY * key,
+				      const UcharArray& peer_pub_key,
+				      UcharArray& secret)
+{
+	EVP_PKEY * peer;
+	EVP_PKEY_CTX * ctx;
+	size_t len = X25519_KEY_LENGTH;
+	int result = -1;
+
+	if (peer_pub_key.length != X25519_KEY_LENGTH) {
+		LOG_ERR("Wrong X25519 public key length: %d",
+			peer_pub_key.length);
+		return -1;
+	}
+
+	peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL,
+					   peer_pub_key.data,
+					   peer_pub_key.length);
+	if (!peer) {
+		LOG_ERR("Error reading X25519 public key of the peer");
+		return -1;
+	}
+
+	ctx = EVP_PKEY_CTX_new(key, NULL);
+	if (!ctx) {
+		EVP_PKEY_free(peer);
+		return -1;
+	}
+
+	secret.data = new unsigned char[len];
+	if (EVP_PKEY_derive_init(ctx) == 1 &&
+			EVP_PKEY_derive_set_peer(ctx, peer) == 1 &&
+			EVP_PKEY_derive(ctx, secret.data, &len) == 1) {
+		secret.length = len;
+		result = 0;
+	} else {
+		LOG_ERR("Error computing shared secret: %s",
+			ERR_error_string(ERR_get_error(), NULL));
+	}
+
+	EVP_PKEY_CTX_free(ctx);
+	EVP_PKEY_free(peer);
+
+	return result;
+}
+
+int AuthECDHEPolicySet::ed25519_sign(EVP_PKEY * key, const UcharArray& data,
+				     UcharArray& signature)
+{
+	EVP_MD_CTX * ctx;
+	size_t len;
+	int result = -1;
+
+	ctx = EVP_MD_CTX_new();
+	if (!ctx) {
+		return -1;
+	}
+
+	len = EVP_PKEY_size(key);
+	signature.data = new unsigned char[len];
+	if (EVP_DigestSignInit(ctx, NULL, NULL, NULL, key) == 1 &&
+			EVP_DigestSign(ctx, signature.data, &len,
+				       data.data, data.length) == 1) {
+		signature.length = len;
+		result = 0;
+	} else {
+		LOG_ERR("Error signing with Ed25519 key: %s",
+			ERR_error_string(ERR_get_error(), NULL));
+	}
+
+	EVP_MD_CTX_free(ctx);
+
+	return result;
+}
+
+int AuthECDHEPolicySet::ed25519_verify(EVP_PKEY * key, const UcharArray& data,
+				       const UcharArray& signature)
+{
+	EVP_MD_CTX * ctx;
+	int result = -1;
+
+	ctx = EVP_MD_CTX_new();
+	if (!ctx) {
+		return -1;
+	}
+
+	if (EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, key) == 1 &&
+			EVP_DigestVerify(ctx, signature.data, signature.length,
+					 data.data, data.length) == 1) {
+		result = 0;
+	}
+
+	EVP_MD_CTX_free(ctx);
+
+	return result;
+}
+
+EVP_PKEY * AuthECDHEPolicySet::read_key(const std::string& path, bool priv)
+{
+	EVP_PKEY * key;
+	BIO * keystore;
+
+	keystore = BIO_new_file(path.c_str(), "r");
+	if (!keystore) {
+		LOG_ERR("Problems opening keystore file at: %s",
+			path.c_str());
+		return NULL;
+	}
+
+	if (priv) {
+		key = PEM_read_bio_PrivateKey(keystore, NULL, 0, NULL);
+	} else {
+		key = PEM_read_bio_PUBKEY(keystore, NULL, 0, NULL);
+	}
+	BIO_free(keystore);
+
+	if (!key) {
+		LOG_ERR("Problems reading key from %s: %s",
+			path.c_str(),
+			ERR_error_string(ERR_get_error(), NULL));
+		return NULL;
+	}
+
+	if (EVP_PKEY_id(key) != EVP_PKEY_ED25519) {
+		LOG_ERR("Key at %s is not an Ed25519 key",
+			path.c_str());
+		EVP_PKEY_free(key);
+		return NULL;
+	}
+
+	return key;
+}
+
+EVP_PKEY * AuthECDHEPolicySet::get_cached_key(const std::string& path,
+					      bool priv)
+{
+	std::map<std::string, CachedKey>::iterator it;
+	CachedKey entry;
+	struct stat st;
+
+	// A key removed from the keystore is dropped from the cache, and one
+	// whose file changed is read again
+	if (stat(path.c_str(), &st) != 0) {
+		LOG_ERR("Problems opening keystore file at: %s", path.c_str());
+		ScopedLock g(keys_cache_lock);
+		it = keys_cache.find(path);
+		if (it != keys_cache.end()) {
+			EVP_PKEY_free(it->second.key);
+			keys_cache.erase(it);
+		}
+		return NULL;
+	}
+
+	{
+		ScopedLock g(keys_cache_lock);
+		it = keys_cache.find(path);
+		if (it != keys_cache.end() &&
+				it->second.mtime.tv_sec == st.st_mtim.tv_sec &&
+				it->second.mtime.tv_nsec == st.st_mtim.tv_nsec &&
+				it->second.size == st.st_size) {
+			EVP_PKEY_up_ref(it->second.key);
+			return it->second.key;
+		}
+	}
+
+	entry.key = read_key(path, priv);
+	if (!entry.key) {
+		return NULL;
+	}
+	entry.mtime = st.st_mtim;
+	entry.size = st.st_size;
+
+	ScopedLock g(keys_cache_lock);
+	it = keys_cache.find(path);
+	if (it != keys_cache.end()) {
+		LOG_INFO("Keystore file %s changed, key read again",
+			 path.c_str());
+		EVP_PKEY_free(it->second.key);
+		keys_cache.erase(it);
+	}
+	keys_cache.insert(std::make_pair(path, entry));
+	EVP_PKEY_up_ref(entry.key);
+
+	return entry.key;
+}
+
+int AuthECDHEPolicySet::load_authentication_keys(ECDHESecurityContext * sc)
+{
+	std::stringstream ss;
+
+	ss << sc->keystore_path << "/" << ECDHESecurityContext::KEY;
+	sc->auth_key = get_cached_key(ss.str(), true);
+	if (!sc->auth_key) {
+		return -1;
+	}
+
+	ss.str(std::string());
+	ss.clear();
+	ss << sc->keystore_path << "/" << sc->peer_ap_name;
+	sc->peer_auth_key = get_cached_key(ss.str(), false);
+	if (!sc->peer_auth_key) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int AuthECDHEPolicySet::select_algorithms(ECDHESecurityContext * sc,
+					  const ECDHEAuthOptions& options)
+{
+	if (options.encrypt_algs.empty() || options.mac_algs.empty() ||
+			options.compress_algs.empty()) {
+		LOG_ERR("Missing algorithms in the peer options");
+		return -1;
+	}
+
+	sc->offered_encrypt_algs = options.encrypt_algs;
+	sc->offered_mac_algs = options.mac_algs;
+	sc->offered_compress_algs = options.compress_algs;
+
+	sc->encrypt_alg = options.encrypt_algs.front();
+	if (sc->encrypt_alg != SSL_TXT_AES128 &&
+			sc->encrypt_alg != SSL_TXT_AES256) {
+		LOG_ERR("Unsupported encryption algorithm: %s",
+			sc->encrypt_alg.c_str());
+		return -1;
+	}
+
+	sc->mac_alg = options.mac_algs.front();
+	if (sc->mac_alg != SSL_TXT_MD5 &&
+			sc->mac_alg != SSL_TXT_SHA1 &&
+			sc->mac_alg != SSL_TXT_SHA256) {
+		LOG_ERR("Unsupported MAC algorithm: %s",
+			sc->mac_alg.c_str());
+		return -1;
+	}
+
+	sc->compress_alg = options.compress_algs.front();
+	if (sc->compress_alg != "deflate") {
+		LOG_ERR("Unsupported compression algorithm: %s",
+			sc->compress_alg.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+
+static bool is_offered(const std::list<std::string>& offered,
+		       const std::string& alg)
+{
+	return std::find(offered.begin(), offered.end(), alg) != offered.end();
+}
+
+std::string AuthECDHEPolicySet::my_ap_name()
+{
+	ApplicationProcess * ap = sec_man->get_application_process();
+
+	return ap ? ap->get_name() : std::string();
+}
+
+int AuthECDHEPolicySet::check_selected_algorithms(ECDHESecurityContext * sc,
+						  const ECDHEAuthOptions& options)
+{
+	if (options.encrypt_algs.size() != 1 || options.mac_algs.size() != 1 ||
+			options.compress_algs.size() != 1) {
+		LOG_ERR("The server must select one algorithm of each kind");
+		return -1;
+	}
+
+	if (!is_offered(sc->offered_encrypt_algs, options.encrypt_algs.front()) ||
+			!is_offered(sc->offered_mac_algs, options.mac_algs.front()) ||
+			!is_offered(sc->offered_compress_algs,
+				    options.compress_algs.front())) {
+		LOG_ERR("The server selected algorithms that were not proposed");
+		return -1;
+	}
+
+	sc->encrypt_alg = options.encrypt_algs.front();
+	sc->mac_alg = options.mac_algs.front();
+	sc->compress_alg = options.compress_algs.front();
+
+	return 0;
+}
+
+void AuthECDHEPolicySet::configure(const AuthSDUProtectionProfile& profile)
+{
+	std::string value;
+
+	// The auth policy parameters of the profile may size the key pool
+	// too, the parameter is optional
+	try {
+		value = profile.authPolicy.get_param_value_as_string(KEY_POOL_SIZE);
+	} catch (Exception &e) {
+		return;
+	}
+
+	set_policy_set_param(KEY_POOL_SIZE, value);
+}
+
+// Every field goes with its length, 4 bytes in network order, so that
+// the boundaries between them cannot be moved
+static void append_field(std::string& out, const unsigned char * data,
+			 unsigned int length)
+{
+	unsigned char len[4];
+
+	len[0] = (length >> 24) & 0xff;
+	len[1] = (length >> 16) & 0xff;
+	len[2] = (length >> 8) & 0xff;
+	len[3] = length & 0xff;
+	out.append(reinterpret_cast<char *>(len), sizeof(len));
+	out.append(reinterpret_cast<const char *>(data), length);
+}
+
+static void append_field(std::string& out, const std::string& value)
+{
+	append_field(out, reinterpret_cast<const unsigned char *>(value.data()),
+		     value.size());
+}
+
+static void append_field(std::string& out, const std::list<std::string>& values)
+{
+	std::string joined;
+
+	for (std::list<std::string>::const_iterator it = values.begin();
+			it != values.end(); ++it) {
+		if (it != values.begin()) {
+			joined += ",";
+		}
+		joined += *it;
+	}
+	append_field(out, joined);
+}
+
+void AuthECDHEPolicySet::exchange_hash_input(ECDHESecurityContext * sc,
+					     const char * who,
+					     UcharArray& result)
+{
+	std::string data;
+
+	append_field(data, std::string(who, 1));
+	append_field(data, sc->client_ap_name);
+	append_field(data, sc->server_ap_name);
+	append_field(data, sc->offered_encrypt_algs);
+	append_field(data, sc->offered_mac_algs);
+	append_field(data, sc->offered_compress_algs);
+	append_field(data, sc->encrypt_alg);
+	append_field(data, sc->mac_alg);
+	append_field(data, sc->compress_alg);
+	append_field(data, sc->client_pub_key.data, sc->client_pub_key.length);
+	append_field(data, sc->server_pub_key.data, sc->server_pub_key.length);
+
+	result.length = data.size();
+	result.data = new unsigned char[result.length];
+	memcpy(result.data, data.data(), result.length);
+}
+
+// Each key is SHA256(secret || client public key || server public key ||
+// label), truncated to the length the algorithm needs
+static int derive_key(const UcharArray& secret, ECDHESecurityContext * sc,
+		      char label, int length, UcharArray& key)
+{
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	EVP_MD_CTX * ctx;
+	int result = -1;
+
+	ctx = EVP_MD_CTX_new();
+	if (!ctx) {
+		return -1;
+	}
+
+	if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1 &&
+			EVP_DigestUpdate(ctx, secret.data, secret.length) == 1 &&
+			EVP_DigestUpdate(ctx, sc->client_pub_key.data,
+					 sc->client_pub_key.length) == 1 &&
+			EVP_DigestUpdate(ctx, sc->server_pub_key.data,
+					 sc->server_pub_key.length) == 1 &&
+			EVP_DigestUpdate(ctx, &label, 1) == 1 &&
+			EVP_DigestFinal_ex(ctx, digest, NULL) == 1) {
+		key.length = length;
+		key.data = new unsigned char[length];
+		memcpy(key.data, digest, length);
+		result = 0;
+	}
+
+	EVP_MD_CTX_free(ctx);
+
+	return result;
+}
+
+int AuthECDHEPolicySet::generate_keys(ECDHESecurityContext * sc, bool isserver)
+{
+	UcharArray * peer_pub_key;
+	UcharArray secret;
+	int encrypt_len;
+	int mac_len;
+	int result;
+
+	if (sc->encrypt_alg == SSL_TXT_AES128) {
+		encrypt_len = 16;
+	} else if (sc->encrypt_alg == SSL_TXT_AES256) {
+		encrypt_len = 32;
+	} else {
+		LOG_ERR("Unsupported encryption algorithm: %s",
+			sc->encrypt_alg.c_str());
+		return -1;
+	}
+
+	if (sc->mac_alg == SSL_TXT_MD5) {
+		mac_len = 16;
+	} else if (sc->mac_alg == SSL_TXT_SHA1) {
+		mac_len = 20;
+	} else if (sc->mac_alg == SSL_TXT_SHA256) {
+		mac_len = 32;
+	} else {
+		LOG_ERR("Unsupported MAC algorithm: %s",
+			sc->mac_alg.c_str());
+		return -1;
+	}
+
+	if (sc->client_pub_key.length == 0 || sc->server_pub_key.length == 0) {
+		LOG_ERR("Missing X25519 public keys");
+		return -1;
+	}
+
+	peer_pub_key = isserver ? &sc->client_pub_key : &sc->server_pub_key;
+
+	if (x25519_derive(sc->ephemeral_key, *peer_pub_key, secret)) {
+		return -1;
+	}
+
+	// The ephemeral key is not needed anymore
+	EVP_PKEY_free(sc->ephemeral_key);
+	sc->ephemeral_key = NULL;
+
+	result = derive_key(secret, sc, 'A', encrypt_len, sc->encrypt_key_client) ||
+		 derive_key(secret, sc, 'B', encrypt_len, sc->encrypt_key_server) ||
+		 derive_key(secret, sc, 'C', mac_len, sc->mac_key_client) ||
+		 derive_key(secret, sc, 'D', mac_len, sc->mac_key_server);
+
+	OPENSSL_cleanse(secret.data, secret.length);
+
+	if (result) {
+		LOG_ERR("Error deriving the encryption and MAC keys");
+		return -1;
+	}
+
+	LOG_DBG("Generated encryption keys of %d bytes and MAC keys of %d bytes",
+		encrypt_len, mac_len);
+
+	return 0;
+}
+
+cdap_rib::auth_policy_t AuthECDHEPolicySet::get_auth_policy(int session_id,
+							    const cdap_rib::ep_info_t& peer_ap,
+							    const AuthSDUProtectionProfile& profile)
+{
+	if (profile.authPolicy.name_ != type) {
+		LOG_ERR("Wrong policy name: %s, expected: %s",
+				profile.authPolicy.name_.c_str(),
+				type.c_str());
+		throw Exception();
+	}
+
+	LOG_DBG("Initiating authentication for session_id: %d", session_id);
+	cdap_rib::auth_policy_t auth_policy;
+	auth_policy.name = IAuthPolicySet::AUTH_ECDHE;
+	auth_policy.versions.push_back(profile.authPolicy.version_);
+
+	configure(profile);
+
+	ECDHESecurityContext * sc = new ECDHESecurityContext(session_id,
+							     peer_ap.ap_name_,
+							     profile);
+	sc->client_ap_name = my_ap_name();
+	sc->server_ap_name = peer_ap.ap_name_;
+
+	if (load_authentication_keys(sc) != 0) {
+		delete sc;
+		throw Exception();
+	}
+
+	sc->ephemeral_key = key_pool.get();
+	if (!sc->ephemeral_key ||
+			x25519_public_key(sc->ephemeral_key, sc->client_pub_key)) {
+		delete sc;
+		throw Exception();
+	}
+
+	sc->offered_encrypt_algs.push_back(sc->encrypt_alg);
+	sc->offered_mac_algs.push_back(sc->mac_alg);
+	sc->offered_compress_algs.push_back(sc->compress_alg);
+
+	ECDHEAuthOptions options;
+	options.encrypt_algs = sc->offered_encrypt_algs;
+	options.mac_algs = sc->offered_mac_algs;
+	options.compress_algs = sc->offered_compress_algs;
+	options.public_key = sc->client_pub_key;
+
+	encode_ecdhe_auth_options(options, auth_policy.options);
+
+	ScopedLock sc_lock(lock);
+
+	if (sec_man->get_security_context(session_id) != 0) {
+		LOG_ERR("A security context already exists for session_id: %d", session_id);
+		delete sc;
+		throw Exception();
+	}
+
+	//Store security context
+	sc->state = ECDHESecurityContext::WAIT_SERVER_EXCHANGE;
+	sec_man->add_security_context(sc);
+
+	return auth_policy;
+}
+
+IAuthPolicySet::AuthStatus AuthECDHEPolicySet::initiate_authentication(const cdap_rib::auth_policy_t& auth_policy,
+								       const AuthSDUProtectionProfile& profile,
+								       const cdap_rib::ep_info_t& peer_ap,
+								       int session_id)
+{
+	if (auth_policy.name != type) {
+		LOG_ERR("Wrong policy name: %s", auth_policy.name.c_str());
+		return IAuthPolicySet::FAILED;
+	}
+
+	if (auth_policy.versions.front() != RINA_DEFAULT_POLICY_VERSION) {
+		LOG_ERR("Unsupported policy version: %s",
+				auth_policy.versions.front().c_str());
+		return IAuthPolicySet::FAILED;
+	}
+
+	LOG_DBG("Initiating authentication for session_id: %d", session_id);
+	ECDHEAuthOptions options;
+	UcharArray signed_data;
+	decode_ecdhe_auth_options(auth_policy.options, options);
+
+	configure(profile);
+
+	ECDHESecurityContext * sc = new ECDHESecurityContext(session_id,
+							     peer_ap.ap_name_,
+							     profile);
+	sc->client_ap_name = peer_ap.ap_name_;
+	sc->server_ap_name = my_ap_name();
+
+	if (select_algorithms(sc, options) != 0 ||
+			load_authentication_keys(sc) != 0) {
+		delete sc;
+		return IAuthPolicySet::FAILED;
+	}
+
+	sc->client_pub_key = options.public_key;
+	sc->ephemeral_key = key_pool.get();
+	if (!sc->ephemeral_key ||
+			x25519_public_key(sc->ephemeral_key, sc->server_pub_key) ||
+			generate_keys(sc, true) != 0) {
+		delete sc;
+		return IAuthPolicySet::FAILED;
+	}
+
+	exchange_hash_input(sc, "S", signed_data);
+	if (ed25519_sign(sc->auth_key, signed_data, sc->signature) != 0) {
+		delete sc;
+		return IAuthPolicySet::FAILED;
+	}
+
+	ScopedLock sc_lock(lock);
+
+	if (sec_man->get_security_context(session_id) != 0) {
+		LOG_ERR("A security context already exists for session_id: %d", session_id);
+		delete sc;
+		return IAuthPolicySet::FAILED;
+	}
+
+	// Configure kernel SDU protection policy with the keys and algorithms,
+	// tell it to enable decryption
+	AuthStatus result = sec_man->update_crypto_state(sc->get_crypto_state(false, true, true),
+						         this);
+	if (result == IAuthPolicySet::FAILED) {
+		delete sc;
+		return result;
+	}
+
+	sec_man->add_security_context(sc);
+	sc->state = ECDHESecurityContext::REQUESTED_ENABLE_DECRYPTION_SERVER;
+	if (result == IAuthPolicySet::SUCCESSFULL) {
+		result = decryption_enabled_server(sc);
+	}
+	return result;
+}
+
+IAuthPolicySet::AuthStatus AuthECDHEPolicySet::crypto_state_updated(int port_id)
+{
+	ECDHESecurityContext * sc;
+
+	ScopedLock sc_lock(lock);
+
+	sc = dynamic_cast<ECDHESecurityContext *>(sec_man->get_security_context(port_id));
+	if (!sc) {
+		LOG_ERR("Could not retrieve ECDHE security context for port-id: %d", port_id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	switch(sc->state) {
+	case ECDHESecurityContext::REQUESTED_ENABLE_DECRYPTION_SERVER:
+		return decryption_enabled_server(sc);
+	case ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_SERVER:
+		return encryption_enabled_server(sc);
+	case ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_DECRYPTION_CLIENT:
+		return encryption_decryption_enabled_client(sc);
+	default:
+		return wrong_state(sc);
+	}
+}
+
+IAuthPolicySet::AuthStatus AuthECDHEPolicySet::wrong_state(ECDHESecurityContext * sc)
+{
+	LOG_ERR("Wrong security context state: %d", sc->state);
+
+	// Another thread is verifying the exchange without the lock, it
+	// will finish or destroy the context itself
+	if (sc->state != ECDHESecurityContext::VERIFY_SERVER_EXCHANGE) {
+		sec_man->destroy_security_context(sc->id);
+	}
+
+	return IAuthPolicySet::FAILED;
+}
+
+IAuthPolicySet::AuthStatus AuthECDHEPolicySet::decryption_enabled_server(ECDHESecurityContext * sc)
+{
+	if (sc->state != ECDHESecurityContext::REQUESTED_ENABLE_DECRYPTION_SERVER) {
+		LOG_ERR("Wrong state of policy");
+		sec_man->destroy_security_context(sc->id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	LOG_DBG("Decryption enabled for port-id: %d", sc->id);
+	sc->crypto_rx_enabled = true;
+
+	// Send my public key and the signature of the exchange
+	ECDHEAuthOptions options;
+	options.encrypt_algs.push_back(sc->encrypt_alg);
+	options.mac_algs.push_back(sc->mac_alg);
+	options.compress_algs.push_back(sc->compress_alg);
+	options.public_key = sc->server_pub_key;
+	options.signature = sc->signature;
+
+	try {
+		cdap_rib::flags_t flags;
+		cdap_rib::filt_info_t filt;
+		cdap_rib::obj_info_t obj_info;
+
+		obj_info.class_ = SERVER_EXCHANGE;
+		obj_info.name_ = SERVER_EXCHANGE;
+		obj_info.inst_ = 0;
+		encode_ecdhe_auth_options(options, obj_info.value_);
+
+		rib_daemon->remote_write(sc->con, obj_info, flags, filt, NULL);
+	} catch (Exception &e) {
+		LOG_ERR("Problems encoding and sending CDAP message: %s",
+			e.what());
+		sec_man->destroy_security_context(sc->id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	// Tell the kernel SDU protection policy to enable encryption
+	AuthStatus result = sec_man->update_crypto_state(sc->get_crypto_state(true, false, true),
+						         this);
+	if (result == IAuthPolicySet::FAILED) {
+		sec_man->destroy_security_context(sc->id);
+		return result;
+	}
+
+	sc->state = ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_SERVER;
+	if (result == IAuthPolicySet::SUCCESSFULL) {
+		result = encryption_enabled_server(sc);
+	}
+	return result;
+}
+
+IAuthPolicySet::AuthStatus AuthECDHEPolicySet::encryption_enabled_server(ECDHESecurityContext * sc)
+{
+	if (sc->state != ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_SERVER) {
+		LOG_ERR("Wrong state of policy");
+		sec_man->destroy_security_context(sc->id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	LOG_DBG("Encryption enabled for port-id: %d", sc->id);
+	sc->crypto_tx_enabled = true;
+
+	// The signature of the client may have arrived in the meantime
+	if (sc->peer_authenticated) {
+		sc->state = ECDHESecurityContext::DONE;
+		return IAuthPolicySet::SUCCESSFULL;
+	}
+
+	sc->state = ECDHESecurityContext::WAIT_CLIENT_SIGNATURE;
+	return IAuthPolicySet::IN_PROGRESS;
+}
+
+int AuthECDHEPolicySet::process_incoming_message(const cdap::CDAPMessage& message,
+						 int session_id)
+{
+	if (message.op_code_ != cdap::CDAPMessage::M_WRITE) {
+		LOG_ERR("Wrong operation type");
+		return IAuthPolicySet::FAILED;
+	}
+
+	if (message.obj_class_ == SERVER_EXCHANGE) {
+		return process_server_exchange_message(message, session_id);
+	}
+
+	if (message.obj_class_ == CLIENT_SIGNATURE) {
+		return process_client_signature_message(message, session_id);
+	}
+
+	return rina::IAuthPolicySet::FAILED;
+}
+
+int AuthECDHEPolicySet::process_server_exchange_message(const cdap::CDAPMessage& message,
+							int session_id)
+{
+	ECDHESecurityContext * sc;
+	ECDHEAuthOptions options;
+	UcharArray signed_data;
+	UcharArray client_data;
+	bool error = true;
+
+	if (message.obj_value_.message_ == 0) {
+		LOG_ERR("Null object value");
+		return IAuthPolicySet::FAILED;
+	}
+
+	decode_ecdhe_auth_options(message.obj_value_, options);
+
+	{
+		ScopedLock sc_lock(lock);
+
+		sc = dynamic_cast<ECDHESecurityContext *>(sec_man->get_security_context(session_id));
+		if (!sc) {
+			LOG_ERR("Could not retrieve Security Context for session: %d", session_id);
+			return IAuthPolicySet::FAILED;
+		}
+
+		if (sc->state != ECDHESecurityContext::WAIT_SERVER_EXCHANGE) {
+			return wrong_state(sc);
+		}
+
+		// Authenticate the server before using its key or its choice of
+		// algorithms, the signature covers both
+		if (check_selected_algorithms(sc, options) != 0) {
+			sec_man->destroy_security_context(session_id);
+			return IAuthPolicySet::FAILED;
+		}
+
+		sc->server_pub_key = options.public_key;
+
+		// Nobody else touches the context in this state, the crypto
+		// runs without the lock
+		sc->state = ECDHESecurityContext::VERIFY_SERVER_EXCHANGE;
+	}
+
+	exchange_hash_input(sc, "S", signed_data);
+	if (ed25519_verify(sc->peer_auth_key, signed_data, options.signature) != 0) {
+		LOG_ERR("Wrong signature of the exchange from %s",
+			sc->peer_ap_name.c_str());
+	} else {
+		LOG_INFO("Remote peer successfully authenticated");
+
+		// Authenticate to the server with the signature of the exchange
+		exchange_hash_input(sc, "C", client_data);
+		error = generate_keys(sc, false) != 0 ||
+			ed25519_sign(sc->auth_key, client_data, sc->signature) != 0;
+	}
+
+	ScopedLock sc_lock(lock);
+
+	if (error) {
+		sec_man->destroy_security_context(session_id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	// Configure kernel SDU protection policy with the keys and algorithms,
+	// tell it to enable decryption and encryption
+	AuthStatus result = sec_man->update_crypto_state(sc->get_crypto_state(true, true, false),
+						         this);
+	if (result == IAuthPolicySet::FAILED) {
+		sec_man->destroy_security_context(sc->id);
+		return result;
+	}
+
+	sc->state = ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_DECRYPTION_CLIENT;
+	if (result == IAuthPolicySet::SUCCESSFULL) {
+		result = encryption_decryption_enabled_client(sc);
+	}
+	return result;
+}
+
+IAuthPolicySet::AuthStatus AuthECDHEPolicySet::encryption_decryption_enabled_client(ECDHESecurityContext * sc)
+{
+	if (sc->state != ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_DECRYPTION_CLIENT) {
+		LOG_ERR("Wrong state of policy");
+		sec_man->destroy_security_context(sc->id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	LOG_DBG("Encryption and decryption enabled for port-id: %d", sc->id);
+	sc->crypto_rx_enabled = true;
+	sc->crypto_tx_enabled = true;
+
+	try {
+		cdap_rib::flags_t flags;
+		cdap_rib::filt_info_t filt;
+		cdap_rib::obj_info_t obj_info;
+
+		obj_info.class_ = CLIENT_SIGNATURE;
+		obj_info.name_ = CLIENT_SIGNATURE;
+		obj_info.inst_ = 0;
+		sc->signature.get_seralized_object(obj_info.value_);
+
+		rib_daemon->remote_write(sc->con, obj_info, flags, filt, NULL);
+	} catch (Exception &e) {
+		LOG_ERR("Problems encoding and sending CDAP message: %s", e.what());
+		sec_man->destroy_security_context(sc->id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	sc->state = ECDHESecurityContext::DONE;
+	return IAuthPolicySet::SUCCESSFULL;
+}
+
+static bool waits_client_signature(ECDHESecurityContext * sc)
+{
+	return sc->state == ECDHESecurityContext::WAIT_CLIENT_SIGNATURE ||
+		sc->state == ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_SERVER;
+}
+
+int AuthECDHEPolicySet::process_client_signature_message(const cdap::CDAPMessage& message,
+							 int session_id)
+{
+	ECDHESecurityContext * sc;
+	UcharArray signed_data;
+	EVP_PKEY * peer_auth_key;
+	bool verified;
+
+	if (message.obj_value_.message_ == 0) {
+		LOG_ERR("Null object value");
+		return IAuthPolicySet::FAILED;
+	}
+
+	{
+		ScopedLock sc_lock(lock);
+
+		sc = dynamic_cast<ECDHESecurityContext *>(sec_man->get_security_context(session_id));
+		if (!sc) {
+			LOG_ERR("Could not retrieve Security Context for session: %d", session_id);
+			return IAuthPolicySet::FAILED;
+		}
+
+		if (!waits_client_signature(sc)) {
+			return wrong_state(sc);
+		}
+
+		// The kernel may enable encryption meanwhile, so verify with
+		// a copy of what the signature covers and a reference to the key
+		exchange_hash_input(sc, "C", signed_data);
+		peer_auth_key = sc->peer_auth_key;
+		EVP_PKEY_up_ref(peer_auth_key);
+	}
+
+	UcharArray signature(&message.obj_value_);
+	verified = ed25519_verify(peer_auth_key, signed_data, signature) == 0;
+	EVP_PKEY_free(peer_auth_key);
+
+	ScopedLock sc_lock(lock);
+
+	sc = dynamic_cast<ECDHESecurityContext *>(sec_man->get_security_context(session_id));
+	if (!sc) {
+		LOG_ERR("Security Context for session %d destroyed while "
+			"verifying the client signature", session_id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	if (!verified) {
+		LOG_ERR("Wrong signature of the exchange from %s",
+			sc->peer_ap_name.c_str());
+		sec_man->destroy_security_context(session_id);
+		return IAuthPolicySet::FAILED;
+	}
+
+	if (!waits_client_signature(sc)) {
+		return wrong_state(sc);
+	}
+
+	LOG_INFO("Remote peer successfully authenticated");
+
+	// Still waiting for encryption to be enabled, finish there
+	if (sc->state == ECDHESecurityContext::REQUESTED_ENABLE_ENCRYPTION_SERVER) {
+		sc->peer_authenticated = true;
+		return IAuthPolicySet::IN_PROGRESS;
+	}
+
+	sc->state = ECDHESecurityContext::DONE;
+	return IAuthPolicySet::SUCCESSFULL;
+}
+
+int AuthECDHEPolicySet::set_policy_set_param(const std::string& name,
+					     const std::string& value)
+{
+	int size;
+
+	if (name == KEY_POOL_SIZE) {
+		size = atoi(value.c_str());
+		if (size < 0) {
+			LOG_ERR("Invalid key pool size: %s", value.c_str());
+			return -1;
+		}
+		key_pool.resize(size);
+		LOG_DBG("X25519 key pool size set to %d", size);
+		return 0;
+	}
+
+	LOG_DBG("Unknown policy-set-specific parameter to set (%s, %s)",
+		name.c_str(), value.c_str());
+	return -1;
+}
+
+}
+
+#endif
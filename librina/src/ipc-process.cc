@@ -24,6 +24,11 @@
 #include <ostream>
 #include <sstream>
 #include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 
 #define RINA_PREFIX "librina.ipc-process"
 
@@ -1221,6 +1226,21 @@ void ReadManagementSDUResult::setPortId(int portId) {
 }
 
 /* CLASS KERNEL IPC PROCESS */
+KernelIPCProcess::KernelIPCProcess()
+{
+        ipcProcessId = 0;
+        mgmtFd = -1;
+        mgmtStopFd = -1;
+}
+
+KernelIPCProcess::~KernelIPCProcess()
+{
+        if (mgmtFd >= 0)
+                close(mgmtFd);
+        if (mgmtStopFd >= 0)
+                close(mgmtStopFd);
+}
+
 void KernelIPCProcess::setIPCProcessId(unsigned short ipcProcessId) {
         this->ipcProcessId = ipcProcessId;
 }
@@ -1634,6 +1654,24 @@ unsigned int KernelIPCProcess::writeMgmgtSDUToPortId(void * sdu,
 #else
         struct irati_kmsg_ipcp_mgmt_sdu * msg;
 
+        if (mgmtFd >= 0) {
+                struct irati_mgmt_sdu_hdr hdr;
+                struct iovec iov[2];
+
+                /* No padding needed after the last SDU of a write */
+                hdr.port_id = portId;
+                hdr.size = size;
+                iov[0].iov_base = &hdr;
+                iov[0].iov_len = sizeof(hdr);
+                iov[1].iov_base = sdu;
+                iov[1].iov_len = size;
+                if (writev(mgmtFd, iov, 2) < 0) {
+                        throw IPCException("Problems writing management SDU");
+                }
+
+                return 0;
+        }
+
         msg = new irati_kmsg_ipcp_mgmt_sdu();
         msg->msg_type = RINA_C_IPCP_MANAGEMENT_SDU_WRITE_REQUEST;
         msg->sdu = new buffer();
@@ -1657,8 +1695,119 @@ unsigned int KernelIPCProcess::writeMgmgtSDUToPortId(void * sdu,
 	return seqNum;
 }
 
+int KernelIPCProcess::openMgmtSDUChannel()
+{
+#if STUB_API
+        return -1;
+#else
+        if (mgmtFd < 0)
+                mgmtFd = irati_open_mgmt_port(ipcProcessId);
+
+        if (mgmtFd >= 0 && mgmtStopFd < 0) {
+                mgmtStopFd = eventfd(0, EFD_CLOEXEC);
+                if (mgmtStopFd < 0) {
+                        LOG_ERR("Cannot create the management SDU channel "
+                                "stop eventfd: %s", strerror(errno));
+                        close(mgmtFd);
+                        mgmtFd = -1;
+                }
+        }
+
+        return mgmtFd;
+#endif
+}
+
+int KernelIPCProcess::readMgmtSDUs(unsigned char * buf, int size)
+{
+        struct pollfd fds[2];
+        int ret;
+
+        if (mgmtFd < 0)
+                return -1;
+
+        fds[0].fd = mgmtFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = mgmtStopFd;
+        fds[1].events = POLLIN;
+
+        for (;;) {
+                ret = poll(fds, 2, -1);
+                if (ret < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return ret;
+                }
+
+                if (fds[1].revents)
+                        return 0;
+
+                ret = read(mgmtFd, buf, size);
+                if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+                        continue;
+
+                return ret;
+        }
+}
+
+void KernelIPCProcess::stopMgmtSDUReader()
+{
+        uint64_t one = 1;
+
+        if (mgmtStopFd < 0)
+                return;
+
+        if (write(mgmtStopFd, &one, sizeof(one)) != sizeof(one))
+                LOG_ERR("Cannot wake up the management SDU channel reader");
+}
+
 Singleton<KernelIPCProcess> kernelIPCProcess;
 
+/* CLASS MGMT SDU BATCH */
+MgmtSDUBatch::MgmtSDUBatch(const unsigned char * b, int s)
+{
+        buf = b;
+        size = s;
+        offset = 0;
+}
+
+bool MgmtSDUBatch::next(unsigned int& portId, const unsigned char *& sdu,
+                        int& sduSize)
+{
+        struct irati_mgmt_sdu_hdr hdr;
+
+        if (offset + (int) sizeof(hdr) > size)
+                return false;
+
+        memcpy(&hdr, buf + offset, sizeof(hdr));
+        if (hdr.size > size - offset - sizeof(hdr))
+                return false;
+
+        portId = hdr.port_id;
+        sdu = buf + offset + sizeof(hdr);
+        sduSize = hdr.size;
+        offset += IRATI_MGMT_SDU_LEN(hdr.size);
+
+        return true;
+}
+
+bool MgmtSDUBatch::append(unsigned char * buf, int bufSize, int& offset,
+                          unsigned int portId, const void * sdu, int size)
+{
+        struct irati_mgmt_sdu_hdr hdr;
+        int len = IRATI_MGMT_SDU_LEN(size);
+
+        if (offset + len > bufSize)
+                return false;
+
+        hdr.port_id = portId;
+        hdr.size = size;
+        memcpy(buf + offset, &hdr, sizeof(hdr));
+        memcpy(buf + offset + sizeof(hdr), sdu, size);
+        offset += len;
+
+        return true;
+}
+
 // CLASS DirectoryForwardingTableEntry
 DirectoryForwardingTableEntry::DirectoryForwardingTableEntry() {
 	address_ = 0;
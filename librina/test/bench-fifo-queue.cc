@@ -0,0 +1,208 @@
+//
+// Benchmark of rina::BlockingFIFOQueue
+//
+// Producer threads put timestamped items into a queue drained by consumer
+// threads, for 1 to 16 producers. For each run it prints the throughput
+// and the put-to-take latency percentiles of:
+//
+//  - the lock-free BlockingFIFOQueue
+//  - the previous implementation (std::list plus a condition variable),
+//    kept here for comparison
+//
+//    bench-fifo-queue [items-per-producer] [consumers]
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+
+#include "librina/concurrency.h"
+
+using namespace rina;
+
+#define ITEMS_DEFAULT		200000
+#define CONSUMERS_DEFAULT	1
+#define MAX_PRODUCERS		16
+
+static unsigned long long now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct Item {
+	unsigned long long put_ns;
+};
+
+// The queue as it was before, a std::list guarded by a condition variable
+template <class T> class LegacyQueue: public ConditionVariable {
+public:
+	void put(T * element) {
+		lock();
+		queue.push_back(element);
+		if (queue.size() == 1)
+			broadcast();
+		unlock();
+	}
+
+	T * take() {
+		T * result;
+
+		lock();
+		while (queue.size() == 0)
+			doWait();
+		result = queue.front();
+		queue.pop_front();
+		unlock();
+
+		return result;
+	}
+
+private:
+	std::list<T*> queue;
+};
+
+template <class Q> struct Run {
+	Q * queue;
+	unsigned int items;
+	unsigned int producers;
+	unsigned int consumers;
+	Item * pool;
+	std::vector<unsigned long long> * lat;
+	unsigned int next_consumer;
+	pthread_mutex_t lock;
+};
+
+template <class Q> void * producer(void * arg)
+{
+	Run<Q> * r = (Run<Q> *) ((void **) arg)[0];
+	unsigned long id = (unsigned long) ((void **) arg)[1];
+	Item * items = r->pool + id * r->items;
+
+	for (unsigned int i = 0; i < r->items; i++) {
+		items[i].put_ns = now_ns();
+		r->queue->put(&items[i]);
+	}
+
+	return 0;
+}
+
+template <class Q> void * consumer(void * arg)
+{
+	Run<Q> * r = (Run<Q> *) arg;
+	std::vector<unsigned long long> * lat;
+	unsigned int id, total;
+	Item * item;
+
+	pthread_mutex_lock(&r->lock);
+	id = r->next_consumer++;
+	pthread_mutex_unlock(&r->lock);
+
+	lat = &r->lat[id];
+	// Items are split evenly, the first consumer takes the remainder
+	total = r->items * r->producers;
+	total = total / r->consumers + (id ? 0 : total % r->consumers);
+	for (unsigned int i = 0; i < total; i++) {
+		item = r->queue->take();
+		lat->push_back(now_ns() - item->put_ns);
+	}
+
+	return 0;
+}
+
+template <class Q> void run(const char * name, unsigned int items,
+			    unsigned int producers, unsigned int consumers)
+{
+	std::vector<unsigned long long> all;
+	std::vector<pthread_t> pt(producers), ct(consumers);
+	std::vector<void *> args(2 * producers);
+	unsigned long long t0, t;
+	Run<Q> r;
+
+	r.queue = new Q();
+	r.items = items;
+	r.producers = producers;
+	r.consumers = consumers;
+	r.pool = new Item[items * producers];
+	r.lat = new std::vector<unsigned long long>[consumers];
+	r.next_consumer = 0;
+	pthread_mutex_init(&r.lock, 0);
+	for (unsigned int i = 0; i < consumers; i++)
+		r.lat[i].reserve(items * producers / consumers + items);
+
+	t0 = now_ns();
+	for (unsigned int i = 0; i < consumers; i++)
+		pthread_create(&ct[i], 0, consumer<Q>, &r);
+	for (unsigned long i = 0; i < producers; i++) {
+		args[2 * i] = &r;
+		args[2 * i + 1] = (void *) i;
+		pthread_create(&pt[i], 0, producer<Q>, &args[2 * i]);
+	}
+	for (unsigned int i = 0; i < producers; i++)
+		pthread_join(pt[i], 0);
+	for (unsigned int i = 0; i < consumers; i++)
+		pthread_join(ct[i], 0);
+	t = now_ns() - t0;
+
+	for (unsigned int i = 0; i < consumers; i++)
+		all.insert(all.end(), r.lat[i].begin(), r.lat[i].end());
+	std::sort(all.begin(), all.end());
+
+	std::cout << "    " << name << ": "
+		  << all.size() * 1000000000ULL / (t ? t : 1) << " items/s"
+		  << ", latency p50 " << all[all.size() / 2] / 1000
+		  << " us, p99 " << all[all.size() * 99 / 100] / 1000
+		  << " us, p99.9 " << all[all.size() * 999 / 1000] / 1000
+		  << " us, max " << all.back() / 1000 << " us" << std::endl;
+
+	pthread_mutex_destroy(&r.lock);
+	delete[] r.lat;
+	delete[] r.pool;
+	delete r.queue;
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int items = ITEMS_DEFAULT;
+	unsigned int consumers = CONSUMERS_DEFAULT;
+
+	if (argc > 1)
+		items = atoi(argv[1]);
+	if (argc > 2)
+		consumers = atoi(argv[2]);
+	if (!items || !consumers) {
+		std::cerr << "Bad number of items or consumers" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	for (unsigned int p = 1; p <= MAX_PRODUCERS; p *= 2) {
+		std::cout << p << " producers, " << consumers << " consumers, "
+			  << items << " items per producer" << std::endl;
+		run<BlockingFIFOQueue<Item> >("lock-free   ", items, p,
+					      consumers);
+		run<LegacyQueue<Item> >("list+condvar", items, p, consumers);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+//
+// Benchmark of the delivery of management SDUs to the IPCP daemon
+//
+// Measures the management SDUs per second that the user space side can
+// take in through the two paths the kernel offers:
+//
+//  - control messages: one RINA_C_IPCP_MANAGEMENT_SDU_READ_NOTIF per SDU,
+//    serialized, deserialized and turned into a ReadMgmtSDUResponseEvent
+//    (plus one read() of the control device per SDU, not measured here)
+//  - management SDU channel: SDUs laid out back to back in a batch as the
+//    kernel read() does, walked with MgmtSDUBatch and lent to the CDAP
+//    provider without copies (one read() per batch)
+//
+//    bench-mgmt-sdu [num-sdus] [sdu-size]
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <time.h>
+
+#include "irati/serdes-utils.h"
+#include "irati/kernel-msg.h"
+#include "ctrl.h"
+#include "librina/ipc-process.h"
+
+using namespace rina;
+
+#define NUM_SDUS_DEFAULT	200000
+#define SDU_SIZE_DEFAULT	200
+#define BATCH_SIZE		(64 * 1024)
+#define NUM_PORTS		16
+
+static unsigned long long now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fill_sdu(unsigned char * sdu, int size, unsigned int i)
+{
+	for (int j = 0; j < size; j++)
+		sdu[j] = (unsigned char) (i + j);
+}
+
+// Returns a checksum of what the daemon got, or 0 on error
+static unsigned long long ctrl_path(unsigned int num_sdus, int sdu_size)
+{
+	struct irati_kmsg_ipcp_mgmt_sdu * msg, * resp;
+	ReadMgmtSDUResponseEvent * event;
+	unsigned long long sum = 0;
+	char * serbuf;
+	int serlen;
+
+	serbuf = new char[sdu_size + 1024];
+
+	for (unsigned int i = 0; i < num_sdus; i++) {
+		// Kernel side
+		msg = new irati_kmsg_ipcp_mgmt_sdu();
+		msg->msg_type = RINA_C_IPCP_MANAGEMENT_SDU_READ_NOTIF;
+		msg->port_id = i % NUM_PORTS;
+		msg->sdu = new buffer();
+		msg->sdu->size = sdu_size;
+		msg->sdu->data = new unsigned char[sdu_size];
+		fill_sdu(msg->sdu->data, sdu_size, i);
+		serlen = serialize_irati_msg(irati_ker_numtables, RINA_C_MAX,
+					     serbuf, (irati_msg_base *) msg);
+		irati_ctrl_msg_free((irati_msg_base *) msg);
+		if (serlen <= 0)
+			break;
+
+		// User space side
+		resp = (struct irati_kmsg_ipcp_mgmt_sdu *)
+			deserialize_irati_msg(irati_ker_numtables, RINA_C_MAX,
+					      serbuf, serlen);
+		if (!resp)
+			break;
+		event = new ReadMgmtSDUResponseEvent(0, resp->sdu,
+						     resp->port_id, 0, 0, 0);
+		irati_ctrl_msg_free((irati_msg_base *) resp);
+
+		sum += event->port_id + event->msg.message_[event->msg.size_ - 1];
+		delete event;
+	}
+
+	delete[] serbuf;
+
+	return sum;
+}
+
+static unsigned long long channel_path(unsigned int num_sdus, int sdu_size,
+				       unsigned int& batches)
+{
+	unsigned char * batch = new unsigned char[BATCH_SIZE];
+	unsigned char * sdu = new unsigned char[sdu_size];
+	unsigned long long sum = 0;
+	const unsigned char * p;
+	unsigned int i = 0, port_id;
+	ser_obj_t message;
+	int offset, size;
+
+	batches = 0;
+	while (i < num_sdus) {
+		// Kernel side: as many SDUs as fit in the read() buffer
+		offset = 0;
+		for (; i < num_sdus; i++) {
+			fill_sdu(sdu, sdu_size, i);
+			if (!MgmtSDUBatch::append(batch, BATCH_SIZE, offset,
+						  i % NUM_PORTS, sdu, sdu_size))
+				break;
+		}
+		if (!offset)
+			break;
+		batches++;
+
+		// User space side
+		MgmtSDUBatch b(batch, offset);
+		while (b.next(port_id, p, size)) {
+			message.message_ = const_cast<unsigned char *>(p);
+			message.size_ = size;
+			sum += port_id + message.message_[message.size_ - 1];
+			message.message_ = 0;
+		}
+	}
+
+	delete[] sdu;
+	delete[] batch;
+
+	return sum;
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int num_sdus = NUM_SDUS_DEFAULT;
+	int sdu_size = SDU_SIZE_DEFAULT;
+	unsigned long long t0, t_ctrl, t_chan, s_ctrl, s_chan;
+	unsigned int batches;
+
+	if (argc > 1)
+		num_sdus = atoi(argv[1]);
+	if (argc > 2)
+		sdu_size = atoi(argv[2]);
+	if (!num_sdus || sdu_size <= 0 ||
+			IRATI_MGMT_SDU_LEN(sdu_size) > BATCH_SIZE) {
+		std::cerr << "Bad number of SDUs or SDU size" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	t0 = now_ns();
+	s_ctrl = ctrl_path(num_sdus, sdu_size);
+	t_ctrl = now_ns() - t0;
+
+	t0 = now_ns();
+	s_chan = channel_path(num_sdus, sdu_size, batches);
+	t_chan = now_ns() - t0;
+
+	if (s_ctrl != s_chan) {
+		std::cerr << "Control messages and channel delivered different "
+			  << "SDUs" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << num_sdus << " management SDUs of " << sdu_size
+		  << " bytes" << std::endl;
+	std::cout << "    control messages: "
+		  << num_sdus * 1000000000ULL / (t_ctrl ? t_ctrl : 1)
+		  << " SDUs/s, " << num_sdus << " reads" << std::endl;
+	std::cout << "    channel:          "
+		  << num_sdus * 1000000000ULL / (t_chan ? t_chan : 1)
+		  << " SDUs/s, " << batches << " reads" << std::endl;
+
+	return EXIT_SUCCESS;
+}
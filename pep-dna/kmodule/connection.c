@@ -35,8 +35,88 @@
 #endif
 
 #include <linux/sched.h>	/* included for wait_event_interruptible_timeout */
+#include <linux/slab.h>		/* included for kmem_cache */
+#include <linux/workqueue.h>	/* included for the release workqueue */
 #include <net/sock.h>		/* included for struct sock */
 
+static struct kmem_cache *pepdna_con_cache __read_mostly;
+/* Runs pepdna_con_release_work(), see pepdna_con_kref_release() */
+static struct workqueue_struct *pepdna_con_release_wq __read_mostly;
+
+static const struct rhashtable_params pepdna_con_rht_params = {
+	.key_len		= sizeof(u32),
+	.key_offset		= offsetof(struct pepdna_con, id),
+	.head_offset		= offsetof(struct pepdna_con, node),
+	.nelem_hint		= 1 << PEPDNA_HASH_BITS,
+	.automatic_shrinking	= true,
+};
+
+/*
+ * Create the connection table and the connection slab cache
+ * This function is called by pepdna_server_start() @'server.c'
+ * ------------------------------------------------------------------------- */
+int pepdna_con_table_init(struct pepdna_server *srv)
+{
+	int rc = 0;
+
+	pepdna_con_cache = kmem_cache_create("pepdna_con",
+					     sizeof(struct pepdna_con), 0,
+					     SLAB_HWCACHE_ALIGN, NULL);
+	if (!pepdna_con_cache)
+		return -ENOMEM;
+
+	pepdna_con_release_wq = alloc_workqueue("con_release_wq", WQ_UNBOUND,
+						0);
+	if (!pepdna_con_release_wq) {
+		rc = -ENOMEM;
+		goto err_cache;
+	}
+
+	rc = rhashtable_init(&srv->htable, &pepdna_con_rht_params);
+	if (rc < 0)
+		goto err_wq;
+
+	return 0;
+
+err_wq:
+	destroy_workqueue(pepdna_con_release_wq);
+	pepdna_con_release_wq = NULL;
+err_cache:
+	kmem_cache_destroy(pepdna_con_cache);
+	pepdna_con_cache = NULL;
+	return rc;
+}
+
+/*
+ * Destroy the connection table and the connection slab cache
+ * All connections must have been closed before.
+ * This function is called by pepdna_server_stop() @'server.c'
+ * ------------------------------------------------------------------------- */
+void pepdna_con_table_destroy(struct pepdna_server *srv)
+{
+	/* Connections whose last reference is gone leave the table here */
+	flush_workqueue(pepdna_con_release_wq);
+	destroy_workqueue(pepdna_con_release_wq);
+	pepdna_con_release_wq = NULL;
+
+	rhashtable_destroy(&srv->htable);
+
+	/* Wait for the pending pepdna_con_free_rcu() callbacks */
+	rcu_barrier();
+	kmem_cache_destroy(pepdna_con_cache);
+	pepdna_con_cache = NULL;
+}
+
+/*
+ * Return the connection instance to the slab cache
+ * ------------------------------------------------------------------------- */
+static void pepdna_con_free_rcu(struct rcu_head *head)
+{
+	struct pepdna_con *con = container_of(head, struct pepdna_con, rcu);
+
+	kmem_cache_free(pepdna_con_cache, con);
+}
+
 
 /*
  * Check if left connection is active
@@ -61,7 +141,8 @@ bool rconnected(struct pepdna_con *con)
 struct pepdna_con *pepdna_con_alloc(struct syn_tuple *syn, struct sk_buff *skb,
 				    uint32_t hash_id, uint64_t ts, int port_id)
 {
-	struct pepdna_con *con = kzalloc(sizeof(struct pepdna_con), GFP_ATOMIC);
+	struct pepdna_con *con = kmem_cache_zalloc(pepdna_con_cache,
+						   GFP_ATOMIC);
 	if (!con)
 		return NULL;
 
@@ -122,7 +203,7 @@ struct pepdna_con *pepdna_con_alloc(struct syn_tuple *syn, struct sk_buff *skb,
 #endif
 	default:
 		pep_err("pepdna mode undefined");
-		return NULL;
+		goto err_free;
 	}
 
 	con->id = hash_id;
@@ -135,16 +216,15 @@ struct pepdna_con *pepdna_con_alloc(struct syn_tuple *syn, struct sk_buff *skb,
         con->next_seq = MINIP_FIRST_SEQ;
         atomic_set(&con->last_acked, MINIP_FIRST_SEQ);
         con->next_recv = MINIP_FIRST_SEQ;
-	con->window = WINDOW_SIZE;
+	skb_queue_head_init(&con->ooo);
+	minip_cc_init(con);
 
         /* Create the retransmission queue for MINIP flow control */
         con->rtxq = rtxq_create();
         if (!con->rtxq) {
                 pep_err("Failed to create rtxq instance");
-                kfree(con);
-                return NULL;
+                goto err_free;
         }
-	atomic_set(&con->sending, 1);
 	/* Initialize dup_acks counter to 0 */
         atomic_set(&con->dup_acks, 0);
 
@@ -156,9 +236,10 @@ struct pepdna_con *pepdna_con_alloc(struct syn_tuple *syn, struct sk_buff *skb,
 	con->rttvar = 0;
 
 	timer_setup(&con->timer, minip_sender_timeout, 0);
+	hrtimer_init(&con->pacing_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+	con->pacing_timer.function = minip_pacing_timeout;
 #endif
 	con->server = pepdna_srv;
-	atomic_inc(&con->server->conns);
 	con->lsock	= NULL;
 	con->rsock	= NULL;
 	atomic_set(&con->lflag, 0);
@@ -169,40 +250,63 @@ struct pepdna_con *pepdna_con_alloc(struct syn_tuple *syn, struct sk_buff *skb,
 	con->tuple.daddr  = syn->daddr;
 	con->tuple.dest	  = syn->dest;
 
-	INIT_HLIST_NODE(&con->hlist);
-	hash_add(pepdna_srv->htable, &con->hlist, con->id);
+	/* The table itself does not bound the number of elements */
+	if (atomic_inc_return(&pepdna_srv->conns) > MAX_CONNS) {
+		pep_err("too many connections, refusing %u", con->id);
+		goto err_conns;
+	}
+
+	/* A duplicate id is either a retransmitted request that raced with
+	 * the first one, or a 32-bit hash collision; refuse both. */
+	if (rhashtable_lookup_insert_fast(&pepdna_srv->htable, &con->node,
+					  pepdna_con_rht_params) < 0) {
+		pep_err("connection %u already in the table", con->id);
+		goto err_conns;
+	}
 
 	if (!queue_work(con->server->tcfa_wq, &con->tcfa_work)) {
 		pep_err("failed to queue tcfa_work");
+		/* Releases it, and takes it out of the table */
 		pepdna_con_put(con);
+		return NULL;
 	}
 
 	return con;
+
+err_conns:
+	atomic_dec(&pepdna_srv->conns);
+#ifdef CONFIG_PEPDNA_MINIP
+	rtxq_destroy(con->rtxq);
+#endif
+err_free:
+	if (con->skb)
+		kfree_skb(con->skb);
+	kmem_cache_free(pepdna_con_cache, con);
+	return NULL;
 }
 
 /*
- * Find connection in Hash Table
+ * Find connection in Hash Table and take a reference to it
+ * The caller must drop it with pepdna_con_put(). A connection whose last
+ * reference is gone is still in the table until its release removes it, it is
+ * skipped.
  * Called by: pepdna_tcp_accept() @'tcp_listen.c'
- *		  nl_r2i_callback() @'server.c'
+ *		  pepdna_pre_hook() @'server.c'
+ *		  nl_r2i_callback(), nl_i2r_callback() @'rina.c'
+ *		  MINIP receive path @'minip.c'
  * ------------------------------------------------------------------------- */
 struct pepdna_con *pepdna_con_find(uint32_t key)
 {
-	struct pepdna_con* con	 = NULL;
-	struct pepdna_con* found = NULL;
-	struct hlist_head *head	 = NULL;
-	struct hlist_node *next;
+	struct pepdna_con *con;
 
 	rcu_read_lock();
-	head = &pepdna_srv->htable[pepdna_hash(pepdna_srv->htable, key)];
-	hlist_for_each_entry_safe(con, next, head, hlist) {
-		if (con->id == key) {
-			found = con;
-			break;
-		}
-	}
+	con = rhashtable_lookup(&pepdna_srv->htable, &key,
+				pepdna_con_rht_params);
+	if (con && !kref_get_unless_zero(&con->kref))
+		con = NULL;
 	rcu_read_unlock();
 
-	return found;
+	return con;
 }
 
 /*
@@ -267,17 +371,20 @@ void pepdna_con_close(struct pepdna_con *con)
                 }
 #endif
 #ifdef CONFIG_PEPDNA_MINIP
+		/* lflag is 0: once a minip_send_quota() in progress is done,
+		 * the l2r work does not arm the pacing timer again */
+		spin_lock_bh(&con->rtxq->lock);
+		spin_unlock_bh(&con->rtxq->lock);
+
 		del_timer(&con->timer);
+		hrtimer_cancel(&con->pacing_timer);
 
                 if (rconnected) {
 			pep_dbg("Not ready to close the connection");
 			return;
-                } else {
-			if (rtxq_destroy(con->rtxq)) {
-				pep_err("failed to destroy MINIP rtxq queue");
-			}
-                        pep_dbg("destroyed MINIP rtxq queue");
                 }
+		/* The l2r work may still be running, the rtxq is destroyed
+		 * with its last reference in pepdna_con_kref_release() */
 #endif
         }
 err:
@@ -285,13 +392,12 @@ err:
 }
 
 /*
- * Release connection after pepdna_con_put(con) is called
+ * Release connection once its last reference is gone
  * ------------------------------------------------------------------------- */
-static void pepdna_con_kref_release(struct kref *kref)
+static void pepdna_con_release_work(struct work_struct *work)
 {
-	struct pepdna_con *con = container_of(kref, struct pepdna_con, kref);
-	if (!con)
-		return;
+	struct pepdna_con *con = container_of(work, struct pepdna_con,
+					      release_work);
 
 	if (con->lsock) {
 		sock_release(con->lsock);
@@ -301,15 +407,39 @@ static void pepdna_con_kref_release(struct kref *kref)
 		sock_release(con->rsock);
 		con->rsock = NULL;
 	}
+#ifdef CONFIG_PEPDNA_MINIP
+	/* Waits for a running minip_sender_timeout(), which does not arm the
+	 * timer again: lflag is clear, or nobody can ACK without a reference */
+	del_timer_sync(&con->timer);
+	hrtimer_cancel(&con->pacing_timer);
+	if (rtxq_destroy(con->rtxq))
+		pep_err("failed to destroy MINIP rtxq queue");
+	con->rtxq = NULL;
+	skb_queue_purge(&con->ooo);
+#endif
 
-	hlist_del(&con->hlist);
-        kfree(con);
+	rhashtable_remove_fast(&pepdna_srv->htable, &con->node,
+			       pepdna_con_rht_params);
+	call_rcu(&con->rcu, pepdna_con_free_rcu);
         con = NULL;
 
         pep_dbg("Freeing connection instance");
 	atomic_dec(&pepdna_srv->conns);
 }
 
+/*
+ * Called by pepdna_con_put(con) on the last reference. The NF hook and the
+ * MINIP receive path drop theirs in softirq, and sock_release() may sleep, so
+ * the release itself runs in pepdna_con_release_wq.
+ * ------------------------------------------------------------------------- */
+static void pepdna_con_kref_release(struct kref *kref)
+{
+	struct pepdna_con *con = container_of(kref, struct pepdna_con, kref);
+
+	INIT_WORK(&con->release_work, pepdna_con_release_work);
+	queue_work(pepdna_con_release_wq, &con->release_work);
+}
+
 /*
  * Release the reference of connection instance
  * ------------------------------------------------------------------------- */
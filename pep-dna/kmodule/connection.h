@@ -24,6 +24,7 @@
 
 #include <linux/kref.h>
 #include <linux/netfilter.h>
+#include <linux/rhashtable.h>
 
 #ifdef CONFIG_PEPDNA_RINA
 struct ipcp_flow;
@@ -33,9 +34,9 @@ struct ipcp_flow;
 /* timeout for TCP connection in msec */
 #define TCP_ACCEPT_TIMEOUT 3000
 
-#define pepdna_hash(T, K) hash_min(K, HASH_BITS(T))
-
 #ifdef CONFIG_PEPDNA_MINIP
+#include <linux/hrtimer.h>
+#include <linux/skbuff.h>
 struct rtxq;
 #endif
 
@@ -63,7 +64,9 @@ struct syn_tuple {
  * @tcfa_work:     TCP connect/RINA Flow Allocation after accept work item
  * @l2r_work:      left2right work item
  * @r2l_work:      right2left work item
- * @hlist:	   node member in hash table
+ * @release_work:  releases the connection after its last reference is gone
+ * @node:	   node member in the connection table
+ * @rcu:	   deferred free after the last RCU reader is gone
  * @flow:	   RINA flow
  * @port_id:       port id of the flow
  * @rtxq:          MINIP retransmission queue
@@ -71,7 +74,7 @@ struct syn_tuple {
  * @rsock:	   right TCP socket
  * @lflag:	   indicates left connection state
  * @rflag:	   indicates left connection state
- * @id:            32-bit hash connection identifier
+ * @id:            32-bit hash of the 4-tuple, key in the connection table
  * @ts:		   timestamp of the first incoming SYN
  * @tuple:	   connection tuple
  * @skb:	   initial SYN sk_buff
@@ -82,7 +85,9 @@ struct pepdna_con {
 	struct work_struct tcfa_work;
 	struct work_struct l2r_work;
 	struct work_struct r2l_work;
-	struct hlist_node hlist;
+	struct work_struct release_work;
+	struct rhash_head node;
+	struct rcu_head rcu;
 #ifdef CONFIG_PEPDNA_RINA
 	struct ipcp_flow *flow;
 	atomic_t port_id;
@@ -93,21 +98,31 @@ struct pepdna_con {
 	struct rtxq *rtxq;
 	/** @timer: timer for RTO */
 	struct timer_list timer;
+	/** @pacing_timer: releases the next paced packets */
+	struct hrtimer pacing_timer;
 	/** @dup_acks: duplicate ACKs counter */
 	atomic_t dup_acks;
-	/** @sending: sending binary semaphore: 1 if sending, 0 is not */
-	atomic_t sending;
 	 /** @last_acked: last acked packet */
 	atomic_t last_acked;
 	/** @next_seq: next packet to be sent */
         u32 next_seq;
 	/** @state: connection state */
         u8 state;
-	/** @window: congestion window */
-        u8 window;
+	/** @cwnd: congestion window in packets */
+	u32 cwnd;
+	/** @ssthresh: slow start threshold in packets */
+	u32 ssthresh;
+	/** @cwnd_cnt: packets acked since the last increase in cong. avoidance */
+	u32 cwnd_cnt;
+	/** @recovery_point: next_seq when loss recovery started */
+	u32 recovery_point;
+	/** @pacing_next_ns: earliest time to send new data, 0 if not paced */
+	u64 pacing_next_ns;
 	/* receiver variables */
 	/** @next_recv: next in-order packet expected */
 	u32 next_recv;
+	/** @ooo: out-of-order packets received, sorted by seqno */
+	struct sk_buff_head ooo;
         	/** @rto: sender timeout in milliseconds */
 	u32 rto;
 	/** @srtt: smoothed RTT scaled by 2^3 */
@@ -125,6 +140,8 @@ struct pepdna_con {
 	struct sk_buff *skb;
 };
 
+int  pepdna_con_table_init(struct pepdna_server *);
+void pepdna_con_table_destroy(struct pepdna_server *);
 bool lconnected(struct pepdna_con *);
 bool rconnected(struct pepdna_con *);
 struct pepdna_con *pepdna_con_find(u32);
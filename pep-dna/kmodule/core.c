@@ -20,6 +20,9 @@
 #include "core.h"
 #include "server.h"
 #include "tcp_utils.h"
+#ifdef CONFIG_PEPDNA_MINIP
+#include "minip.h"
+#endif
 
 #include <linux/module.h>
 #include <linux/kernel.h>
@@ -47,6 +50,9 @@ MODULE_PARM_DESC(macstr, "Ethernet MAC address of the peer PEP-DNA");
 
 int sysctl_pepdna_sock_rmem[3] __read_mostly;	    /* min/default/max */
 int sysctl_pepdna_sock_wmem[3] __read_mostly;	    /* min/default/max */
+#ifdef CONFIG_PEPDNA_MINIP
+int sysctl_pepdna_minip_window[2] __read_mostly;    /* min/max in packets */
+#endif
 
 static const char* get_mode_name(void)
 {
@@ -86,6 +92,11 @@ static int __init pepdna_init(void)
 	sysctl_pepdna_sock_wmem[1] = SNDBUF_DEF;
 	sysctl_pepdna_sock_wmem[2] = SNDBUF_MAX;
 
+#ifdef CONFIG_PEPDNA_MINIP
+	sysctl_pepdna_minip_window[0] = MINIP_MIN_WINDOW;
+	sysctl_pepdna_minip_window[1] = MINIP_MAX_WINDOW;
+#endif
+
 	rc = pepdna_register_sysctl();
 	if (rc) {
 		pep_err("Unable to register sysctl");
@@ -29,6 +29,9 @@
 
 extern int sysctl_pepdna_sock_rmem[3] __read_mostly;
 extern int sysctl_pepdna_sock_wmem[3] __read_mostly;
+#ifdef CONFIG_PEPDNA_MINIP
+extern int sysctl_pepdna_minip_window[2] __read_mostly;
+#endif
 
 #ifdef CONFIG_PEPDNA_DEBUG
 #define pep_dbg(fmt, args...) pr_debug("pepdna[DBG] %s() [%d]: " fmt"\n", \
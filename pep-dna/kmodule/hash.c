@@ -19,22 +19,25 @@
 
 #include "hash.h"
 #include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/net.h>          /* included for net_get_random_once */
+
+static u32 pepdna_hash_seed __read_mostly;
 
 /*
- * Generate hash key for (scr_ip, src_port)
+ * Generate hash key for the (saddr, source, daddr, dest) 4-tuple
+ *
+ * The seed is random and drawn on first use, so that the identifiers, and
+ * with them the connection table buckets, cannot be predicted from outside.
+ * The identifier is local to this node; peers that need to agree on it, as
+ * MINIP does, carry it in their messages instead of recomputing it.
  * ------------------------------------------------------------------------- */
-__u32 pepdna_hash32_rjenkins1_2(__be32 src_ip, __be16 src_port)
+__u32 pepdna_hash32_tuple(__be32 saddr, __be16 source, __be32 daddr,
+                          __be16 dest)
 {
-        __u32 a   = be32_to_cpu(src_ip);
-        __be32 sp = src_port;
-        __u32 b   = be32_to_cpu(sp);
-
-        __u32 hash = pepdna_hash_seed ^ a ^ b;
-        __u32 x = 231232;
-        __u32 y = 1232;
-        pepdna_hashmix(a, b, hash);
-        pepdna_hashmix(x, a, hash);
-        pepdna_hashmix(b, y, hash);
+        net_get_random_once(&pepdna_hash_seed, sizeof(pepdna_hash_seed));
 
-        return hash;
+        return jhash_3words((__force u32)saddr, (__force u32)daddr,
+                            ((__force u32)source << 16) | (__force u32)dest,
+                            pepdna_hash_seed);
 }
@@ -22,20 +22,6 @@
 
 #include <linux/types.h>        /* types __u32, _be32, etc. */
 
-#define pepdna_hashmix(a, b, c) do {        \
-        a = a-b;  a = a-c;  a = a^(c>>13);  \
-        b = b-c;  b = b-a;  b = b^(a<<8);   \
-        c = c-a;  c = c-b;  c = c^(b>>13);  \
-        a = a-b;  a = a-c;  a = a^(c>>12);  \
-        b = b-c;  b = b-a;  b = b^(a<<16);  \
-        c = c-a;  c = c-b;  c = c^(b>>5);   \
-        a = a-b;  a = a-c;  a = a^(c>>3);   \
-        b = b-c;  b = b-a;  b = b^(a<<10);  \
-        c = c-a;  c = c-b;  c = c^(b>>15);  \
-} while (0)
-
-#define pepdna_hash_seed 1315423911
-
-__u32 pepdna_hash32_rjenkins1_2(__be32, __be16);
+__u32 pepdna_hash32_tuple(__be32, __be16, __be32, __be16);
 
 #endif /* _PEPDNA_HASH_H */
@@ -1,6 +1,7 @@
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/math64.h>
 
 #include "minip.h"
 #include "core.h"
@@ -34,143 +35,179 @@ static u32 skb_seq_get(struct sk_buff *skb)
 	return ntohl(hdr->seq);
 }
 
-static u32 rtxq_size(struct pepdna_con *con)
+static inline struct rtxq_entry *rtxqueue_entry(struct rtxqueue *q, u32 seq)
 {
-	return (u32)con->rtxq->queue->len;
+	return &q->ring[seq & (MINIP_RTXQ_SIZE - 1)];
 }
 
-static int rtxq_entry_destroy(struct rtxq_entry *entry)
+/* Packets in flight, as the pipe of RFC6675: the outstanding ones which are
+ * neither SACKed nor lost, plus the retransmitted ones. Called with the
+ * rtxq lock held */
+static u32 rtxqueue_pipe(struct rtxqueue *q)
 {
-	if (!entry) {
-		pep_dbg("Entry to be destroyed not found in rtx queue");
-		return -1;
-	}
-
-	if (skb_unref(entry->skb)) {
-		pep_dbg("Decrementing and freeing skb now");
-		kfree_skb(entry->skb);
-	}
-	list_del(&entry->next);
-	kfree(entry);
+	return (q->nxt - q->una) - q->sacked - q->lost + q->retrans;
+}
 
-	return 0;
+static void rtxq_entry_release(struct rtxqueue *q, struct rtxq_entry *entry)
+{
+	if (entry->flags & MINIP_RTXQ_SACKED)
+		q->sacked--;
+	if (entry->flags & MINIP_RTXQ_LOST)
+		q->lost--;
+	if (entry->flags & MINIP_RTXQ_RETRANS)
+		q->retrans--;
+
+	kfree_skb(entry->skb);
+	entry->skb = NULL;
+	entry->flags = 0;
+	entry->retries = 0;
 }
 
+/* Release the entries cumulatively acked by @ack, return how many */
 static int rtxqueue_entries_ack(struct rtxqueue *q, u32 ack)
 {
-	struct rtxq_entry *cur, *n;
 	int credit = 0;
-	u32 seq;
 
-	list_for_each_entry_safe(cur, n, &q->head, next) {
-		seq = skb_seq_get(cur->skb);
-		if (seq >= ack)
-			break;
-		pep_dbg("Seq num acked: %u. rtxq size %d", seq, q->len);
-		if (rtxq_entry_destroy(cur)) {
-			pep_dbg("Failed to delete seq %u from rtxq", seq);
-			credit = -1;
-			break;
-		}
-		pep_dbg("Deleted seq %u from rtxq", seq);
-		q->len--;
+	if (!minip_before(q->una, ack))
+		return 0;
+	if (minip_before(q->nxt, ack)) {
+		pep_dbg("ACK %u acks unsent data (nxt %u)", ack, q->nxt);
+		ack = q->nxt;
+	}
+
+	while (q->una != ack) {
+		rtxq_entry_release(q, rtxqueue_entry(q, q->una));
+		pep_dbg("Seq num acked: %u", q->una);
+		q->una++;
 		credit++;
 	}
 
 	return credit;
 }
 
-static int rtxq_entry_rtx(struct rtxq_entry *entry, u32 seq)
+/* Mark [start, end) as received by the peer, return how many were new.
+ * The receiver never drops what it has SACKed, so the skbs go right away. */
+static int rtxqueue_entries_sack(struct rtxqueue *q, u32 start, u32 end)
 {
-	if (entry->retries < MAX_MINIP_RETRY) {
-		struct minip_hdr *hdr;
-
-		hdr = (struct minip_hdr *)skb_network_header(entry->skb);
-		hdr->ts = htonl(jiffies_to_msecs(jiffies));
-		entry->retries++;
-		skb_get(entry->skb); // bump the ref count
-		return dev_queue_xmit(entry->skb);
-	} else {
-		pep_err("Max MINIP retransmissions reached for seq %u", seq);
+	struct rtxq_entry *entry;
+	int sacked = 0;
+	u32 seq;
 
-		return -1;
-	}
-}
+	if (minip_before(start, q->una))
+		start = q->una;
+	if (minip_before(q->nxt, end))
+		end = q->nxt;
 
-static int rtxqueue_entries_rtx(struct rtxqueue *q, u32 ack)
-{
-	struct rtxq_entry *cur, *n;
-	u32 seq;
+	for (seq = start; minip_before(seq, end); seq++) {
+		entry = rtxqueue_entry(q, seq);
+		if (entry->flags & MINIP_RTXQ_SACKED)
+			continue;
 
-	list_for_each_entry_safe(cur, n, &q->head, next) {
-		seq = skb_seq_get(cur->skb);
-		if (seq >= ack) {
-			if (rtxq_entry_rtx(cur, seq) < 0) {
-				pep_dbg("Failed to rtx seq %u", seq);
-				return -1;
-			}
-			pep_dbg("Retransmitted seq %u", seq);
-		}
+		rtxq_entry_release(q, entry);
+		entry->flags = MINIP_RTXQ_SACKED;
+		q->sacked++;
+		sacked++;
 	}
 
-	return 0;
+	/* high_sacked is stale once everything SACKed got cumulatively acked */
+	if (sacked && (minip_before(q->high_sacked, q->una) ||
+		       minip_before(q->high_sacked, end - 1)))
+		q->high_sacked = end - 1;
+
+	return sacked;
 }
 
-int rtxq_full_rtx(struct rtxq * q, u32 ack)
+/* Mark as lost the holes with at least MINIP_DUPTHRESH SACKed packets above
+ * them; with @dupthresh the oldest outstanding one is lost in any case */
+static void rtxqueue_mark_lost(struct rtxqueue *q, bool dupthresh)
 {
-	if (!q)
-		return -1;
+	struct rtxq_entry *entry;
+	u32 above = q->sacked;
+	u32 seq;
 
-	if (rtxqueue_entries_rtx(q->queue, ack) < 0)
-		return -1;
+	if (q->una == q->nxt)
+		return;
 
-	return 0;
+	entry = rtxqueue_entry(q, q->una);
+	if (dupthresh && !entry->flags) {
+		entry->flags = MINIP_RTXQ_LOST;
+		q->lost++;
+	}
+
+	for (seq = q->una; above >= MINIP_DUPTHRESH &&
+		     minip_before(seq, q->high_sacked); seq++) {
+		entry = rtxqueue_entry(q, seq);
+		if (entry->flags & MINIP_RTXQ_SACKED) {
+			above--;
+			continue;
+		}
+		if (!(entry->flags & MINIP_RTXQ_LOST)) {
+			entry->flags |= MINIP_RTXQ_LOST;
+			q->lost++;
+		}
+	}
 }
 
-static int rtxqueue_fast_rtx(struct rtxqueue *q, u32 ack)
+/* After a timeout everything outstanding and not SACKed is lost */
+static void rtxqueue_mark_all_lost(struct rtxqueue *q)
 {
-	struct rtxq_entry *cur, *n;
+	struct rtxq_entry *entry;
 	u32 seq;
 
-	list_for_each_entry_safe(cur, n, &q->head, next) {
-		seq = skb_seq_get(cur->skb);
-		if (seq == ack) {
-			if (rtxq_entry_rtx(cur, seq) < 0) {
-				pep_dbg("Failed to rtx seq %u", seq);
-				return -1;
-			}
-			pep_dbg("Fast retransmitted seq %u", seq);
-			break;
-		}
+	for (seq = q->una; seq != q->nxt; seq++) {
+		entry = rtxqueue_entry(q, seq);
+		if (entry->flags & MINIP_RTXQ_SACKED)
+			continue;
+		entry->flags = MINIP_RTXQ_LOST;
 	}
-
-	return 0;
+	q->lost = (q->nxt - q->una) - q->sacked;
+	q->retrans = 0;
 }
 
-int rtxq_single_rtx(struct rtxq * q, u32 ack)
+static int rtxq_entry_rtx(struct rtxq_entry *entry, u32 seq)
 {
-	if (!q)
-		return -1;
+	if (entry->retries < MAX_MINIP_RETRY) {
+		struct minip_hdr *hdr;
 
-	if (rtxqueue_fast_rtx(q->queue, ack) < 0)
-		return -1;
+		hdr = (struct minip_hdr *)skb_network_header(entry->skb);
+		hdr->ts = htonl(jiffies_to_msecs(jiffies));
+		entry->retries++;
+		skb_get(entry->skb); // bump the ref count
+		return dev_queue_xmit(entry->skb);
+	} else {
+		pep_err("Max MINIP retransmissions reached for seq %u", seq);
 
-	return 0;
+		return -1;
+	}
 }
 
-int rtxq_ack(struct rtxq *q, u32 ack)
+/* Retransmit up to @budget lost packets, oldest first.
+ * Return the number of retransmitted packets or -1 if one ran out of retries */
+static int rtxqueue_entries_rtx(struct rtxqueue *q, u32 budget)
 {
-	int rc = 0;
+	struct rtxq_entry *entry;
+	int rtx = 0;
+	u32 seq;
 
-	if (!q)
-		return -1;
+	for (seq = q->una; budget && q->lost > q->retrans && seq != q->nxt;
+	     seq++) {
+		entry = rtxqueue_entry(q, seq);
+		if ((entry->flags & (MINIP_RTXQ_LOST | MINIP_RTXQ_RETRANS)) !=
+		    MINIP_RTXQ_LOST)
+			continue;
 
-	spin_lock_bh(&q->lock);
-	rc = rtxqueue_entries_ack(q->queue, ack);
-	/* rtimer_restart(&q->parent->timers.rtx, tr); */
-	spin_unlock_bh(&q->lock);
+		if (rtxq_entry_rtx(entry, seq) < 0) {
+			pep_dbg("Failed to rtx seq %u", seq);
+			return -1;
+		}
+		pep_dbg("Retransmitted seq %u", seq);
+		entry->flags |= MINIP_RTXQ_RETRANS;
+		q->retrans++;
+		budget--;
+		rtx++;
+	}
 
-	return rc;
+	return rtx;
 }
 
 int rtxq_push(struct rtxq * q, struct sk_buff *skb)
@@ -192,8 +229,12 @@ static struct rtxqueue *rtxqueue_create(void)
 	if (!tmp)
 		return NULL;
 
-	INIT_LIST_HEAD(&tmp->head);
-	tmp->len = 0;
+	tmp->ring = kcalloc(MINIP_RTXQ_SIZE, sizeof(struct rtxq_entry),
+			    GFP_ATOMIC);
+	if (!tmp->ring) {
+		kfree(tmp);
+		return NULL;
+	}
 
 	return tmp;
 }
@@ -201,11 +242,9 @@ static struct rtxqueue *rtxqueue_create(void)
 
 static void rtxqueue_flush(struct rtxqueue * q)
 {
-	struct rtxq_entry *cur, *n;
-
-	list_for_each_entry_safe(cur, n, &q->head, next) {
-		rtxq_entry_destroy(cur);
-		q->len --;
+	while (q->una != q->nxt) {
+		rtxq_entry_release(q, rtxqueue_entry(q, q->una));
+		q->una++;
 	}
 }
 
@@ -215,6 +254,7 @@ static int rtxqueue_destroy(struct rtxqueue * q)
 		return -1;
 
 	rtxqueue_flush(q);
+	kfree(q->ring);
 	kfree(q);
 
 	return 0;
@@ -259,56 +299,186 @@ int rtxq_destroy(struct rtxq * q)
 	return 0;
 }
 
-static struct rtxq_entry * rtxq_entry_create(struct sk_buff *skb)
+/* push in seq_num order */
+static int rtxqueue_push(struct rtxqueue *q, struct sk_buff *skb)
 {
-	struct rtxq_entry *tmp;
+	u32 seq = skb_seq_get(skb);
+	struct rtxq_entry *entry;
 
-	tmp = kzalloc(sizeof(*tmp), GFP_ATOMIC);
-	if (!tmp)
-		return NULL;
+	/* First packet, the scoreboard starts at its seqno */
+	if (q->una == q->nxt)
+		q->una = q->nxt = seq;
 
-	tmp->skb = skb;
-	tmp->retries = 0;
+	if (seq != q->nxt || q->nxt - q->una >= MINIP_RTXQ_SIZE) {
+		pep_dbg("No room for seq %u in rtxq [%u, %u)", seq, q->una,
+			q->nxt);
+		return -1;
+	}
 
-	INIT_LIST_HEAD(&tmp->next);
+	entry = rtxqueue_entry(q, seq);
+	entry->skb = skb;
+	entry->retries = 0;
+	entry->flags = 0;
+	q->nxt++;
 
-	return tmp;
+	pep_dbg("Pushed PDU with seq: %u to rtxq queue", seq);
+
+	return 0;
 }
 
-/* push in seq_num order */
-static int rtxqueue_push(struct rtxqueue *q, struct sk_buff *skb)
+/*
+ * Congestion control
+ * Slow start and congestion avoidance as in RFC5681, loss recovery driven by
+ * the SACK scoreboard as in RFC6675, and the window bounded by the
+ * net.pepdna.pepdna_minip_window sysctl. New data is paced over the SRTT.
+ * ------------------------------------------------------------------------- */
+static void minip_window_bounds(u32 *lo, u32 *hi)
 {
-	struct rtxq_entry *tmp = rtxq_entry_create(skb);
-	if (!tmp)
-		return -1;
+	int min = READ_ONCE(sysctl_pepdna_minip_window[0]);
+	int max = READ_ONCE(sysctl_pepdna_minip_window[1]);
 
-	list_add_tail(&tmp->next, &q->head);
-	q->len++;
+	*hi = clamp_t(int, max, 1, MINIP_RTXQ_SIZE);
+	*lo = clamp_t(int, min, 1, *hi);
+}
 
-	pep_dbg("Pushed PDU with seq: %u to rtxq queue", skb_seq_get(skb));
+void minip_cc_init(struct pepdna_con *con)
+{
+	u32 lo, hi;
+
+	minip_window_bounds(&lo, &hi);
+	con->cwnd = clamp(MINIP_INIT_WINDOW, lo, hi);
+	con->ssthresh = hi;
+	con->cwnd_cnt = 0;
+	con->recovery_point = 0;
+	con->pacing_next_ns = 0;
+}
 
-	return 0;
+static void minip_cc_on_ack(struct pepdna_con *con, u32 acked)
+{
+	u32 lo, hi;
+
+	if (con->cwnd < con->ssthresh) {
+		/* Slow start, also after a timeout */
+		con->cwnd += acked;
+	} else if (con->state != RECOVERY) {
+		/* Congestion avoidance, one packet per window acked */
+		con->cwnd_cnt += acked;
+		if (con->cwnd_cnt >= con->cwnd) {
+			con->cwnd_cnt -= con->cwnd;
+			con->cwnd++;
+		}
+	}
+
+	minip_window_bounds(&lo, &hi);
+	con->cwnd = clamp(con->cwnd, lo, hi);
+}
+
+static void minip_cc_on_loss(struct pepdna_con *con, bool timeout)
+{
+	struct rtxqueue *q = con->rtxq->queue;
+	u32 lo, hi;
+
+	minip_window_bounds(&lo, &hi);
+	con->ssthresh = max((q->nxt - q->una) >> 1, lo);
+	con->cwnd = timeout ? lo : con->ssthresh;
+	con->cwnd_cnt = 0;
+	con->recovery_point = con->next_seq;
+	con->state = RECOVERY;
+
+	pep_dbg("%s: cwnd %u ssthresh %u", timeout ? "RTO" : "Loss",
+		con->cwnd, con->ssthresh);
 }
 
-static void minip_update_cwnd(struct pepdna_con *con)
+/* Time between two paced packets: the window spread over the SRTT, which is
+ * kept in 1/8 ms */
+static u64 minip_pacing_interval(struct pepdna_con *con)
 {
-	u32 flight = con->next_seq - (u32)(atomic_read(&con->last_acked));
-
-	/* Adjust window size based on difference */
-	if (WINDOW_SIZE >= flight) {
-		/* More packets needed, increase window size */
-		con->window++;
-	} else if (WINDOW_SIZE < flight) {
-		/* Too many packets, decrease window size */
-		if (con->window > 0)
-			con->window--;
+	u32 ratio = (con->cwnd < con->ssthresh) ? MINIP_PACING_SS_RATIO :
+						  MINIP_PACING_CA_RATIO;
+
+	if (!con->srtt)
+		return 0;
+
+	return div64_u64((u64)con->srtt * NSEC_PER_MSEC * 100,
+			 (u64)con->cwnd * ratio * 8);
+}
+
+/* How many new packets may be sent now; arms the pacing timer if none */
+static u32 minip_send_quota(struct pepdna_con *con)
+{
+	struct rtxqueue *q = con->rtxq->queue;
+	u32 pipe, quota = 0, burst;
+	u64 interval, now;
+
+	/* The ACK path updates the scoreboard and the cwnd under the lock,
+	 * and pepdna_con_close() clears lflag under it: once it has, the
+	 * pacing timer is not armed again */
+	spin_lock_bh(&con->rtxq->lock);
+
+	if (!lconnected(con))
+		goto out;
+
+	/* Lost packets go first, they are sent from the ACK path */
+	pipe = rtxqueue_pipe(q);
+	if (q->lost > q->retrans || pipe >= con->cwnd)
+		goto out;
+
+	quota = min(con->cwnd - pipe, MINIP_TX_BATCH);
+	if (q->nxt - q->una + quota > MINIP_RTXQ_SIZE)
+		quota = MINIP_RTXQ_SIZE - (q->nxt - q->una);
+
+	interval = minip_pacing_interval(con);
+	if (!interval)
+		goto out;
+
+	now = ktime_get_ns();
+	if (now < con->pacing_next_ns) {
+		if (!hrtimer_active(&con->pacing_timer))
+			hrtimer_start(&con->pacing_timer,
+				      ns_to_ktime(con->pacing_next_ns),
+				      HRTIMER_MODE_ABS_SOFT);
+		quota = 0;
+		goto out;
 	}
 
-	/* Ensure window size stays within bounds */
-	if (con->window > WINDOW_SIZE)
-		con->window = WINDOW_SIZE;
+	/* Send up to 1 ms worth of packets at a time, at least 2 */
+	burst = max_t(u64, div64_u64(NSEC_PER_MSEC, interval), 2);
+	quota = min(quota, burst);
+out:
+	spin_unlock_bh(&con->rtxq->lock);
+	return quota;
+}
+
+/* Account for @pkts new packets just sent in the pacing schedule */
+static void minip_pacing_update(struct pepdna_con *con, u32 pkts)
+{
+	u64 interval = minip_pacing_interval(con);
+	u64 now;
+
+	if (!interval) {
+		con->pacing_next_ns = 0;
+		return;
+	}
+
+	now = ktime_get_ns();
+	con->pacing_next_ns = max(now, con->pacing_next_ns) + pkts * interval;
+}
+
+/**
+ * minip_pacing_timeout() - the pacing timer expired
+ * @t: address to pacing_timer inside con
+ *
+ * Kick the l2r work to send the next paced packets.
+ */
+enum hrtimer_restart minip_pacing_timeout(struct hrtimer *t)
+{
+	struct pepdna_con *con = container_of(t, struct pepdna_con,
+					      pacing_timer);
+
+	if (lconnected(con))
+		con->lsock->sk->sk_data_ready(con->lsock->sk);
 
-	pep_dbg("%u pkts in flight", flight);
+	return HRTIMER_NORESTART;
 }
 
 /**
@@ -316,37 +486,48 @@ static void minip_update_cwnd(struct pepdna_con *con)
  * @t: address to timer_list inside con
  *
  * If fired it means that there was packet loss.
- * Retransmit unacked packets
- * Switch to Slow Start, set the ss_threshold to half of the current cwnd and
- * reset the cwnd to 3*MSS
+ * Mark everything not SACKed as lost, set the ssthresh to half of the flight,
+ * collapse the cwnd to its lower bound and retransmit the oldest lost packets
+ * from there. The RTO doubles until the next RTT sample.
  */
 void minip_sender_timeout(struct timer_list *t)
 {
 	struct pepdna_con *con = from_timer(con, t, timer);
+	struct rtxqueue *q = con->rtxq->queue;
+	int rtx = 0;
+
+	spin_lock_bh(&con->rtxq->lock);
+	/* pepdna_con_close() clears lflag and then deletes the timer, once
+	 * it is clear the timer is not armed again */
+	if (!lconnected(con)) {
+		spin_unlock_bh(&con->rtxq->lock);
+		return;
+	}
 
 	/* resend the non-ACKed packets... if any */
-	if (rtxq_size(con)) {
-		atomic_set(&con->sending, 0);
-		/* Retransmit all pkts in the rtx queue */
-		con->state = RECOVERY;
-		if (rtxq_full_rtx(con->rtxq, (u32)atomic_read(&con->last_acked) + 1) < 0) {
-			/* Send a MINIP_CONN_DELETE to deallocate the flow */
-			if (pepdna_minip_conn_delete(con->id,
-						     con->server->to_mac) < 0) {
-				pep_err("failed to send MINIP_CONN_DELETE");
-			}
-			pep_dbg("Sent MINIP_CONN_DELETE [cid %u]", con->id);
-			pepdna_con_close(con);
+	if (q->una != q->nxt) {
+		rtxqueue_mark_all_lost(q);
+		minip_cc_on_loss(con, true);
+		atomic_set(&con->dup_acks, 0);
+		con->rto = min(con->rto << 1, MINIP_RTO_MAX);
 
-			return;
+		rtx = rtxqueue_entries_rtx(q, con->cwnd);
+		pep_dbg("Rtxd %d of pkts [%u, %u) due to timeout (rto=%u ms)",
+			rtx, q->una, q->nxt, con->rto);
+	}
+	if (rtx >= 0)
+		mod_timer(&con->timer, jiffies + msecs_to_jiffies(con->rto));
+	spin_unlock_bh(&con->rtxq->lock);
+
+	if (rtx < 0) {
+		/* Send a MINIP_CONN_DELETE to deallocate the flow */
+		if (pepdna_minip_conn_delete(con->id,
+					     con->server->to_mac) < 0) {
+			pep_err("failed to send MINIP_CONN_DELETE");
 		}
-
-		pep_dbg("Rtxd pkts [%u, %u] due to timeout (rto=%u ms)",
-			(u32)atomic_read(&con->last_acked) + 1,
-			con->next_seq - 1, con->rto);
+		pep_dbg("Sent MINIP_CONN_DELETE [cid %u]", con->id);
+		pepdna_con_close(con);
 	}
-
-	mod_timer(&con->timer, jiffies + msecs_to_jiffies(con->rto));
 }
 
 /* minip_update_rto() - calculate new retransmission timeout
@@ -380,7 +561,8 @@ static void minip_update_rto(struct pepdna_con *con, u32 new_rtt)
 	/* rto = srtt + 4 * rttvar.
 	 * rttvar is scaled by 4, therefore doesn't need to be multiplied
 	 */
-	con->rto = (con->srtt >> 3) + con->rttvar;
+	con->rto = clamp_t(u32, (con->srtt >> 3) + con->rttvar,
+			   MINIP_RTO_MIN, MINIP_RTO_MAX);
 }
 
 /*
@@ -524,7 +706,9 @@ out:
 	return -1;
 }
 
-static int pepdna_minip_send_ack(u32 id, u32 ack, u8 *to_mac, __be32 ts)
+static int pepdna_minip_send_ack(u32 id, u32 ack,
+				 struct minip_sack_block *sack, int nsack,
+				 u8 *to_mac, __be32 ts)
 {
 	/* FIXME */
 	struct net_device *dev = dev_get_by_name(&init_net, ifname);
@@ -532,15 +716,19 @@ static int pepdna_minip_send_ack(u32 id, u32 ack, u8 *to_mac, __be32 ts)
 	int hlen = LL_RESERVED_SPACE(dev);
 	int tlen = dev->needed_tailroom;
 	int hdr_len = sizeof(struct minip_hdr);
+	int sack_len = nsack * sizeof(struct minip_sack_block);
 	struct minip_hdr *hdr;
 
 	/* skb */
-	struct sk_buff* skb = alloc_skb(hdr_len + hlen + tlen, GFP_ATOMIC);
+	struct sk_buff* skb = alloc_skb(hdr_len + sack_len + hlen + tlen,
+					GFP_ATOMIC);
 	if (!skb)
 		return -1;
 	skb_reserve(skb, hlen);
 	skb_reset_network_header(skb);
 	hdr = skb_put(skb, hdr_len);
+	if (sack_len)
+		skb_put_data(skb, sack, sack_len);
 	skb->dev = dev;
 
 	/*
@@ -553,7 +741,7 @@ static int pepdna_minip_send_ack(u32 id, u32 ack, u8 *to_mac, __be32 ts)
 	 * Fill out the MINIP protocol part
 	 */
 	hdr->pkt_type = MINIP_CONN_ACK;
-	hdr->sdu_len = 0u;
+	hdr->sdu_len = (u16)sack_len;
 	hdr->id = htonl(id);
 	hdr->ack = htonl(ack);
 	hdr->ts = ts;
@@ -637,6 +825,7 @@ static int pepdna_minip_conn_snd_data(struct pepdna_con *con, unsigned char *buf
 				      size_t len)
 {
 	size_t left = len, mtu = MINIP_MSS, copylen = 0, sent = 0;
+	u32 pkts = 0;
 	int rc	= 0;
 
 	pep_dbg("Trying to forward a total of %lu bytes to MINIP", len);
@@ -655,17 +844,14 @@ static int pepdna_minip_conn_snd_data(struct pepdna_con *con, unsigned char *buf
 
 		left -= copylen;
 		sent += copylen;
+		pkts++;
 
 		pep_dbg("Forwarded %lu out of %lu bytes to MINIP", sent, len);
 
-		/* Update window */
 		con->next_seq++;
-		if (con->window > 0) {
-			con->window--;
-			pep_dbg("Sent SKB Cwnd update %u", con->window);
-		}
 	}
 out:
+	minip_pacing_update(con, pkts);
 	return sent ? sent : rc;
 }
 
@@ -835,6 +1021,7 @@ static int pepdna_minip_recv_finished(struct minip_hdr *hdr)
 	}
 	atomic_set(&con->rflag, 0);
 	pepdna_con_close(con);
+	pepdna_con_put(con);
 
 	return 0;
 }
@@ -855,15 +1042,18 @@ static int pepdna_minip_recv_delete(struct minip_hdr *hdr)
 	pep_dbg("Sent MINIP_CONN_FINISHED [cid %u]", hash);
 	atomic_set(&con->rflag, 0);
 	pepdna_con_close(con);
+	pepdna_con_put(con);
 
 	return 0;
 }
 
-static int pepdna_minip_recv_ack(struct minip_hdr *hdr)
+static int pepdna_minip_recv_ack(struct minip_hdr *hdr, struct sk_buff *skb)
 {
+	struct minip_sack_block *sack = NULL;
 	struct pepdna_con *con = NULL;
-	u32 ack, hash, rtt;
-	int credit;
+	struct rtxqueue *q;
+	u32 ack, hash, rtt, acked, pipe, budget = 0;
+	int nsack = 0, sacked = 0, rtx = 0, i;
 
 	hash = ntohl(hdr->id);
 
@@ -877,9 +1067,20 @@ static int pepdna_minip_recv_ack(struct minip_hdr *hdr)
 	pep_dbg("Recvd ACK %u (last_acked %u) (SRTT=%ums) [cid %u]", ack,
 		(u32)atomic_read(&con->last_acked), con->srtt >> 3, hash);
 
-		/* old ACK? silently drop it.. */
-	if (unlikely(ack < (u32)atomic_read(&con->last_acked))) {
+	if (hdr->sdu_len && skb->len >= sizeof(struct minip_hdr) + hdr->sdu_len) {
+		sack = (struct minip_sack_block *)(hdr + 1);
+		nsack = min_t(int, hdr->sdu_len / sizeof(*sack),
+			      MINIP_MAX_SACK_BLOCKS);
+	}
+
+	q = con->rtxq->queue;
+	spin_lock_bh(&con->rtxq->lock);
+
+	/* old ACK? silently drop it.. */
+	if (unlikely(minip_before(ack, q->una))) {
+		spin_unlock_bh(&con->rtxq->lock);
 		pep_dbg("Dropping old ACK");
+		pepdna_con_put(con);
 		return 0;
 	}
 
@@ -888,67 +1089,68 @@ static int pepdna_minip_recv_ack(struct minip_hdr *hdr)
 	if (hdr->ts && rtt)
 		minip_update_rto(con, rtt);
 
-	/* ACK arrived... reset the timer */
-	mod_timer(&con->timer, jiffies + msecs_to_jiffies(con->rto));
+	/* ACK arrived... reset the timer, unless the connection is closing */
+	if (lconnected(con))
+		mod_timer(&con->timer, jiffies + msecs_to_jiffies(con->rto));
 
-	/* check if this ACK acks new data */
-	if (ack > (u32)atomic_read(&con->last_acked)) {
-		pep_dbg("ACK %u arrived (last_acked %u)", ack, (u32)atomic_read(&con->last_acked));
+	acked = rtxqueue_entries_ack(q, ack);
+	for (i = 0; i < nsack; i++)
+		sacked += rtxqueue_entries_sack(q, ntohl(sack[i].start),
+						ntohl(sack[i].end));
 
+	if (acked) {
 		/* reset the duplicate ACKs counter */
 		atomic_set(&con->dup_acks, 0);
-
-		/* Update LWE */
 		atomic_set(&con->last_acked, ack - 1);
-		credit = rtxq_ack(con->rtxq, ack);
-
-		if (con->state == RECOVERY) {
-			/* Resume sending new data */
-			atomic_set(&con->sending, 1);
-			con->state = ESTABLISHED;
-			pep_dbg("Resume sending new data");
-		}
+	} else if (q->una != q->nxt) {
+		atomic_inc(&con->dup_acks);
+	}
 
-		/* Update cwnd */
-		con->window += credit;
-		pep_dbg("Good ACK Cwnd update to %u", con->window);
+	if (con->state == RECOVERY && !minip_before(q->una, con->recovery_point)) {
+		con->state = ESTABLISHED;
+		pep_dbg("Recovery completed at %u", q->una);
+	}
 
-		/* Double check cwnd once per RTT */
-                if (rtxq_size(con) <  (WINDOW_SIZE >> 1)) {
-			pep_dbg("Updating cwnd since rtxq is almost empty");
-			minip_update_cwnd(con);
-		}
+	if (acked)
+		minip_cc_on_ack(con, acked);
 
-		con->lsock->sk->sk_data_ready(con->lsock->sk);
+	/* New holes in the scoreboard start a recovery episode */
+	rtxqueue_mark_lost(q, atomic_read(&con->dup_acks) >= MINIP_DUPTHRESH);
+	if (q->lost > q->retrans && con->state != RECOVERY) {
+		minip_cc_on_loss(con, false);
+		/* the first lost packet goes out right away (RFC6675 5.1) */
+		budget = 1;
+	}
 
-		return 0;
+	if (con->state == RECOVERY) {
+		pipe = rtxqueue_pipe(q);
+		if (con->cwnd > pipe)
+			budget = max(budget, con->cwnd - pipe);
+		rtx = rtxqueue_entries_rtx(q, budget);
 	}
 
-	/* check if this ACK is a duplicate */
-	if ((u32)atomic_read(&con->last_acked) == ack) {
-		atomic_inc(&con->dup_acks);
-		con->state = RECOVERY;
-		atomic_set(&con->sending, 0);
+	pep_dbg("cwnd %u ssthresh %u pipe %u (acked %u sacked %d rtx %d)",
+		con->cwnd, con->ssthresh, rtxqueue_pipe(q), acked, sacked, rtx);
+	spin_unlock_bh(&con->rtxq->lock);
 
-		if (atomic_read(&con->dup_acks) != 1) {
-			pep_dbg("Dropping DupACKs");
-			return 0;
+	if (rtx < 0) {
+		/* Send a MINIP_CONN_DELETE to deallocate the flow */
+		if (pepdna_minip_conn_delete(con->id,
+					     con->server->to_mac) < 0) {
+			pep_err("failed to send MINIP_CONN_DELETE");
 		}
+		pep_dbg("Sent MINIP_CONN_DELETE [cid %u]", con->id);
+		pepdna_con_close(con);
+		pepdna_con_put(con);
 
-		/* if this is the first duplicate ACK do Full Retransmit */
-		if (rtxq_full_rtx(con->rtxq, ack) < 0) {
-			/* Send a MINIP_CONN_DELETE to deallocate the flow */
-			if (pepdna_minip_conn_delete(con->id,
-						     con->server->to_mac) < 0) {
-				pep_err("failed to send MINIP_CONN_DELETE");
-			}
-			pep_dbg("Sent MINIP_CONN_DELETE [cid %u]", con->id);
-			pepdna_con_close(con);
-		}
+		return 0;
 	}
 
-	pep_dbg("window changed to %u", con->window);
+	/* Room in the window, resume sending new data */
+	if (acked || sacked)
+		con->lsock->sk->sk_data_ready(con->lsock->sk);
 
+	pepdna_con_put(con);
 	return 0;
 }
 
@@ -990,6 +1192,7 @@ static int pepdna_minip_recv_data(struct minip_hdr *hdr, struct sk_buff *skb)
 	/* } */
 	/* read_unlock_bh(&sk->sk_callback_lock); */
 
+	pepdna_con_put(con);
 	return 0;
 }
 
@@ -1024,18 +1227,20 @@ static int pepdna_minip_recv_response(struct minip_hdr *hdr)
 	ip_local_out(net, con->server->listener->sk, con->skb);
 #endif
 
+	pepdna_con_put(con);
 	return 0;
 }
 
 static int pepdna_minip_recv_request(struct sk_buff *skb)
 {
+	struct minip_hdr *hdr  = (struct minip_hdr *)skb_network_header(skb);
 	struct pepdna_con *con = NULL;
 	struct syn_tuple *syn  = NULL;
-	u32 hash;
+	/* Use the id of the requesting peer, both ends must agree on it */
+	u32 hash = ntohl(hdr->id);
 
 	skb_pull(skb, sizeof(struct minip_hdr));
 	syn = (struct syn_tuple *)skb->data;
-	hash = pepdna_hash32_rjenkins1_2(syn->saddr, syn->source);
 
 	pep_dbg("Recvd MINIP_CONN_REQUEST [cid %u]", hash);
 
@@ -1064,7 +1269,7 @@ int pepdna_minip_recv_packet(struct sk_buff *skb)
 		ret = pepdna_minip_recv_data(hdr, skb);
 		break;
 	case MINIP_CONN_ACK:
-		ret = pepdna_minip_recv_ack(hdr);
+		ret = pepdna_minip_recv_ack(hdr, skb);
 		break;
 	case MINIP_CONN_DELETE:
 		ret = pepdna_minip_recv_delete(hdr);
@@ -1081,13 +1286,6 @@ int pepdna_minip_recv_packet(struct sk_buff *skb)
 	return ret;
 }
 
-static bool can_send(struct pepdna_con *con)
-{
-	if (!atomic_read(&con->sending) || !con->window)
-		return false;
-	return true;
-}
-
 /*
  * Forward data from TCP socket to MINIP flow
  * ------------------------------------------------------------------------- */
@@ -1099,13 +1297,14 @@ static int pepdna_con_i2minip_fwd(struct pepdna_con *con)
 	int read = 0, sent = 0;
 	struct msghdr msg;
 	struct kvec vec;
+	u32 quota = minip_send_quota(con);
 
-	if (!can_send(con)) {
+	if (!quota) {
 		pep_dbg("Cannot forward to MINIP at this moment");
 		return -EAGAIN;
 	}
 
-	how_much *= con->window;
+	how_much *= quota;
 
 	/* allocate buffer memory */
 	buff = kzalloc(how_much, GFP_KERNEL);
@@ -1136,26 +1335,150 @@ static int pepdna_con_i2minip_fwd(struct pepdna_con *con)
 	return read;
 }
 
+/*
+ * Keep an out-of-order packet until the hole before it is filled
+ * Return false if it is a duplicate or out of the receive window.
+ * ------------------------------------------------------------------------- */
+static bool minip_ooo_queue(struct pepdna_con *con, struct sk_buff *skb,
+			    u32 seq)
+{
+	struct sk_buff *cur;
+	u32 cseq;
+
+	if (minip_before(seq, con->next_recv) ||
+	    seq - con->next_recv >= MINIP_RTXQ_SIZE)
+		return false;
+
+	spin_lock_bh(&con->ooo.lock);
+	/* Mostly appended, so look for the place from the tail */
+	skb_queue_reverse_walk(&con->ooo, cur) {
+		cseq = skb_seq_get(cur);
+		if (cseq == seq) {
+			spin_unlock_bh(&con->ooo.lock);
+			return false;
+		}
+		if (minip_before(cseq, seq)) {
+			__skb_queue_after(&con->ooo, cur, skb_get(skb));
+			goto out;
+		}
+	}
+	__skb_queue_head(&con->ooo, skb_get(skb));
+out:
+	spin_unlock_bh(&con->ooo.lock);
+
+	return true;
+}
+
+/*
+ * Take the next in-order packet from the out-of-order queue, if any
+ * ------------------------------------------------------------------------- */
+static struct sk_buff *minip_ooo_dequeue(struct pepdna_con *con)
+{
+	struct sk_buff *skb;
+	u32 seq;
+
+	spin_lock_bh(&con->ooo.lock);
+	while ((skb = skb_peek(&con->ooo)) != NULL) {
+		seq = skb_seq_get(skb);
+		if (seq == con->next_recv) {
+			__skb_unlink(skb, &con->ooo);
+			break;
+		}
+		if (!minip_before(seq, con->next_recv)) {
+			skb = NULL;
+			break;
+		}
+		/* already delivered */
+		__skb_unlink(skb, &con->ooo);
+		kfree_skb(skb);
+	}
+	spin_unlock_bh(&con->ooo.lock);
+
+	return skb;
+}
+
+/*
+ * Describe the out-of-order queue as SACK blocks
+ * The block holding the just received @seq goes first, as in RFC2018, the
+ * others follow in seqno order.
+ * ------------------------------------------------------------------------- */
+static int minip_ooo_sack(struct pepdna_con *con, u32 seq,
+			  struct minip_sack_block *sack)
+{
+	struct minip_sack_block blocks[MINIP_MAX_SACK_BLOCKS];
+	struct minip_sack_block blk = { 0, 0 };
+	struct sk_buff *cur;
+	int nblocks = 0, nsack = 0, i;
+	bool latest = false;
+	u32 cseq;
+
+	spin_lock_bh(&con->ooo.lock);
+	skb_queue_walk(&con->ooo, cur) {
+		cseq = skb_seq_get(cur);
+		if (blk.start != blk.end && cseq == blk.end) {
+			blk.end++;
+			continue;
+		}
+		if (blk.start != blk.end) {
+			if (!latest && !minip_before(seq, blk.start) &&
+			    minip_before(seq, blk.end)) {
+				sack[nsack++] = blk;
+				latest = true;
+			} else if (nblocks < MINIP_MAX_SACK_BLOCKS) {
+				blocks[nblocks++] = blk;
+			}
+		}
+		blk.start = cseq;
+		blk.end = cseq + 1;
+	}
+	spin_unlock_bh(&con->ooo.lock);
+
+	if (blk.start != blk.end) {
+		if (!latest && !minip_before(seq, blk.start) &&
+		    minip_before(seq, blk.end))
+			sack[nsack++] = blk;
+		else if (nblocks < MINIP_MAX_SACK_BLOCKS)
+			blocks[nblocks++] = blk;
+	}
+
+	for (i = 0; i < nblocks && nsack < MINIP_MAX_SACK_BLOCKS; i++)
+		sack[nsack++] = blocks[i];
+
+	for (i = 0; i < nsack; i++) {
+		sack[i].start = htonl(sack[i].start);
+		sack[i].end = htonl(sack[i].end);
+	}
+
+	return nsack;
+}
+
 /*
  * Forward data from MINIP flow to TCP socket
+ * Out-of-order packets are kept and reported with SACK blocks, and written
+ * to the socket once the packets before them arrive.
  * ------------------------------------------------------------------------- */
 static int pepdna_con_minip2i_fwd(struct pepdna_con *con, struct sk_buff *skb)
 {
+	struct minip_sack_block sack[MINIP_MAX_SACK_BLOCKS];
 	struct socket *lsock = con->lsock;
 	struct minip_hdr *hdr;
 	unsigned char *buf;
-	int read = 0, sent = 0;
+	int read = 0, sent = 0, nsack;
+	__be32 ts;
+	u32 seq;
 
 	hdr = (struct minip_hdr *)skb_network_header(skb);
 	read = hdr->sdu_len;
+	seq = ntohl(hdr->seq);
+	ts = hdr->ts;
 
 	skb_pull(skb, sizeof(struct minip_hdr));
 	buf = (unsigned char *)skb->data;
 
-	pep_dbg("Forwarding MINIP pkt seq %u to TCP", ntohl(hdr->seq));
+	pep_dbg("Forwarding MINIP pkt seq %u to TCP", seq);
 
-	if (ntohl(hdr->seq) == con->next_recv) {
-		pep_dbg("Yesss, seq %u is in order", ntohl(hdr->seq));
+	if (seq == con->next_recv) {
+		pep_dbg("Yesss, seq %u is in order", seq);
 		sent = pepdna_sock_write(lsock, buf, read);
 		if (sent < 0) {
 			pep_dbg("Forwarded %d out of %d bytes from MINIP to TCP", read, sent);
@@ -1163,15 +1486,31 @@ static int pepdna_con_minip2i_fwd(struct pepdna_con *con, struct sk_buff *skb)
 		} else {
 			con->next_recv++;
 		}
+
+		/* The hole is filled, deliver what was waiting behind it */
+		while (read > 0 && (skb = minip_ooo_dequeue(con)) != NULL) {
+			hdr = (struct minip_hdr *)skb_network_header(skb);
+			sent = pepdna_sock_write(lsock, skb->data, hdr->sdu_len);
+			kfree_skb(skb);
+			if (sent < 0) {
+				read = -1;
+				break;
+			}
+			con->next_recv++;
+		}
 	} else {
-		pep_dbg("Nooo, seq %u is out of order", ntohl(hdr->seq));
+		if (minip_ooo_queue(con, skb, seq))
+			pep_dbg("Nooo, seq %u is out of order, queued", seq);
+		else
+			pep_dbg("Dropping duplicate seq %u", seq);
 		read = -EAGAIN;
 	}
 
-	/* Send an ACK with the expected sequence */
-	pepdna_minip_send_ack(con->id, con->next_recv, con->server->to_mac,
-			      hdr->ts);
-	pep_dbg("Sent ACK %u", con->next_recv);
+	/* Send an ACK with the expected sequence and what is beyond it */
+	nsack = minip_ooo_sack(con, seq, sack);
+	pepdna_minip_send_ack(con->id, con->next_recv, sack, nsack,
+			      con->server->to_mac, ts);
+	pep_dbg("Sent ACK %u with %d SACK blocks", con->next_recv, nsack);
 
 	return read;
 }
@@ -4,6 +4,9 @@
 #ifdef CONFIG_PEPDNA_MINIP
 #include <linux/workqueue.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
+
+struct pepdna_con;
 
 #define ETH_ALEN      6
 #define ETH_P_MINIP   0x88FF
@@ -16,13 +19,32 @@
  */
 #define MINIP_FIRST_SEQ 9u
 
-#define WINDOW_SIZE	12u
-#define MAX_MINIP_RETRY 3u
+/**
+ * MINIP_RTXQ_SIZE - Slots of the retransmission ring, indexed by seqno. Must
+ *  be a power of 2; it is also the upper bound of the congestion window.
+ */
+#define MINIP_RTXQ_SIZE	512u
+/* Default bounds of the congestion window, net.pepdna.pepdna_minip_window */
+#define MINIP_MIN_WINDOW 2u
+#define MINIP_MAX_WINDOW 256u
+#define MINIP_INIT_WINDOW 10u
+/* Packets SACKed above a hole before the hole is considered lost (RFC6675) */
+#define MINIP_DUPTHRESH 3u
+#define MINIP_MAX_SACK_BLOCKS 4u
+/* Pacing rate is cwnd/srtt scaled by these ratios in %, as tcp_pacing_*_ratio */
+#define MINIP_PACING_SS_RATIO 200u
+#define MINIP_PACING_CA_RATIO 120u
+/* Max packets read from the TCP socket and sent in one go */
+#define MINIP_TX_BATCH	16u
+#define MAX_MINIP_RETRY 15u
 /**
  * MINIP_RECV_TIMEOUT - Sender activity timeout. If the sender does not
  *  get any 'good' ACK for such amount of milliseconds, it resends unacked pkts.
  */
 #define MINIP_RTO 3000u
+/* Lower bound of the RTO, as TCP_RTO_MIN */
+#define MINIP_RTO_MIN 200u
+#define MINIP_RTO_MAX 60000u
 
 /**
  * struct minip_hdr - MINIP header
@@ -32,7 +54,9 @@
  * @seq:      sequence number
  * @ack:      acknowledge number
  * @ts:       time when the packet has been sent
-
+ *
+ * A MINIP_CONN_ACK carries sdu_len / sizeof(struct minip_sack_block) SACK
+ * blocks after the header.
  */
 struct minip_hdr {
 	u8  pkt_type;
@@ -43,6 +67,16 @@ struct minip_hdr {
 	__be32 ts;
 } __attribute__ ((packed));
 
+/**
+ * struct minip_sack_block - received out-of-order range [start, end)
+ * @start: first seqno of the range
+ * @end:   seqno following the last one of the range
+ */
+struct minip_sack_block {
+	u32 start;
+	u32 end;
+} __attribute__ ((packed));
+
 /**
  * enum minip_packet_type - MINIP packet type
  * @MINIP_CONN_REQUEST:  SYN
@@ -68,16 +102,35 @@ enum minip_state {
 	RECOVERY      = 0x04,
 };
 
+/* rtxq_entry flags */
+#define MINIP_RTXQ_SACKED  0x01	/* received by the peer, skb released */
+#define MINIP_RTXQ_LOST    0x02	/* considered lost, to be retransmitted */
+#define MINIP_RTXQ_RETRANS 0x04	/* lost and retransmitted */
+
 struct rtxq_entry {
-	/* unsigned long    time_stamp; */
 	struct sk_buff *skb;
 	u8 retries;
-	struct list_head next;
+	u8 flags;
 };
 
+/**
+ * struct rtxqueue - retransmission scoreboard
+ * @una:         oldest unacknowledged seqno
+ * @nxt:         seqno of the next pushed packet
+ * @high_sacked: highest SACKed seqno
+ * @sacked:      entries with MINIP_RTXQ_SACKED
+ * @lost:        entries with MINIP_RTXQ_LOST
+ * @retrans:     entries with MINIP_RTXQ_RETRANS
+ * @ring:        entries of [una, nxt), at index seqno % MINIP_RTXQ_SIZE
+ */
 struct rtxqueue {
-	int len;
-	struct list_head head;
+	u32 una;
+	u32 nxt;
+	u32 high_sacked;
+	u32 sacked;
+	u32 lost;
+	u32 retrans;
+	struct rtxq_entry *ring;
 };
 
 struct rtxq {
@@ -85,6 +138,12 @@ struct rtxq {
 	struct rtxqueue *queue;
 };
 
+/* seqno comparison that survives the wrap around, as before() in TCP */
+static inline bool minip_before(u32 seq1, u32 seq2)
+{
+	return (s32)(seq1 - seq2) < 0;
+}
+
 /**
  * minip_has_timed_out() - compares current time (jiffies) and timestamp +
  *  timeout
@@ -106,6 +165,8 @@ void pepdna_minip_handshake(struct work_struct *);
 void pepdna_con_i2m_work(struct work_struct *);
 void pepdna_con_m2i_work(struct work_struct *);
 void minip_sender_timeout(struct timer_list *);
+enum hrtimer_restart minip_pacing_timeout(struct hrtimer *);
+void minip_cc_init(struct pepdna_con *);
 
 struct rtxq *rtxq_create(void);
 int rtxq_destroy(struct rtxq *);
@@ -313,7 +313,8 @@ void nl_r2i_callback(struct nl_msg *nlmsg)
 		syn->daddr  = cpu_to_be32(nlmsg->daddr);
 		syn->dest   = cpu_to_be16(nlmsg->dest);
 
-		hash_id = pepdna_hash32_rjenkins1_2(syn->saddr, syn->source);
+		hash_id = pepdna_hash32_tuple(syn->saddr, syn->source,
+					      syn->daddr, syn->dest);
 		con = pepdna_con_alloc(syn, NULL, hash_id, 0ull, nlmsg->port_id);
 		if (!con)
 			pep_err("pepdna_con_alloc");
@@ -340,11 +341,14 @@ void nl_r2i_callback(struct nl_msg *nlmsg)
 			if (!queue_work(con->server->r2l_wq, &con->r2l_work)) {
 				pep_err("r2i_work was already on a queue");
 				pepdna_con_put(con);
+				pepdna_con_put(con);
 				return;
 			}
 			/* Wake up 'left' socket */
 			con->lsock->sk->sk_data_ready(con->lsock->sk);
 		}
+		/* Drop the reference of pepdna_con_find() */
+		pepdna_con_put(con);
 	}
 }
 
@@ -381,6 +385,7 @@ void nl_i2r_callback(struct nl_msg *nlmsg)
 		ip_local_out(net, con->server->listener->sk, con->skb);
 #endif
 	}
+	pepdna_con_put(con);
 }
 
 /*
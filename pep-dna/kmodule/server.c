@@ -237,8 +237,8 @@ static unsigned int pepdna_pre_hook(void *priv, struct sk_buff *skb,
 			if (ntohs(tcph->dest) == SSH_PORT)
 				return NF_ACCEPT;
 
-			hash_id = pepdna_hash32_rjenkins1_2(iph->saddr,
-							    tcph->source);
+			hash_id = pepdna_hash32_tuple(iph->saddr, tcph->source,
+						      iph->daddr, tcph->dest);
 
 			con = pepdna_con_find(hash_id);
 			if (!con) {
@@ -273,8 +273,10 @@ static unsigned int pepdna_pre_hook(void *priv, struct sk_buff *skb,
 			} else {
 				if (skb->tstamp != con->ts) {
 					pep_dbg("Dropping duplicate SYN");
+					pepdna_con_put(con);
 					return NF_DROP;
 				}
+				pepdna_con_put(con);
 			}
 		}
 	}
@@ -548,7 +550,6 @@ static void init_pepdna_server(struct pepdna_server *srv)
 	srv->r2l_wq    = NULL;
 
 	atomic_set(&srv->conns, 0);
-	hash_init(srv->htable);
 }
 
 /*
@@ -566,6 +567,12 @@ int pepdna_server_start(void)
 
 	init_pepdna_server(srv);
 
+	if (pepdna_con_table_init(srv) < 0) {
+		pep_err("Couldn't create the connection table");
+		kfree(srv);
+		return -ENOMEM;
+	}
+
 	switch (srv->mode) {
 	case TCP2TCP:
 		if (pepdna_i2i_start(srv) < 0)
@@ -616,6 +623,7 @@ int pepdna_server_start(void)
 	}
 	return 0;
  err_start:
+	pepdna_con_table_destroy(srv);
 	kfree(srv);
 	return -1;
 }
@@ -628,7 +636,7 @@ void pepdna_server_stop(void)
 {
 	struct socket *lsock = pepdna_srv->listener;
 	struct pepdna_con *con = NULL;
-	struct hlist_node *n;
+	struct rhashtable_iter iter;
 
 	/* 1. First, we unregister NF_HOOK to stop processing new SYNs */
 	if (pepdna_srv->mode < 4) {
@@ -638,13 +646,26 @@ void pepdna_server_stop(void)
 
 	/* 2. Check for connections which are still alive and destroy them */
 	if (atomic_read(&pepdna_srv->conns)) {
-		hlist_for_each_entry_safe(con, n, pepdna_srv->htable, hlist) {
-		if (con) {
+		rhashtable_walk_enter(&pepdna_srv->htable, &iter);
+		rhashtable_walk_start(&iter);
+		while ((con = rhashtable_walk_next(&iter)) != NULL) {
+			/* -EAGAIN: the table was resized, keep walking */
+			if (IS_ERR(con))
+				continue;
+			/* Its release is already queued */
+			if (!kref_get_unless_zero(&con->kref))
+				continue;
 			pep_err("Hmmm, %d conns. still alive",
 				atomic_read(&pepdna_srv->conns));
+			/* Closing may sleep, leave the RCU section. Our
+			 * reference keeps con alive until we are done. */
+			rhashtable_walk_stop(&iter);
 			pepdna_con_close(con);
+			pepdna_con_put(con);
+			rhashtable_walk_start(&iter);
 		}
-		}
+		rhashtable_walk_stop(&iter);
+		rhashtable_walk_exit(&iter);
 	}
 
 	/* 3. Release main listening socket and Netlink socket */
@@ -660,7 +681,8 @@ void pepdna_server_stop(void)
 	/* Remove the MINIP packet hook */
 	dev_remove_pack(&minip);
 #endif
-	/* 5. kfree PEPDNA server struct */
+	/* 5. Destroy the connection table, kfree PEPDNA server struct */
+	pepdna_con_table_destroy(pepdna_srv);
 	kfree(pepdna_srv);
 	pepdna_srv = NULL;
 
@@ -20,11 +20,12 @@
 #ifndef _PEPDNA_SERVER_H
 #define _PEPDNA_SERVER_H
 
-#include <linux/workqueue.h>    /* work_struct, workqueue_struct, htable*/
+#include <linux/workqueue.h>    /* work_struct, workqueue_struct */
+#include <linux/rhashtable.h>   /* struct rhashtable */
 
 #define MODULE_NAME      "pepdna"
 #define NF_PEPDNA_PRI    -500
-#define PEPDNA_HASH_BITS 9
+#define PEPDNA_HASH_BITS 9     /* initial size of the connection table */
 #define ETH_ALEN	 6
 #define MAX_CONNS        65535
 #define MAX_SDU_SIZE     1448
@@ -56,7 +57,7 @@ enum server_mode {
  * @accept_work: TCP accept work item
  * @listener:    pepdna listener socket
  * @port:        pepdna TCP listener port
- * @htable:      Hash table for connections
+ * @htable:      resizable RCU hash table of connections, keyed by id
  * @conns:	 counter for active connections
  */
 struct pepdna_server {
@@ -71,7 +72,7 @@ struct pepdna_server {
 #ifdef CONFIG_PEPDNA_MINIP
         u8 to_mac[ETH_ALEN];
 #endif
-	struct hlist_head htable[PEPDNA_HASH_BITS];
+	struct rhashtable htable;
 	atomic_t conns;
 };
 
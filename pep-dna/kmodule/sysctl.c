@@ -38,6 +38,15 @@ static struct ctl_table sys_table[] = {
 		.mode	      = 0644,
 		.proc_handler = proc_dointvec,
 	},
+#ifdef CONFIG_PEPDNA_MINIP
+	{
+		.procname     = "pepdna_minip_window",
+		.data	      = &sysctl_pepdna_minip_window,
+		.maxlen	      = sizeof(sysctl_pepdna_minip_window),
+		.mode	      = 0644,
+		.proc_handler = proc_dointvec,
+	},
+#endif
 	{}
 };
 
@@ -157,6 +157,7 @@ static int pepdna_tcp_accept(struct pepdna_server *srv)
                         if (!queue_work(srv->r2l_wq, &con->r2l_work)) {
                                 pep_err("r2i_work already in queue");
                                 pepdna_con_put(con);
+                                pepdna_con_put(con);
                                 return -1;
                         }
                 }
@@ -167,6 +168,9 @@ static int pepdna_tcp_accept(struct pepdna_server *srv)
                         rsk = con->rsock->sk;
                         rsk->sk_data_ready(rsk);
                 }
+
+                /* Drop the reference of pepdna_con_find() */
+                pepdna_con_put(con);
         }
 
         return rc;
@@ -257,13 +257,15 @@ void print_syn(__be32 daddr, __be16 dest)
 }
 
 /*
- * Return the hash(saddr, source) of the connected socket
+ * Return the hash of the 4-tuple of the connected socket
+ * The listener is transparent, so the local address of an accepted socket is
+ * the original destination of the intercepted SYN.
  * ------------------------------------------------------------------------- */
 uint32_t identify_client(struct socket *sock)
 {
 	struct sockaddr_in *addr  = NULL;
-	__be32 src_ip;
-	__be16 src_port;
+	__be32 src_ip, dst_ip;
+	__be16 src_port, dst_port;
 	uint32_t hash_id;
 	int addr_len, rc = 0;
 
@@ -286,7 +288,22 @@ uint32_t identify_client(struct socket *sock)
 
 	src_ip   = addr->sin_addr.s_addr;
 	src_port = addr->sin_port;
-	hash_id  = pepdna_hash32_rjenkins1_2(src_ip, src_port);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,17,0)
+	rc = sock->ops->getname(sock, (struct sockaddr *)addr, &addr_len, 0);
+#else
+	rc = sock->ops->getname(sock, (struct sockaddr *)addr, 0);
+#endif
+	if (rc < 0) {
+		pep_err("getname %d", rc);
+		kfree(addr);
+		addr = NULL;
+		goto err;
+	}
+
+	dst_ip   = addr->sin_addr.s_addr;
+	dst_port = addr->sin_port;
+	hash_id  = pepdna_hash32_tuple(src_ip, src_port, dst_ip, dst_port);
 
 	kfree(addr);
 	addr = NULL;
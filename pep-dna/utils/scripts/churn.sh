@@ -0,0 +1,148 @@
+# -*- bash -*-
+
+#
+# Connection churn benchmark for the PEP-DNA connection table
+#
+# Runs on a single host. The client and the server live in their own network
+# namespaces, and PEP-DNA runs in the root namespace between them in TCP2TCP
+# mode:
+#
+#   pepdna-cli (10.77.1.2) --- (10.77.1.1) root (10.77.2.1) --- (10.77.2.2) pepdna-srv
+#
+# autobench drives httperf from the client namespace at increasing connection
+# rates, one short request per connection, so that the PEP has to insert and
+# remove a connection for every request. The table, with the connection rate,
+# reply rate and errors of each step, is written to $outfile.
+#
+# How to run: sudo bash churn.sh [low_rate] [high_rate] [rate_step] [test_time]
+# Needs httperf, autobench (../apps/autobench) and httpapp (../apps/httpapp)
+# in PATH, and the pepdna module built (or $PEPDNA_KO pointing to pepdna.ko).
+#
+
+readonly low_rate=${1:-1000}
+readonly high_rate=${2:-10000}
+readonly rate_step=${3:-1000}
+readonly test_time=${4:-20}
+
+readonly cli_ns="pepdna-cli"
+readonly srv_ns="pepdna-srv"
+readonly cli_ip="10.77.1.2"
+readonly cli_gw_ip="10.77.1.1"
+readonly srv_ip="10.77.2.2"
+readonly srv_gw_ip="10.77.2.1"
+readonly lport="8080"
+readonly proxy_port="9999"
+readonly www="/var/www/web"
+readonly filename="churn.bin"
+readonly outfile=${outfile:-"churn_$(date +%Y%m%d%H%M%S).tsv"}
+
+#-----------------------------------------------------
+# Create the namespaces and the veth links
+#-----------------------------------------------------
+setup_netns() {
+        ip netns add $cli_ns
+        ip netns add $srv_ns
+
+        ip link add veth-cli type veth peer name eth0 netns $cli_ns
+        ip link add veth-srv type veth peer name eth0 netns $srv_ns
+
+        ip addr add ${cli_gw_ip}/24 dev veth-cli
+        ip addr add ${srv_gw_ip}/24 dev veth-srv
+        ip link set veth-cli up
+        ip link set veth-srv up
+
+        ip -n $cli_ns addr add ${cli_ip}/24 dev eth0
+        ip -n $cli_ns link set lo up
+        ip -n $cli_ns link set eth0 up
+        ip -n $cli_ns route add default via $cli_gw_ip
+
+        ip -n $srv_ns addr add ${srv_ip}/24 dev eth0
+        ip -n $srv_ns link set lo up
+        ip -n $srv_ns link set eth0 up
+        ip -n $srv_ns route add default via $srv_gw_ip
+
+        # httperf runs out of ephemeral ports long before the PEP does
+        ip netns exec $cli_ns sysctl -qw net.ipv4.ip_local_port_range="1024 65535"
+        ip netns exec $cli_ns sysctl -qw net.ipv4.tcp_tw_reuse=1
+}
+
+#-----------------------------------------------------
+# Divert the client SYNs to the PEP-DNA listener
+#-----------------------------------------------------
+setup_pepdna() {
+        sysctl -qw net.ipv4.ip_forward=1
+        sysctl -qw net.ipv4.ip_nonlocal_bind=1
+
+        iptables -t mangle -N DIVERT
+        iptables -t mangle -A PREROUTING -p tcp -m socket -j DIVERT
+        iptables -t mangle -A DIVERT -j MARK --set-mark 1
+        iptables -t mangle -A DIVERT -j ACCEPT
+        ip rule add fwmark 1 lookup 100
+        ip route add local 0.0.0.0/0 dev lo table 100
+        iptables -t mangle -A PREROUTING -i veth-cli -p tcp --dport $lport \
+                 -j TPROXY --on-port $proxy_port --tproxy-mark 1
+
+        if [ -n "$PEPDNA_KO" ]; then
+                insmod $PEPDNA_KO port=$proxy_port mode=0
+        else
+                modprobe pepdna port=$proxy_port mode=0
+        fi
+}
+
+#-----------------------------------------------------
+# Undo everything, also after a failed run
+#-----------------------------------------------------
+cleanup() {
+        pkill -f "httpapp -s -p $lport" > /dev/null 2>&1
+        rmmod pepdna > /dev/null 2>&1
+
+        iptables -t mangle -D PREROUTING -i veth-cli -p tcp --dport $lport \
+                 -j TPROXY --on-port $proxy_port --tproxy-mark 1 > /dev/null 2>&1
+        iptables -t mangle -D PREROUTING -p tcp -m socket -j DIVERT > /dev/null 2>&1
+        iptables -t mangle -F DIVERT > /dev/null 2>&1
+        iptables -t mangle -X DIVERT > /dev/null 2>&1
+        ip rule del fwmark 1 lookup 100 > /dev/null 2>&1
+        ip route del local 0.0.0.0/0 dev lo table 100 > /dev/null 2>&1
+
+        ip link del veth-cli > /dev/null 2>&1
+        ip link del veth-srv > /dev/null 2>&1
+        ip netns del $cli_ns > /dev/null 2>&1
+        ip netns del $srv_ns > /dev/null 2>&1
+}
+
+if [ $(id -u) -ne 0 ]; then
+        echo "churn.sh needs root privileges"
+        exit 1
+fi
+
+trap cleanup EXIT
+cleanup
+
+# One small object, so that every request is dominated by connection setup
+mkdir -p $www
+if [ ! -f ${www}/${filename} ]; then
+        dd if=/dev/urandom of=${www}/${filename} bs=1K count=1 status=none
+fi
+
+setup_netns
+setup_pepdna || exit 1
+
+ip netns exec $srv_ns httpapp -s -p $lport > /dev/null 2>&1 &
+sleep 1
+
+ip netns exec $cli_ns autobench --single_host --host1 $srv_ip --port1 $lport \
+        --uri1 /${filename} --low_rate $low_rate --high_rate $high_rate \
+        --rate_step $rate_step --num_call 1 --const_test_time $test_time \
+        --timeout 5 --file $outfile
+
+# Everything should be gone from the table once the clients are done;
+# pepdna reports the connections it still has to close when unloaded
+sleep 5
+dmesg -C
+rmmod pepdna
+if dmesg | grep -q "still alive"; then
+        dmesg | grep "still alive" | head -n 1
+else
+        echo "No connections left in the table"
+fi
+echo "Results in $outfile"
@@ -0,0 +1,138 @@
+# -*- bash -*-
+
+#
+# MINIP goodput versus loss rate
+#
+# PEP-DNA binds to the initial network namespace, so the two MINIP ends need
+# two kernels: $snd_host runs TCP2MINIP and $rcv_host MINIP2TCP, e.g. two VMs
+# on the same machine whose $iface interfaces are linked through a bridge or a
+# veth pair. The TCP client and server run in network namespaces on those
+# hosts, attached with veth pairs:
+#
+#   pepdna-cli --veth-- snd_host ==MINIP($iface, netem)== rcv_host --veth-- pepdna-srv
+#
+# For each loss rate netem drops packets on $iface in both directions, so
+# data and ACKs are lost, and httpapp uploads a file from the client to the
+# server. The goodput of each run is written to $outfile.
+#
+# How to run: bash minip-loss.sh snd_host rcv_host [iface] [delay_ms]
+# Needs passwordless ssh/sudo to both hosts, and pepdna built with MINIP and
+# httpapp installed on both.
+#
+
+readonly snd_host=$1
+readonly rcv_host=$2
+readonly iface=${3:-"eth1"}
+readonly delay=${4:-"10"}
+
+readonly loss_vec=("0" "0.1" "0.5" "1" "2" "5" "10")
+readonly count=${count:-"5"}
+readonly filesize_mb=${filesize_mb:-"100"}
+readonly window=${window:-"2 256"}
+
+readonly cli_ns="pepdna-cli"
+readonly srv_ns="pepdna-srv"
+readonly cli_ip="10.77.1.2"
+readonly cli_gw_ip="10.77.1.1"
+readonly srv_ip="10.77.2.2"
+readonly srv_gw_ip="10.77.2.1"
+readonly lport="8080"
+readonly proxy_port="9999"
+readonly filename="minip.bin"
+readonly outfile=${outfile:-"minip_loss_$(date +%Y%m%d%H%M%S).dat"}
+
+if [ -z "$snd_host" ] || [ -z "$rcv_host" ]; then
+        echo "Usage: bash minip-loss.sh snd_host rcv_host [iface] [delay_ms]"
+        exit 1
+fi
+
+#-----------------------------------------------------
+# Attach namespace $1 with address $2 to the host, gateway $3
+#-----------------------------------------------------
+netns_cmd() {
+        local ns=$1
+        local ip=$2
+        local gw=$3
+
+        echo "sudo ip netns add $ns;
+              sudo ip link add veth-$ns type veth peer name eth0 netns $ns;
+              sudo ip addr add ${gw}/24 dev veth-$ns;
+              sudo ip link set veth-$ns up;
+              sudo ip -n $ns addr add ${ip}/24 dev eth0;
+              sudo ip -n $ns link set lo up;
+              sudo ip -n $ns link set eth0 up;
+              sudo ip -n $ns route add default via $gw"
+}
+
+# The replies of the transparent sockets must reach PEP-DNA
+readonly divert_cmd="sudo sysctl -qw net.ipv4.ip_forward=1;
+                     sudo sysctl -qw net.ipv4.ip_nonlocal_bind=1;
+                     sudo iptables -t mangle -N DIVERT;
+                     sudo iptables -t mangle -A PREROUTING -p tcp -m socket -j DIVERT;
+                     sudo iptables -t mangle -A DIVERT -j MARK --set-mark 1;
+                     sudo iptables -t mangle -A DIVERT -j ACCEPT;
+                     sudo ip rule add fwmark 1 lookup 100;
+                     sudo ip route add local 0.0.0.0/0 dev lo table 100"
+
+setup() {
+        local snd_mac=$(ssh $snd_host cat /sys/class/net/${iface}/address)
+        local rcv_mac=$(ssh $rcv_host cat /sys/class/net/${iface}/address)
+
+        ssh $snd_host "$(netns_cmd $cli_ns $cli_ip $cli_gw_ip);
+                       $divert_cmd;
+                       sudo iptables -t mangle -A PREROUTING -i veth-$cli_ns -p tcp --dport $lport -j TPROXY --on-port $proxy_port --tproxy-mark 1;
+                       sudo mkdir -p /var/www/web;
+                       sudo dd if=/dev/urandom of=/var/www/web/$filename bs=1M count=$filesize_mb status=none;
+                       sudo modprobe pepdna port=$proxy_port mode=3 ifname=$iface macstr=$rcv_mac;
+                       sudo sysctl -qw net.pepdna.pepdna_minip_window='$window'"
+
+        ssh $rcv_host "$(netns_cmd $srv_ns $srv_ip $srv_gw_ip);
+                       $divert_cmd;
+                       sudo modprobe pepdna port=$proxy_port mode=5 ifname=$iface macstr=$snd_mac;
+                       sudo sysctl -qw net.pepdna.pepdna_minip_window='$window';
+                       sudo ip netns exec $srv_ns httpapp -s -p $lport > /dev/null 2>&1"
+}
+
+cleanup() {
+        local hosts=($snd_host $rcv_host)
+        local nss=($cli_ns $srv_ns)
+
+        for i in ${!hosts[@]}; do
+                ssh ${hosts[$i]} "sudo pkill -f 'httpapp -s -p $lport';
+                                  sudo rmmod pepdna;
+                                  sudo tc qdisc del dev $iface root;
+                                  sudo iptables -t mangle -F;
+                                  sudo iptables -t mangle -X DIVERT;
+                                  sudo ip rule del fwmark 1 lookup 100;
+                                  sudo ip route del local 0.0.0.0/0 dev lo table 100;
+                                  sudo ip link del veth-${nss[$i]};
+                                  sudo ip netns del ${nss[$i]}" > /dev/null 2>&1
+        done
+}
+
+set_loss() {
+        local loss=$1
+
+        for host in $snd_host $rcv_host; do
+                ssh $host "sudo tc qdisc replace dev $iface root netem delay ${delay}ms loss ${loss}%"
+        done
+}
+
+trap cleanup EXIT
+cleanup
+setup
+
+echo "# loss(%) run time(ms) goodput(Mbps)" | tee $outfile
+for loss in ${loss_vec[@]}; do
+        set_loss $loss
+        for run in $(seq 1 $count); do
+                ms=$(ssh $snd_host "sudo ip netns exec $cli_ns httpapp -u -c http://${srv_ip}:${lport}/${filename}")
+                if [ -z "$ms" ]; then
+                        echo "$loss $run failed failed" | tee -a $outfile
+                        continue
+                fi
+                mbps=$(echo "$filesize_mb * 8 * 1048576 / ($ms * 1000)" | bc -l)
+                printf "%s %d %s %.2f\n" $loss $run $ms $mbps | tee -a $outfile
+                sleep 1
+        done
+done
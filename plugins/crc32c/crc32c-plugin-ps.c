@@ -0,0 +1,214 @@
+/*
+ * CRC32C error check plugin for SDUP
+ *
+ * Publishes the CRC32C SDUP error check policy set. With bench=1 it also
+ * times, at load, the protection and unprotection of PDUs of several
+ * sizes with the CRC32 (default) and CRC32C policy sets, and the check of
+ * fragmented PDUs, and prints the results in the kernel log.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/string.h>
+#include <linux/skbuff.h>
+#include <linux/crc32.h>
+#include <linux/timekeeping.h>
+
+#define RINA_PREFIX "crc32c-plugin"
+
+#include "logs.h"
+#include "du.h"
+#include "sdup-errc-ps.h"
+#include "sdup-errc-ps-default.h"
+#include "crc32c-ps.h"
+
+static bool bench;
+module_param(bench, bool, 0444);
+MODULE_PARM_DESC(bench, "Run the error check benchmark at load");
+
+static unsigned int bench_pdus = 100000;
+module_param(bench_pdus, uint, 0444);
+MODULE_PARM_DESC(bench_pdus, "PDUs per benchmark run");
+
+#define BENCH_FRAGS 4
+
+static const unsigned int bench_sizes[] = { 64, 256, 1024, 1500, 4096, 9000 };
+
+/* Protect and unprotect the same DU bench_pdus times, in ns per PDU */
+static u64 bench_roundtrip(struct sdup_errc_ps * ps, unsigned int size)
+{
+	struct du * du;
+	u64         t0, ns;
+	int         i;
+
+	du = du_create_room(size, 0, sizeof(u32));
+	if (!du)
+		return 0;
+	memset(du_buffer(du), 0xa5, size);
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < bench_pdus; i++) {
+		if (ps->sdup_add_error_check_policy(ps, du) ||
+		    ps->sdup_check_error_check_policy(ps, du)) {
+			LOG_ERR("Error check failed at PDU %d", i);
+			du_destroy(du);
+			return 0;
+		}
+	}
+	ns = ktime_get_ns() - t0;
+
+	du_destroy(du);
+
+	return ns / bench_pdus;
+}
+
+/* A PDU of size bytes spread over BENCH_FRAGS page fragments */
+static struct sk_buff * bench_frag_skb(unsigned int size)
+{
+	struct sk_buff * skb;
+	struct page *    page;
+	unsigned int     off, len;
+	int              i;
+
+	skb = alloc_skb(0, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	for (i = 0, off = 0; i < BENCH_FRAGS; i++, off += len) {
+		len = (size - off) / (BENCH_FRAGS - i);
+		page = alloc_page(GFP_KERNEL);
+		if (!page) {
+			kfree_skb(skb);
+			return NULL;
+		}
+		memset(page_address(page), 0xa5, len);
+		skb_add_rx_frag(skb, i, page, 0, len, PAGE_SIZE);
+	}
+
+	return skb;
+}
+
+/*
+ * Check a fragmented PDU: the default policy set needs it linear, which
+ * costs a copy, crc32c walks the fragments in place. In ns per PDU.
+ */
+static void bench_frags(unsigned int size, u64 * ns_lin, u64 * ns_frag)
+{
+	struct sk_buff * skb, * lin;
+	u64              t0;
+	u32              crc = 0;
+	int              i;
+
+	*ns_lin = *ns_frag = 0;
+
+	skb = bench_frag_skb(size);
+	if (!skb)
+		return;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < bench_pdus; i++) {
+		lin = skb_copy(skb, GFP_KERNEL);
+		if (!lin)
+			goto out;
+		crc += crc32_le(0, lin->data, lin->len);
+		kfree_skb(lin);
+	}
+	*ns_lin = (ktime_get_ns() - t0) / bench_pdus;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < bench_pdus; i++)
+		crc += crc32c_skb(skb, skb->len);
+	*ns_frag = (ktime_get_ns() - t0) / bench_pdus;
+
+	LOG_DBG("Benchmark checksum %u", crc);
+out:
+	kfree_skb(skb);
+}
+
+static void crc32c_bench(void)
+{
+	struct crc32c_errc_ps_data data;
+	struct sdup_errc_ps        dflt, c32c;
+	u64                        ns_dflt, ns_c32c, ns_lin, ns_frag;
+	unsigned int               size;
+	int                        i;
+
+	memset(&dflt, 0, sizeof(dflt));
+	dflt.sdup_add_error_check_policy   = default_sdup_add_error_check_policy;
+	dflt.sdup_check_error_check_policy = default_sdup_check_error_check_policy;
+
+	memset(&data, 0, sizeof(data));
+	memset(&c32c, 0, sizeof(c32c));
+	c32c.priv = &data;
+	c32c.sdup_add_error_check_policy   = crc32c_sdup_add_error_check;
+	c32c.sdup_check_error_check_policy = crc32c_sdup_check_error_check;
+
+	LOG_INFO("Error check benchmark, %u PDUs per run, ns per PDU",
+		 bench_pdus);
+	LOG_INFO("%6s %12s %12s %16s %16s", "size", "crc32", "crc32c",
+		 "crc32 (linearize)", "crc32c (frags)");
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		size = bench_sizes[i];
+		ns_dflt = bench_roundtrip(&dflt, size);
+		ns_c32c = bench_roundtrip(&c32c, size);
+		bench_frags(size, &ns_lin, &ns_frag);
+
+		LOG_INFO("%6u %12llu %12llu %16llu %16llu", size,
+			 ns_dflt, ns_c32c, ns_lin, ns_frag);
+	}
+}
+
+static int __init mod_init(void)
+{
+	int ret;
+
+	strcpy(errc_factory.name, RINA_CRC32C_PS_NAME);
+
+	ret = sdup_errc_ps_publish(&errc_factory);
+	if (ret) {
+		LOG_ERR("Failed to publish SDUP error check policy set factory");
+		return -1;
+	}
+
+	LOG_INFO("SDUP CRC32C error check policy set loaded successfully");
+
+	if (bench)
+		crc32c_bench();
+
+	return 0;
+}
+
+static void __exit mod_exit(void)
+{
+	int ret;
+
+	ret = sdup_errc_ps_unpublish(RINA_CRC32C_PS_NAME);
+	if (ret) {
+		LOG_ERR("Failed to unpublish SDUP CRC32C error check policy set");
+		return;
+	}
+
+	LOG_INFO("SDUP CRC32C error check policy set unloaded successfully");
+}
+
+module_init(mod_init);
+module_exit(mod_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CRC32C error check policy set for SDUP");
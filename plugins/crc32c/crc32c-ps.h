@@ -0,0 +1,43 @@
+/*
+ * CRC32C error check policy set for SDUP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef CRC32C_PS_H
+#define CRC32C_PS_H
+
+#include <linux/skbuff.h>
+
+#include "sdup-errc-ps.h"
+
+#define RINA_CRC32C_PS_NAME "CRC32C"
+
+struct crc32c_errc_ps_data {
+	/* Skip the check of PDUs verified by the hardware of the lower IPCP */
+	bool         trust_offload;
+	atomic_t     checks_skipped;
+	atomic_t     errors;
+};
+
+/* CRC32C of the first len bytes of skb, fragments are not linearized */
+u32 crc32c_skb(struct sk_buff * skb, unsigned int len);
+
+int crc32c_sdup_add_error_check(struct sdup_errc_ps * ps, struct du * du);
+int crc32c_sdup_check_error_check(struct sdup_errc_ps * ps, struct du * du);
+
+extern struct ps_factory errc_factory;
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * CRC32C error check policy set for SDUP
+ *
+ * Appends a little endian CRC32C of the PDU, computed with crc32c(), which
+ * uses the CPU instructions for it when there are (SSE4.2, ARMv8 CRC32).
+ * Fragmented sk_buffs are walked in place instead of being linearized,
+ * and the check can be skipped for PDUs the lower IPCP had verified by
+ * the hardware (du->hw_verified).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/skbuff.h>
+#include <linux/crc32c.h>
+
+#define RINA_PREFIX "crc32c-errc-ps"
+
+#include "logs.h"
+#include "rds/rmem.h"
+#include "sdup-errc-ps.h"
+#include "policies.h"
+#include "crc32c-ps.h"
+
+u32 crc32c_skb(struct sk_buff * skb, unsigned int len)
+{
+	struct skb_seq_state st;
+	const u8 *           data;
+	unsigned int         consumed = 0;
+	unsigned int         n;
+	u32                  crc = ~0;
+
+	if (!skb_is_nonlinear(skb))
+		return ~crc32c(crc, skb->data, len);
+
+	skb_prepare_seq_read(skb, 0, len, &st);
+	while ((n = skb_seq_read(consumed, &data, &st)) != 0) {
+		crc = crc32c(crc, data, n);
+		consumed += n;
+	}
+
+	return ~crc;
+}
+
+int crc32c_sdup_add_error_check(struct sdup_errc_ps * ps, struct du * du)
+{
+	struct sk_buff * skb = du->skb;
+	unsigned int     len = skb->len;
+	__le32           crc;
+
+	crc = cpu_to_le32(crc32c_skb(skb, len));
+
+	/* DUs built by KFA are linear, the trailer only needs skb_put() */
+	if (unlikely(skb_is_nonlinear(skb)) && skb_linearize(skb)) {
+		LOG_ERR("Failed to linearize PDU");
+		return -1;
+	}
+
+	if (du_tail_grow(du, sizeof(crc))) {
+		LOG_ERR("Failed to grow PDU");
+		return -1;
+	}
+
+	memcpy(skb->data + len, &crc, sizeof(crc));
+
+	return 0;
+}
+
+int crc32c_sdup_check_error_check(struct sdup_errc_ps * ps, struct du * du)
+{
+	struct crc32c_errc_ps_data * data = ps->priv;
+	struct sk_buff *             skb = du->skb;
+	unsigned int                 len;
+	__le32                       trailer;
+
+	if (unlikely(skb->len < sizeof(trailer))) {
+		LOG_DBG("PDU too short for the CRC");
+		return -1;
+	}
+	len = skb->len - sizeof(trailer);
+
+	if (data->trust_offload && du->hw_verified) {
+		atomic_inc(&data->checks_skipped);
+	} else {
+		if (skb_copy_bits(skb, len, &trailer, sizeof(trailer)))
+			return -1;
+
+		if (crc32c_skb(skb, len) != le32_to_cpu(trailer)) {
+			atomic_inc(&data->errors);
+			return -1;
+		}
+	}
+
+	if (pskb_trim(skb, len)) {
+		LOG_ERR("Failed to shrink PDU");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int crc32c_errc_ps_set_policy_set_param(struct ps_base * bps,
+					       const char * name,
+					       const char * value)
+{
+	struct sdup_errc_ps * ps = container_of(bps, struct sdup_errc_ps, base);
+	struct crc32c_errc_ps_data * data = ps->priv;
+	unsigned int ival;
+
+	if (!name) {
+		LOG_ERR("Null parameter name");
+		return -1;
+	}
+
+	if (!value) {
+		LOG_ERR("Null parameter value");
+		return -1;
+	}
+
+	if (strcmp(name, "trust_offload") == 0) {
+		if (kstrtouint(value, 10, &ival)) {
+			LOG_ERR("Invalid value for trust_offload: %s", value);
+			return -1;
+		}
+		data->trust_offload = ival ? true : false;
+		return 0;
+	}
+
+	LOG_ERR("No such parameter to set");
+
+	return -1;
+}
+
+static struct ps_base * crc32c_errc_ps_create(struct rina_component * component)
+{
+	struct sdup_comp * sdup_comp;
+	struct sdup_errc_ps * ps;
+	struct crc32c_errc_ps_data * data;
+	struct policy_parm * param;
+
+	sdup_comp = sdup_comp_from_component(component);
+	if (!sdup_comp)
+		return NULL;
+
+	ps = rkzalloc(sizeof(*ps), GFP_KERNEL);
+	if (!ps)
+		return NULL;
+
+	data = rkzalloc(sizeof(*data), GFP_KERNEL);
+	if (!data) {
+		rkfree(ps);
+		return NULL;
+	}
+
+	atomic_set(&data->checks_skipped, 0);
+	atomic_set(&data->errors, 0);
+
+	ps->base.set_policy_set_param = crc32c_errc_ps_set_policy_set_param;
+	ps->dm           = sdup_comp->parent;
+	ps->max_tailroom = sizeof(u32);
+	ps->priv         = data;
+
+	ps->sdup_add_error_check_policy   = crc32c_sdup_add_error_check;
+	ps->sdup_check_error_check_policy = crc32c_sdup_check_error_check;
+
+	if (ps->dm && ps->dm->conf && ps->dm->conf->crc) {
+		param = policy_param_find(ps->dm->conf->crc, "trust_offload");
+		if (param)
+			crc32c_errc_ps_set_policy_set_param(&ps->base,
+						policy_param_name(param),
+						policy_param_value(param));
+	}
+
+	LOG_INFO("CRC32C error check policy created, trust_offload = %d",
+		 data->trust_offload);
+
+	return &ps->base;
+}
+
+static void crc32c_errc_ps_destroy(struct ps_base * bps)
+{
+	struct sdup_errc_ps * ps = container_of(bps, struct sdup_errc_ps, base);
+	struct crc32c_errc_ps_data * data;
+
+	if (!bps)
+		return;
+
+	data = ps->priv;
+	if (data) {
+		LOG_INFO("CRC32C error check policy destroyed, %d bad PDUs, "
+			 "%d checks skipped", atomic_read(&data->errors),
+			 atomic_read(&data->checks_skipped));
+		rkfree(data);
+	}
+
+	rkfree(ps);
+}
+
+struct ps_factory errc_factory = {
+	.owner   = THIS_MODULE,
+	.create  = crc32c_errc_ps_create,
+	.destroy = crc32c_errc_ps_destroy,
+};
@@ -30,6 +30,8 @@
 
 #define DEC_PRECISION 1000000
 #define DCTCP_MAX_ALPHA 1024U
+/* Window updates between two refreshes of the average PDU size */
+#define DCTCP_PDU_LEN_REFRESH 64U
 
 enum tx_state {
 	SLOW_START,
@@ -46,6 +48,11 @@ struct dctcp_dtcp_ps_data {
 	uint_t        ecn_total;
 	uint_t        dctcp_alpha;
 	uint_t	      obs_window_size;
+	bool	      pacing;
+	/* Average PDU size sent, summed up from the per-CPU DTP counters
+	 * only once every DCTCP_PDU_LEN_REFRESH window updates */
+	u64	      avg_pdu_len;
+	uint_t	      pdu_len_updates;
 };
 
 static int dctcp_rcvr_flow_control(struct dtcp_ps * ps, const struct pci * pci)
@@ -117,6 +124,49 @@ static int dctcp_rcvr_flow_control(struct dtcp_ps * ps, const struct pci * pci)
 	return 0;
 }
 
+/* Spreads the granted credit over the smoothed RTT instead of sending it back
+ * to back. The PDU size is the average of what this flow has sent so far */
+static int dctcp_sender_pacing(struct dtcp_ps * ps)
+{
+	struct dtcp * dtcp = ps->dm;
+	struct dctcp_dtcp_ps_data * data = ps->priv;
+	seq_num_t lwe, rwe;
+	unsigned int srtt;
+	u64 pdus, bytes, rate;
+	bool refresh;
+
+	if (!data->pacing)
+		return 0;
+
+	spin_lock_bh(&dtcp->parent->sv_lock);
+	lwe = dtcp->sv->snd_lft_win;
+	rwe = dtcp->sv->snd_rt_wind_edge;
+	srtt = dtcp->sv->srtt;
+	refresh = !data->avg_pdu_len ||
+		  ++data->pdu_len_updates >= DCTCP_PDU_LEN_REFRESH;
+	if (refresh)
+		data->pdu_len_updates = 0;
+	spin_unlock_bh(&dtcp->parent->sv_lock);
+
+	if (refresh) {
+		pdus = rstats_read(dtcp->parent->stats, DTP_TX_PDUS);
+		bytes = rstats_read(dtcp->parent->stats, DTP_TX_BYTES);
+		if (pdus)
+			data->avg_pdu_len = div64_u64(bytes, pdus);
+	}
+
+	/* No RTT sample or nothing sent yet */
+	if (!srtt || !data->avg_pdu_len || rwe <= lwe)
+		return 0;
+
+	rate = (u64)(rwe - lwe) * data->avg_pdu_len * MSEC_PER_SEC;
+	do_div(rate, srtt);
+
+	dtcp_pacing_rate_set(dtcp, rate);
+
+	return 0;
+}
+
 static int dtcp_ps_set_policy_set_param(struct ps_base * bps, const char * name,
 					const char * value)
 {
@@ -144,6 +194,13 @@ static int dtcp_ps_set_policy_set_param(struct ps_base * bps, const char * name,
 		}
 	}
 
+	if (strcmp(name, "pacing") == 0) {
+		ret = kstrtoint(value, 10, &ival);
+		if (!ret) {
+			data->pacing = ival;
+		}
+	}
+
 	return 0;
 }
 static struct ps_base * dtcp_ps_dctcp_create(struct rina_component * component)
@@ -186,6 +243,7 @@ static struct ps_base * dtcp_ps_dctcp_create(struct rina_component * component)
 	ps->rcvr_control_ack            = NULL;
 	ps->no_rate_slow_down           = NULL;
 	ps->no_override_default_peak    = NULL;
+	ps->sender_pacing               = dctcp_sender_pacing;
 
 	LOG_INFO("DCTCP DTCP policy created, shift_g value is %d",
 		 data->shift_g);
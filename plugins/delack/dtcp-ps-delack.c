@@ -0,0 +1,339 @@
+/*
+ * Delayed ACK Policy Set for DTCP
+ *
+ * Coalesces the ACK and Flow Control PDUs sent by the receiver: one
+ * control PDU acknowledges up to ack_every data PDUs, or whatever arrived
+ * within ack_delay_us of the first unacknowledged one. Out of order PDUs,
+ * gaps being filled and ECN marked PDUs are acknowledged immediately, so
+ * the sender's loss recovery and congestion control do not see the delay.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <linux/export.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+
+#define RINA_PREFIX "delack-dtcp-ps"
+
+#include "rds/rmem.h"
+#include "dtcp-ps.h"
+#include "dtcp.h"
+#include "dtp.h"
+#include "pci.h"
+#include "efcp-str.h"
+#include "policies.h"
+#include "logs.h"
+
+#define DEFAULT_ACK_EVERY	2
+#define DEFAULT_ACK_DELAY_US	500
+
+struct delack_dtcp_ps_data {
+	struct dtcp *         dtcp;
+
+	/* Parameters */
+	unsigned int          ack_every;
+	unsigned int          ack_delay_us;
+
+	/* Protected by the DTP sv_lock */
+	unsigned int          pending;
+	seq_num_t             last_lwe;
+	bool                  rtx;
+
+	struct hrtimer        timer;
+	struct tasklet_struct tasklet;
+
+	/* Why control PDUs were (not) sent */
+	atomic_t              acks_immediate;
+	atomic_t              acks_delayed;
+	atomic_t              pdus_coalesced;
+};
+
+static int delack_send(struct dtcp * dtcp, bool rtx, seq_num_t seq)
+{
+	struct du * du;
+
+	/* ACK (and FC if enabled) with the current window values; nothing
+	 * is sent if the LWE did not move since the last ACK */
+	if (rtx)
+		return dtcp_ack_flow_control_pdu_send(dtcp, seq);
+
+	du = pdu_ctrl_generate(dtcp, PDU_TYPE_FC);
+	if (!du)
+		return -1;
+
+	if (dtcp_pdu_send(dtcp, du)) {
+		du_destroy(du);
+		return -1;
+	}
+
+	return 0;
+}
+
+static enum hrtimer_restart tf_delack(struct hrtimer * timer)
+{
+	struct delack_dtcp_ps_data * data;
+
+	data = container_of(timer, struct delack_dtcp_ps_data, timer);
+	tasklet_hi_schedule(&data->tasklet);
+
+	return HRTIMER_NORESTART;
+}
+
+static void delack_worker(unsigned long o)
+{
+	struct delack_dtcp_ps_data * data = (struct delack_dtcp_ps_data *) o;
+	struct dtcp * dtcp = data->dtcp;
+	seq_num_t lwe;
+	bool rtx;
+
+	spin_lock_bh(&dtcp->parent->sv_lock);
+	if (!data->pending) {
+		spin_unlock_bh(&dtcp->parent->sv_lock);
+		return;
+	}
+	data->pending = 0;
+	lwe = dtcp->parent->sv->rcv_left_window_edge;
+	rtx = data->rtx;
+	spin_unlock_bh(&dtcp->parent->sv_lock);
+
+	atomic_inc(&data->acks_delayed);
+
+	LOG_DBG("Delayed ACK timer expired, LWE %u", lwe);
+
+	if (delack_send(dtcp, rtx, lwe))
+		LOG_ERR("Could not send delayed ACK/FC PDU");
+
+	dtp_send_pending_ctrl_pdus(dtcp->parent);
+}
+
+/* Called for every in-window data PDU, after the DTP LWE and the receiver
+ * window (rcvr_flow_control) have been updated */
+static int delack_rcv(struct dtcp_ps * ps, const struct pci * pci, bool rtx)
+{
+	struct dtcp * dtcp = ps->dm;
+	struct delack_dtcp_ps_data * data = ps->priv;
+	seq_num_t seq, lwe;
+	unsigned int credit;
+	bool now;
+
+	if (!pci) {
+		LOG_ERR("No PCI passed, cannot run policy");
+		return -1;
+	}
+	seq = pci_sequence_number_get(pci);
+
+	spin_lock_bh(&dtcp->parent->sv_lock);
+	lwe = dtcp->parent->sv->rcv_left_window_edge;
+	credit = dtcp->sv->rcvr_credit;
+
+	data->rtx = rtx;
+	data->pending++;
+
+	/* Out of order, or the LWE jumped over PDUs buffered in the
+	 * sequencing queue: the sender needs to know now */
+	now = seq != lwe || (lwe - data->last_lwe) > 1;
+	now = now || (pci_flags_get(pci) & PDU_FLAGS_EXPLICIT_CONGESTION);
+	now = now || data->pending >= data->ack_every;
+	/* Never sit on more than half of the window, or the sender stalls */
+	now = now || (credit && data->pending >= max(credit / 2, 1U));
+
+	data->last_lwe = lwe;
+	if (now)
+		data->pending = 0;
+	spin_unlock_bh(&dtcp->parent->sv_lock);
+
+	if (now) {
+		hrtimer_try_to_cancel(&data->timer);
+		atomic_inc(&data->acks_immediate);
+		return delack_send(dtcp, rtx, seq);
+	}
+
+	atomic_inc(&data->pdus_coalesced);
+	if (!hrtimer_active(&data->timer))
+		hrtimer_start(&data->timer,
+			      ktime_set(0, data->ack_delay_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+static int delack_rcvr_ack(struct dtcp_ps * ps, const struct pci * pci)
+{
+	return delack_rcv(ps, pci, true);
+}
+
+static int delack_receiving_flow_control(struct dtcp_ps * ps,
+					 const struct pci * pci)
+{
+	return delack_rcv(ps, pci, false);
+}
+
+static int dtcp_ps_set_policy_set_param(struct ps_base * bps,
+					const char * name,
+					const char * value)
+{
+	struct dtcp_ps *ps = container_of(bps, struct dtcp_ps, base);
+	struct delack_dtcp_ps_data *data = ps->priv;
+	unsigned int ival = 0;
+	int ret = 0;
+
+	if (!name) {
+		LOG_ERR("Null parameter name");
+		return -1;
+	}
+
+	if (!value) {
+		LOG_ERR("Null parameter value");
+		return -1;
+	}
+
+	if (strcmp(name, "ack_every") == 0) {
+		ret = kstrtouint(value, 10, &ival);
+		if (!ret && ival > 0) {
+			data->ack_every = ival;
+		}
+	}
+
+	if (strcmp(name, "ack_delay_us") == 0) {
+		ret = kstrtouint(value, 10, &ival);
+		if (!ret && ival > 0) {
+			data->ack_delay_us = ival;
+		}
+	}
+
+	return 0;
+}
+
+static int dtcp_ps_delack_load_param(struct dtcp_ps *ps, const char *param_name)
+{
+	struct dtcp_config * dtcp_cfg;
+	struct policy_parm * ps_param;
+
+	dtcp_cfg = ps->dm->cfg;
+
+	if (dtcp_cfg) {
+		ps_param = policy_param_find(dtcp_cfg->dtcp_ps, param_name);
+	} else {
+		ps_param = NULL;
+	}
+
+	if (ps_param) {
+		dtcp_ps_set_policy_set_param(&ps->base,
+					     policy_param_name(ps_param),
+					     policy_param_value(ps_param));
+	}
+
+	return 0;
+}
+
+static struct ps_base * dtcp_ps_delack_create(struct rina_component * component)
+{
+	struct dtcp * dtcp = dtcp_from_component(component);
+	struct dtcp_ps * ps;
+	struct delack_dtcp_ps_data * data;
+
+	if (!dtcp)
+		return NULL;
+
+	ps = rkzalloc(sizeof(*ps), GFP_KERNEL);
+	if (!ps)
+		return NULL;
+
+	data = rkzalloc(sizeof(*data), GFP_KERNEL);
+	if (!data) {
+		rkfree(ps);
+		return NULL;
+	}
+
+	data->dtcp = dtcp;
+	data->ack_every = DEFAULT_ACK_EVERY;
+	data->ack_delay_us = DEFAULT_ACK_DELAY_US;
+	atomic_set(&data->acks_immediate, 0);
+	atomic_set(&data->acks_delayed, 0);
+	atomic_set(&data->pdus_coalesced, 0);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,13,0)
+	hrtimer_init(&data->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->timer.function = tf_delack;
+#else
+	hrtimer_setup(&data->timer, tf_delack, CLOCK_MONOTONIC,
+		      HRTIMER_MODE_REL);
+#endif
+	tasklet_init(&data->tasklet, delack_worker, (unsigned long) data);
+
+	ps->base.set_policy_set_param   = dtcp_ps_set_policy_set_param;
+	ps->dm                          = dtcp;
+	ps->priv                        = data;
+	ps->flow_init                   = NULL;
+	ps->lost_control_pdu            = NULL;
+	ps->rtt_estimator               = NULL;
+	ps->retransmission_timer_expiry = NULL;
+	ps->received_retransmission     = NULL;
+	ps->sender_ack                  = NULL;
+	ps->sending_ack                 = NULL;
+	ps->receiving_ack_list          = NULL;
+	ps->initial_rate                = NULL;
+	ps->receiving_flow_control      = delack_receiving_flow_control;
+	ps->update_credit               = NULL;
+	ps->rcvr_ack                    = delack_rcvr_ack;
+	ps->rcvr_flow_control           = NULL;
+	ps->rate_reduction              = NULL;
+	ps->rcvr_control_ack            = NULL;
+	ps->no_rate_slow_down           = NULL;
+	ps->no_override_default_peak    = NULL;
+	ps->sender_pacing               = NULL;
+
+	dtcp_ps_delack_load_param(ps, "ack_every");
+	dtcp_ps_delack_load_param(ps, "ack_delay_us");
+
+	LOG_INFO("Delayed ACK DTCP policy created, ack_every = %u, "
+		 "ack_delay_us = %u", data->ack_every, data->ack_delay_us);
+
+	return &ps->base;
+}
+
+static void dtcp_ps_delack_destroy(struct ps_base * bps)
+{
+	struct dtcp_ps *ps = container_of(bps, struct dtcp_ps, base);
+	struct delack_dtcp_ps_data * data;
+
+	if (!bps)
+		return;
+
+	data = ps->priv;
+	if (data) {
+		tasklet_kill(&data->tasklet);
+		hrtimer_cancel(&data->timer);
+		tasklet_kill(&data->tasklet);
+
+		LOG_INFO("Delayed ACK DTCP policy destroyed, immediate ACKs %u, "
+			 "delayed ACKs %u, coalesced PDUs %u",
+			 atomic_read(&data->acks_immediate),
+			 atomic_read(&data->acks_delayed),
+			 atomic_read(&data->pdus_coalesced));
+		rkfree(data);
+	}
+
+	rkfree(ps);
+}
+
+struct ps_factory dtcp_factory = {
+	.owner   = THIS_MODULE,
+	.create  = dtcp_ps_delack_create,
+	.destroy = dtcp_ps_delack_destroy,
+};
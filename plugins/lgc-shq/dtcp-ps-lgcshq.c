@@ -57,6 +57,8 @@ struct lgcshq_dtcp_ps_data {
         u32	rate_thresh;
         u32	min_RTT;
         u32	fraction;
+        bool	pacing;
+        const struct lgc_math_ops * math;
 };
 
 static void lgc_update_rate(struct dtcp_ps *ps)
@@ -97,14 +99,14 @@ static void lgc_update_rate(struct dtcp_ps *ps)
 
         do_div(tmp_rate64, data->max_rate32);
 
-        u32 first_term = lgc_log_lut_lookup((u32)tmp_rate64);
-        u32 second_term = lgc_log_lut_lookup((u32)(ONE - data->fraction));
+        u32 first_term = data->math->log((u32)tmp_rate64);
+        u32 second_term = data->math->log((u32)(ONE - data->fraction));
 
         s32 gradient = first_term - second_term;
 
         /* s64 gradient = (s64)((s64)(BIG_ONE) - (s64)(rateo) - (s64)q); */
 
-        gr = lgc_pow_lut_lookup(delivered_ce); /* 16bit scaled */
+        gr = data->math->pow(delivered_ce); /* 16bit scaled */
 
         /* s32 lgcc_r = (s32)gr; */
         /* if (gr < 12451 && ca->fraction) { */
@@ -288,6 +290,35 @@ static int lgcshq_rcvr_flow_control(struct dtcp_ps * ps, const struct pci * pci)
         return 0;
 }
 
+/* The credit granted by the receiver is its rate * min_RTT / mss (see
+ * lgc_set_cwnd), so the sender paces at credit * mss / min_RTT
+ */
+static int lgcshq_sender_pacing(struct dtcp_ps * ps)
+{
+        struct dtcp * dtcp = ps->dm;
+        struct lgcshq_dtcp_ps_data * data = ps->priv;
+        seq_num_t lwe, rwe;
+        u64 rate64;
+
+        if (!data->pacing)
+                return 0;
+
+        spin_lock_bh(&dtcp->parent->sv_lock);
+        lwe = dtcp->sv->snd_lft_win;
+        rwe = dtcp->sv->snd_rt_wind_edge;
+        spin_unlock_bh(&dtcp->parent->sv_lock);
+
+        if (rwe <= lwe)
+                return 0;
+
+        rate64 = (u64)(rwe - lwe) * DEFAULT_PACKET_SIZE * USEC_PER_SEC;
+        do_div(rate64, data->min_RTT);
+
+        dtcp_pacing_rate_set(dtcp, rate64);
+
+        return 0;
+}
+
 static int dtcp_ps_set_policy_set_param(struct ps_base * bps, const char * name,
                                         const char * value)
 {
@@ -336,6 +367,24 @@ static int dtcp_ps_set_policy_set_param(struct ps_base * bps, const char * name,
                 }
         }
 
+        if (strcmp(name, "pacing") == 0) {
+                ret = kstrtoint(value, 10, &ival);
+                if (!ret) {
+                        data->pacing = ival;
+                }
+        }
+
+        if (strcmp(name, "math_backend") == 0) {
+                if (strcmp(value, lgc_math_lut.name) == 0) {
+                        data->math = &lgc_math_lut;
+                } else if (strcmp(value, lgc_math_interp.name) == 0) {
+                        data->math = &lgc_math_interp;
+                } else {
+                        LOG_WARN("Unknown math backend %s, keeping %s",
+                                 value, data->math->name);
+                }
+        }
+
         return 0;
 }
 
@@ -383,6 +432,7 @@ static struct ps_base * dtcp_ps_lgcshq_create(struct rina_component * component)
         data->samples_received = 0;
         data->ecn_received = 0;
         data->obs_window_size = data->init_credit;
+        data->math = &lgc_math_lut;
         dtcp->sv->rcvr_credit = data->init_credit;
 
         ps->base.set_policy_set_param   = dtcp_ps_set_policy_set_param;
@@ -405,11 +455,14 @@ static struct ps_base * dtcp_ps_lgcshq_create(struct rina_component * component)
         ps->rcvr_control_ack            = NULL;
         ps->no_rate_slow_down           = NULL;
         ps->no_override_default_peak    = NULL;
+        ps->sender_pacing               = lgcshq_sender_pacing;
 
         dtcp_ps_lgcshq_load_param(ps, "lgc_max_rate");
         dtcp_ps_lgcshq_load_param(ps, "rate_thresh");
         dtcp_ps_lgcshq_load_param(ps, "min_RTT");
         dtcp_ps_lgcshq_load_param(ps, "ecn_bits");
+        dtcp_ps_lgcshq_load_param(ps, "math_backend");
+        dtcp_ps_lgcshq_load_param(ps, "pacing");
 
         data->max_rate32 = data->lgc_max_rate * 125U;
         data->s_max_rate64 = data->max_rate32;
@@ -418,8 +471,10 @@ static struct ps_base * dtcp_ps_lgcshq_create(struct rina_component * component)
         data->fraction = 0U;
 
         LOG_INFO("LGC-ShQ DTCP policy created, "
-                 "lgc_max_rate = %u, rate_thresh = %u, min_RTT = %u ms, ecn_bits = %u",
-                 data->lgc_max_rate, data->rate_thresh, data->min_RTT/USEC_PER_MSEC, data->ecn_bits);
+                 "lgc_max_rate = %u, rate_thresh = %u, min_RTT = %u ms, ecn_bits = %u, "
+                 "math_backend = %s, pacing = %d",
+                 data->lgc_max_rate, data->rate_thresh, data->min_RTT/USEC_PER_MSEC, data->ecn_bits,
+                 data->math->name, data->pacing);
 
         return &ps->base;
 }
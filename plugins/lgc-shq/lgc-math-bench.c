@@ -0,0 +1,255 @@
+/*
+ * LGC-ShQ math backends benchmark
+ *
+ * User-space harness comparing the compact (interpolated) log/pow/exp
+ * kernels against the full lookup tables: accuracy over the whole input
+ * domain, cost per call for sequential and random inputs (optionally with
+ * a competing working set evicting the tables), and drift of the LGC rate
+ * update loop when driven by each backend.
+ *
+ * Build with "make bench" in this directory.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "tcp_lgc.h"
+
+#define ONE             (1U << 16)
+#define ALMOST_ONE      (999U << 16) / 1000U
+#define LGCSHQ_ALPHA    (5U << 16) / 100U
+#define ONE_MINUS_ALPHA (95U << 16) / 100U
+#define RATE_THRESH     (8U << 16) / 10U
+#define MAX_RATE_MBPS   100U
+
+#define NR_INPUTS       (1U << 20)
+#define NR_ROUNDS       16U
+#define NR_UPDATES      200000U
+/* Competing working set walked one cache line per call in "pressure" runs */
+#define PRESSURE_BYTES  (8U << 20)
+
+static volatile u32 sink;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static u32 lcg_next(u32 * state)
+{
+	*state = *state * 1664525U + 1013904223U;
+	return *state;
+}
+
+static void accuracy(const char * fname,
+		     u32 (* ref)(u32),
+		     u32 (* approx)(u32))
+{
+	u32 x, max_abs = 0, max_at = 0;
+	double sum_abs = 0, max_rel = 0;
+
+	for (x = 0; x <= ONE; x++) {
+		s64 r = ref(x);
+		s64 a = approx(x);
+		u32 d = (u32) (r > a ? r - a : a - r);
+
+		sum_abs += d;
+		if (d > max_abs) {
+			max_abs = d;
+			max_at  = x;
+		}
+		if (r && (double) d / r > max_rel)
+			max_rel = (double) d / r;
+	}
+
+	printf("%-4s max |err| %5u (x=%5u)  mean |err| %.3f  max rel %.2e\n",
+	       fname, max_abs, max_at, sum_abs / (ONE + 1), max_rel);
+}
+
+static void timing(const char * pattern,
+		   const u32 * inputs,
+		   const struct lgc_math_ops * ops,
+		   volatile unsigned char * pressure)
+{
+	uint64_t t0, c0, t1, c1;
+	unsigned long n = (unsigned long) NR_INPUTS * NR_ROUNDS;
+	u32 i, r, acc = 0, off = 0;
+
+	t0 = now_ns();
+	c0 = now_cycles();
+	for (r = 0; r < NR_ROUNDS; r++)
+		for (i = 0; i < NR_INPUTS; i++) {
+			if (pressure) {
+				pressure[off]++;
+				off = (off + 64) % PRESSURE_BYTES;
+			}
+			acc += ops->log(inputs[i]) + ops->pow(inputs[i]);
+		}
+	c1 = now_cycles();
+	t1 = now_ns();
+	sink = acc;
+
+	printf("%-6s %-10s %6.2f ns/op  %6.1f cycles/op\n",
+	       ops->name, pattern,
+	       (double) (t1 - t0) / (2 * n),
+	       (double) (c1 - c0) / (2 * n));
+}
+
+/* Mirrors lgc_update_rate() in dtcp-ps-lgcshq.c */
+struct lgc_sim {
+	u64 rate64;
+	u64 max_rate64;
+	u32 max_rate32;
+	u32 fraction;
+};
+
+static void sim_update(struct lgc_sim * s,
+		       const struct lgc_math_ops * ops,
+		       u32 marked, u32 samples)
+{
+	u64 rate64 = s->rate64, new_rate64;
+	s64 gr_rate_gradient = 1LL;
+	u32 delivered_ce = (marked << 16) / (samples ? samples : 1);
+	u32 fraction;
+	s32 gradient;
+
+	if (delivered_ce >= RATE_THRESH)
+		fraction = ONE_MINUS_ALPHA * s->fraction +
+			LGCSHQ_ALPHA * delivered_ce;
+	else
+		fraction = ONE_MINUS_ALPHA * s->fraction;
+	s->fraction = fraction >> 16;
+	if (s->fraction >= ONE)
+		s->fraction = ALMOST_ONE;
+
+	gradient = ops->log((u32) (rate64 / s->max_rate32)) -
+		ops->log(ONE - s->fraction);
+
+	gr_rate_gradient *= ops->pow(delivered_ce);
+	gr_rate_gradient *= rate64;
+	gr_rate_gradient >>= 16;
+	gr_rate_gradient *= gradient;
+
+	new_rate64 = (u64) ((rate64 << 16) + gr_rate_gradient) >> 16;
+	if (new_rate64 > (rate64 << 1))
+		rate64 <<= 1;
+	else if (new_rate64 == 0)
+		rate64 = 65536U;
+	else
+		rate64 = new_rate64;
+	if (rate64 > s->max_rate64)
+		rate64 = s->max_rate64;
+
+	s->rate64 = rate64;
+}
+
+static void control_loop(void)
+{
+	struct lgc_sim lut, itp;
+	double max_rel = 0, sum_rel = 0;
+	u32 seed = 1, i;
+
+	lut.max_rate32 = MAX_RATE_MBPS * 125U;
+	lut.max_rate64 = (u64) lut.max_rate32 << 16;
+	lut.rate64     = lut.max_rate64 / 10;
+	lut.fraction   = 0;
+	itp = lut;
+
+	for (i = 0; i < NR_UPDATES; i++) {
+		u32 samples = 10 + lcg_next(&seed) % 90;
+		/* Congestion episodes of varying depth every 1000 updates */
+		u32 depth   = (i / 1000) % 4 == 3 ? 100 : (i / 1000) % 4 * 15;
+		u32 marked  = samples * depth / 100;
+		double rel;
+
+		sim_update(&lut, &lgc_math_lut, marked, samples);
+		sim_update(&itp, &lgc_math_interp, marked, samples);
+
+		rel = lut.rate64 ? (double) (lut.rate64 > itp.rate64 ?
+					    lut.rate64 - itp.rate64 :
+					    itp.rate64 - lut.rate64) /
+			lut.rate64 : 0;
+		sum_rel += rel;
+		if (rel > max_rel)
+			max_rel = rel;
+	}
+
+	printf("rate loop: %u updates, max rel deviation %.2e, "
+	       "mean rel deviation %.2e\n",
+	       NR_UPDATES, max_rel, sum_rel / NR_UPDATES);
+	printf("rate loop: final rate lut %llu interp %llu (bytes/ms << 16)\n",
+	       (unsigned long long) lut.rate64,
+	       (unsigned long long) itp.rate64);
+}
+
+int main(void)
+{
+	u32 * inputs;
+	unsigned char * pressure;
+	u32 seed = 12345, i;
+
+	inputs   = malloc(NR_INPUTS * sizeof(*inputs));
+	pressure = calloc(1, PRESSURE_BYTES);
+	if (!inputs || !pressure) {
+		perror("malloc");
+		return 1;
+	}
+
+	printf("table footprint: lut %zu bytes, interp %zu bytes\n",
+	       3 * LGC_LUT_SIZE * sizeof(u32),
+	       3 * (LGC_INTERP_SEGS + 1) * sizeof(u32));
+
+	accuracy("log", lgc_log_lut_lookup, lgc_log_interp);
+	accuracy("pow", lgc_pow_lut_lookup, lgc_pow_interp);
+	accuracy("exp", lgc_exp_lut_lookup, lgc_exp_interp);
+
+	for (i = 0; i < NR_INPUTS; i++)
+		inputs[i] = i & (ONE - 1);
+	timing("sequential", inputs, &lgc_math_lut, NULL);
+	timing("sequential", inputs, &lgc_math_interp, NULL);
+
+	for (i = 0; i < NR_INPUTS; i++)
+		inputs[i] = lcg_next(&seed) & (ONE - 1);
+	timing("random", inputs, &lgc_math_lut, NULL);
+	timing("random", inputs, &lgc_math_interp, NULL);
+	timing("pressure", inputs, &lgc_math_lut, pressure);
+	timing("pressure", inputs, &lgc_math_interp, pressure);
+
+	control_loop();
+
+	free(pressure);
+	free(inputs);
+
+	return 0;
+}
@@ -12,4 +12,25 @@ inline u32 lgc_log_lut_lookup(u32);
 inline u32 lgc_pow_lut_lookup(u32);
 inline u32 lgc_exp_lut_lookup(u32);
 
-#endif
\ No newline at end of file
+/* Compact backend: 257-entry tables with linear interpolation between
+ * knots, same input/output scaling as the *_lut_lookup() functions.
+ */
+#define LGC_INTERP_SHIFT 8U
+#define LGC_INTERP_SEGS  (1U << LGC_INTERP_SHIFT)
+
+u32 lgc_log_interp(u32);
+u32 lgc_pow_interp(u32);
+u32 lgc_exp_interp(u32);
+
+/* Math backend used by the DTCP policy, selected with "math_backend" */
+struct lgc_math_ops {
+	const char * name;
+	u32 (* log)(u32);
+	u32 (* pow)(u32);
+	u32 (* exp)(u32);
+};
+
+extern const struct lgc_math_ops lgc_math_lut;
+extern const struct lgc_math_ops lgc_math_interp;
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * LGC-ShQ fixed-point math, compact backend
+ *
+ * Approximates the 65537-entry log/pow/exp lookup tables of tcp_lgc_lut.c
+ * with 257-entry tables and linear interpolation, so that the whole
+ * working set of a rate update stays within a few cache lines.
+ *
+ *    log: -log10(x / 2^16) * 2^16, computed as a normalized log2 where
+ *         only the mantissa goes through the table
+ *    pow: knots sampled every 2^8 from pow_lut
+ *    exp: knots sampled every 2^8 from exp_lut
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "tcp_lgc.h"
+
+#define LGC_ONE       65536U
+/* log10(2) scaled by 2^24 */
+#define LOG10_2_Q24   5050445U
+
+/* log10(1 + i/256) scaled by 2^24 */
+static const u32 log_mant_tbl[LGC_INTERP_SEGS + 1] = {
+	0, 28406, 56703, 84889, 112967, 140938, 168801, 196558,
+	224210, 251757, 279201, 306541, 333780, 360917, 387953, 414889,
+	441726, 468465, 495106, 521649, 548097, 574449, 600705, 626868,
+	652937, 678913, 704796, 730589, 756290, 781900, 807421, 832853,
+	858197, 883453, 908621, 933703, 958699, 983609, 1008434, 1033175,
+	1057833, 1082407, 1106899, 1131308, 1155636, 1179883, 1204050, 1228137,
+	1252144, 1276073, 1299923, 1323696, 1347391, 1371009, 1394551, 1418017,
+	1441408, 1464724, 1487966, 1511134, 1534228, 1557249, 1580198, 1603075,
+	1625880, 1648614, 1671278, 1693871, 1716394, 1738848, 1761232, 1783549,
+	1805797, 1827977, 1850090, 1872136, 1894116, 1916030, 1937878, 1959660,
+	1981378, 2003031, 2024620, 2046145, 2067607, 2089005, 2110341, 2131615,
+	2152827, 2173977, 2195066, 2216094, 2237062, 2257969, 2278817, 2299605,
+	2320334, 2341004, 2361616, 2382170, 2402666, 2423104, 2443485, 2463809,
+	2484077, 2504289, 2524444, 2544544, 2564589, 2584579, 2604514, 2624394,
+	2644221, 2663994, 2683713, 2703379, 2722992, 2742552, 2762061, 2781516,
+	2800921, 2820273, 2839575, 2858825, 2878025, 2897174, 2916273, 2935322,
+	2954321, 2973271, 2992172, 3011024, 3029827, 3048582, 3067289, 3085947,
+	3104558, 3123122, 3141639, 3160108, 3178531, 3196908, 3215238, 3233522,
+	3251760, 3269953, 3288101, 3306203, 3324261, 3342274, 3360243, 3378167,
+	3396047, 3413884, 3431677, 3449427, 3467133, 3484797, 3502418, 3519996,
+	3537532, 3555026, 3572479, 3589889, 3607258, 3624585, 3641872, 3659118,
+	3676322, 3693487, 3710611, 3727695, 3744738, 3761743, 3778707, 3795632,
+	3812518, 3829365, 3846173, 3862942, 3879673, 3896365, 3913020, 3929636,
+	3946214, 3962755, 3979259, 3995725, 4012154, 4028546, 4044901, 4061220,
+	4077502, 4093748, 4109957, 4126131, 4142269, 4158371, 4174438, 4190469,
+	4206465, 4222427, 4238353, 4254244, 4270101, 4285924, 4301712, 4317466,
+	4333186, 4348872, 4364525, 4380144, 4395729, 4411282, 4426801, 4442287,
+	4457740, 4473161, 4488549, 4503905, 4519228, 4534519, 4549779, 4565006,
+	4580201, 4595365, 4610498, 4625599, 4640668, 4655707, 4670715, 4685692,
+	4700638, 4715554, 4730439, 4745293, 4760118, 4774912, 4789677, 4804411,
+	4819116, 4833791, 4848437, 4863054, 4877641, 4892199, 4906728, 4921228,
+	4935699, 4950141, 4964555, 4978941, 4993298, 5007627, 5021928, 5036200,
+	5050445
+};
+
+/* pow_lut[i << 8] */
+static const u32 pow_knot_tbl[LGC_INTERP_SEGS + 1] = {
+	41021, 40764, 40508, 40255, 40002, 39752, 39502, 39255,
+	39009, 38764, 38521, 38280, 38040, 37802, 37565, 37329,
+	37095, 36863, 36632, 36402, 36174, 35947, 35722, 35498,
+	35276, 35055, 34835, 34617, 34400, 34184, 33970, 33757,
+	33545, 33335, 33126, 32919, 32712, 32507, 32304, 32101,
+	31900, 31700, 31501, 31304, 31108, 30913, 30719, 30527,
+	30335, 30145, 29956, 29768, 29582, 29396, 29212, 29029,
+	28847, 28666, 28487, 28308, 28131, 27955, 27779, 27605,
+	27432, 27260, 27089, 26920, 26751, 26583, 26417, 26251,
+	26087, 25923, 25761, 25599, 25439, 25279, 25121, 24963,
+	24807, 24652, 24497, 24344, 24191, 24039, 23889, 23739,
+	23590, 23442, 23295, 23149, 23004, 22860, 22717, 22575,
+	22433, 22292, 22153, 22014, 21876, 21739, 21603, 21467,
+	21333, 21199, 21066, 20934, 20803, 20672, 20543, 20414,
+	20286, 20159, 20033, 19907, 19782, 19658, 19535, 19413,
+	19291, 19170, 19050, 18931, 18812, 18694, 18577, 18461,
+	18345, 18230, 18116, 18002, 17889, 17777, 17666, 17555,
+	17445, 17336, 17227, 17119, 17012, 16905, 16799, 16694,
+	16589, 16485, 16382, 16279, 16177, 16076, 15975, 15875,
+	15776, 15677, 15578, 15481, 15384, 15287, 15192, 15096,
+	15002, 14908, 14814, 14721, 14629, 14537, 14446, 14356,
+	14266, 14176, 14088, 13999, 13912, 13824, 13738, 13652,
+	13566, 13481, 13397, 13313, 13229, 13146, 13064, 12982,
+	12901, 12820, 12739, 12660, 12580, 12501, 12423, 12345,
+	12268, 12191, 12114, 12039, 11963, 11888, 11814, 11740,
+	11666, 11593, 11520, 11448, 11376, 11305, 11234, 11164,
+	11094, 11024, 10955, 10886, 10818, 10750, 10683, 10616,
+	10550, 10483, 10418, 10352, 10288, 10223, 10159, 10095,
+	10032, 9969, 9907, 9845, 9783, 9722, 9661, 9600,
+	9540, 9480, 9421, 9362, 9303, 9245, 9187, 9129,
+	9072, 9015, 8959, 8902, 8847, 8791, 8736, 8681,
+	8627, 8573, 8519, 8466, 8413, 8360, 8308, 8256,
+	8204
+};
+
+/* exp_lut[i << 8] */
+static const u32 exp_knot_tbl[LGC_INTERP_SEGS + 1] = {
+	65536, 65280, 65024, 64768, 64512, 64256, 64000, 63744,
+	63488, 63232, 62976, 62720, 62464, 62208, 61952, 61696,
+	61440, 61184, 60928, 60672, 60416, 60160, 59904, 59648,
+	59392, 59136, 58880, 58624, 58368, 58112, 57856, 57600,
+	57344, 57088, 56832, 56576, 56320, 56064, 55808, 55552,
+	55296, 55040, 54784, 54528, 54272, 54016, 53760, 53504,
+	53248, 52992, 52736, 52480, 52224, 51968, 51712, 51456,
+	51200, 50944, 50688, 50432, 50176, 49920, 49664, 49408,
+	49152, 48896, 48640, 48384, 48128, 47872, 47616, 47360,
+	47104, 46848, 46592, 46336, 46080, 45824, 45568, 45312,
+	45056, 44800, 44544, 44288, 44032, 43776, 43520, 43264,
+	43008, 42752, 42496, 42240, 41984, 41728, 41472, 41216,
+	40960, 40704, 40448, 40192, 39936, 39680, 39424, 39168,
+	38912, 38656, 38400, 38144, 37888, 37632, 37376, 37120,
+	36864, 36608, 36352, 36096, 35840, 35584, 35328, 35072,
+	34816, 34560, 34304, 34048, 33792, 33536, 33280, 33024,
+	32768, 32512, 32256, 32000, 31744, 31488, 31232, 30976,
+	30720, 30464, 30208, 29952, 29696, 29440, 29184, 28928,
+	28672, 28416, 28160, 27904, 27648, 27391, 27136, 26880,
+	26624, 26368, 26112, 25855, 25600, 25344, 25088, 24832,
+	24576, 24319, 24063, 23808, 23551, 23295, 23039, 22784,
+	22527, 22272, 22016, 21760, 21504, 21248, 20992, 20736,
+	20480, 20224, 19968, 19712, 19456, 19200, 18944, 18688,
+	18432, 18176, 17920, 17664, 17408, 17152, 16896, 16640,
+	16384, 16128, 15872, 15616, 15359, 15104, 14848, 14592,
+	14335, 14080, 13824, 13568, 13311, 13055, 12800, 12544,
+	12288, 12032, 11776, 11520, 11264, 11008, 10752, 10496,
+	10240, 9984, 9728, 9472, 9215, 8960, 8704, 8448,
+	8192, 7936, 7679, 7423, 7168, 6911, 6655, 6400,
+	6143, 5888, 5632, 5376, 5120, 4864, 4608, 4351,
+	4096, 3840, 3584, 3328, 3071, 2815, 2560, 2304,
+	2048, 1792, 1536, 1280, 1024, 767, 512, 256,
+	0
+};
+
+static inline u32 interp(const u32 * tbl, u32 x)
+{
+	u32 idx  = x >> LGC_INTERP_SHIFT;
+	s32 frac = x & (LGC_INTERP_SEGS - 1);
+	s32 diff = (s32) tbl[idx + 1] - (s32) tbl[idx];
+
+	return (u32) ((s32) tbl[idx] + ((diff * frac) >> LGC_INTERP_SHIFT));
+}
+
+u32 lgc_log_interp(u32 fraction)
+{
+	u32 msb, mant, r24;
+
+	/* Same domain as lgc_log_lut_lookup(): log_lut[0] == log_lut[1] */
+	if (fraction >= LGC_ONE)
+		return 0u;
+	if (fraction == 0)
+		fraction = 1;
+
+	/* fraction = 2^msb * (1 + mant / 2^16) */
+	msb  = 31 - __builtin_clz(fraction);
+	mant = (fraction << (16 - msb)) - LGC_ONE;
+
+	r24  = (16 - msb) * LOG10_2_Q24;
+	r24 -= interp(log_mant_tbl, mant);
+
+	return r24 >> 8;
+}
+
+u32 lgc_pow_interp(u32 fraction)
+{
+	if (fraction >= LGC_ONE)
+		return pow_knot_tbl[LGC_INTERP_SEGS];
+
+	return interp(pow_knot_tbl, fraction);
+}
+
+u32 lgc_exp_interp(u32 fraction)
+{
+	if (fraction >= LGC_ONE)
+		return exp_knot_tbl[LGC_INTERP_SEGS];
+
+	return interp(exp_knot_tbl, fraction);
+}
+
+const struct lgc_math_ops lgc_math_lut = {
+	.name = "lut",
+	.log  = lgc_log_lut_lookup,
+	.pow  = lgc_pow_lut_lookup,
+	.exp  = lgc_exp_lut_lookup,
+};
+
+const struct lgc_math_ops lgc_math_interp = {
+	.name = "interp",
+	.log  = lgc_log_interp,
+	.pow  = lgc_pow_interp,
+	.exp  = lgc_exp_interp,
+};
@@ -30,6 +30,24 @@
 namespace rinad {
 namespace configs {
 static const std::string NEIGH_CONT_NAME = "/difManagement/enrollment/neighbors";
+
+/// Version of the objects of a RIB class that an IPC Process generated:
+/// the epoch identifies the incarnation of the IPC Process, the generation
+/// grows every time one of the objects of the class changes
+class RIBVersion {
+ public:
+        RIBVersion()
+                        : epoch_(0),
+                          generation_(0)
+        {
+        }
+        ;
+
+        std::string class_;
+        unsigned long long epoch_;
+        unsigned long long generation_;
+};
+
 /// The object that contains all the information
 /// that is required to initiate an enrollment
 /// request (send as the objectvalue of a CDAP M_START
@@ -49,6 +67,10 @@ class EnrollmentInformationRequest {
         std::list<rina::ApplicationProcessNamingInformation> supporting_difs_;
         bool allowed_to_start_early_;
         std::string token;
+
+        /// Versions of the RIB objects of the other end that the sender
+        /// already holds, so that only the changes have to be sent
+        std::list<RIBVersion> rib_versions_;
 };
 
 /// Encapsulates all the information required to manage a Flow
@@ -926,6 +926,24 @@ void ADataObjectEncoder::decode(const rina::ser_obj_t &serobj,
                gpb.cdapmessage().size());
 }
 
+namespace rib_version_helpers {
+void toGPB(const configs::RIBVersion &obj,
+           rina::messages::ribVersion_t &gpb)
+{
+        gpb.set_objclass(obj.class_);
+        gpb.set_epoch(obj.epoch_);
+        gpb.set_generation(obj.generation_);
+}
+
+void toModel(const rina::messages::ribVersion_t &gpb,
+             configs::RIBVersion &des_obj)
+{
+        des_obj.class_ = gpb.objclass();
+        des_obj.epoch_ = gpb.epoch();
+        des_obj.generation_ = gpb.generation();
+}
+}  // namespace rib_version_helpers
+
 // Class EnrollmentInformationRequestEncoder
 void EnrollmentInformationRequestEncoder::encode(
                 const configs::EnrollmentInformationRequest &obj,
@@ -944,6 +962,13 @@ void EnrollmentInformationRequestEncoder::encode(
                 gpb.add_supportingdifs(it->processName);
         }
 
+        for (std::list<configs::RIBVersion>::const_iterator it =
+                        obj.rib_versions_.begin();
+                        it != obj.rib_versions_.end(); ++it)
+        {
+                rib_version_helpers::toGPB(*it, *gpb.add_ribversions());
+        }
+
         serobj.size_ = gpb.ByteSizeLong();
         serobj.message_ = new unsigned char[serobj.size_];
         gpb.SerializeToArray(serobj.message_, serobj.size_);
@@ -966,6 +991,43 @@ void EnrollmentInformationRequestEncoder::decode(
                                 rina::ApplicationProcessNamingInformation(
                                                 gpb.supportingdifs(i), ""));
         }
+        for (int i = 0; i < gpb.ribversions_size(); ++i)
+        {
+                configs::RIBVersion version;
+                rib_version_helpers::toModel(gpb.ribversions(i), version);
+                des_obj.rib_versions_.push_back(version);
+        }
+}
+
+// Class RIBVersionListEncoder
+void RIBVersionListEncoder::encode(const std::list<configs::RIBVersion> &obj,
+                                   rina::ser_obj_t& serobj)
+{
+        rina::messages::ribVersionList_t gpb;
+
+        for (std::list<configs::RIBVersion>::const_iterator it = obj.begin();
+                        it != obj.end(); ++it)
+        {
+                rib_version_helpers::toGPB(*it, *gpb.add_ribversion());
+        }
+
+        serobj.size_ = gpb.ByteSizeLong();
+        serobj.message_ = new unsigned char[serobj.size_];
+        gpb.SerializeToArray(serobj.message_, serobj.size_);
+}
+
+void RIBVersionListEncoder::decode(const rina::ser_obj_t &serobj,
+                                   std::list<configs::RIBVersion> &des_obj)
+{
+        rina::messages::ribVersionList_t gpb;
+        gpb.ParseFromArray(serobj.message_, serobj.size_);
+
+        for (int i = 0; i < gpb.ribversion_size(); ++i)
+        {
+                configs::RIBVersion version;
+                rib_version_helpers::toModel(gpb.ribversion(i), version);
+                des_obj.push_back(version);
+        }
 }
 
 // CLASS FlowEncoder
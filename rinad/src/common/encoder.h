@@ -149,6 +149,16 @@ public:
                     configs::EnrollmentInformationRequest &des_obj);
 };
 
+/// Encoder of a list of RIBVersion
+class RIBVersionListEncoder : public rina::Encoder<
+                std::list<configs::RIBVersion> > {
+public:
+        void encode(const std::list<configs::RIBVersion> &obj,
+                    rina::ser_obj_t& serobj);
+        void decode(const rina::ser_obj_t &serobj,
+                    std::list<configs::RIBVersion> &des_obj);
+};
+
 /// Encoder of the Flow
 class FlowEncoder : public rina::Encoder<configs::Flow> {
 public:
@@ -172,9 +172,15 @@ struct LocalConfiguration {
 	/* The system name */
 	rina::ApplicationProcessNamingInformation system_name;
 
+	/*
+	 * Number of worker threads processing IPC events, sharded by IPCP.
+	 * 0 processes the events in the I/O thread
+	 */
+	unsigned int eventWorkers;
+
         std::string toString() const;
 
-        LocalConfiguration() { }
+        LocalConfiguration() : eventWorkers(0) { }
 };
 
 struct DIFTemplateMapping {
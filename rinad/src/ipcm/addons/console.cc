@@ -116,6 +116,18 @@ public:
 	}
 };
 
+class ShowEventStatsConsoleCmd: public rina::ConsoleCmdInfo {
+public:
+	ShowEventStatsConsoleCmd(IPCMConsole * console) :
+		rina::ConsoleCmdInfo("USAGE: show-event-stats", console) {};
+
+	int execute(std::vector<string>& args) {
+		IPCManager->print_event_stats(console->outstream);
+
+		return rina::UNIXConsole::CMDRETCONT;
+	}
+};
+
 class ListIPCPTypesConsoleCmd: public rina::ConsoleCmdInfo {
 public:
 	ListIPCPTypesConsoleCmd(IPCMConsole * console) :
@@ -901,6 +913,7 @@ IPCMConsole::IPCMConsole(const string& socket_path_) :
 	commands_map["update-catalog"] = new UpdateCatalogueConsoleCmd(this);
 	commands_map["query-ma-rib"] = new QueryMARIBConsoleCmd(this);
 	commands_map["list-da-map"] = new ListDIFAllocatorMapCmd(this);
+	commands_map["show-event-stats"] = new ShowEventStatsConsoleCmd(this);
 	commands_map["register-ip-vpn"] = new RegisterIPVPNConsoleCmd(this);
 	commands_map["unregister-ip-vpn"] = new UnegisterIPVPNConsoleCmd(this);
 	commands_map["allocate-ip-vpn-flow"] = new AllocateIPVPNFlowConsoleCmd(this);
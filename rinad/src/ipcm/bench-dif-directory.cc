@@ -0,0 +1,185 @@
+//
+// Benchmark of the DIF Allocator directory lookups
+//
+// Populates the application to DIF directory with a large number of
+// registered applications and measures the latency of the lookups done
+// on every flow allocation (application -> DIF, then DIF -> supporting
+// DIFs), comparing the indexed directory against a linear scan of the
+// mappings list. Both must return the same results.
+//
+//    bench-dif-directory [num-apps] [num-lookups]
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <time.h>
+
+#include "dif-directory.h"
+
+using namespace std;
+using namespace rinad;
+
+#define NUM_APPS_DEFAULT	100000
+#define NUM_LOOKUPS_DEFAULT	500
+#define NUM_DIFS		64
+#define NUM_SHIMS		4
+
+static unsigned long long now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// The lookups as done before the directory was indexed
+static bool linear_lookup(const DIFDirectory::mappings_t& mappings,
+			  const string& app_name,
+			  string& dif_name,
+			  list<string>& supporting_difs)
+{
+	DIFDirectory::mappings_t::const_iterator it, jt;
+
+	for (it = mappings.begin(); it != mappings.end(); ++it) {
+		if (it->first != app_name)
+			continue;
+
+		dif_name = it->second;
+		for (jt = mappings.begin(); jt != mappings.end(); ++jt) {
+			if (jt->first.compare(0, dif_name.size(), dif_name) == 0)
+				supporting_difs.push_back(jt->second);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static bool indexed_lookup(const DIFDirectory& directory,
+			   const string& app_name,
+			   string& dif_name,
+			   list<string>& supporting_difs)
+{
+	if (!directory.lookup(app_name, dif_name))
+		return false;
+
+	directory.find_by_prefix(dif_name, supporting_difs);
+	return true;
+}
+
+static string app_name(unsigned int i)
+{
+	stringstream ss;
+
+	ss << "rina.apps.bench.app" << i << "-1--";
+	return ss.str();
+}
+
+int main(int argc, char * argv[])
+{
+	DIFDirectory::mappings_t mappings;
+	DIFDirectory directory;
+	vector<string> queries;
+	unsigned int num_apps = NUM_APPS_DEFAULT;
+	unsigned int num_lookups = NUM_LOOKUPS_DEFAULT;
+	unsigned long long t0, t_linear, t_indexed;
+	unsigned int i, found = 0;
+
+	if (argc > 1)
+		num_apps = atoi(argv[1]);
+	if (argc > 2)
+		num_lookups = atoi(argv[2]);
+
+	// Every normal DIF is supported by a few shim DIFs, and every
+	// application is available through one normal DIF
+	for (i = 0; i < NUM_DIFS; i++) {
+		stringstream dif;
+
+		dif << "normal" << i << ".DIF";
+		for (unsigned int j = 0; j < NUM_SHIMS; j++) {
+			stringstream shim;
+
+			shim << "shim" << j << "." << dif.str();
+			mappings.push_back(make_pair(dif.str() + "-1--",
+						     shim.str()));
+		}
+	}
+	for (i = 0; i < num_apps; i++) {
+		stringstream dif;
+
+		dif << "normal" << i % NUM_DIFS << ".DIF";
+		mappings.push_back(make_pair(app_name(i), dif.str()));
+	}
+
+	t0 = now_ns();
+	directory.load(mappings);
+	cout << "Loaded " << directory.size() << " mappings in "
+	     << (now_ns() - t0) / 1000 << " us" << endl;
+
+	// One lookup out of 8 is for an unknown application
+	srand(1);
+	for (i = 0; i < num_lookups; i++) {
+		if (i % 8 == 7)
+			queries.push_back(app_name(num_apps + i));
+		else
+			queries.push_back(app_name(rand() % num_apps));
+	}
+
+	for (i = 0; i < num_lookups; i++) {
+		string d1, d2;
+		list<string> s1, s2;
+		bool r1, r2;
+
+		r1 = linear_lookup(mappings, queries[i], d1, s1);
+		r2 = indexed_lookup(directory, queries[i], d2, s2);
+		if (r1 != r2 || d1 != d2 || s1 != s2) {
+			cerr << "Mismatch looking up " << queries[i] << endl;
+			return EXIT_FAILURE;
+		}
+		if (r1)
+			found++;
+	}
+
+	t0 = now_ns();
+	for (i = 0; i < num_lookups; i++) {
+		string d;
+		list<string> s;
+
+		linear_lookup(mappings, queries[i], d, s);
+	}
+	t_linear = now_ns() - t0;
+
+	t0 = now_ns();
+	for (i = 0; i < num_lookups; i++) {
+		string d;
+		list<string> s;
+
+		indexed_lookup(directory, queries[i], d, s);
+	}
+	t_indexed = now_ns() - t0;
+
+	cout << num_apps << " applications, " << num_lookups
+	     << " lookups (" << found << " hits)" << endl;
+	cout << "    linear scan: " << t_linear / num_lookups
+	     << " ns/lookup" << endl;
+	cout << "    indexed:     " << t_indexed / num_lookups
+	     << " ns/lookup" << endl;
+
+	return EXIT_SUCCESS;
+}
@@ -243,6 +243,7 @@ StaticDIFAllocator::~StaticDIFAllocator()
 
 int StaticDIFAllocator::set_config(const DIFAllocatorConfig& da_config)
 {
+	DIFDirectory::mappings_t mappings;
 	std::string folder_name;
 	rina::Parameter folder_name_parm;
 	stringstream ss;
@@ -269,11 +270,12 @@ int StaticDIFAllocator::set_config(const DIFAllocatorConfig& da_config)
 	joinable_difs = da_config.joinable_difs;
 
 	//load current mappings
-	if (!parse_app_to_dif_mappings(fq_file_name, dif_directory)) {
+	if (!parse_app_to_dif_mappings(fq_file_name, mappings)) {
 		LOG_ERR("Problems loading initial directory");
 		return -1;
 	}
 
+	dif_directory.load(mappings);
 	print_directory_contents();
 
 	return 0;
@@ -284,30 +286,20 @@ da_res_t StaticDIFAllocator::lookup_dif_by_application(const rina::ApplicationPr
 						       std::list<std::string>& supporting_difs)
 {
 	rina::ReadScopedLock g(directory_lock);
-        string encoded_name = app_name.getEncodedString();
-        std::list< std::pair<std::string, std::string> >::iterator it;
-        std::list<std::string>::const_iterator jt;
-
-        for (it = dif_directory.begin(); it != dif_directory.end(); ++it) {
-        	if (it->first == encoded_name) {
-        		result.processName = it->second;
-        		find_supporting_difs(supporting_difs, it->second);
-        		return DA_SUCCESS;
-        	}
-        }
+	std::string dif_name;
+
+	if (!dif_directory.lookup(app_name.getEncodedString(), dif_name))
+		return DA_FAILURE;
 
-        return DA_FAILURE;
+	result.processName = dif_name;
+	find_supporting_difs(supporting_difs, dif_name);
+	return DA_SUCCESS;
 }
 
 void StaticDIFAllocator::find_supporting_difs(std::list<std::string>& supporting_difs,
         				      const std::string& dif_name)
 {
-	std::list< std::pair<std::string, std::string> >::iterator it;
-
-	for (it = dif_directory.begin(); it != dif_directory.end(); ++it) {
-		if (it->first.compare(0, dif_name.size(), dif_name) == 0)
-			supporting_difs.push_back(it->second);
-	}
+	dif_directory.find_by_prefix(dif_name, supporting_difs);
 }
 
 void StaticDIFAllocator::app_registered(const rina::ApplicationProcessNamingInformation & app_name,
@@ -329,11 +321,14 @@ void StaticDIFAllocator::assigned_to_dif(const std::string& dif_name)
 
 void StaticDIFAllocator::update_directory_contents()
 {
+	DIFDirectory::mappings_t mappings;
+
 	rina::WriteScopedLock g(directory_lock);
-	dif_directory.clear();
-	if (!parse_app_to_dif_mappings(fq_file_name, dif_directory)) {
+	if (!parse_app_to_dif_mappings(fq_file_name, mappings)) {
+	    dif_directory.clear();
 	    LOG_ERR("Problems while updating DIF Allocator Directory!");
         } else {
+	    dif_directory.load(mappings);
 	    LOG_DBG("DIF Allocator Directory updated!");
 	    print_directory_contents();
         }
@@ -341,11 +336,12 @@ void StaticDIFAllocator::update_directory_contents()
 
 void StaticDIFAllocator::list_da_mappings(std::ostream& os)
 {
-	std::list< std::pair<std::string, std::string> >::iterator it;
+	DIFDirectory::mappings_t::const_iterator it;
 
 	rina::ReadScopedLock g(directory_lock);
 
-	for (it = dif_directory.begin(); it != dif_directory.end(); ++it) {
+	for (it = dif_directory.get_mappings().begin();
+			it != dif_directory.get_mappings().end(); ++it) {
 		os << "Application name: " << it->first
 		   << "; DIF name: " << it->second << std::endl;
 	}
@@ -359,11 +355,12 @@ void StaticDIFAllocator::get_ipcp_name_for_dif(rina::ApplicationProcessNamingInf
 
 void StaticDIFAllocator::print_directory_contents()
 {
-	std::list< std::pair<std::string, std::string> >::iterator it;
+	DIFDirectory::mappings_t::const_iterator it;
 	std::stringstream ss;
 
 	ss << "Application to DIF mappings" << std::endl;
-	for (it = dif_directory.begin(); it != dif_directory.end(); ++it) {
+	for (it = dif_directory.get_mappings().begin();
+			it != dif_directory.get_mappings().end(); ++it) {
 		ss << "Application name: " << it->first
 		   << "; DIF name: " << it->second << std::endl;
 	}
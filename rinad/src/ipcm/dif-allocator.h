@@ -28,6 +28,7 @@
 
 #include "rina-configuration.h"
 #include "ipcm.h"
+#include "dif-directory.h"
 
 namespace rinad {
 
@@ -59,7 +60,7 @@ private:
         std::string fq_file_name;
 
 	//The current DIF Directory
-	std::list< std::pair<std::string, std::string> > dif_directory;
+	DIFDirectory dif_directory;
 
 	std::list<NeighborData> joinable_difs;
 
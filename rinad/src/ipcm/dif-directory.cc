@@ -0,0 +1,91 @@
+/*
+ * Indexed application to DIF directory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#include <algorithm>
+
+#include "dif-directory.h"
+
+namespace rinad {
+
+void DIFDirectory::load(const mappings_t& new_mappings)
+{
+	mappings_t::const_iterator it;
+	unsigned int pos = 0;
+
+	clear();
+
+	mappings = new_mappings;
+	difs.reserve(mappings.size());
+	for (it = mappings.begin(); it != mappings.end(); ++it, ++pos) {
+		difs.push_back(it->second);
+		// insert() keeps the first mapping of a duplicated name
+		by_app.insert(std::make_pair(it->first, pos));
+		by_prefix.insert(std::make_pair(it->first, pos));
+	}
+}
+
+void DIFDirectory::clear()
+{
+	mappings.clear();
+	difs.clear();
+	by_app.clear();
+	by_prefix.clear();
+}
+
+bool DIFDirectory::lookup(const std::string& app_name,
+			  std::string& dif_name) const
+{
+	std::map<std::string, unsigned int>::const_iterator it;
+
+	it = by_app.find(app_name);
+	if (it == by_app.end())
+		return false;
+
+	dif_name = difs[it->second];
+	return true;
+}
+
+void DIFDirectory::find_by_prefix(const std::string& prefix,
+				  std::list<std::string>& dif_names) const
+{
+	std::multimap<std::string, unsigned int>::const_iterator it;
+	std::vector<unsigned int> positions;
+	std::vector<unsigned int>::iterator pit;
+
+	for (it = by_prefix.lower_bound(prefix); it != by_prefix.end() &&
+			it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+		positions.push_back(it->second);
+
+	// Restore file order
+	std::sort(positions.begin(), positions.end());
+	for (pit = positions.begin(); pit != positions.end(); ++pit)
+		dif_names.push_back(difs[*pit]);
+}
+
+const DIFDirectory::mappings_t& DIFDirectory::get_mappings() const
+{
+	return mappings;
+}
+
+unsigned int DIFDirectory::size() const
+{
+	return mappings.size();
+}
+
+} //namespace rinad
@@ -0,0 +1,72 @@
+/*
+ * Indexed application to DIF directory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#ifndef __DIF_DIRECTORY_H__
+#define __DIF_DIRECTORY_H__
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rinad {
+
+/// Application to DIF mappings as read from the directory file, indexed
+/// for the lookups done on every flow allocation. Mappings keep the order
+/// of the file: for an application name the first mapping wins, and
+/// supporting DIFs are returned in file order.
+class DIFDirectory {
+public:
+	typedef std::list< std::pair<std::string, std::string> > mappings_t;
+
+	/// Replaces the contents of the directory and rebuilds the indexes
+	void load(const mappings_t& mappings);
+	void clear();
+
+	/// Returns the DIF of the first mapping for the encoded application
+	/// name, or false if there is none
+	bool lookup(const std::string& app_name, std::string& dif_name) const;
+
+	/// Appends the DIFs of all mappings whose application name starts with
+	/// prefix
+	void find_by_prefix(const std::string& prefix,
+			    std::list<std::string>& dif_names) const;
+
+	const mappings_t& get_mappings() const;
+	unsigned int size() const;
+
+private:
+	/// Mappings in file order
+	mappings_t mappings;
+
+	/// DIF name of every mapping, by position in the file
+	std::vector<std::string> difs;
+
+	/// Exact match index: application name -> position of its first
+	/// mapping
+	std::map<std::string, unsigned int> by_app;
+
+	/// Prefix index: application names in lexicographical order, so that
+	/// all names sharing a prefix form a contiguous range
+	std::multimap<std::string, unsigned int> by_prefix;
+};
+
+} //namespace rinad
+
+#endif  /* __DIF_DIRECTORY_H__ */
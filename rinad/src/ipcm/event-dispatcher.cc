@@ -0,0 +1,194 @@
+/*
+ * Parallel dispatch of IPC events to a pool of worker threads
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#include <sstream>
+#include <iomanip>
+
+#define RINA_PREFIX     "ipcm.event-dispatcher"
+#include <librina/logs.h>
+
+#include "event-dispatcher.h"
+#include "ipcm.h"
+
+using namespace std;
+
+namespace rinad {
+
+//Class IPCMEventWorker
+IPCMEventWorker::IPCMEventWorker(IPCMEventDispatcher * d, unsigned int i)
+		: rina::SimpleThread(std::string("ipcm-event-worker"), false),
+		  id(i), dispatcher(d)
+{
+}
+
+IPCMEventWorker::~IPCMEventWorker() throw()
+{
+}
+
+int IPCMEventWorker::run()
+{
+	QueuedIPCEvent * qe;
+	rina::IPCEvent * event;
+
+	LOG_DBG("Event worker %u started", id);
+
+	while (true) {
+		qe = queue.take();
+		event = qe->event;
+
+		// A NULL event is the stop request, queued after all the
+		// pending events of this worker
+		if (!event) {
+			delete qe;
+			break;
+		}
+
+		dispatcher->account(event->eventType, qe->enqueued);
+		delete qe;
+
+		IPCManager->process_event(event);
+	}
+
+	LOG_DBG("Event worker %u stopped", id);
+
+	return 0;
+}
+
+//Class IPCMEventDispatcher
+IPCMEventDispatcher::IPCMEventDispatcher(unsigned int num_workers)
+		: started(false)
+{
+	for (unsigned int i = 0; i < num_workers; i++)
+		workers.push_back(new IPCMEventWorker(this, i));
+}
+
+IPCMEventDispatcher::~IPCMEventDispatcher()
+{
+	stop();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		delete workers[i];
+}
+
+unsigned int IPCMEventDispatcher::num_workers() const
+{
+	return workers.size();
+}
+
+void IPCMEventDispatcher::start()
+{
+	if (started)
+		return;
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i]->start();
+
+	started = true;
+
+	LOG_INFO("Started %u IPC event workers", (unsigned int) workers.size());
+}
+
+unsigned int IPCMEventDispatcher::shard(const rina::IPCEvent * event) const
+{
+	// Application events are keyed by the IPCP they target, so that they
+	// keep their order with the events that IPCP sends for the same
+	// flows and registrations
+	return IPCManager->get_event_target_ipcp(event) % workers.size();
+}
+
+void IPCMEventDispatcher::dispatch(rina::IPCEvent * event)
+{
+	QueuedIPCEvent * qe;
+
+	if (!started || workers.empty()) {
+		IPCManager->process_event(event);
+		return;
+	}
+
+	qe = new QueuedIPCEvent();
+	qe->event = event;
+	clock_gettime(CLOCK_MONOTONIC, &qe->enqueued);
+
+	workers[shard(event)]->queue.put(qe);
+}
+
+void IPCMEventDispatcher::stop()
+{
+	QueuedIPCEvent * qe;
+	void * status;
+
+	if (!started)
+		return;
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		qe = new QueuedIPCEvent();
+		qe->event = NULL;
+		workers[i]->queue.put(qe);
+	}
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i]->join(&status);
+
+	started = false;
+}
+
+void IPCMEventDispatcher::account(rina::IPCEventType type,
+				  const struct timespec& enqueued)
+{
+	struct timespec now;
+	unsigned long long delay_us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	delay_us = (now.tv_sec - enqueued.tv_sec) * 1000000ULL +
+		   (now.tv_nsec - enqueued.tv_nsec) / 1000;
+
+	rina::ScopedLock g(stats_lock);
+	EventDelayStats& s = delay_stats[type];
+	s.count++;
+	s.total_us += delay_us;
+	if (delay_us > s.max_us)
+		s.max_us = delay_us;
+}
+
+void IPCMEventDispatcher::print_stats(std::ostream& os)
+{
+	std::map<rina::IPCEventType, EventDelayStats>::const_iterator it;
+
+	os << "Event workers: " << workers.size() << endl;
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		os << "    worker " << i << ": "
+		   << workers[i]->queue.size() << " queued" << endl;
+	}
+
+	rina::ScopedLock g(stats_lock);
+
+	os << "Queueing delay per event type (us):" << endl;
+	os << "    " << setw(48) << left << "event type"
+	   << setw(10) << right << "count"
+	   << setw(12) << "avg" << setw(12) << "max" << endl;
+	for (it = delay_stats.begin(); it != delay_stats.end(); ++it) {
+		os << "    " << setw(48) << left
+		   << rina::IPCEvent::eventTypeToString(it->first)
+		   << setw(10) << right << it->second.count
+		   << setw(12) << it->second.total_us / it->second.count
+		   << setw(12) << it->second.max_us << endl;
+	}
+}
+
+} //namespace rinad
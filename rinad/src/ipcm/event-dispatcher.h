@@ -0,0 +1,105 @@
+/*
+ * Parallel dispatch of IPC events to a pool of worker threads
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301  USA
+ */
+
+#ifndef __EVENT_DISPATCHER_H__
+#define __EVENT_DISPATCHER_H__
+
+#include <time.h>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include <librina/common.h>
+#include <librina/concurrency.h>
+
+namespace rinad {
+
+class IPCMEventDispatcher;
+
+/// An event waiting in a worker queue, with its enqueue timestamp
+struct QueuedIPCEvent {
+	rina::IPCEvent * event;
+	struct timespec enqueued;
+};
+
+/// Per event type queueing delay accounting
+struct EventDelayStats {
+	unsigned long count;
+	unsigned long long total_us;
+	unsigned long long max_us;
+
+	EventDelayStats() : count(0), total_us(0), max_us(0) { }
+};
+
+/// Worker thread, processes the events of the shards mapped to it in
+/// arrival order
+class IPCMEventWorker: public rina::SimpleThread {
+public:
+	IPCMEventWorker(IPCMEventDispatcher * dispatcher, unsigned int id);
+	~IPCMEventWorker() throw();
+	int run();
+
+	rina::BlockingFIFOQueue<QueuedIPCEvent> queue;
+	unsigned int id;
+
+private:
+	IPCMEventDispatcher * dispatcher;
+};
+
+/// Shards the events by the id of the IPCP they operate on onto a pool
+/// of workers. Application events are mapped to their target IPCP (by
+/// DIF name, port-id or pending transaction), so the events of one IPCP
+/// are always handled by the same worker in arrival order while
+/// independent IPCPs progress in parallel. Events whose target cannot
+/// be resolved when they arrive (no DIF given, unknown port-id) go to
+/// the first worker, so they are not ordered with the events of the
+/// IPCP that ends up serving them.
+class IPCMEventDispatcher {
+public:
+	IPCMEventDispatcher(unsigned int num_workers);
+	~IPCMEventDispatcher();
+
+	void start();
+
+	/// Hands over ownership of the event to a worker
+	void dispatch(rina::IPCEvent * event);
+
+	/// Waits for all queued events to be processed and joins the workers
+	void stop();
+
+	/// Dumps queueing delay per event type and worker queue depths
+	void print_stats(std::ostream& os);
+
+	unsigned int num_workers() const;
+
+private:
+	friend class IPCMEventWorker;
+
+	unsigned int shard(const rina::IPCEvent * event) const;
+	void account(rina::IPCEventType type, const struct timespec& enqueued);
+
+	std::vector<IPCMEventWorker *> workers;
+	std::map<rina::IPCEventType, EventDelayStats> delay_stats;
+	rina::Lockable stats_lock;
+	bool started;
+};
+
+} //namespace rinad
+
+#endif  /* __EVENT_DISPATCHER_H__ */
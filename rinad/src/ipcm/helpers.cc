@@ -32,6 +32,7 @@
 #include <librina/logs.h>
 
 #include "ipcm.h"
+#include "flow-alloc-handlers.h"
 
 using namespace std;
 
@@ -265,4 +266,100 @@ IPCManager_::is_any_ipcp_assigned_to_dif(const rina::ApplicationProcessNamingInf
 	return false;
 }
 
+// Returns the id of the IPC process an event operates on, resolving it
+// the same way the event handler will, or 0 if it cannot be told from
+// the event alone.
+unsigned short
+IPCManager_::get_event_target_ipcp(const rina::IPCEvent *event)
+{
+	IPCMIPCProcess *ipcp = NULL;
+	unsigned short id;
+
+	switch (event->eventType) {
+	case rina::FLOW_ALLOCATION_REQUESTED_EVENT: {
+		const rina::FlowRequestEvent *e =
+			static_cast<const rina::FlowRequestEvent *>(event);
+
+		// Remote requests come from the IPCP providing the flow,
+		// local ones go to the DIF they name, if any
+		if (!e->localRequest)
+			return event->ipcp_id;
+		if (e->DIFName.processName == "")
+			return 0;
+		ipcp = select_ipcp_by_dif(e->DIFName);
+		break;
+	}
+	case rina::ALLOCATE_FLOW_RESPONSE_EVENT: {
+		std::map<int, TransactionState*>::iterator it;
+		FlowAllocTransState *trans;
+
+		rina::ReadScopedLock readlock(trans_rwlock);
+
+		it = pend_transactions.find(event->sequenceNumber);
+		if (it == pend_transactions.end())
+			return 0;
+		trans = dynamic_cast<FlowAllocTransState *>(it->second);
+
+		return trans ? trans->slave_ipcp_id : 0;
+	}
+	case rina::FLOW_DEALLOCATION_REQUESTED_EVENT:
+		ipcp = lookup_ipcp_by_port(static_cast<const
+				rina::FlowDeallocateRequestEvent *>(event)->portId);
+		break;
+	case rina::FLOW_DEALLOCATED_EVENT:
+		ipcp = lookup_ipcp_by_port(static_cast<const
+				rina::FlowDeallocatedEvent *>(event)->portId);
+		if (!ipcp)
+			return event->ipcp_id;
+		break;
+	case rina::APPLICATION_REGISTRATION_REQUEST_EVENT: {
+		const rina::ApplicationRegistrationInformation& info =
+			static_cast<const rina::ApplicationRegistrationRequestEvent *>
+			(event)->applicationRegistrationInformation;
+
+		// Registrations to any DIF are left to the DIF allocator
+		if (info.applicationRegistrationType !=
+				rina::APPLICATION_REGISTRATION_SINGLE_DIF)
+			return 0;
+		ipcp = select_ipcp_by_dif(info.difName);
+		break;
+	}
+	case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT: {
+		const rina::ApplicationUnregistrationRequestEvent *e =
+			static_cast<const rina::ApplicationUnregistrationRequestEvent *>
+			(event);
+
+		if (e->DIFName.processName == "")
+			ipcp = select_ipcp_by_reg_app(e->applicationName);
+		else
+			ipcp = select_ipcp_by_dif(e->DIFName);
+		break;
+	}
+	case rina::GET_DIF_PROPERTIES: {
+		const rina::GetDIFPropertiesRequestEvent *e =
+			static_cast<const rina::GetDIFPropertiesRequestEvent *>
+			(event);
+
+		if (e->DIFName.processName == "")
+			return 0;
+		ipcp = select_ipcp_by_dif(e->DIFName);
+		break;
+	}
+	default:
+		// Events coming from an IPCP concern the IPCP itself
+		return event->ipcp_id;
+	}
+
+	if (!ipcp)
+		return 0;
+
+	{
+		//Auto release the read lock
+		rina::ReadScopedLock readlock(ipcp->rwlock, false);
+		id = ipcp->get_id();
+	}
+
+	return id;
+}
+
 } //rinad namespace
@@ -88,6 +88,7 @@ Singleton<IPCManager_> IPCManager;
 IPCManager_::IPCManager_()
         : req_to_stop(false),
           io_thread(NULL),
+          event_dispatcher(NULL),
           dif_template_manager(NULL),
           dif_allocator(NULL),
 	  osp_monitor(NULL),
@@ -112,6 +113,10 @@ IPCManager_::~IPCManager_()
 	        delete ip_vpn_manager;
 	}
 
+	if (event_dispatcher) {
+		delete event_dispatcher;
+	}
+
 	forwarded_calls.clear();
 
 	for (std::map<int, TransactionState*>::iterator
@@ -142,6 +147,14 @@ void IPCManager_::init(const std::string& loglevel, std::string& config_file)
         //catalog.print();
 
         // Initialize the I/O thread
+        // Dispatch events to a pool of workers, sharded by IPCP,
+        // instead of handling them inline in the I/O thread
+        if (config.local.eventWorkers > 0) {
+            event_dispatcher =
+                    new IPCMEventDispatcher(config.local.eventWorkers);
+            event_dispatcher->start();
+        }
+
         io_thread = new rina::Thread(io_loop_trampoline, NULL,
                                      std::string("ipcm-io-thread"), false);
         io_thread->start();
@@ -384,6 +397,17 @@ void IPCManager_::list_da_mappings(std::ostream& os)
 	dif_allocator->list_da_mappings(os);
 }
 
+void IPCManager_::print_event_stats(std::ostream& os)
+{
+	if (!event_dispatcher) {
+		os << "Event workers disabled, events are processed by the "
+		   << "I/O thread" << std::endl;
+		return;
+	}
+
+	event_dispatcher->print_stats(os);
+}
+
 std::string IPCManager_::query_ma_rib()
 {
 	std::stringstream ss;
@@ -2111,210 +2135,238 @@ delegated_stored_t* IPCManager_::get_forwarded_object(int invoke_id,
         }
 }
 
-//static
-void* IPCManager_::io_loop_trampoline(void* param)
+void IPCManager_::process_event(rina::IPCEvent *event)
 {
-    IPCManager->io_loop();
-    return NULL;
-}
+    LOG_DBG("Got event of type %s and sequence number %u",
+            rina::IPCEvent::eventTypeToString(event->eventType).c_str(),
+            event->sequenceNumber);
 
-void IPCManager_::io_loop()
-{
-    rina::IPCEvent *event;
+    try
+    {
+        switch (event->eventType) {
+            case rina::FLOW_ALLOCATION_REQUESTED_EVENT: {
+                DOWNCAST_DECL(event, rina::FlowRequestEvent, e);
+                flow_allocation_requested_event_handler(NULL, e);
+            }
+                break;
 
-    LOG_DBG("Starting main I/O loop...");
+            case rina::ALLOCATE_FLOW_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::AllocateFlowResponseEvent, e);
+                allocate_flow_response_event_handler(e);
+            }
+                break;
 
-    while (true)
-    {
-        event = rina::ipcEventProducer->eventWait();
-        if (!event) {
-        	LOG_WARN("Event is NULL");
-        	rina::librina_finalize();
-        	stop_cond.signal();
-        	break;
-        }
+            case rina::FLOW_DEALLOCATION_REQUESTED_EVENT: {
+                DOWNCAST_DECL(event, rina::FlowDeallocateRequestEvent, e);
+                flow_deallocation_requested_event_handler(NULL, e);
+            }
+                break;
 
-        if (event->eventType == rina::IPCM_FINALIZATION_REQUEST_EVENT && req_to_stop)
-        {
-        	//Signal the main thread to start
-        	//the stop procedure
-        	LOG_INFO("IPCM event loop requested to stop");
+            case rina::FLOW_DEALLOCATED_EVENT: {
+                DOWNCAST_DECL(event, rina::FlowDeallocatedEvent, e);
+                IPCManager->flow_deallocated_event_handler(e);
+            }
+                break;
+            case rina::APPLICATION_REGISTRATION_REQUEST_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::ApplicationRegistrationRequestEvent, e);
+                app_reg_req_handler(e);
+            }
+                break;
 
-        	void * status;
-        	if (osp_monitor) {
-        		osp_monitor->do_stop();
-        		osp_monitor->join(&status);
+            case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::ApplicationUnregistrationRequestEvent,
+                              e);
+                application_unregistration_request_event_handler(e);
+            }
+                break;
 
-        		delete osp_monitor;
-        	}
+            case rina::ASSIGN_TO_DIF_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::AssignToDIFResponseEvent, e);
+                assign_to_dif_response_event_handler(e);
+            }
+                break;
 
-        	stop_cond.signal();
-        	break;
-        }
+            case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::UpdateDIFConfigurationResponseEvent, e);
+                update_dif_config_response_event_handler(e);
+            }
+                break;
 
-        LOG_DBG("Got event of type %s and sequence number %u",
-                rina::IPCEvent::eventTypeToString(event->eventType).c_str(),
-                event->sequenceNumber);
+            case rina::ENROLL_TO_DIF_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::EnrollToDIFResponseEvent, e);
+                enroll_to_dif_response_event_handler(e);
+            }
+                break;
 
-        try
-        {
-            switch (event->eventType) {
-                case rina::FLOW_ALLOCATION_REQUESTED_EVENT: {
-                    DOWNCAST_DECL(event, rina::FlowRequestEvent, e);
-                    flow_allocation_requested_event_handler(NULL, e);
-                }
-                    break;
+            case rina::DISCONNECT_NEIGHBOR_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::DisconnectNeighborResponseEvent, e);
+                disconnect_neighbor_response_event_handler(e);
+            }
+                break;
 
-                case rina::ALLOCATE_FLOW_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::AllocateFlowResponseEvent, e);
-                    allocate_flow_response_event_handler(e);
-                }
-                    break;
+            case rina::IPCM_REGISTER_APP_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::IpcmRegisterApplicationResponseEvent, e);
+                app_reg_response_handler(e);
+            }
+                break;
 
-                case rina::FLOW_DEALLOCATION_REQUESTED_EVENT: {
-                    DOWNCAST_DECL(event, rina::FlowDeallocateRequestEvent, e);
-                    flow_deallocation_requested_event_handler(NULL, e);
-                }
-                    break;
+            case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event,
+                              rina::IpcmUnregisterApplicationResponseEvent,
+                              e);
+                unreg_app_response_handler(e);
+            }
+                break;
 
-                case rina::FLOW_DEALLOCATED_EVENT: {
-                    DOWNCAST_DECL(event, rina::FlowDeallocatedEvent, e);
-                    IPCManager->flow_deallocated_event_handler(e);
-                }
-                    break;
-                case rina::APPLICATION_REGISTRATION_REQUEST_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::ApplicationRegistrationRequestEvent, e);
-                    app_reg_req_handler(e);
-                }
-                    break;
+            case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT: {
+                DOWNCAST_DECL(event,
+                              rina::IpcmAllocateFlowRequestResultEvent, e);
+                ipcm_allocate_flow_request_result_handler(e);
+            }
+                break;
 
-                case rina::APPLICATION_UNREGISTRATION_REQUEST_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::ApplicationUnregistrationRequestEvent,
-                                  e);
-                    application_unregistration_request_event_handler(e);
-                }
-                    break;
+            case rina::QUERY_RIB_RESPONSE_EVENT: {
+                DOWNCAST_DECL(event, rina::QueryRIBResponseEvent, e);
+                query_rib_response_event_handler(e);
+            }
+                break;
 
-                case rina::ASSIGN_TO_DIF_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::AssignToDIFResponseEvent, e);
-                    assign_to_dif_response_event_handler(e);
-                }
-                    break;
+            case rina::IPC_PROCESS_DAEMON_INITIALIZED_EVENT: {
+                DOWNCAST_DECL(event,
+            		  rina::IPCProcessDaemonInitializedEvent, e);
+                ipc_process_daemon_initialized_event_handler(e);
+            }
+                break;
 
-                case rina::UPDATE_DIF_CONFIG_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::UpdateDIFConfigurationResponseEvent, e);
-                    update_dif_config_response_event_handler(e);
-                }
-                    break;
+                //Policies
+            case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE: {
+                DOWNCAST_DECL(event, rina::SetPolicySetParamResponseEvent,
+                              e);
+                ipc_process_set_policy_set_param_response_handler(e);
+            }
+                break;
+            case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE: {
+                DOWNCAST_DECL(event, rina::SelectPolicySetResponseEvent, e);
+                ipc_process_select_policy_set_response_handler(e);
+            }
+                break;
+            case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE: {
+                DOWNCAST_DECL(event, rina::PluginLoadResponseEvent, e);
+                ipc_process_plugin_load_response_handler(e);
+            }
+                break;
 
-                case rina::ENROLL_TO_DIF_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::EnrollToDIFResponseEvent, e);
-                    enroll_to_dif_response_event_handler(e);
-                }
-                    break;
+            case rina::IPCM_CREATE_IPCP_RESPONSE: {
+                DOWNCAST_DECL(event, rina::CreateIPCPResponseEvent, e);
+                ipc_process_create_response_event_handler(e);
+            }
+                break;
 
-                case rina::DISCONNECT_NEIGHBOR_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::DisconnectNeighborResponseEvent, e);
-                    disconnect_neighbor_response_event_handler(e);
-                }
-                    break;
+            case rina::IPCM_DESTROY_IPCP_RESPONSE: {
+                DOWNCAST_DECL(event, rina::DestroyIPCPResponseEvent, e);
+                ipc_process_destroy_response_event_handler(e);
+            }
+                break;
 
-                case rina::IPCM_REGISTER_APP_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::IpcmRegisterApplicationResponseEvent, e);
-                    app_reg_response_handler(e);
-                }
-                    break;
+                //Addon specific events
+            default:
+            {
+                TransactionState* trans = get_transaction_state<
+                        TransactionState>(event->sequenceNumber);
 
-                case rina::IPCM_UNREGISTER_APP_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event,
-                                  rina::IpcmUnregisterApplicationResponseEvent,
-                                  e);
-                    unreg_app_response_handler(e);
-                }
-                    break;
+                Addon::distribute_flow_event(event);
 
-                case rina::IPCM_ALLOCATE_FLOW_REQUEST_RESULT: {
-                    DOWNCAST_DECL(event,
-                                  rina::IpcmAllocateFlowRequestResultEvent, e);
-                    ipcm_allocate_flow_request_result_handler(e);
+                if (trans)
+                {
+                    //Mark as completed
+                    trans->completed(IPCM_SUCCESS);
+                    remove_transaction_state(trans->tid);
                 }
-                    break;
 
-                case rina::QUERY_RIB_RESPONSE_EVENT: {
-                    DOWNCAST_DECL(event, rina::QueryRIBResponseEvent, e);
-                    query_rib_response_event_handler(e);
-                }
-                    break;
+                // Ownership of the event passed to the addons
+                return;
+            }
+        }
 
-                case rina::IPC_PROCESS_DAEMON_INITIALIZED_EVENT: {
-                    DOWNCAST_DECL(event,
-                		  rina::IPCProcessDaemonInitializedEvent, e);
-                    ipc_process_daemon_initialized_event_handler(e);
-                }
-                    break;
+    } catch (rina::Exception &e)
+    {
+        LOG_ERR("ERROR while processing event %d: %s",event->eventType,
+        		e.what());
+        //TODO: move locking to a smaller scope
+    }
 
-                    //Policies
-                case rina::IPC_PROCESS_SET_POLICY_SET_PARAM_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::SetPolicySetParamResponseEvent,
-                                  e);
-                    ipc_process_set_policy_set_param_response_handler(e);
-                }
-                    break;
-                case rina::IPC_PROCESS_SELECT_POLICY_SET_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::SelectPolicySetResponseEvent, e);
-                    ipc_process_select_policy_set_response_handler(e);
-                }
-                    break;
-                case rina::IPC_PROCESS_PLUGIN_LOAD_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::PluginLoadResponseEvent, e);
-                    ipc_process_plugin_load_response_handler(e);
-                }
-                    break;
+    delete event;
+}
 
-                case rina::IPCM_CREATE_IPCP_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::CreateIPCPResponseEvent, e);
-                    ipc_process_create_response_event_handler(e);
-                }
-                    break;
+//static
+void* IPCManager_::io_loop_trampoline(void* param)
+{
+    IPCManager->io_loop();
+    return NULL;
+}
 
-                case rina::IPCM_DESTROY_IPCP_RESPONSE: {
-                    DOWNCAST_DECL(event, rina::DestroyIPCPResponseEvent, e);
-                    ipc_process_destroy_response_event_handler(e);
-                }
-                    break;
+void IPCManager_::io_loop()
+{
+    std::vector<rina::IPCEvent *> events;
+    rina::IPCEvent *event;
+    bool stop = false;
+    unsigned int i;
 
-                    //Addon specific events
-                default:
-                {
-                    TransactionState* trans = get_transaction_state<
-                            TransactionState>(event->sequenceNumber);
+    LOG_DBG("Starting main I/O loop...");
+
+    while (!stop)
+    {
+        events.clear();
+        if (!rina::ipcEventProducer->eventsWait(events)) {
+        	LOG_WARN("Event is NULL");
+        	if (event_dispatcher)
+        		event_dispatcher->stop();
+        	rina::librina_finalize();
+        	stop_cond.signal();
+        	break;
+        }
 
-                    Addon::distribute_flow_event(event);
+        for (i = 0; i < events.size(); i++) {
+        	event = events[i];
 
-                    if (trans)
-                    {
-                        //Mark as completed
-                        trans->completed(IPCM_SUCCESS);
-                        remove_transaction_state(trans->tid);
-                    }
+        	if (stop) {
+        		//Drop what came after the stop request
+        		delete event;
+        		continue;
+        	}
 
-                    continue;
-                    break;
-                }
-            }
+        	if (event->eventType == rina::IPCM_FINALIZATION_REQUEST_EVENT && req_to_stop)
+        	{
+        		//Signal the main thread to start
+        		//the stop procedure
+        		LOG_INFO("IPCM event loop requested to stop");
 
-        } catch (rina::Exception &e)
-        {
-            LOG_ERR("ERROR while processing event %d: %s",event->eventType,
-            		e.what());
-            //TODO: move locking to a smaller scope
-        }
+        		//Let the workers drain the events already dispatched
+        		if (event_dispatcher)
+        			event_dispatcher->stop();
+
+        		void * status;
+        		if (osp_monitor) {
+        			osp_monitor->do_stop();
+        			osp_monitor->join(&status);
+
+        			delete osp_monitor;
+        		}
 
-        delete event;
+        		stop_cond.signal();
+        		stop = true;
+        		continue;
+        	}
+
+        	if (event_dispatcher)
+        		event_dispatcher->dispatch(event);
+        	else
+        		process_event(event);
+        }
     }
 
     //TODO: probably move this to a private method if it starts to grow
@@ -41,6 +41,7 @@
 #include "catalog.h"
 #include "process-event-listener.h"
 #include "ip-vpn-manager.h"
+#include "event-dispatcher.h"
 
 //Addons
 #include "addon.h"
@@ -290,6 +291,25 @@ public:
 	//
 	void list_da_mappings(std::ostream& os);
 
+	//
+	// Dump the event worker pool queue depths and per event type
+	// queueing delays
+	//
+	void print_event_stats(std::ostream& os);
+
+	//
+	// Process an IPC event coming from the kernel or from an application.
+	// Called by the I/O thread, or by the event workers when enabled
+	//
+	void process_event(rina::IPCEvent *event);
+
+	//
+	// Get the id of the IPCP an event operates on, or 0 if it cannot be
+	// told from the event (e.g. the DIF is left to the DIF allocator).
+	// Used to shard the events onto the event workers
+	//
+	unsigned short get_event_target_ipcp(const rina::IPCEvent *event);
+
 	//
 	// List the objects in the MA RIB
 	//
@@ -952,6 +972,10 @@ private:
 	//I/O loop main thread
 	rina::Thread* io_thread;
 
+	//Worker pool for event processing (NULL if events are processed
+	//inline by the I/O thread)
+	IPCMEventDispatcher* event_dispatcher;
+
 	//Stop condition
 	rina::ConditionVariable stop_cond;
 
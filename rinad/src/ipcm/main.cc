@@ -75,6 +75,8 @@ void override_config(vector<std::string> &opts) {
             config.local.installationPath = v;
         else if (k == "libraryPath")
             config.local.logPath = v;
+        else if (k == "eventWorkers")
+            config.local.eventWorkers = atoi(v.c_str());
         else
             LOG_WARN("Unknown local configuration value: %s", k.c_str());
     }
@@ -119,6 +119,11 @@ public:
 	virtual int get_neighbor_info(rina::Neighbor& neigh) = 0;
 	virtual void clean_state(unsigned int port_id) = 0;
 
+	/// Runs the task in the enrollment worker of the state machine bound
+	/// to port_id, after the tasks already queued for it. Runs it right
+	/// away if there are no workers. Takes ownership of the task
+	virtual void dispatch(int port_id, rina::TimerTask * task) = 0;
+
 	/// The maximum time to wait between steps of the enrollment sequence (in ms)
 	int timeout_;
 
@@ -348,6 +353,13 @@ public:
 
 	virtual void notify_neighbors_add(const std::list<rina::DirectoryForwardingTableEntry>& entries,
 			          std::list<int>& neighs_to_exclude) = 0;
+
+	/// Gets the DFT entries changed and the keys of the entries removed
+	/// after a generation of the RIB Daemon. Returns false if the removals
+	/// since then are no longer known, then all entries have to be sent
+	virtual bool getDFTChanges(unsigned long long since,
+				   std::list<rina::DirectoryForwardingTableEntry>& changed,
+				   std::list<std::string>& removed) = 0;
 };
 
 ///N-1 Flow Manager interface
@@ -504,6 +516,37 @@ public:
         			  rina::rib::RIBObj** obj) = 0;
         virtual void removeObjRIB(const std::string& fqn) = 0;
         virtual void processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event) = 0;
+
+        /// Versions of the RIB objects, so that a neighbor that enrolls
+        /// again only gets the objects that changed (see configs::RIBVersion).
+        /// The epoch identifies this incarnation of the IPC Process
+        virtual unsigned long long get_rib_epoch() = 0;
+
+        /// The last generation given out, and a new one for a change
+        virtual unsigned long long get_rib_generation() = 0;
+        virtual unsigned long long next_rib_generation() = 0;
+
+        /// Versions of the objects generated by other IPC Processes that
+        /// this one holds
+        virtual void set_held_rib_version(const configs::RIBVersion& version) = 0;
+        virtual void invalidate_held_rib_versions(const std::string& clazz) = 0;
+        virtual std::list<configs::RIBVersion> get_held_rib_versions() = 0;
+
+        /// Versions of the objects generated by this IPC Process that a
+        /// neighbor holds, as told by the neighbor during enrollment
+        virtual void set_neighbor_rib_versions(const std::string& neighbor,
+        				       const std::list<configs::RIBVersion>& versions) = 0;
+
+        /// The generation of the objects of a class that the neighbor
+        /// holds, 0 if unknown (the neighbor needs all of them)
+        virtual unsigned long long get_neighbor_rib_generation(const std::string& neighbor,
+        						       const std::string& clazz) = 0;
+
+        /// Tells the peer of con that it holds all the objects of a
+        /// class up to a generation
+        virtual void send_rib_version(const rina::cdap_rib::con_handle_t& con,
+        			      const std::string& clazz,
+        			      unsigned long long generation) = 0;
 };
 
 /// IPC Process interface
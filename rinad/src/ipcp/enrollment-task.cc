@@ -661,6 +661,35 @@ void RetryEnrollmentTimerTask::run()
 	etask->initiateEnrollment(erequest);
 }
 
+//Class EnrollmentWorker
+EnrollmentWorker::EnrollmentWorker(unsigned int i)
+		: rina::SimpleThread(std::string("enrollment-worker"), false),
+		  id(i)
+{
+}
+
+EnrollmentWorker::~EnrollmentWorker() throw()
+{
+}
+
+int EnrollmentWorker::run()
+{
+	rina::TimerTask * task;
+
+	LOG_IPCP_DBG("Enrollment worker %u started", id);
+
+	// A NULL task is the stop request, queued after all the pending
+	// tasks of this worker
+	while ((task = queue.take()) != 0) {
+		task->run();
+		delete task;
+	}
+
+	LOG_IPCP_DBG("Enrollment worker %u stopped", id);
+
+	return 0;
+}
+
 //Class Enrollment Task
 const std::string EnrollmentTask::ENROLL_TIMEOUT_IN_MS = "enrollTimeoutInMs";
 const std::string EnrollmentTask::WATCHDOG_PERIOD_IN_MS = "watchdogPeriodInMs";
@@ -671,6 +700,7 @@ const std::string EnrollmentTask::N1_FLOWS = "n1flows";
 const std::string EnrollmentTask::N1_DIFS_PEER_DISCOVERY = "n1difsPeerDiscovery";
 const std::string EnrollmentTask::PEER_DISCOVERY_PERIOD_IN_MS = "peerDiscoveryPeriodMs";
 const std::string EnrollmentTask::MAX_PEER_DISCOVERY_ATTEMPTS = "maxPeerDiscoveryAttempts";
+const std::string EnrollmentTask::ENROLLMENT_WORKERS = "enrollmentWorkers";
 
 EnrollmentTask::EnrollmentTask() : IPCPEnrollmentTask()
 {
@@ -690,9 +720,62 @@ EnrollmentTask::EnrollmentTask() : IPCPEnrollmentTask()
 
 EnrollmentTask::~EnrollmentTask()
 {
+	stop_workers();
 	delete ps;
 }
 
+void EnrollmentTask::start_workers(unsigned int num_workers)
+{
+	EnrollmentWorker * worker;
+
+	for (unsigned int i = 0; i < num_workers; i++) {
+		worker = new EnrollmentWorker(i);
+		worker->start();
+		workers.push_back(worker);
+	}
+
+	LOG_IPCP_INFO("Started %u enrollment workers", num_workers);
+}
+
+void EnrollmentTask::stop_workers()
+{
+	void * status;
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i]->queue.put(0);
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		workers[i]->join(&status);
+		delete workers[i];
+	}
+
+	workers.clear();
+}
+
+void EnrollmentTask::dispatch(int port_id, rina::TimerTask * task)
+{
+	if (workers.empty()) {
+		task->run();
+		delete task;
+		return;
+	}
+
+	workers[(unsigned int) port_id % workers.size()]->queue.put(task);
+}
+
+void EnrollmentTask::destroy_state_machine(int port_id,
+					   IEnrollmentStateMachine * esm)
+{
+	// Behind the tasks queued for the state machine, which may still
+	// be using it
+	if (!workers.empty()) {
+		dispatch(port_id, new DestroyESMTimerTask(esm));
+		return;
+	}
+
+	timer.scheduleTask(new DestroyESMTimerTask(esm), 0);
+}
+
 void EnrollmentTask::set_application_process(rina::ApplicationProcess * ap)
 {
 	if (!ap)
@@ -819,7 +902,6 @@ void EnrollmentTask::internal_flow_deallocated(rina::IPCPInternalFlowDeallocated
 	IEnrollmentStateMachine * esm = 0;
 	rina::ConnectiviyToNeighborLostEvent * event2 = 0;
 	DeallocateFlowTimerTask * timer_task = 0;
-	DestroyESMTimerTask * dsm_task = 0;
 
 	//1 Stop the internal flow SDU reader
 	ribd->stop_internal_flow_sdu_reader(event->port_id);
@@ -849,8 +931,7 @@ void EnrollmentTask::internal_flow_deallocated(rina::IPCPInternalFlowDeallocated
 
 	// Update and defer deletion of state machine to a timer task (takes long)
 	esm->reset_state();
-	dsm_task = new DestroyESMTimerTask(esm);
-	timer.scheduleTask(dsm_task, 0);
+	destroy_state_machine(esm->con.port_id, esm);
 }
 
 void EnrollmentTask::operational_status_start(int port_id,
@@ -1161,6 +1242,7 @@ void EnrollmentTask::set_dif_configuration(const rina::DIFInformation& dif_infor
 	std::list<std::string>::iterator it2;
 	RetryEnrollmentTimerTask * timer_task = 0;
 	rina::EnrollmentRequest enr_request;
+	unsigned int num_workers = 0;
 
 	rina::PolicyConfig psconf = dif_information.dif_configuration_.et_configuration_.policy_set_;
 	if (select_policy_set(std::string(), psconf.name_) != 0) {
@@ -1224,6 +1306,16 @@ void EnrollmentTask::set_dif_configuration(const rina::DIFInformation& dif_infor
 			       max_peer_discovery_attempts);
 	}
 
+	try {
+		num_workers = psconf.get_param_value_as_uint(ENROLLMENT_WORKERS);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_INFO("Could not parse enrollment_workers, using default value: %u",
+			      num_workers);
+	}
+
+	if (workers.empty() && num_workers > 0)
+		start_workers(num_workers);
+
 	//Add Watchdog RIB object to RIB
 	try{
 		rina::rib::RIBObj * ribObj = new WatchdogRIBObject(ipcp,
@@ -1412,9 +1504,7 @@ void EnrollmentTask::initiateEnrollment(const rina::EnrollmentRequest& request)
 								  -1, handle,
 								  "N-1 Flow allocation timeout", false);
 	timer.scheduleTask(to_store->abort_timer_task, timeout_);
-	lock_.lock();
 	port_ids_pending_to_be_allocated_.put(handle, to_store);
-	lock_.unlock();
 }
 
 void EnrollmentTask::connect(const rina::cdap::CDAPMessage& cdap_m,
@@ -1739,7 +1829,6 @@ void EnrollmentTask::nMinusOneFlowDeallocated(rina::NMinusOneFlowDeallocatedEven
 	IEnrollmentStateMachine * esm = 0;
 	rina::ConnectiviyToNeighborLostEvent * event2 = 0;
 	rina::FlowDeallocateRequestEvent fd_event;
-	DestroyESMTimerTask * dsm_task = 0;
 	IPCPRIBDaemonImpl * ribd = dynamic_cast<IPCPRIBDaemonImpl*>(ipcp->rib_daemon_);
 	rina::Neighbor neighbor;
 
@@ -1768,17 +1857,14 @@ void EnrollmentTask::nMinusOneFlowDeallocated(rina::NMinusOneFlowDeallocatedEven
 	event_manager_->deliverEvent(event2);
 
 	//4 Move destruction of state machine to a timer task
-	dsm_task = new DestroyESMTimerTask(esm);
-	timer.scheduleTask(dsm_task, 0);
+	destroy_state_machine(event->port_id_, esm);
 }
 
 void EnrollmentTask::nMinusOneFlowAllocated(rina::NMinusOneFlowAllocatedEvent * flowEvent)
 {
 	rina::EnrollmentRequest * request;
 
-	lock_.lock();
 	request = port_ids_pending_to_be_allocated_.erase(flowEvent->handle_);
-	lock_.unlock();
 
 	if (!request) {
 		return;
@@ -1797,9 +1883,7 @@ void EnrollmentTask::nMinusOneFlowAllocationFailed(rina::NMinusOneFlowAllocation
 {
 	rina::EnrollmentRequest * request;
 
-	lock_.lock();
 	request = port_ids_pending_to_be_allocated_.erase(event->handle_);
-	lock_.unlock();
 
 	if (!request){
 		return;
@@ -1865,9 +1949,7 @@ void EnrollmentTask::enrollmentFailed(const rina::ApplicationProcessNamingInform
 		deallocate_flows_and_destroy_esm(stateMachine, portId, false);
 	} else {
 		//N-1 flow could not be allocated
-		lock_.lock();
 		pending_req = port_ids_pending_to_be_allocated_.erase(internal_portId);
-		lock_.unlock();
 
 		if (!pending_req) {
 			return;
@@ -1978,7 +2060,6 @@ void EnrollmentTask::clean_state(unsigned int port_id)
 	IEnrollmentStateMachine * esm;
 	rina::cdap_rib::con_handle_t con_handle;
 	rina::ConnectiviyToNeighborLostEvent * cnl_event = 0;
-	DestroyESMTimerTask * timer_task = 0;
 
 	esm = getEnrollmentStateMachine(port_id, true);
 
@@ -1992,8 +2073,7 @@ void EnrollmentTask::clean_state(unsigned int port_id)
 
 		//Schedule destruction of enrollment state machine in a separate thread, since it may take time
 		esm->reset_state();
-		timer_task = new DestroyESMTimerTask(esm);
-		timer.scheduleTask(timer_task, 0);
+		destroy_state_machine(port_id, esm);
 	}
 }
 
@@ -2002,7 +2082,6 @@ void EnrollmentTask::deallocate_flows_and_destroy_esm(IEnrollmentStateMachine *
 						      bool call_ps)
 {
 	IPCPRIBDaemonImpl * ribd = dynamic_cast<IPCPRIBDaemonImpl*>(ipcp->rib_daemon_);
-	DestroyESMTimerTask * timer_task = 0;
 	rina::FlowDeallocateRequestEvent fd_event;
 	IPCPEnrollmentTaskPS * ipcp_ps = 0;
 	rina::ConnectiviyToNeighborLostEvent * cnl_event = 0;
@@ -2051,8 +2130,7 @@ void EnrollmentTask::deallocate_flows_and_destroy_esm(IEnrollmentStateMachine *
 
 	//Schedule destruction of enrollment state machine in a separate thread, since it may take time
 	esm->reset_state();
-	timer_task = new DestroyESMTimerTask(esm);
-	timer.scheduleTask(timer_task, 0);
+	destroy_state_machine(port_id, esm);
 }
 
 // Class Operational Status RIB Object
@@ -24,6 +24,7 @@
 #define IPCP_ENROLLMENT_TASK_HH
 
 #include <map>
+#include <vector>
 
 #include "common/concurrency.h"
 #include "ipcp/components.h"
@@ -326,6 +327,18 @@ private:
 	rina::EnrollmentRequest erequest;
 };
 
+/// Worker thread of the enrollment task, runs the tasks of the state
+/// machines mapped to it in arrival order
+class EnrollmentWorker: public rina::SimpleThread {
+public:
+	EnrollmentWorker(unsigned int id);
+	~EnrollmentWorker() throw();
+	int run();
+
+	rina::BlockingFIFOQueue<rina::TimerTask> queue;
+	unsigned int id;
+};
+
 class EnrollmentTask: public IPCPEnrollmentTask, public rina::InternalEventListener {
 public:
 	static const std::string ENROLL_TIMEOUT_IN_MS;
@@ -337,6 +350,7 @@ public:
 	static const std::string N1_DIFS_PEER_DISCOVERY;
 	static const std::string PEER_DISCOVERY_PERIOD_IN_MS;
 	static const std::string MAX_PEER_DISCOVERY_ATTEMPTS;
+	static const std::string ENROLLMENT_WORKERS;
 
 	EnrollmentTask();
 	~EnrollmentTask();
@@ -389,6 +403,7 @@ public:
 				            rina::cdap_rib::con_handle_t& con);
 	int get_neighbor_info(rina::Neighbor& neigh);
 	void clean_state(unsigned int port_id);
+	void dispatch(int port_id, rina::TimerTask * task);
 
 private:
 	void parse_n1flows(const std::string& name,
@@ -429,19 +444,29 @@ private:
 	int get_con_handle_to_ipcp_with_address(unsigned int address,
 				   	   	rina::cdap_rib::con_handle_t& con);
 
+	void start_workers(unsigned int num_workers);
+	void stop_workers();
+
+	/// Destroys a state machine out of the calling thread
+	void destroy_state_machine(int port_id, IEnrollmentStateMachine * esm);
+
 	IPCPRIBDaemon * rib_daemon_;
 	rina::InternalEventManager * event_manager_;
 	rina::IPCResourceManager * irm_;
 	INamespaceManager * namespace_manager_;
 
-	rina::Lockable lock_;
 	rina::Timer timer;
 
 	/// Stores the enrollment state machines, one per remote IPC process that this IPC
-	/// process is enrolled to.
+	/// process is enrolled to. Each state machine has its own lock, sm_lock only
+	/// protects the map.
 	std::map<int, IEnrollmentStateMachine*> state_machines_;
 	rina::ReadWriteLockable sm_lock;
 
+	/// Run the RIB synchronization of the state machines, sharded by
+	/// port-id, so that many neighbors can enroll at the same time
+	std::vector<EnrollmentWorker *> workers;
+
 	rina::ThreadSafeMapOfPointers<unsigned int, rina::EnrollmentRequest> port_ids_pending_to_be_allocated_;
 
 	std::map<std::string, rina::Neighbor *> neighbors;
@@ -208,6 +208,10 @@ void DFTRIBObj::checkDFTEntriesToRemove(unsigned int address,
 	if (entriesToDelete.size() == 0)
 		return;
 
+	// Neighbors may still have these entries, what was received from them
+	// is not complete anymore
+	rib_daemon_->invalidate_held_rib_versions(DFTRIBObj::class_name);
+
 	std::list<int> exc_neighs;
 	std::list<std::string>::const_iterator it;
 	for (it = entriesToDelete.begin(); it != entriesToDelete.end(); ++it) {
@@ -270,6 +274,80 @@ void DFTRIBObj::create(const rina::cdap_rib::con_handle_t &con_handle,
 	}
 }
 
+//Class DFTChangeLog
+const unsigned int DFTChangeLog::MAX_TOMBSTONES = 4096;
+
+DFTChangeLog::DFTChangeLog()
+{
+	floor = 0;
+}
+
+void DFTChangeLog::changed(const std::string& key,
+			   unsigned long long generation)
+{
+	std::map<std::string, unsigned long long>::iterator it;
+
+	rina::ScopedLock g(lock);
+
+	changes[key] = generation;
+
+	it = tombstones.find(key);
+	if (it != tombstones.end()) {
+		tombstones_by_gen.erase(it->second);
+		tombstones.erase(it);
+	}
+}
+
+void DFTChangeLog::removed(const std::string& key,
+			   unsigned long long generation)
+{
+	std::map<std::string, unsigned long long>::iterator it;
+
+	rina::ScopedLock g(lock);
+
+	changes.erase(key);
+
+	it = tombstones.find(key);
+	if (it != tombstones.end()) {
+		tombstones_by_gen.erase(it->second);
+		tombstones.erase(it);
+	}
+
+	tombstones[key] = generation;
+	tombstones_by_gen[generation] = key;
+
+	while (tombstones.size() > MAX_TOMBSTONES) {
+		floor = tombstones_by_gen.begin()->first;
+		tombstones.erase(tombstones_by_gen.begin()->second);
+		tombstones_by_gen.erase(tombstones_by_gen.begin());
+	}
+}
+
+bool DFTChangeLog::changes_since(unsigned long long since,
+				 std::list<std::string>& changed,
+				 std::list<std::string>& removed)
+{
+	std::map<std::string, unsigned long long>::iterator it;
+	std::map<unsigned long long, std::string>::iterator jt;
+
+	rina::ScopedLock g(lock);
+
+	if (since < floor)
+		return false;
+
+	for (it = changes.begin(); it != changes.end(); ++it) {
+		if (it->second > since)
+			changed.push_back(it->first);
+	}
+
+	for (jt = tombstones_by_gen.upper_bound(since);
+			jt != tombstones_by_gen.end(); ++jt) {
+		removed.push_back(jt->second);
+	}
+
+	return true;
+}
+
 //Class AddressChangeTimerTask
 AddressChangeTimerTask::AddressChangeTimerTask(INamespaceManager * nsm,
 		       	       	       	       unsigned int naddr,
@@ -395,6 +473,12 @@ void NamespaceManager::addressChangeUpdateDFT(unsigned int new_address,
 	if (mod_entries.size() == 0)
 		return;
 
+	unsigned long long generation = rib_daemon_->next_rib_generation();
+	for (std::list<rina::DirectoryForwardingTableEntry>::iterator it = mod_entries.begin();
+			it != mod_entries.end(); ++it) {
+		dft_changes_.changed(it->getKey(), generation);
+	}
+
 	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
 	encoders::DFTEListEncoder encoder;
 	rina::cdap_rib::obj_info_t obj;
@@ -422,8 +506,8 @@ void NamespaceManager::addressChangeUpdateDFT(unsigned int new_address,
 unsigned int NamespaceManager::getDFTNextHop(rina::ApplicationProcessNamingInformation& apNamingInfo)
 {
 	rina::DirectoryForwardingTableEntry * nextHop = 0;
-	std::list<rina::DirectoryForwardingTableEntry *> entries;
-	std::list<rina::DirectoryForwardingTableEntry *>::iterator it;
+	std::map<std::string, std::set<std::string> >::iterator it;
+	std::set<std::string>::iterator jt;
 	unsigned int my_address = 0;
 
 	rina::ScopedLock g(lock);
@@ -438,13 +522,16 @@ unsigned int NamespaceManager::getDFTNextHop(rina::ApplicationProcessNamingInfor
 			apNamingInfo.entityName == "" &&
 			apNamingInfo.entityInstance == "") {
 		//Searching for a DAF name
+		it = dft_by_process_.find(apNamingInfo.processName);
+		if (it == dft_by_process_.end())
+			return 0;
+
 		my_address = ipcp->get_active_address();
-		entries = dft_.getEntries();
-		for (it = entries.begin(); it != entries.end(); ++it) {
-			if ((*it)->ap_naming_info_.processName == apNamingInfo.processName &&
-					(*it)->address_ != my_address) {
-				apNamingInfo.processInstance = (*it)->ap_naming_info_.processInstance;
-				return (*it)->address_;
+		for (jt = it->second.begin(); jt != it->second.end(); ++jt) {
+			nextHop = dft_.find(*jt);
+			if (nextHop && nextHop->address_ != my_address) {
+				apNamingInfo.processInstance = nextHop->ap_naming_info_.processInstance;
+				return nextHop->address_;
 			}
 		}
 
@@ -484,6 +571,7 @@ void NamespaceManager::addDFTEntries(const std::list<rina::DirectoryForwardingTa
 		}
 
 		dft_.put(entry->getKey(), entry);
+		dft_by_process_[entry->ap_naming_info_.processName].insert(entry->getKey());
 		LOG_IPCP_DBG("Added entry to DFT: %s",
 			     entry->toString().c_str());
 	}
@@ -495,6 +583,13 @@ void NamespaceManager::notify_neighbors_add(const std::list<rina::DirectoryForwa
 		          	  	    std::list<int>& neighs_to_exclude)
 {
 	std::vector<int> session_ids;
+
+	unsigned long long generation = rib_daemon_->next_rib_generation();
+	std::list<rina::DirectoryForwardingTableEntry>::const_iterator it;
+	for (it = entries.begin(); it != entries.end(); ++it) {
+		dft_changes_.changed(it->getKey(), generation);
+	}
+
 	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
 	encoders::DFTEListEncoder encoder;
 	rina::cdap_rib::obj_info_t obj;
@@ -533,6 +628,28 @@ std::list<rina::DirectoryForwardingTableEntry> NamespaceManager::getDFTEntries()
 	return dft_.getCopyofentries();
 }
 
+bool NamespaceManager::getDFTChanges(unsigned long long since,
+				     std::list<rina::DirectoryForwardingTableEntry>& changed,
+				     std::list<std::string>& removed)
+{
+	std::list<std::string> keys;
+	rina::DirectoryForwardingTableEntry * entry;
+
+	rina::ScopedLock g(lock);
+
+	if (!dft_changes_.changes_since(since, keys, removed))
+		return false;
+
+	for (std::list<std::string>::iterator it = keys.begin();
+			it != keys.end(); ++it) {
+		entry = dft_.find(*it);
+		if (entry)
+			changed.push_back(*entry);
+	}
+
+	return true;
+}
+
 void NamespaceManager::removeDFTEntry(const std::string& key,
 			 	      bool notify_neighs,
 			 	      bool remove_from_rib,
@@ -548,6 +665,14 @@ void NamespaceManager::removeDFTEntry(const std::string& key,
 		return;
 	}
 
+	std::map<std::string, std::set<std::string> >::iterator pit =
+			dft_by_process_.find(entry->ap_naming_info_.processName);
+	if (pit != dft_by_process_.end()) {
+		pit->second.erase(key);
+		if (pit->second.empty())
+			dft_by_process_.erase(pit);
+	}
+
 	std::stringstream ss;
 	ss << DFTEntryRIBObj::object_name_prefix
 	   << key;
@@ -565,6 +690,8 @@ void NamespaceManager::removeDFTEntry(const std::string& key,
 	LOG_IPCP_DBG("Removed entry from DFT: %s",
 		     entry->toString().c_str());
 
+	dft_changes_.removed(key, rib_daemon_->next_rib_generation());
+
 	std::vector<int> session_ids;
 	rina::cdap::getProvider()->get_session_manager()->getAllCDAPSessionIds(session_ids);
 	rina::cdap_rib::obj_info_t obj;
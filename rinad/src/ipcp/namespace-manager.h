@@ -23,6 +23,9 @@
 #ifndef IPCP_NAMESPACE_MANAGER_HH
 #define IPCP_NAMESPACE_MANAGER_HH
 
+#include <map>
+#include <set>
+
 #include <librina/ipc-process.h>
 #include <librina/internal-events.h>
 
@@ -165,6 +168,33 @@ public:
 	unsigned int old_address;
 };
 
+/// Generation of the last change of each DFT entry, and of the removal of
+/// the entries removed recently, to tell a neighbor only what changed
+/// since it got the DFT. Only the last MAX_TOMBSTONES removals are kept
+class DFTChangeLog {
+public:
+	static const unsigned int MAX_TOMBSTONES;
+
+	DFTChangeLog();
+	void changed(const std::string& key, unsigned long long generation);
+	void removed(const std::string& key, unsigned long long generation);
+
+	/// Keys changed and removed after generation since. Returns false if
+	/// removals after since have been forgotten
+	bool changes_since(unsigned long long since,
+			   std::list<std::string>& changed,
+			   std::list<std::string>& removed);
+
+private:
+	std::map<std::string, unsigned long long> changes;
+	std::map<std::string, unsigned long long> tombstones;
+	std::map<unsigned long long, std::string> tombstones_by_gen;
+
+	/// Removals up to this generation have been forgotten
+	unsigned long long floor;
+	rina::Lockable lock;
+};
+
 class NamespaceManager: public INamespaceManager, public rina::InternalEventListener {
 public:
 	NamespaceManager();
@@ -198,6 +228,9 @@ public:
 				    unsigned int old_address);
 	void notify_neighbors_add(const std::list<rina::DirectoryForwardingTableEntry>& entries,
 			          std::list<int>& neighs_to_exclude);
+	bool getDFTChanges(unsigned long long since,
+			   std::list<rina::DirectoryForwardingTableEntry>& changed,
+			   std::list<std::string>& removed);
 
 private:
 	rina::Lockable lock;
@@ -205,6 +238,13 @@ private:
 	/// The directory forwarding table
 	rina::ThreadSafeMapOfPointers<std::string, rina::DirectoryForwardingTableEntry> dft_;
 
+	/// Index of the DFT by process name (DAF name), mapping it to the keys
+	/// of the DFT entries of its members. Protected by lock
+	std::map<std::string, std::set<std::string> > dft_by_process_;
+
+	/// Generations of the changes to the DFT
+	DFTChangeLog dft_changes_;
+
 	/// Applications registered in this IPC Process
 	rina::ThreadSafeMapOfPointers<std::string, rina::ApplicationRegistrationInformation> registrations_;
 
@@ -0,0 +1,475 @@
+//
+// Benchmark of the RIB synchronization when a neighbor enrolls again
+//
+// Builds a DFT and a FSDB, synchronizes a neighbor with them, and then
+// changes some of the objects, as happens while the neighbor is away
+// during a short flap. It then compares two ways to synchronize the
+// neighbor again. The first sends the complete tables, as was done
+// before. The second sends only the objects changed after the generation
+// the neighbor holds. For both it reports the bytes of CDAP object values
+// and names sent, and the time to converge. That time covers encoding,
+// decoding and applying the objects at the neighbor, plus sending them
+// at the given link rate. After the delta the neighbor must have the same
+// tables.
+//
+//    bench-rib-sync [dft-entries] [fsos] [changed-per-mille] [link-mbps]
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+// MA  02110-1301  USA
+//
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <time.h>
+
+#define IPCP_MODULE "bench-rib-sync"
+#include "../../ipcp-logging.h"
+
+#include "common/encoder.h"
+#include "ipcp/namespace-manager.h"
+#include "ipcp/rib-daemon.h"
+#include "routing-ps.h"
+
+using namespace std;
+using namespace rinad;
+
+int ipcp_id = 1;
+
+#define DFT_ENTRIES_DEFAULT	10000
+#define FSOS_DEFAULT		20000
+#define CHANGED_DEFAULT		10	// per mille
+#define LINK_MBPS_DEFAULT	10
+#define DFT_BATCH		100
+#define LINKS_PER_NODE		4
+
+typedef map<string, rina::DirectoryForwardingTableEntry> dft_t;
+typedef map<string, FlowStateObject> fsdb_t;
+
+struct sync_cost {
+	sync_cost() : messages(0), bytes(0), ns(0) { };
+
+	unsigned int messages;
+	unsigned long long bytes;
+	unsigned long long ns;
+};
+
+static unsigned long long now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Accounts one CDAP message carrying a value to an object
+static void account(sync_cost& cost, const string& clazz, const string& name,
+		    const rina::ser_obj_t * value)
+{
+	cost.messages++;
+	cost.bytes += clazz.size() + name.size();
+	if (value)
+		cost.bytes += value->size_;
+}
+
+// The M_WRITE of the RIB version that closes a delta synchronization
+static void send_version(sync_cost& cost, const string& clazz,
+			 unsigned long long generation)
+{
+	encoders::RIBVersionListEncoder encoder;
+	list<configs::RIBVersion> versions, received;
+	configs::RIBVersion version;
+	rina::ser_obj_t value;
+
+	version.class_ = clazz;
+	version.epoch_ = 0x5a5a5a5a5a5aULL;
+	version.generation_ = generation;
+	versions.push_back(version);
+
+	encoder.encode(versions, value);
+	encoder.decode(value, received);
+	account(cost, RIBVersionsRO::class_name, RIBVersionsRO::object_name,
+		&value);
+}
+
+// As DFTRIBObj::create does at the neighbor
+static void apply_dft(dft_t& dft,
+		      const list<rina::DirectoryForwardingTableEntry>& entries)
+{
+	list<rina::DirectoryForwardingTableEntry>::const_iterator it;
+	dft_t::iterator jt;
+
+	for (it = entries.begin(); it != entries.end(); ++it) {
+		jt = dft.find(it->getKey());
+		if (jt == dft.end()) {
+			dft[it->getKey()] = *it;
+		} else if (it->seqnum_ > jt->second.seqnum_) {
+			jt->second.address_ = it->address_;
+			jt->second.seqnum_ = it->seqnum_;
+		}
+	}
+}
+
+static void send_dft(const list<rina::DirectoryForwardingTableEntry>& entries,
+		     dft_t& neighbor, sync_cost& cost)
+{
+	encoders::DFTEListEncoder encoder;
+	list<rina::DirectoryForwardingTableEntry> received;
+	rina::ser_obj_t value;
+
+	if (entries.empty())
+		return;
+
+	encoder.encode(entries, value);
+	encoder.decode(value, received);
+	apply_dft(neighbor, received);
+	account(cost, DFTRIBObj::class_name, DFTRIBObj::object_name, &value);
+}
+
+static bool same_dft(const dft_t& a, const dft_t& b)
+{
+	dft_t::const_iterator it, jt;
+
+	if (a.size() != b.size())
+		return false;
+
+	for (it = a.begin(), jt = b.begin(); it != a.end(); ++it, ++jt) {
+		if (it->first != jt->first ||
+				it->second.address_ != jt->second.address_ ||
+				it->second.seqnum_ != jt->second.seqnum_)
+			return false;
+	}
+
+	return true;
+}
+
+static rina::DirectoryForwardingTableEntry dft_entry(unsigned int i,
+						     unsigned int address)
+{
+	rina::DirectoryForwardingTableEntry entry;
+	stringstream ss;
+
+	ss << "rina.apps.bench.app" << i;
+	entry.ap_naming_info_.processName = ss.str();
+	entry.ap_naming_info_.processInstance = "1";
+	entry.address_ = address;
+	entry.seqnum_ = 1;
+
+	return entry;
+}
+
+static int bench_dft(unsigned int num_entries, unsigned int per_mille,
+		     sync_cost& full, sync_cost& delta)
+{
+	dft_t dft, neighbor_full, neighbor_delta;
+	DFTChangeLog changes;
+	unsigned long long generation = 0, since;
+	list<rina::DirectoryForwardingTableEntry> batch;
+	list<string> changed, removed;
+	unsigned int i, num_changes, updated = 0, gone = 0, added = 0;
+	unsigned long long t0;
+
+	// Applications register in batches, each batch propagated at once
+	for (i = 0; i < num_entries; i++) {
+		rina::DirectoryForwardingTableEntry entry = dft_entry(i, 16 + i % 200);
+
+		dft[entry.getKey()] = entry;
+		if (i % DFT_BATCH == 0)
+			generation++;
+		changes.changed(entry.getKey(), generation);
+	}
+
+	// The neighbor had all of it before the flap
+	neighbor_full = dft;
+	neighbor_delta = dft;
+	since = generation;
+
+	// Some applications move, unregister or register meanwhile
+	num_changes = (unsigned long long) num_entries * per_mille / 1000;
+	generation++;
+	for (i = 0; i < num_changes; i++) {
+		unsigned int victim = (i * 7919) % num_entries;
+		string key = dft_entry(victim, 0).getKey();
+
+		switch (i % 5) {
+		case 3:
+			if (dft.erase(key) == 0)
+				break;
+			changes.removed(key, ++generation);
+			gone++;
+			break;
+		case 4: {
+			rina::DirectoryForwardingTableEntry entry =
+					dft_entry(num_entries + i, 300);
+			dft[entry.getKey()] = entry;
+			changes.changed(entry.getKey(), generation);
+			added++;
+			break;
+		}
+		default:
+			if (dft.find(key) == dft.end())
+				break;
+			dft[key].address_ = 400 + i % 50;
+			dft[key].seqnum_++;
+			changes.changed(key, generation);
+			updated++;
+		}
+	}
+
+	// Full synchronization, as sendDFTEntries did
+	t0 = now_ns();
+	batch.clear();
+	for (dft_t::iterator it = dft.begin(); it != dft.end(); ++it)
+		batch.push_back(it->second);
+	send_dft(batch, neighbor_full, full);
+	full.ns = now_ns() - t0;
+
+	// Delta synchronization
+	t0 = now_ns();
+	if (!changes.changes_since(since, changed, removed)) {
+		cerr << "Removals since generation " << since
+		     << " are not known" << endl;
+		return -1;
+	}
+	batch.clear();
+	for (list<string>::iterator it = changed.begin();
+			it != changed.end(); ++it)
+		batch.push_back(dft[*it]);
+	send_dft(batch, neighbor_delta, delta);
+	for (list<string>::iterator it = removed.begin();
+			it != removed.end(); ++it) {
+		neighbor_delta.erase(*it);
+		account(delta, DFTEntryRIBObj::class_name,
+			DFTEntryRIBObj::object_name_prefix + *it, 0);
+	}
+	send_version(delta, DFTRIBObj::class_name, generation);
+	delta.ns = now_ns() - t0;
+
+	cout << "DFT: " << dft.size() << " entries, " << updated
+	     << " updated, " << gone << " removed, " << added
+	     << " added during the flap" << endl;
+
+	if (!same_dft(dft, neighbor_delta)) {
+		cerr << "The DFT of the neighbor differs after the delta" << endl;
+		return -1;
+	}
+
+	// The full synchronization never removed anything at the neighbor
+	if (neighbor_full.size() != dft.size())
+		cout << "    (full synchronization leaves "
+		     << neighbor_full.size() - dft.size()
+		     << " stale entries at the neighbor)" << endl;
+
+	return 0;
+}
+
+// As FlowStateManager::updateObjects does at the neighbor
+static void apply_fsos(fsdb_t& fsdb, const list<FlowStateObject>& fsos)
+{
+	list<FlowStateObject>::const_iterator it;
+	fsdb_t::iterator jt;
+
+	for (it = fsos.begin(); it != fsos.end(); ++it) {
+		jt = fsdb.find(it->object_name);
+		if (jt == fsdb.end())
+			fsdb.insert(make_pair(it->object_name, *it));
+		else if (it->seq_num > jt->second.seq_num)
+			jt->second = *it;
+	}
+}
+
+// In messages of max_objects FSOs, as processNeighborAddedEvent does
+static void send_fsos(const list<FlowStateObject>& fsos, fsdb_t& neighbor,
+		      sync_cost& cost)
+{
+	FlowStateObjectListEncoder encoder;
+	list<FlowStateObject> chunk;
+	list<FlowStateObject>::const_iterator it;
+	unsigned int max_objects =
+			LinkStateRoutingPolicy::MAX_OBJECTS_PER_ROUTING_UPDATE_DEFAULT;
+
+	for (it = fsos.begin(); it != fsos.end(); ) {
+		list<FlowStateObject> received;
+		rina::ser_obj_t value;
+
+		chunk.clear();
+		for (; it != fsos.end() && chunk.size() < max_objects; ++it)
+			chunk.push_back(*it);
+
+		encoder.encode(chunk, value);
+		encoder.decode(value, received);
+		apply_fsos(neighbor, received);
+		account(cost, FlowStateRIBObjects::clazz_name,
+			FlowStateRIBObjects::object_name, &value);
+	}
+}
+
+static bool same_fsdb(const fsdb_t& a, const fsdb_t& b)
+{
+	fsdb_t::const_iterator it, jt;
+
+	if (a.size() != b.size())
+		return false;
+
+	for (it = a.begin(), jt = b.begin(); it != a.end(); ++it, ++jt) {
+		if (it->first != jt->first ||
+				it->second.seq_num != jt->second.seq_num ||
+				it->second.state_up != jt->second.state_up ||
+				it->second.cost != jt->second.cost)
+			return false;
+	}
+
+	return true;
+}
+
+static int bench_fsdb(unsigned int num_fsos, unsigned int per_mille,
+		      sync_cost& full, sync_cost& delta)
+{
+	fsdb_t fsdb, neighbor_full, neighbor_delta;
+	unsigned long long generation = 1, since;
+	list<FlowStateObject> batch;
+	unsigned int i, num_nodes, num_changes;
+	unsigned long long t0;
+
+	// A few N-1 flows per IPCP
+	num_nodes = num_fsos / LINKS_PER_NODE + 1;
+	for (i = 0; i < num_fsos; i++) {
+		unsigned int node = i / LINKS_PER_NODE;
+		unsigned int neigh = (node + i % LINKS_PER_NODE + 1) % num_nodes;
+		stringstream name, neigh_name;
+
+		name << "ipcp" << node << ".bench";
+		neigh_name << "ipcp" << neigh << ".bench";
+
+		FlowStateObject fso(name.str(), neigh_name.str(), 1, true, 1, 0);
+		fso.add_address(16 + node);
+		fso.add_neighboraddress(16 + neigh);
+		fso.modified = false;
+		fso.generation = generation;
+		fsdb.insert(make_pair(fso.object_name, fso));
+	}
+
+	neighbor_full = fsdb;
+	neighbor_delta = fsdb;
+	since = generation;
+
+	// Some N-1 flows go down or change their cost, and are propagated
+	num_changes = (unsigned long long) num_fsos * per_mille / 1000;
+	generation++;
+	vector<fsdb_t::iterator> objects;
+	fsdb_t::iterator it;
+	for (it = fsdb.begin(); it != fsdb.end(); ++it)
+		objects.push_back(it);
+	for (i = 0; i < num_changes; i++) {
+		it = objects[(unsigned long long) i * num_fsos / num_changes];
+
+		if (i % 2)
+			it->second.state_up = false;
+		else
+			it->second.cost++;
+		it->second.seq_num++;
+		it->second.generation = generation;
+	}
+
+	// Full synchronization, as processNeighborAddedEvent did
+	t0 = now_ns();
+	batch.clear();
+	for (it = fsdb.begin(); it != fsdb.end(); ++it)
+		batch.push_back(it->second);
+	send_fsos(batch, neighbor_full, full);
+	full.ns = now_ns() - t0;
+
+	// Delta synchronization, as getAllFSOsForPropagation selects them
+	t0 = now_ns();
+	batch.clear();
+	for (it = fsdb.begin(); it != fsdb.end(); ++it) {
+		if (it->second.modified || it->second.generation > since)
+			batch.push_back(it->second);
+	}
+	send_fsos(batch, neighbor_delta, delta);
+	send_version(delta, FlowStateRIBObjects::clazz_name, generation);
+	delta.ns = now_ns() - t0;
+
+	cout << "FSDB: " << fsdb.size() << " flow state objects, "
+	     << batch.size() << " changed during the flap" << endl;
+
+	if (!same_fsdb(fsdb, neighbor_delta) || !same_fsdb(fsdb, neighbor_full)) {
+		cerr << "The FSDB of the neighbor differs" << endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void report(const char * what, const sync_cost& cost,
+		   unsigned int link_mbps)
+{
+	// Bits over Mb/s is microseconds
+	unsigned long long tx_us = cost.bytes * 8 / link_mbps;
+
+	cout << "    " << left << setw(8) << what << right
+	     << setw(10) << cost.messages
+	     << setw(12) << cost.bytes
+	     << setw(14) << fixed << setprecision(2) << cost.ns / 1e6
+	     << setw(14) << (cost.ns / 1e3 + tx_us) / 1e3 << endl;
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int num_entries = DFT_ENTRIES_DEFAULT;
+	unsigned int num_fsos = FSOS_DEFAULT;
+	unsigned int per_mille = CHANGED_DEFAULT;
+	unsigned int link_mbps = LINK_MBPS_DEFAULT;
+	sync_cost dft_full, dft_delta, fsdb_full, fsdb_delta;
+
+	if (argc > 1)
+		num_entries = atoi(argv[1]);
+	if (argc > 2)
+		num_fsos = atoi(argv[2]);
+	if (argc > 3)
+		per_mille = atoi(argv[3]);
+	if (argc > 4)
+		link_mbps = atoi(argv[4]);
+
+	if (num_entries == 0 || num_fsos == 0 || per_mille > 1000 ||
+			link_mbps == 0) {
+		cerr << "Usage: " << argv[0] << " [dft-entries] [fsos] "
+		     << "[changed-per-mille] [link-mbps]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (bench_dft(num_entries, per_mille, dft_full, dft_delta))
+		return EXIT_FAILURE;
+	if (bench_fsdb(num_fsos, per_mille, fsdb_full, fsdb_delta))
+		return EXIT_FAILURE;
+
+	cout << endl << "Re-enrollment, " << per_mille / 10.0
+	     << "% of the objects changed, " << link_mbps << " Mb/s link"
+	     << endl;
+	cout << "    " << left << setw(8) << "" << right << setw(10)
+	     << "messages" << setw(12) << "bytes" << setw(14) << "cpu ms"
+	     << setw(14) << "converge ms" << endl;
+	cout << "  DFT" << endl;
+	report("full", dft_full, link_mbps);
+	report("delta", dft_delta, link_mbps);
+	cout << "  FSDB" << endl;
+	report("full", fsdb_full, link_mbps);
+	report("delta", fsdb_delta, link_mbps);
+
+	return EXIT_SUCCESS;
+}
@@ -183,32 +183,70 @@ void BaseEnrollmentStateMachine::sendDIFDynamicInformation()
 
 void BaseEnrollmentStateMachine::sendDFTEntries()
 {
-	std::list<rina::DirectoryForwardingTableEntry> dftEntries =
-			ipc_process_->namespace_manager_->getDFTEntries();
+	std::list<rina::DirectoryForwardingTableEntry> dftEntries;
+	std::list<std::string> removed;
+	unsigned long long generation;
+	unsigned long long since;
+
+	// The peer will have all the changes up to this generation
+	generation = rib_daemon_->get_rib_generation();
+
+	// If the peer already had the DFT (it is enrolling again) send only
+	// what changed since then
+	since = rib_daemon_->get_neighbor_rib_generation(remote_peer_.name_.processName,
+							 DFTRIBObj::class_name);
+	if (since != 0 &&
+			ipc_process_->namespace_manager_->getDFTChanges(since,
+									dftEntries,
+									removed)) {
+		LOG_IPCP_DBG("Sending %d changed and %d removed DFT entries since generation %llu",
+			     dftEntries.size(), removed.size(), since);
+	} else {
+		dftEntries = ipc_process_->namespace_manager_->getDFTEntries();
+		removed.clear();
+	}
 
-	if (dftEntries.size() == 0) {
+	if (dftEntries.size() == 0 && removed.size() == 0) {
 		LOG_IPCP_DBG("No DFT entries to be sent");
-		return;
 	}
 
 	try {
-		encoders::DFTEListEncoder encoder;
-		rina::cdap_rib::obj_info_t obj;
-		obj.class_ = DFTRIBObj::class_name;
-		obj.name_ = DFTRIBObj::object_name;
-		encoder.encode(dftEntries, obj.value_);
 		rina::cdap_rib::filt_info_t filt;
 		rina::cdap_rib::flags_t flags;
 
-		rib_daemon_->getProxy()->remote_create(con,
-						       obj,
-						       flags,
-						       filt,
-						       NULL);
+		if (dftEntries.size() != 0) {
+			encoders::DFTEListEncoder encoder;
+			rina::cdap_rib::obj_info_t obj;
+			obj.class_ = DFTRIBObj::class_name;
+			obj.name_ = DFTRIBObj::object_name;
+			encoder.encode(dftEntries, obj.value_);
+
+			rib_daemon_->getProxy()->remote_create(con,
+							       obj,
+							       flags,
+							       filt,
+							       NULL);
+		}
+
+		for (std::list<std::string>::iterator it = removed.begin();
+				it != removed.end(); ++it) {
+			rina::cdap_rib::obj_info_t obj;
+			obj.class_ = DFTEntryRIBObj::class_name;
+			obj.name_ = DFTEntryRIBObj::object_name_prefix + *it;
+
+			rib_daemon_->getProxy()->remote_delete(con,
+							       obj,
+							       flags,
+							       filt,
+							       NULL);
+		}
 	} catch (rina::Exception &e) {
 		LOG_IPCP_ERR("Problems sending DFT entries: %s",
 			     e.what());
+		return;
 	}
+
+	rib_daemon_->send_rib_version(con, DFTRIBObj::class_name, generation);
 }
 
 /// Handles the operations related to the "daf.management.enrollment" objects
@@ -246,6 +284,48 @@ private:
 	IPCPEnrollmentTask * enrollment_task_;
 };
 
+/// Runs an M_START received from an enrollee in the enrollment worker of the
+/// state machine, the state machine is looked up again when the task runs
+class StartEnrollmentTask: public rina::TimerTask {
+public:
+	StartEnrollmentTask(IPCPEnrollmentTask * et,
+			    const configs::EnrollmentInformationRequest& eiRequest,
+			    int invoke_id,
+			    const rina::cdap_rib::con_handle_t& con_handle);
+	~StartEnrollmentTask() throw() {};
+	void run();
+	std::string name() const {
+		return "start-enrollment";
+	}
+
+private:
+	IPCPEnrollmentTask * enrollment_task;
+	configs::EnrollmentInformationRequest ei_request;
+	int invoke_id;
+	rina::cdap_rib::con_handle_t con_handle;
+};
+
+/// Runs an M_STOP received from the enroller in the enrollment worker of the
+/// state machine, the state machine is looked up again when the task runs
+class StopEnrollmentTask: public rina::TimerTask {
+public:
+	StopEnrollmentTask(IPCPEnrollmentTask * et,
+			   const configs::EnrollmentInformationRequest& eiRequest,
+			   int invoke_id,
+			   const rina::cdap_rib::con_handle_t& con_handle);
+	~StopEnrollmentTask() throw() {};
+	void run();
+	std::string name() const {
+		return "stop-enrollment";
+	}
+
+private:
+	IPCPEnrollmentTask * enrollment_task;
+	configs::EnrollmentInformationRequest ei_request;
+	int invoke_id;
+	rina::cdap_rib::con_handle_t con_handle;
+};
+
 /// The state machine of the party that wants to
 /// become a new member of the DIF.
 class EnrolleeStateMachine: public BaseEnrollmentStateMachine {
@@ -309,9 +389,10 @@ private:
 	void requestMoreInformationOrStart();
 
 	/// Checks if more information is required for enrollment
-	/// (At least there must be DataTransferConstants, a QoS cube and a DAF Member). If there is,
-	/// it sends a read request message and returns tru
-	bool sendNextObjectRequired();
+	/// (At least there must be DataTransferConstants, a QoS cube and a DAF Member).
+	/// Sends the read requests for all the missing objects at once, without
+	/// waiting for each response, and returns how many there are
+	int sendObjectsRequired();
 
 	/// Create the objects in the RIB
 	void commitEnrollment();
@@ -324,6 +405,9 @@ private:
 	bool allowed_to_start_early_;
 	int stop_request_invoke_id_;
 	int start_request_invoke_id;
+
+	/// M_READ responses still to come
+	int pending_reads_;
 };
 
 // Class EnrolleeStateMachine
@@ -340,6 +424,7 @@ EnrolleeStateMachine::EnrolleeStateMachine(IPCProcess * ipc_process,
 	allowed_to_start_early_ = false;
 	stop_request_invoke_id_ = 0;
 	start_request_invoke_id = 0;
+	pending_reads_ = 0;
 }
 
 void EnrolleeStateMachine::initiateEnrollment(const rina::EnrollmentRequest& enrollmentRequest,
@@ -505,6 +590,9 @@ void EnrolleeStateMachine::connectResponse(int result,
 			ipc_process_->set_dif_information(difInformation);
 		}
 
+		// Tell the enroller what I already have, if anything
+		eiRequest.rib_versions_ = rib_daemon_->get_held_rib_versions();
+
 		encoders::EnrollmentInformationRequestEncoder encoder;
 		rina::cdap_rib::obj_info_t obj;
 		obj.class_ = EnrollmentRIBObject::class_name;
@@ -601,6 +689,9 @@ void EnrolleeStateMachine::stop(const configs::EnrollmentInformationRequest& eiR
 	stop_request_invoke_id_ = invoke_id;
 	token = eiRequest.token;
 
+	rib_daemon_->set_neighbor_rib_versions(remote_peer_.name_.processName,
+					       eiRequest.rib_versions_);
+
 	LOG_IPCP_DBG("Allowed to start early: %d \n Token: %s",
 		     allowed_to_start_early_,
 		     token.c_str());
@@ -617,7 +708,8 @@ void EnrolleeStateMachine::stop(const configs::EnrollmentInformationRequest& eiR
 
 void EnrolleeStateMachine::requestMoreInformationOrStart()
 {
-	if (sendNextObjectRequired()){
+	pending_reads_ = sendObjectsRequired();
+	if (pending_reads_ > 0){
 		//Set timer
 		last_scheduled_task_ = new AbortEnrollmentTimerTask(enrollment_task_,
 	    	    	    	    	    	    	    	    remote_peer_.name_,
@@ -694,32 +786,36 @@ void EnrolleeStateMachine::requestMoreInformationOrStart()
 	state_ = STATE_WAIT_START;
 }
 
-bool EnrolleeStateMachine::sendNextObjectRequired()
+int EnrolleeStateMachine::sendObjectsRequired()
 {
-	bool result = false;
 	rina::DIFInformation difInformation = ipc_process_->get_dif_information();
+	std::list<rina::cdap_rib::obj_info_t> objs;
+	std::list<rina::cdap_rib::obj_info_t>::iterator it;
 
 	rina::cdap_rib::obj_info_t obj;
 	if (!difInformation.dif_configuration_.efcp_configuration_.data_transfer_constants_.isInitialized()) {
 		obj.class_ = DataTransferRIBObj::class_name;
 		obj.name_ = DataTransferRIBObj::object_name;
-		result = true;
-	} else if (difInformation.dif_configuration_.efcp_configuration_.qos_cubes_.size() == 0){
+		objs.push_back(obj);
+	}
+	if (difInformation.dif_configuration_.efcp_configuration_.qos_cubes_.size() == 0){
 		obj.class_ = QoSCubesRIBObject::class_name;
 		obj.name_ = QoSCubesRIBObject::object_name;
-		result = true;
-	}else if (ipc_process_->get_neighbors().size() == 0){
+		objs.push_back(obj);
+	}
+	if (ipc_process_->get_neighbors().size() == 0){
 		obj.class_ = NeighborsRIBObj::class_name;
 		obj.name_ = NeighborsRIBObj::object_name;
-		result = true;
+		objs.push_back(obj);
 	}
 
-	if (result) {
+	// A read that could not be sent is left to the read response timeout
+	for (it = objs.begin(); it != objs.end(); ++it) {
 		try{
 			rina::cdap_rib::flags_t flags;
 			rina::cdap_rib::filt_info_t filt;
 			rib_daemon_->getProxy()->remote_read(con,
-							     obj,
+							     *it,
 							     flags,
 							     filt,
 							     this);
@@ -728,7 +824,7 @@ bool EnrolleeStateMachine::sendNextObjectRequired()
 		}
 	}
 
-	return result;
+	return objs.size();
 }
 
 void EnrolleeStateMachine::commitEnrollment()
@@ -792,8 +888,6 @@ void EnrolleeStateMachine::remoteReadResult(const rina::cdap_rib::con_handle_t &
 		return;
 	}
 
-	timer->cancelTask(last_scheduled_task_);
-
 	if (res.code_ != rina::cdap_rib::CDAP_SUCCESS ||
 			obj.value_.message_ == 0){
 		abortEnrollment(res.reason_, true);
@@ -831,6 +925,12 @@ void EnrolleeStateMachine::remoteReadResult(const rina::cdap_rib::con_handle_t &
 		LOG_IPCP_WARN("The object to be created is not required for enrollment");
 	}
 
+	//Wait for the rest of the reads, under the same timer
+	if (--pending_reads_ > 0)
+		return;
+
+	timer->cancelTask(last_scheduled_task_);
+
 	//Request more information or proceed with the enrollment program
 	requestMoreInformationOrStart();
 }
@@ -1369,6 +1469,14 @@ void EnrollerStateMachine::start(configs::EnrollmentInformationRequest& eiReques
 		eiRequest.address_ = address;
 	}
 
+	// What the remote IPC Process already holds of my RIB is of no use if
+	// it has to be initialized
+	if (requiresInitialization)
+		eiRequest.rib_versions_.clear();
+	rib_daemon_->set_neighbor_rib_versions(remote_peer_.name_.processName,
+					       eiRequest.rib_versions_);
+	eiRequest.rib_versions_.clear();
+
 	try {
 		rina::cdap_rib::obj_info_t obj;
 		obj.class_ = EnrollmentRIBObject::class_name;
@@ -1415,6 +1523,7 @@ void EnrollerStateMachine::start(configs::EnrollmentInformationRequest& eiReques
 		encoders::EnrollmentInformationRequestEncoder encoder;
 		eiRequest.allowed_to_start_early_ = false;
 		eiRequest.token = token;
+		eiRequest.rib_versions_ = rib_daemon_->get_held_rib_versions();
 		encoder.encode(eiRequest, obj.value_);
 		rina::cdap_rib::flags_t flags;
 		rina::cdap_rib::filt_info_t filt;
@@ -1619,11 +1728,8 @@ void EnrollmentRIBObject::start(const rina::cdap_rib::con_handle_t &con_handle,
 				rina::ser_obj_t &obj_reply,
 				rina::cdap_rib::res_info_t& res)
 {
-	EnrollerStateMachine * stateMachine;
-	stateMachine = (EnrollerStateMachine *) enrollment_task_->getEnrollmentStateMachine(con_handle.port_id,
-											    false);
-
-	if (!stateMachine) {
+	if (!enrollment_task_->getEnrollmentStateMachine(con_handle.port_id,
+							 false)) {
 		LOG_IPCP_ERR("Got a CDAP message that is not for me ");
 		return;
 	}
@@ -1634,9 +1740,14 @@ void EnrollmentRIBObject::start(const rina::cdap_rib::con_handle_t &con_handle,
 		encoders::EnrollmentInformationRequestEncoder encoder;
 		encoder.decode(obj_req, eiRequest);
 	}
-	stateMachine->start(eiRequest,
-			    invoke_id,
-			    con_handle);
+
+	// Sending the RIB to the new member is the long part of the
+	// enrollment, do it out of the RIB daemon thread
+	enrollment_task_->dispatch(con_handle.port_id,
+				   new StartEnrollmentTask(enrollment_task_,
+							   eiRequest,
+							   invoke_id,
+							   con_handle));
 
 	res.code_ = rina::cdap_rib::CDAP_PENDING;
 }
@@ -1650,11 +1761,8 @@ void EnrollmentRIBObject::stop(const rina::cdap_rib::con_handle_t &con_handle,
 			       rina::ser_obj_t &obj_reply,
 			       rina::cdap_rib::res_info_t& res)
 {
-	EnrolleeStateMachine * stateMachine;
-	stateMachine = (EnrolleeStateMachine *) enrollment_task_->getEnrollmentStateMachine(con_handle.port_id,
-											    false);
-
-	if (!stateMachine) {
+	if (!enrollment_task_->getEnrollmentStateMachine(con_handle.port_id,
+							 false)) {
 		LOG_IPCP_ERR("Got a CDAP message that is not for me");
 		return;
 	}
@@ -1665,9 +1773,12 @@ void EnrollmentRIBObject::stop(const rina::cdap_rib::con_handle_t &con_handle,
 		encoders::EnrollmentInformationRequestEncoder encoder;
 		encoder.decode(obj_req, eiRequest);
 	}
-	stateMachine->stop(eiRequest,
-			   invoke_id ,
-			   con_handle);
+
+	enrollment_task_->dispatch(con_handle.port_id,
+				   new StopEnrollmentTask(enrollment_task_,
+							  eiRequest,
+							  invoke_id,
+							  con_handle));
 
 	res.code_ = rina::cdap_rib::CDAP_PENDING;
 }
@@ -1681,6 +1792,62 @@ void EnrollmentRIBObject::sendErrorMessage(unsigned int port_id)
 	}
 }
 
+//Class StartEnrollmentTask
+StartEnrollmentTask::StartEnrollmentTask(IPCPEnrollmentTask * et,
+					 const configs::EnrollmentInformationRequest& eiRequest,
+					 int id,
+					 const rina::cdap_rib::con_handle_t& con)
+{
+	enrollment_task = et;
+	ei_request = eiRequest;
+	invoke_id = id;
+	con_handle = con;
+}
+
+void StartEnrollmentTask::run()
+{
+	EnrollerStateMachine * stateMachine;
+	stateMachine = (EnrollerStateMachine *) enrollment_task->getEnrollmentStateMachine(con_handle.port_id,
+											   false);
+	if (!stateMachine) {
+		LOG_IPCP_DBG("Enrollment state machine of port-id %d is gone",
+			     con_handle.port_id);
+		return;
+	}
+
+	stateMachine->start(ei_request,
+			    invoke_id,
+			    con_handle);
+}
+
+//Class StopEnrollmentTask
+StopEnrollmentTask::StopEnrollmentTask(IPCPEnrollmentTask * et,
+				       const configs::EnrollmentInformationRequest& eiRequest,
+				       int id,
+				       const rina::cdap_rib::con_handle_t& con)
+{
+	enrollment_task = et;
+	ei_request = eiRequest;
+	invoke_id = id;
+	con_handle = con;
+}
+
+void StopEnrollmentTask::run()
+{
+	EnrolleeStateMachine * stateMachine;
+	stateMachine = (EnrolleeStateMachine *) enrollment_task->getEnrollmentStateMachine(con_handle.port_id,
+											   false);
+	if (!stateMachine) {
+		LOG_IPCP_DBG("Enrollment state machine of port-id %d is gone",
+			     con_handle.port_id);
+		return;
+	}
+
+	stateMachine->stop(ei_request,
+			   invoke_id,
+			   con_handle);
+}
+
 class EnrollmentTaskPs: public IPCPEnrollmentTaskPS {
 public:
 	EnrollmentTaskPs(IPCProcess * ipcp_);
@@ -1712,7 +1879,6 @@ private:
         IPCProcess * ipcp;
         IPCPEnrollmentTask * et;
         int timeout;
-        rina::Lockable lock;
         rina::IPCResourceManager * irm;
         IPCPRIBDaemon * rib_daemon;
         rina::Timer timer;
@@ -1759,8 +1925,6 @@ void EnrollmentTaskPs::populate_rib()
 void EnrollmentTaskPs::connect_received(const rina::cdap::CDAPMessage& cdapMessage,
 		     	     	        const rina::cdap_rib::con_handle_t &con_handle)
 {
-	rina::ScopedLock g(lock);
-
 	try{
 		rina::FlowInformation flowInformation =
 			irm->getNMinus1FlowInformation(con_handle.port_id);
@@ -1799,8 +1963,6 @@ void EnrollmentTaskPs::connect_response_received(int result,
 			     	     	         const rina::cdap_rib::con_handle_t &con_handle,
 						 const rina::cdap_rib::auth_policy_t &auth)
 {
-	rina::ScopedLock g(lock);
-
 	EnrolleeStateMachine * stateMachine =
 			(EnrolleeStateMachine*) et->getEnrollmentStateMachine(con_handle.port_id,
 									      false);
@@ -1826,8 +1988,6 @@ void EnrollmentTaskPs::connect_response_received(int result,
 void EnrollmentTaskPs::process_authentication_message(const rina::cdap::CDAPMessage& message,
 						      const rina::cdap_rib::con_handle_t &con_handle)
 {
-	rina::ScopedLock g(lock);
-
 	IEnrollmentStateMachine * stateMachine =
 		et->getEnrollmentStateMachine(con_handle.port_id,
 					      false);
@@ -1848,8 +2008,6 @@ void EnrollmentTaskPs::process_authentication_message(const rina::cdap::CDAPMess
 
 void EnrollmentTaskPs::authentication_completed(int port_id, bool success)
 {
-	rina::ScopedLock g(lock);
-
 	IEnrollmentStateMachine * stateMachine =
 					et->getEnrollmentStateMachine(port_id, false);
 
@@ -1874,8 +2032,6 @@ void EnrollmentTaskPs::initiate_enrollment(const rina::NMinusOneFlowAllocatedEve
         int t = currentTime.get_current_time_in_ms();
         LOG_IPCP_INFO("initiate_enrollment at %d", t);
 
-        rina::ScopedLock g(lock);
-
 	EnrolleeStateMachine * enrollmentStateMachine = 0;
 
 	//1 Tell the enrollment task to create a new Enrollment state machine
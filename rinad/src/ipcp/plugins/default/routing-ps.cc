@@ -843,6 +843,7 @@ FlowStateObject::FlowStateObject()
 	cost = 0;
 	state_up = false;
 	seq_num = 0;
+	generation = 0;
 	age = 0;
 	modified = false;
 	avoid_port = 0;
@@ -861,6 +862,7 @@ FlowStateObject::FlowStateObject(const std::string& name_,
 	cost = cost_;
 	state_up = up;
 	seq_num = sequence_number;
+	generation = 0;
 	age = age_;
 	std::stringstream ss;
 	ss << FlowStateRIBObject::object_name_prefix
@@ -1018,9 +1020,12 @@ const std::string FlowStateRIBObject::get_displayable_value() const
 }
 
 // CLASS FlowStateObjects
+const unsigned int FlowStateObjects::MAX_TOMBSTONES = 4096;
+
 FlowStateObjects::FlowStateObjects(LinkStateRoutingPolicy * ps)
 {
 	modified_ = false;
+	tombstones_floor = 0;
 	ps_ = ps;
 	rina::rib::RIBObj *rib_objects = new FlowStateRIBObjects(this, ps);
 	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*)IPCPFactory::getIPCP()
@@ -1132,6 +1137,7 @@ void FlowStateObjects::addCheckedObject(const FlowStateObject& object)
 	fso->set_addresses(object.addresses);
 	fso->set_neighboraddresses(object.neighbor_addresses);
 
+	eraseTombstone(object.object_name);
 	objects[object.object_name] = fso;
 	rina::rib::RIBObj* rib_obj = new FlowStateRIBObject(fso);
 	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*)IPCPFactory::getIPCP()->get_rib_daemon();
@@ -1224,10 +1230,45 @@ void FlowStateObjects::removeObject(const std::string& fqn)
 	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*) IPCPFactory::getIPCP()->get_rib_daemon();
 	rib_daemon->removeObjRIB(it->second->object_name);
 
+	// An object that aged out without being deprecated may still be alive
+	// at its origin, what was received from neighbors is not complete anymore
+	if (it->second->state_up)
+		rib_daemon->invalidate_held_rib_versions(FlowStateRIBObjects::clazz_name);
+
+	// Keep it deprecated, so that a neighbor that gets a delta later
+	// deprecates its copy too
+	FlowStateObject tombstone(*it->second);
+	if (tombstone.state_up) {
+		tombstone.state_up = false;
+		tombstone.seq_num++;
+	}
+	tombstone.generation = rib_daemon->next_rib_generation();
+	eraseTombstone(fqn);
+	tombstones[fqn] = tombstone;
+	tombstones_by_gen[tombstone.generation] = fqn;
+
+	while (tombstones.size() > MAX_TOMBSTONES) {
+		tombstones_floor = tombstones_by_gen.begin()->first;
+		tombstones.erase(tombstones_by_gen.begin()->second);
+		tombstones_by_gen.erase(tombstones_by_gen.begin());
+	}
+
 	objects.erase(it);
 	delete it->second;
 }
 
+void FlowStateObjects::eraseTombstone(const std::string& fqn)
+{
+	std::map<std::string, FlowStateObject>::iterator it;
+
+	it = tombstones.find(fqn);
+	if (it == tombstones.end())
+		return;
+
+	tombstones_by_gen.erase(it->second.generation);
+	tombstones.erase(it);
+}
+
 FlowStateObject* FlowStateObjects::getObject(const std::string& fqn)
 {
 	rina::ScopedLock g(lock);
@@ -1332,17 +1373,24 @@ void FlowStateObjects::encodeAllFSOs(rina::ser_obj_t& obj)
 }
 
 void FlowStateObjects::getAllFSOsForPropagation(std::list< std::list<FlowStateObject> >& fsos,
-						unsigned int max_objects)
+						unsigned int max_objects,
+						unsigned long long since)
 {
 	rina::ScopedLock g(lock);
 	std::list<FlowStateObject> fsolist;
 
-	if (objects.empty())
-		return;
+	// The neighbor may hold objects removed since then that we cannot
+	// tell it about anymore, send everything
+	if (since < tombstones_floor)
+		since = 0;
 
 	for (std::map<std::string, FlowStateObject*>::iterator it
 			= objects.begin(); it != objects.end();++it)
 	{
+		if (since != 0 && !it->second->modified &&
+				it->second->generation <= since)
+			continue;
+
 		if (fsolist.size() == max_objects) {
 			fsos.push_back(fsolist);
 			fsolist.clear();
@@ -1351,6 +1399,20 @@ void FlowStateObjects::getAllFSOsForPropagation(std::list< std::list<FlowStateOb
 		fsolist.push_back(*(it->second));
 	}
 
+	// A full copy replaces what the neighbor had, it gets no removals
+	if (since != 0) {
+		for (std::map<unsigned long long, std::string>::iterator jt =
+				tombstones_by_gen.upper_bound(since);
+				jt != tombstones_by_gen.end(); ++jt) {
+			if (fsolist.size() == max_objects) {
+				fsos.push_back(fsolist);
+				fsolist.clear();
+			}
+
+			fsolist.push_back(tombstones[jt->second]);
+		}
+	}
+
 	if (fsolist.size() != 0) {
 		fsos.push_back(fsolist);
 	}
@@ -1540,6 +1602,12 @@ void FlowStateManager::prepareForPropagation(std::map<int, std::list< std::list<
 	std::list<FlowStateObject *> modifiedFSOs;
 	fsos->getModifiedFSOs(modifiedFSOs);
 
+	if (modifiedFSOs.empty())
+		return;
+
+	IPCPRIBDaemon* rib_daemon = (IPCPRIBDaemon*) IPCPFactory::getIPCP()->get_rib_daemon();
+	unsigned long long generation = rib_daemon->next_rib_generation();
+
 	//2 add each modified object to its port list
 	for (std::list<FlowStateObject*>::iterator it = modifiedFSOs.begin();
 			it != modifiedFSOs.end(); ++it)
@@ -1574,6 +1642,7 @@ void FlowStateManager::prepareForPropagation(std::map<int, std::list< std::list<
 		}
 
 		(*it)->modified = false;
+		(*it)->generation = generation;
 		(*it)->avoid_port = NO_AVOID_PORT;
 	}
 }
@@ -1604,9 +1673,10 @@ void FlowStateManager::getAllFSOs(std::list<FlowStateObject>& list) const
 }
 
 void FlowStateManager::getAllFSOsForPropagation(std::list< std::list<FlowStateObject> >& fsolist,
-						unsigned int max_objects)
+						unsigned int max_objects,
+						unsigned long long since)
 {
-	fsos->getAllFSOsForPropagation(fsolist, max_objects);
+	fsos->getAllFSOsForPropagation(fsolist, max_objects, since);
 }
 
 void FlowStateManager::deprecateObjectsNeighbor(const std::string& neigh_name,
@@ -2001,21 +2071,29 @@ void LinkStateRoutingPolicy::processNeighborAddedEvent(rina::NeighborAddedEvent
 				ipc_process_->get_name(), 10000);
 	}
 
+	// The neighbor will have all the changes up to this generation. If it
+	// already had the FSDB (it is enrolling again) send only what changed
+	unsigned long long generation = rib_daemon_->get_rib_generation();
+	unsigned long long since = rib_daemon_->get_neighbor_rib_generation(
+			event->neighbor_.get_name().processName,
+			FlowStateRIBObjects::clazz_name);
+
 	std::list< std::list<FlowStateObject> > all_fsos;
 	FlowStateObjectListEncoder encoder;
-	db_->getAllFSOsForPropagation(all_fsos, max_objects_per_rupdate_);
+	rina::cdap_rib::con_handle_t con;
+	bool sent = true;
+	con.port_id = portId;
+	db_->getAllFSOsForPropagation(all_fsos, max_objects_per_rupdate_, since);
 	for (std::list< std::list<FlowStateObject> >::iterator it = all_fsos.begin();
 			it != all_fsos.end(); ++it) {
 		try {
 			rina::cdap_rib::obj_info_t obj;
-			rina::cdap_rib::con_handle_t con;
 			obj.class_ = FlowStateRIBObjects::clazz_name;
 			obj.name_ = FlowStateRIBObjects::object_name;
 			encoder.encode(*it, obj.value_);
 			obj.inst_ = 0;
 			rina::cdap_rib::flags_t flags;
 			rina::cdap_rib::filt_info_t filt;
-			con.port_id = portId;
 			if (obj.value_.size_ != 0)
 				rib_daemon_->getProxy()->remote_write(con,
 						obj,
@@ -2024,9 +2102,15 @@ void LinkStateRoutingPolicy::processNeighborAddedEvent(rina::NeighborAddedEvent
 						0);
 		} catch (rina::Exception &e) {
 			LOG_IPCP_ERR("Problems encoding and sending CDAP message: %s", e.what());
+			sent = false;
 		}
 	}
 
+	// Otherwise the neighbor would skip what it missed in the next delta
+	if (sent)
+		rib_daemon_->send_rib_version(con, FlowStateRIBObjects::clazz_name,
+					      generation);
+
 	//Force a routing table update
 	db_->force_table_update();
 	_routingTableUpdate();
@@ -319,6 +319,9 @@ public:
 	// A sequence number to be able to discard old information
 	unsigned int seq_num;
 
+	// Generation of the RIB Daemon when it was last propagated
+	unsigned long long generation;
+
 	// Avoid port in the next propagation
 	int avoid_port;
 
@@ -397,15 +400,26 @@ public:
 			  unsigned int avoid_port);
 	void encodeAllFSOs(rina::ser_obj_t& obj);
 	void getAllFSOsForPropagation(std::list< std::list<FlowStateObject> >& fsos,
-				      unsigned int max_objects);
+				      unsigned int max_objects,
+				      unsigned long long since);
 	bool is_modified() const;
 	void has_modified(bool modified);
 	void set_wait_until_remove_object(unsigned int wait_object);
 	void removeObject(const std::string& fqn);
 
+	/// Removed objects remembered to tell neighbors in a delta
+	static const unsigned int MAX_TOMBSTONES;
+
 private:
 	void addCheckedObject(const FlowStateObject& object);
+	void eraseTombstone(const std::string& fqn);
 	std::map<std::string,FlowStateObject*> objects;
+	/// The last MAX_TOMBSTONES objects removed, deprecated, by name and
+	/// by the generation they were removed at
+	std::map<std::string, FlowStateObject> tombstones;
+	std::map<unsigned long long, std::string> tombstones_by_gen;
+	/// Removals up to this generation have been forgotten
+	unsigned long long tombstones_floor;
 	//Signals a modification in the FlowStateDB
 	bool modified_;
 	LinkStateRoutingPolicy * ps_;
@@ -496,8 +510,12 @@ public:
 	void getAllFSOs(std::list<FlowStateObject>& list) const;
 	bool tableUpdate() const;
 	void removeObject(const std::string& fqn);
+	/// The FSOs changed or removed after generation since of the RIB
+	/// Daemon, all of them if since is 0 or removals after since have
+	/// been forgotten
 	void getAllFSOsForPropagation(std::list< std::list<FlowStateObject> >& fsos,
-				      unsigned int max_objects);
+				      unsigned int max_objects,
+				      unsigned long long since);
 
 	//Force a routing table update;
 	void force_table_update();
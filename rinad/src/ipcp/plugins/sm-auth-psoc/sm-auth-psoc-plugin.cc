@@ -4,6 +4,7 @@
 #include "ipcp/components.h"
 
 #include <librina/tlshand-authp.h>
+#include <librina/ecdhe-authp.h>
 
 namespace rinad {
 
@@ -83,6 +84,33 @@ destroyAuthTLSHandPs(rina::IPolicySet * ps)
         }
 }
 
+#ifdef LIBRINA_HAVE_ECDHE_AUTH
+extern "C" rina::IPolicySet *
+createAuthECDHEPs(rina::ApplicationEntity * ctx)
+{
+	IPCPSecurityManager * sm = dynamic_cast<IPCPSecurityManager *>(ctx);
+        if (!sm || !sm->get_application_process()) {
+                return NULL;
+        }
+
+        IPCPRIBDaemon * rib_daemon =
+        		dynamic_cast<IPCPRIBDaemon *>(sm->get_application_process()->get_rib_daemon());
+        if (!rib_daemon) {
+        	return NULL;
+        }
+
+        return new rina::AuthECDHEPolicySet(rib_daemon->getProxy(), sm);
+}
+
+extern "C" void
+destroyAuthECDHEPs(rina::IPolicySet * ps)
+{
+        if (ps) {
+                delete ps;
+        }
+}
+#endif
+
 extern "C" int
 get_factories(std::vector<struct rina::PsFactory>& factories)
 {
@@ -108,6 +136,16 @@ get_factories(std::vector<struct rina::PsFactory>& factories)
 	auth_tls_hand_factory.destroy = destroyAuthTLSHandPs;
 	factories.push_back(auth_tls_hand_factory);
 
+#ifdef LIBRINA_HAVE_ECDHE_AUTH
+	struct rina::PsFactory auth_ecdhe_factory;
+
+	auth_ecdhe_factory.info.name = rina::IAuthPolicySet::AUTH_ECDHE;
+	auth_ecdhe_factory.info.app_entity = rina::ApplicationEntity::SECURITY_MANAGER_AE_NAME;
+	auth_ecdhe_factory.create = createAuthECDHEPs;
+	auth_ecdhe_factory.destroy = destroyAuthECDHEPs;
+	factories.push_back(auth_ecdhe_factory);
+#endif
+
 	return 0;
 }
 
@@ -23,6 +23,10 @@
 #define IPCP_MODULE "rib-daemon"
 #include "ipcp-logging.h"
 
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
 #include <librina/cdap_v2.h>
 #include <librina/common.h>
 #include <librina/rib_v2.h>
@@ -464,6 +468,65 @@ void RIBDaemonRO::read(const rina::cdap_rib::con_handle_t &con,
         res.code_ = rina::cdap_rib::CDAP_SUCCESS;
 }
 
+// CLASS RIBVersionsRO
+const std::string RIBVersionsRO::class_name = "RIBVersions";
+const std::string RIBVersionsRO::object_name = "/ribd/versions";
+
+RIBVersionsRO::RIBVersionsRO(IPCPRIBDaemonImpl * ribd) :
+                rina::rib::RIBObj(class_name)
+{
+        rib_daemon = ribd;
+}
+
+const std::string RIBVersionsRO::get_displayable_value() const
+{
+        std::stringstream ss;
+        std::list<configs::RIBVersion> versions =
+                        rib_daemon->get_held_rib_versions();
+
+        for (std::list<configs::RIBVersion>::iterator it = versions.begin();
+                        it != versions.end(); ++it) {
+                ss << "Class: " << it->class_ << "; Epoch: " << it->epoch_
+                   << "; Generation: " << it->generation_ << std::endl;
+        }
+
+        return ss.str();
+}
+
+void RIBVersionsRO::read(const rina::cdap_rib::con_handle_t &con,
+                         const std::string& fqn,
+                         const std::string& class_,
+                         const rina::cdap_rib::filt_info_t &filt,
+                         const int invoke_id,
+                         rina::cdap_rib::obj_info_t &obj_reply,
+                         rina::cdap_rib::res_info_t& res)
+{
+        encoders::RIBVersionListEncoder encoder;
+        encoder.encode(rib_daemon->get_held_rib_versions(), obj_reply.value_);
+        res.code_ = rina::cdap_rib::CDAP_SUCCESS;
+}
+
+void RIBVersionsRO::write(const rina::cdap_rib::con_handle_t &con,
+                          const std::string& fqn,
+                          const std::string& class_,
+                          const rina::cdap_rib::filt_info_t &filt,
+                          const int invoke_id,
+                          const rina::ser_obj_t &obj_req,
+                          rina::ser_obj_t &obj_reply,
+                          rina::cdap_rib::res_info_t& res)
+{
+        std::list<configs::RIBVersion> versions;
+        encoders::RIBVersionListEncoder encoder;
+        encoder.decode(obj_req, versions);
+
+        for (std::list<configs::RIBVersion>::iterator it = versions.begin();
+                        it != versions.end(); ++it) {
+                rib_daemon->set_held_rib_version(*it);
+        }
+
+        res.code_ = rina::cdap_rib::CDAP_SUCCESS;
+}
+
 // Class InternalFlowSDUReader
 InternalFlowSDUReader::InternalFlowSDUReader(int port_id,
 					     int fd_,
@@ -524,11 +587,30 @@ int InternalFlowSDUReader::run()
 IPCPRIBDaemonImpl::IPCPRIBDaemonImpl(rina::cacep::AppConHandlerInterface *app_con_callback)
 {
 	n_minus_one_flow_manager_ = 0;
+	mgmt_sdu_reader = 0;
 	aconcback = app_con_callback;
+
+	// Different every time the IPC Process is started, so that the
+	// generations of a previous incarnation are never taken as current
+	rib_epoch = ((unsigned long long) time(0) << 32) ^
+		    ((unsigned long long) getpid() << 16) ^ std::rand();
+	if (rib_epoch == 0)
+		rib_epoch = 1;
+	rib_generation = 0;
 }
 
 IPCPRIBDaemonImpl::~IPCPRIBDaemonImpl()
 {
+	void * status;
+
+	// The reader hands SDUs to the RIB, stop it before the RIB goes
+	if (mgmt_sdu_reader) {
+		rina::kernelIPCProcess->stopMgmtSDUReader();
+		mgmt_sdu_reader->join(&status);
+		delete mgmt_sdu_reader;
+		mgmt_sdu_reader = 0;
+	}
+
 	rina::rib::fini();
 }
 
@@ -574,6 +656,9 @@ void IPCPRIBDaemonImpl::initialize_rib_daemon(rina::cacep::AppConHandlerInterfac
 		robj = new RIBDaemonRO(rib);
 		ribd->addObjRIB(rib, "/ribd", &robj);
 
+		robj = new RIBVersionsRO(this);
+		ribd->addObjRIB(rib, RIBVersionsRO::object_name, &robj);
+
 		robj = new rina::rib::RIBObj("SDUDelimiting");
 		ribd->addObjRIB(rib, "/sdudel", &robj);
 	} catch (rina::Exception &e1) {
@@ -598,6 +683,20 @@ void IPCPRIBDaemonImpl::set_application_process(rina::ApplicationProcess * ap)
         initialize_rib_daemon(aconcback);
 
         subscribeToEvents();
+
+        start_mgmt_sdu_channel_reader();
+}
+
+void IPCPRIBDaemonImpl::start_mgmt_sdu_channel_reader()
+{
+	if (rina::kernelIPCProcess->openMgmtSDUChannel() < 0) {
+		LOG_IPCP_INFO("No management SDU channel, management SDUs "
+			      "will be notified through events");
+		return;
+	}
+
+	mgmt_sdu_reader = new MgmtSDUChannelReader(this);
+	mgmt_sdu_reader->start();
 }
 
 void IPCPRIBDaemonImpl::set_dif_configuration(const rina::DIFInformation& dif_information) {
@@ -670,6 +769,143 @@ void IPCPRIBDaemonImpl::removeObjRIB(const std::string& fqn)
 	ribd->removeObjRIB(rib, fqn);
 }
 
+const unsigned int IPCPRIBDaemonImpl::MAX_HELD_RIB_VERSIONS = 64;
+
+unsigned long long IPCPRIBDaemonImpl::get_rib_epoch()
+{
+	return rib_epoch;
+}
+
+unsigned long long IPCPRIBDaemonImpl::get_rib_generation()
+{
+	rina::ScopedLock g(versions_lock);
+
+	return rib_generation;
+}
+
+unsigned long long IPCPRIBDaemonImpl::next_rib_generation()
+{
+	rina::ScopedLock g(versions_lock);
+
+	return ++rib_generation;
+}
+
+void IPCPRIBDaemonImpl::set_held_rib_version(const configs::RIBVersion& version)
+{
+	rina::ScopedLock g(versions_lock);
+
+	if (version.epoch_ == 0 || version.epoch_ == rib_epoch)
+		return;
+
+	std::map<unsigned long long, unsigned long long>& epochs =
+			held_versions[version.class_];
+	if (epochs.find(version.epoch_) == epochs.end() &&
+			epochs.size() >= MAX_HELD_RIB_VERSIONS) {
+		// Epochs are random, this drops an arbitrary one
+		epochs.erase(epochs.begin());
+	}
+
+	epochs[version.epoch_] = version.generation_;
+
+	LOG_IPCP_DBG("Holding objects of class %s up to generation %llu of epoch %llu",
+		     version.class_.c_str(), version.generation_, version.epoch_);
+}
+
+void IPCPRIBDaemonImpl::invalidate_held_rib_versions(const std::string& clazz)
+{
+	rina::ScopedLock g(versions_lock);
+
+	if (held_versions.erase(clazz) > 0) {
+		LOG_IPCP_DBG("Invalidated held versions of class %s",
+			     clazz.c_str());
+	}
+}
+
+std::list<configs::RIBVersion> IPCPRIBDaemonImpl::get_held_rib_versions()
+{
+	std::list<configs::RIBVersion> result;
+	std::map<std::string, std::map<unsigned long long, unsigned long long> >::iterator it;
+	std::map<unsigned long long, unsigned long long>::iterator jt;
+	configs::RIBVersion version;
+
+	rina::ScopedLock g(versions_lock);
+
+	for (it = held_versions.begin(); it != held_versions.end(); ++it) {
+		for (jt = it->second.begin(); jt != it->second.end(); ++jt) {
+			version.class_ = it->first;
+			version.epoch_ = jt->first;
+			version.generation_ = jt->second;
+			result.push_back(version);
+		}
+	}
+
+	return result;
+}
+
+void IPCPRIBDaemonImpl::set_neighbor_rib_versions(const std::string& neighbor,
+						  const std::list<configs::RIBVersion>& versions)
+{
+	rina::ScopedLock g(versions_lock);
+
+	std::map<std::string, unsigned long long>& classes =
+			neighbor_versions[neighbor];
+	classes.clear();
+
+	// Only the versions of this incarnation are of any use
+	for (std::list<configs::RIBVersion>::const_iterator it = versions.begin();
+			it != versions.end(); ++it) {
+		if (it->epoch_ == rib_epoch)
+			classes[it->class_] = it->generation_;
+	}
+}
+
+unsigned long long IPCPRIBDaemonImpl::get_neighbor_rib_generation(const std::string& neighbor,
+								   const std::string& clazz)
+{
+	std::map<std::string, std::map<std::string, unsigned long long> >::iterator it;
+	std::map<std::string, unsigned long long>::iterator jt;
+
+	rina::ScopedLock g(versions_lock);
+
+	it = neighbor_versions.find(neighbor);
+	if (it == neighbor_versions.end())
+		return 0;
+
+	jt = it->second.find(clazz);
+	if (jt == it->second.end())
+		return 0;
+
+	return jt->second;
+}
+
+void IPCPRIBDaemonImpl::send_rib_version(const rina::cdap_rib::con_handle_t& con,
+					 const std::string& clazz,
+					 unsigned long long generation)
+{
+	std::list<configs::RIBVersion> versions;
+	configs::RIBVersion version;
+	encoders::RIBVersionListEncoder encoder;
+	rina::cdap_rib::obj_info_t obj;
+	rina::cdap_rib::flags_t flags;
+	rina::cdap_rib::filt_info_t filt;
+
+	version.class_ = clazz;
+	version.epoch_ = rib_epoch;
+	version.generation_ = generation;
+	versions.push_back(version);
+
+	obj.class_ = RIBVersionsRO::class_name;
+	obj.name_ = RIBVersionsRO::object_name;
+	encoder.encode(versions, obj.value_);
+
+	try {
+		ribd->remote_write(con, obj, flags, filt, NULL);
+	} catch (rina::Exception &e) {
+		LOG_IPCP_WARN("Problems sending RIB version to port-id %d: %s",
+			      con.port_id, e.what());
+	}
+}
+
 void IPCPRIBDaemonImpl::start_internal_flow_sdu_reader(int port_id,
 						       int fd,
 						       int cdap_session)
@@ -742,24 +978,74 @@ void ETCleanStateTimerTask::run()
 }
 
 void IPCPRIBDaemonImpl::processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event)
+{
+	processManagementSDU(event.msg, event.port_id);
+}
+
+void IPCPRIBDaemonImpl::processManagementSDU(rina::ser_obj_t& message,
+					     unsigned int port_id)
 {
 	rina::cdap_rib::con_handle_t con_handle;
 
-	LOG_IPCP_DBG("Got message of %d bytes, handling to CDAP Provider", event.msg.size_);
+	LOG_IPCP_DBG("Got message of %d bytes, handling to CDAP Provider", message.size_);
 
 	//Instruct CDAP provider to process the messages
 	try {
-		rina::cdap::getProvider()->process_message(event.msg,
-							   event.port_id);
+		rina::cdap::getProvider()->process_message(message,
+							   port_id);
 	} catch(rina::Exception &e) {
 		LOG_IPCP_WARN("Error processing CDAP message on port-id %d: %s",
-			      event.port_id, e.what());
+			      port_id, e.what());
 		if (std::string(e.what()).find("M_CONNECT received on an") != std::string::npos) {
-			LOG_IPCP_WARN("Closing CDAP session on port-id %u", event.port_id);
-			con_handle.port_id = event.port_id;
+			LOG_IPCP_WARN("Closing CDAP session on port-id %u", port_id);
+			con_handle.port_id = port_id;
 			ipcp->enrollment_task_->release(0, con_handle);
 		}
 	}
 }
 
+// Class MgmtSDUChannelReader
+#define MGMT_SDU_BATCH_SIZE (64 * 1024)
+
+MgmtSDUChannelReader::MgmtSDUChannelReader(IPCPRIBDaemonImpl * ribd)
+		: rina::SimpleThread(std::string("mgmt-sdu-channel-reader"), false)
+{
+	rib_daemon = ribd;
+}
+
+int MgmtSDUChannelReader::run()
+{
+	unsigned char * buffer = new unsigned char[MGMT_SDU_BATCH_SIZE];
+	rina::ser_obj_t message;
+	const unsigned char * sdu;
+	unsigned int port_id;
+	int bytes_read;
+	int size;
+
+	LOG_IPCP_DBG("Management SDU channel reader starting");
+
+	for (;;) {
+		bytes_read = rina::kernelIPCProcess->readMgmtSDUs(buffer,
+								  MGMT_SDU_BATCH_SIZE);
+		if (bytes_read <= 0)
+			break;
+
+		rina::MgmtSDUBatch batch(buffer, bytes_read);
+		while (batch.next(port_id, sdu, size)) {
+			// Lend the SDU to the CDAP provider, no copy
+			message.message_ = const_cast<unsigned char *>(sdu);
+			message.size_ = size;
+			rib_daemon->processManagementSDU(message, port_id);
+			message.message_ = 0;
+		}
+	}
+
+	LOG_IPCP_DBG("Management SDU channel reader terminating (%d)",
+		     bytes_read);
+
+	delete[] buffer;
+
+	return 0;
+}
+
 } //namespace rinad
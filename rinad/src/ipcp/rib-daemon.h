@@ -56,6 +56,37 @@ private:
         rina::rib::rib_handle_t rib;
 };
 
+class IPCPRIBDaemonImpl;
+
+/// The versions of the objects of other IPC Processes held by this one. A
+/// neighbor writes it after sending a set of objects during enrollment
+class RIBVersionsRO: public rina::rib::RIBObj {
+public:
+        RIBVersionsRO(IPCPRIBDaemonImpl * ribd);
+        const std::string get_displayable_value() const;
+        void read(const rina::cdap_rib::con_handle_t &con,
+                  const std::string& fqn,
+                  const std::string& class_,
+                  const rina::cdap_rib::filt_info_t &filt,
+                  const int invoke_id,
+                  rina::cdap_rib::obj_info_t &obj_reply,
+                  rina::cdap_rib::res_info_t& res);
+        void write(const rina::cdap_rib::con_handle_t &con,
+                   const std::string& fqn,
+                   const std::string& class_,
+                   const rina::cdap_rib::filt_info_t &filt,
+                   const int invoke_id,
+                   const rina::ser_obj_t &obj_req,
+                   rina::ser_obj_t &obj_reply,
+                   rina::cdap_rib::res_info_t& res);
+
+        const static std::string class_name;
+        const static std::string object_name;
+
+private:
+        IPCPRIBDaemonImpl * rib_daemon;
+};
+
 /// Reads layer management SDUs from internal flows
 class InternalFlowSDUReader : public rina::SimpleThread
 {
@@ -71,6 +102,19 @@ public:
 	int fd;
 };
 
+/// Reads batches of layer management SDUs from the management SDU
+/// channel of the kernel IPC Process
+class MgmtSDUChannelReader : public rina::SimpleThread
+{
+public:
+	MgmtSDUChannelReader(IPCPRIBDaemonImpl * ribd);
+	~MgmtSDUChannelReader() throw() {};
+	int run();
+
+private:
+	IPCPRIBDaemonImpl * rib_daemon;
+};
+
 class StopInternalFlowReaderTimerTask;
 class IPCPCDAPIOHandler;
 
@@ -92,8 +136,27 @@ public:
 					    int cdap_session);
         void stop_internal_flow_sdu_reader(int port_id);
         void processReadManagementSDUEvent(rina::ReadMgmtSDUResponseEvent& event);
+        void processManagementSDU(rina::ser_obj_t& message,
+        			  unsigned int port_id);
         int get_fd(unsigned int cdap_session);
 
+        unsigned long long get_rib_epoch();
+        unsigned long long get_rib_generation();
+        unsigned long long next_rib_generation();
+        void set_held_rib_version(const configs::RIBVersion& version);
+        void invalidate_held_rib_versions(const std::string& clazz);
+        std::list<configs::RIBVersion> get_held_rib_versions();
+        void set_neighbor_rib_versions(const std::string& neighbor,
+        			       const std::list<configs::RIBVersion>& versions);
+        unsigned long long get_neighbor_rib_generation(const std::string& neighbor,
+        					       const std::string& clazz);
+        void send_rib_version(const rina::cdap_rib::con_handle_t& con,
+        		      const std::string& clazz,
+        		      unsigned long long generation);
+
+        /// Maximum number of held versions kept per object class
+        static const unsigned int MAX_HELD_RIB_VERSIONS;
+
 private:
         friend class StopInternalFlowReaderTimerTask;
 
@@ -101,7 +164,7 @@ private:
 	rina::rib::rib_handle_t rib;
 	rina::Timer timer;
         INMinusOneFlowManager * n_minus_one_flow_manager_;
-        rina::Thread * management_sdu_reader_;
+        MgmtSDUChannelReader * mgmt_sdu_reader;
         IPCPCDAPIOHandler * io_handler;
         rina::cacep::AppConHandlerInterface * aconcback;
 
@@ -113,6 +176,16 @@ private:
         std::map<int, int> fds;
         rina::Lockable iflow_readers_lock;
 
+        /// RIB versions: epoch and generation of this IPC Process, the
+        /// generations held of other IPC Processes by class and epoch, and
+        /// the generations of this IPC Process held by each neighbor by
+        /// class. Protected by versions_lock
+        unsigned long long rib_epoch;
+        unsigned long long rib_generation;
+        std::map<std::string, std::map<unsigned long long, unsigned long long> > held_versions;
+        std::map<std::string, std::map<std::string, unsigned long long> > neighbor_versions;
+        rina::Lockable versions_lock;
+
         void initialize_rib_daemon(rina::cacep::AppConHandlerInterface *app_con_callback);
 
         void subscribeToEvents();
@@ -123,6 +196,7 @@ private:
         void nMinusOneFlowAllocated(rina::NMinusOneFlowAllocatedEvent * event);
 
         void __stop_internal_flow_sdu_reader(int port_id);
+        void start_mgmt_sdu_channel_reader();
 };
 
 /// The RIB Daemon will start a thread that continuously tries to retrieve management
@@ -0,0 +1,320 @@
+#!/usr/bin/env python3
+#
+# Enrollment scale test
+#
+# Creates one shim-tcp-udp IPCP on 127.0.0.1 and N+1 normal IPCPs on top
+# of it, all of them in the same normal DIF. The first one bootstraps the
+# DIF and the others enroll to it through peer discovery, all at about the
+# same time. Reports the enrollment rate, in enrollments per second, once
+# the bootstrap IPCP sees all of them as enrolled neighbors.
+#
+# With -a the enrollments are authenticated with the SSH2 or the ECDHE
+# policy set and the N-1 flows encrypted; a keystore for all the IPCPs is
+# generated in the output directory with openssl. -k sets the keyPoolSize
+# of the ECDHE policy set. Several policy sets given to -a are run one
+# after the other and their rates compared.
+#
+# Needs the IRATI kernel modules loaded and root privileges, e.g.
+#
+#   sudo ./enrollment-scale.py -n 100 -w 8
+#   sudo ./enrollment-scale.py -n 100 -w 0    (enrollments one by one)
+#   sudo ./enrollment-scale.py -n 100 -a ecdhe -k 64
+#   sudo ./enrollment-scale.py -n 100 -a ssh2 ecdhe
+#
+
+import argparse
+import copy
+import json
+import os
+import re
+import signal
+import socket
+import subprocess
+import sys
+import time
+
+DIF = 'normal.DIF'
+SHIM_DIF = 'shim.DIF'
+HOST = '127.0.0.1'
+POLL_INTERVAL = 0.5
+
+
+def ipcp_name(i):
+    return 'scale%d.IRATI' % i
+
+
+def encode_entries(entries):
+    # "<count>:" and then "<len>:<value>" for each field of each entry
+    s = '%d:' % len(entries)
+    for fields in entries:
+        for f in fields:
+            s += '%d:%s' % (len(f), f)
+    return s
+
+
+def shim_dif(n, base_port):
+    exp_reg = []
+    dir_entry = []
+    for i in range(n + 1):
+        port = str(base_port + i)
+        exp_reg.append((ipcp_name(i), '', port))
+        dir_entry.append((ipcp_name(i), '', HOST, port))
+
+    # Peer discovery allocates a flow to the DIF name, which takes the
+    # enrollees to the bootstrap IPCP
+    dir_entry.append((DIF, '', HOST, str(base_port)))
+
+    return {
+        'difType': 'shim-tcp-udp',
+        'configParameters': {
+            'hostname': HOST,
+            'dirEntry': encode_entries(dir_entry),
+            'expReg': encode_entries(exp_reg),
+        }
+    }
+
+
+def keystore(n, auth, outdir):
+    # Private key in "key" and the public key of every IPCP under its name.
+    # All the IPCPs share the key pair, what is measured is the handshake.
+    path = os.path.join(outdir, 'keystore-%s' % auth)
+    if not os.path.isdir(path):
+        os.makedirs(path)
+
+    key = os.path.join(path, 'key')
+    if auth == 'ecdhe':
+        gen = ['openssl', 'genpkey', '-algorithm', 'ed25519', '-out', key]
+        pub = ['openssl', 'pkey', '-in', key, '-pubout']
+    else:
+        gen = ['openssl', 'genrsa', '-out', key, '2048']
+        pub = ['openssl', 'rsa', '-in', key, '-pubout']
+    subprocess.check_call(gen, stderr=subprocess.DEVNULL)
+    pem = subprocess.check_output(pub, stderr=subprocess.DEVNULL)
+
+    for i in range(n + 1):
+        with open(os.path.join(path, ipcp_name(i)), 'wb') as f:
+            f.write(pem)
+
+    return path
+
+
+def auth_profile(args, auth_name, path):
+    auth = {'name': 'PSOC_authentication-%s' % auth_name, 'version': '1',
+            'parameters': [{'name': 'keystore', 'value': path}]}
+    if auth_name == 'ssh2':
+        # The key is not encrypted, but the parameter is mandatory
+        auth['parameters'] += [{'name': 'keyExchangeAlg', 'value': 'EDH'},
+                               {'name': 'keystorePass', 'value': ''}]
+    else:
+        auth['parameters'].append({'name': 'keyPoolSize',
+                                   'value': str(args.key_pool)})
+
+    return {
+        'authPolicy': auth,
+        'encryptPolicy': {
+            'name': 'default', 'version': '1',
+            'parameters': [{'name': 'encryptAlg', 'value': 'AES128'},
+                           {'name': 'macAlg', 'value': 'SHA256'},
+                           {'name': 'compressAlg', 'value': 'deflate'}]
+        }
+    }
+
+
+def normal_dif(template, n, workers, profile):
+    dif = copy.deepcopy(template)
+
+    dif['knownIPCProcessAddresses'] = [
+        {'apName': ipcp_name(i), 'apInstance': '1', 'address': 16 + i}
+        for i in range(n + 1)]
+
+    params = dif['enrollmentTaskConfiguration']['policySet']['parameters']
+    params.append({'name': 'enrollmentWorkers', 'value': str(workers)})
+
+    if profile:
+        dif['securityManagerConfiguration']['authSDUProtProfiles'] = {
+            'default': profile}
+
+    return dif
+
+
+def ipcm_conf(n, prefix, outdir):
+    ipcps = [{'apName': 'scale-shim', 'apInstance': '1',
+              'difName': SHIM_DIF}]
+    for i in range(n + 1):
+        ipcp = {'apName': ipcp_name(i), 'apInstance': '1',
+                'difName': DIF, 'difsToRegisterAt': [SHIM_DIF]}
+        if i > 0:
+            ipcp['n1difPeerDiscovery'] = [SHIM_DIF]
+        ipcps.append(ipcp)
+
+    return {
+        'configFileVersion': '1.4.1',
+        'localConfiguration': {
+            'installationPath': os.path.join(prefix, 'bin'),
+            'libraryPath': os.path.join(prefix, 'lib'),
+            'logPath': outdir,
+            'consoleSocket': os.path.join(outdir, 'ipcm-console.sock'),
+            'pluginsPaths': [os.path.join(prefix, 'lib/rinad/ipcp')],
+        },
+        'ipcProcessesToCreate': ipcps,
+        'difConfigurations': [
+            {'name': SHIM_DIF, 'template': 'scale-shim.dif'},
+            {'name': DIF, 'template': 'scale-normal.dif'},
+        ]
+    }
+
+
+def console_command(path, cmd):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.settimeout(10)
+    s.connect(path)
+    data = b''
+    try:
+        s.sendall((cmd + '\n').encode('ascii'))
+        # The console prompt ends the response
+        while data.decode('ascii', 'replace').count('IPCM >>>') < 2:
+            chunk = s.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+    finally:
+        s.close()
+
+    return data.decode('ascii', 'replace')
+
+
+def enrolled_neighbors(sock, ipcp_id):
+    out = console_command(sock, 'query-rib %d Neighbor' % ipcp_id)
+    return out.count('Enrolled: 1')
+
+
+def find_ipcp_id(sock, name):
+    out = console_command(sock, 'list-ipcps')
+    m = re.search(r'^\s*(\d+) \| %s:' % re.escape(name), out, re.M)
+    return int(m.group(1)) if m else None
+
+
+def run(args, auth, template, outdir):
+    # Returns the enrollments per second, None if not all enrolled
+    if not os.path.isdir(outdir):
+        os.makedirs(outdir)
+
+    profile = None
+    if auth != 'none':
+        profile = auth_profile(args, auth, keystore(args.enrollees, auth,
+                                                    outdir))
+
+    files = {
+        'scale-shim.dif': shim_dif(args.enrollees, args.base_port),
+        'scale-normal.dif': normal_dif(template, args.enrollees,
+                                       args.workers, profile),
+        'ipcmanager.conf': ipcm_conf(args.enrollees, args.prefix, outdir),
+    }
+    for name, content in files.items():
+        with open(os.path.join(outdir, name), 'w') as f:
+            json.dump(content, f, indent=4)
+
+    sock = os.path.join(outdir, 'ipcm-console.sock')
+    if os.path.exists(sock):
+        os.unlink(sock)
+
+    log = open(os.path.join(outdir, 'ipcm.log'), 'w')
+    ipcm = subprocess.Popen([os.path.join(args.prefix, 'bin', 'ipcm'),
+                             '-c', os.path.join(outdir, 'ipcmanager.conf')],
+                            stdout=log, stderr=subprocess.STDOUT)
+    start = time.time()
+    first = None
+    enrolled = 0
+    ipcp_id = None
+    rate = None
+
+    print('%d enrollees, %d enrollment workers, %s authentication%s' %
+          (args.enrollees, args.workers, auth,
+           ', key pool of %d' % args.key_pool if auth == 'ecdhe' else ''))
+
+    try:
+        while time.time() - start < args.timeout:
+            time.sleep(POLL_INTERVAL)
+            if ipcm.poll() is not None:
+                print('ipcm exited with %d' % ipcm.returncode)
+                break
+            try:
+                if ipcp_id is None:
+                    ipcp_id = find_ipcp_id(sock, ipcp_name(0))
+                    continue
+                enrolled = enrolled_neighbors(sock, ipcp_id)
+            except (socket.error, socket.timeout):
+                continue
+
+            now = time.time()
+            if enrolled and first is None:
+                first = now
+            sys.stdout.write('\r%6.1f s: %d/%d enrolled, %.1f enrollments/s' %
+                             (now - start, enrolled, args.enrollees,
+                              enrolled / (now - start)))
+            sys.stdout.flush()
+
+            if enrolled >= args.enrollees:
+                rate = enrolled / (now - start)
+                print('\n%.1f enrollments/s, %.1f enrollments/s after '
+                      'the first one (polled every %.1f s)' %
+                      (rate, (enrolled - 1) / max(now - first, POLL_INTERVAL),
+                       POLL_INTERVAL))
+                break
+        else:
+            print('\nTimed out, %d/%d enrolled' % (enrolled, args.enrollees))
+    finally:
+        if ipcm.poll() is None:
+            ipcm.send_signal(signal.SIGINT)
+            try:
+                ipcm.wait(30)
+            except subprocess.TimeoutExpired:
+                ipcm.kill()
+        log.close()
+
+    return rate
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+
+    parser = argparse.ArgumentParser(description='Enrollment scale test')
+    parser.add_argument('-n', '--enrollees', type=int, default=100,
+                        help='IPCPs that enroll to the bootstrap one')
+    parser.add_argument('-w', '--workers', type=int, default=8,
+                        help='enrollmentWorkers of the DIF, 0 for none')
+    parser.add_argument('-a', '--auth', choices=['none', 'ssh2', 'ecdhe'],
+                        nargs='+', default=['none'],
+                        help='authentication policy sets to run')
+    parser.add_argument('-k', '--key-pool', type=int, default=0,
+                        help='keyPoolSize of the ecdhe policy set')
+    parser.add_argument('-p', '--base-port', type=int, default=33000,
+                        help='first TCP/UDP port of the shim IPCP')
+    parser.add_argument('-t', '--timeout', type=int, default=600,
+                        help='seconds to wait for all enrollments')
+    parser.add_argument('--prefix', default='/usr/local/irati',
+                        help='IRATI installation prefix')
+    parser.add_argument('-o', '--outdir', default='/tmp/enrollment-scale',
+                        help='where the configuration and logs go')
+    args = parser.parse_args()
+
+    with open(os.path.join(here, 'conf', 'default.dif')) as f:
+        template = json.load(f)
+
+    rates = []
+    for auth in args.auth:
+        outdir = args.outdir
+        if len(args.auth) > 1:
+            outdir = os.path.join(args.outdir, auth)
+        rates.append((auth, run(args, auth, template, outdir)))
+
+    if len(rates) > 1:
+        print('\n%-6s %s' % ('auth', 'enrollments/s'))
+        for auth, rate in rates:
+            print('%-6s %s' % (auth, '%.1f' % rate if rate else 'failed'))
+
+    return 0 if all(rate for auth, rate in rates) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,298 @@
+#!/usr/bin/env python3
+#
+# SDU protection error check throughput test
+#
+# Two hosts, each with a shim-tcp-udp IPCP bound to its address and one
+# normal IPCP on top of it, in the same normal DIF. The DIF protects every
+# PDU on its N-1 ports with the error check policy set given with -e. The
+# server bootstraps the DIF and runs a rinaperf server, the client enrolls
+# to it and runs a rinaperf perf test for each SDU size, then prints the
+# throughput measured by the receiver.
+#
+# Both ends must be on different hosts: the IPCM serves all the
+# applications of a DIF with the first of its IPCPs, so on a single host
+# the rinaperf flow would never leave that IPCP and no PDU would be
+# protected. Run the same command, with the same -e, on both hosts:
+#
+#   host A: sudo ./errc-throughput.py -r server -l 10.0.0.1 -R 10.0.0.2 -e CRC32C
+#   host B: sudo ./errc-throughput.py -r client -l 10.0.0.2 -R 10.0.0.1 -e CRC32C
+#
+# Needs the IRATI kernel modules loaded (and crc32c-plugin for CRC32C) and
+# root privileges.
+#
+
+import argparse
+import copy
+import json
+import os
+import re
+import signal
+import socket
+import subprocess
+import sys
+import time
+
+DIF = 'errc.DIF'
+SHIM_DIF = 'errc-shim.DIF'
+SERVER = 'errc0.IRATI'
+CLIENT = 'errc1.IRATI'
+
+
+def encode_entries(entries):
+    # "<count>:" and then "<len>:<value>" for each field of each entry
+    s = '%d:' % len(entries)
+    for fields in entries:
+        for f in fields:
+            s += '%d:%s' % (len(f), f)
+    return s
+
+
+def shim_dif(args):
+    port = str(args.port)
+    server_ip = args.local if args.role == 'server' else args.remote
+    client_ip = args.remote if args.role == 'server' else args.local
+    name = SERVER if args.role == 'server' else CLIENT
+
+    dir_entry = [(SERVER, '', server_ip, port),
+                 (CLIENT, '', client_ip, port),
+                 # Peer discovery allocates a flow to the DIF name
+                 (DIF, '', server_ip, port)]
+
+    return {
+        'difType': 'shim-tcp-udp',
+        'configParameters': {
+            'hostname': args.local,
+            'dirEntry': encode_entries(dir_entry),
+            'expReg': encode_entries([(name, '', port)]),
+        }
+    }
+
+
+def normal_dif(template, args):
+    dif = copy.deepcopy(template)
+
+    dif['knownIPCProcessAddresses'] = [
+        {'apName': SERVER, 'apInstance': '1', 'address': 16},
+        {'apName': CLIENT, 'apInstance': '1', 'address': 17}]
+
+    if args.errc != 'none':
+        errc = {'name': args.errc, 'version': '1'}
+        if args.trust_offload:
+            errc['parameters'] = [{'name': 'trust_offload', 'value': '1'}]
+        dif['securityManagerConfiguration']['authSDUProtProfiles'] = {
+            'default': {
+                'authPolicy': {'name': 'PSOC_authentication-none',
+                               'version': '1'},
+                'ErrorCheckPolicy': errc,
+            }
+        }
+
+    return dif
+
+
+def ipcm_conf(args):
+    ipcp = {'apName': SERVER if args.role == 'server' else CLIENT,
+            'apInstance': '1', 'difName': DIF,
+            'difsToRegisterAt': [SHIM_DIF]}
+    if args.role == 'client':
+        ipcp['n1difPeerDiscovery'] = [SHIM_DIF]
+    ipcps = [{'apName': 'errc-shim', 'apInstance': '1',
+              'difName': SHIM_DIF}, ipcp]
+
+    return {
+        'configFileVersion': '1.4.1',
+        'localConfiguration': {
+            'installationPath': os.path.join(args.prefix, 'bin'),
+            'libraryPath': os.path.join(args.prefix, 'lib'),
+            'logPath': args.outdir,
+            'consoleSocket': os.path.join(args.outdir, 'ipcm-console.sock'),
+            'pluginsPaths': [os.path.join(args.prefix, 'lib/rinad/ipcp')],
+        },
+        'ipcProcessesToCreate': ipcps,
+        'difConfigurations': [
+            {'name': SHIM_DIF, 'template': 'errc-shim.dif'},
+            {'name': DIF, 'template': 'errc-normal.dif'},
+        ]
+    }
+
+
+def console_command(path, cmd):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.settimeout(10)
+    s.connect(path)
+    data = b''
+    try:
+        s.sendall((cmd + '\n').encode('ascii'))
+        # The console prompt ends the response
+        while data.decode('ascii', 'replace').count('IPCM >>>') < 2:
+            chunk = s.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+    finally:
+        s.close()
+
+    return data.decode('ascii', 'replace')
+
+
+def enrolled_neighbors(sock, ipcp_id):
+    out = console_command(sock, 'query-rib %d Neighbor' % ipcp_id)
+    return out.count('Enrolled: 1')
+
+
+def find_ipcp_id(sock, name):
+    out = console_command(sock, 'list-ipcps')
+    m = re.search(r'^\s*(\d+) \| %s:' % re.escape(name), out, re.M)
+    return int(m.group(1)) if m else None
+
+
+def wait_enrolled(ipcm, sock, args):
+    start = time.time()
+    ipcp_id = None
+
+    while time.time() - start < args.timeout:
+        time.sleep(1)
+        if ipcm.poll() is not None:
+            print('ipcm exited with %d' % ipcm.returncode)
+            return False
+        try:
+            if ipcp_id is None:
+                ipcp_id = find_ipcp_id(sock, CLIENT)
+                continue
+            if enrolled_neighbors(sock, ipcp_id):
+                return True
+        except (socket.error, socket.timeout):
+            continue
+
+    print('Not enrolled after %d s' % args.timeout)
+    return False
+
+
+def rinaperf(args, size):
+    out = subprocess.run([os.path.join(args.prefix, 'bin', 'rinaperf'),
+                          '-t', 'perf', '-d', DIF, '-s', str(size),
+                          '-c', str(args.count)],
+                         stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                         universal_newlines=True).stdout
+
+    # Receiver <packets> <Kpps> <Mbps>
+    m = re.search(r'^Receiver\s+(\d+)\s+([\d.]+)\s+([\d.]+)', out, re.M)
+    if not m:
+        sys.stdout.write(out)
+        return None
+
+    return int(m.group(1)), float(m.group(2)), float(m.group(3))
+
+
+def run_server(ipcm, args):
+    perf = subprocess.Popen([os.path.join(args.prefix, 'bin', 'rinaperf'),
+                             '-l', '-d', DIF])
+    print('rinaperf server running, Ctrl-C to stop')
+    try:
+        while ipcm.poll() is None and perf.poll() is None:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if perf.poll() is None:
+            perf.send_signal(signal.SIGINT)
+            perf.wait()
+
+    return 0
+
+
+def run_client(ipcm, sock, args):
+    if not wait_enrolled(ipcm, sock, args):
+        return 1
+
+    print('Error check %s%s, %d SDUs per run' %
+          (args.errc, ' (trust_offload)' if args.trust_offload else '',
+           args.count))
+    print('%6s %12s %10s %10s' % ('size', 'received', 'Kpps', 'Mbps'))
+
+    result = 0
+    for size in args.sizes:
+        res = rinaperf(args, size)
+        if res is None:
+            print('%6d failed' % size)
+            result = 1
+            continue
+        print('%6d %12d %10.3f %10.3f' % ((size,) + res))
+
+    return result
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+
+    parser = argparse.ArgumentParser(description='Error check throughput')
+    parser.add_argument('-r', '--role', choices=['server', 'client'],
+                        required=True)
+    parser.add_argument('-l', '--local', required=True,
+                        help='IP address of this host')
+    parser.add_argument('-R', '--remote', required=True,
+                        help='IP address of the other host')
+    parser.add_argument('-e', '--errc', default='CRC32',
+                        help='error check policy set, none for no check')
+    parser.add_argument('-T', '--trust-offload', action='store_true',
+                        help='set the trust_offload parameter of CRC32C, '
+                        'no effect here: shim-tcp-udp PDUs are not '
+                        'verified by the hardware')
+    parser.add_argument('-s', '--sizes', type=int, nargs='+',
+                        default=[64, 256, 1024, 1400],
+                        help='SDU sizes, in bytes')
+    parser.add_argument('-c', '--count', type=int, default=1000000,
+                        help='SDUs sent for each size')
+    parser.add_argument('-p', '--port', type=int, default=34000,
+                        help='TCP/UDP port of the shim IPCPs')
+    parser.add_argument('-t', '--timeout', type=int, default=120,
+                        help='seconds to wait for the enrollment')
+    parser.add_argument('--prefix', default='/usr/local/irati',
+                        help='IRATI installation prefix')
+    parser.add_argument('-o', '--outdir', default='/tmp/errc-throughput',
+                        help='where the configuration and logs go')
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.outdir):
+        os.makedirs(args.outdir)
+
+    with open(os.path.join(here, 'conf', 'default.dif')) as f:
+        template = json.load(f)
+
+    files = {
+        'errc-shim.dif': shim_dif(args),
+        'errc-normal.dif': normal_dif(template, args),
+        'ipcmanager.conf': ipcm_conf(args),
+    }
+    for name, content in files.items():
+        with open(os.path.join(args.outdir, name), 'w') as f:
+            json.dump(content, f, indent=4)
+
+    sock = os.path.join(args.outdir, 'ipcm-console.sock')
+    if os.path.exists(sock):
+        os.unlink(sock)
+
+    log = open(os.path.join(args.outdir, 'ipcm.log'), 'w')
+    ipcm = subprocess.Popen([os.path.join(args.prefix, 'bin', 'ipcm'),
+                             '-c', os.path.join(args.outdir,
+                                                'ipcmanager.conf')],
+                            stdout=log, stderr=subprocess.STDOUT)
+    try:
+        if args.role == 'server':
+            result = run_server(ipcm, args)
+        else:
+            result = run_client(ipcm, sock, args)
+    finally:
+        if ipcm.poll() is None:
+            ipcm.send_signal(signal.SIGINT)
+            try:
+                ipcm.wait(30)
+            except subprocess.TimeoutExpired:
+                ipcm.kill()
+        log.close()
+
+    return result
+
+
+if __name__ == '__main__':
+    sys.exit(main())